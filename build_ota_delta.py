@@ -0,0 +1,210 @@
+#!/usr/bin/env python3
+"""
+Delta-Updates für die Firmware (Format HBD1, siehe src/OTADelta.h)
+
+Ein Patch beschreibt das neue Image als Folge von
+  COPY   (Offset, Länge)  -> Bytes aus der laufenden Firmware auf dem Gerät
+  INSERT (Länge, Daten)   -> neue Bytes aus dem Patch
+Kopf: "HBD1" | Größe alt | SHA-256 alt | Größe neu | SHA-256 neu (Ganzzahlen uint32 LE)
+
+Das Gerät prüft vor dem Anwenden den SHA-256 der laufenden Firmware und vor dem
+Umschalten der Boot-Partition den des Ergebnisses.
+
+  python3 build_ota_delta.py diff   alt.bin neu.bin patch.hbd
+  python3 build_ota_delta.py apply  alt.bin patch.hbd ergebnis.bin
+  python3 build_ota_delta.py verify alt.bin neu.bin     # Hin- und Rückweg prüfen
+
+Ins OTA-Paket kommt der Patch über: python3 build_ota_package.py --base alt.bin
+"""
+
+import hashlib
+import struct
+import sys
+from pathlib import Path
+
+HBD_MAGIC = b"HBD1"
+OP_COPY = 0x01
+OP_INSERT = 0x02
+
+SEED = 16        # Mindestlänge eines Treffers im Index
+INDEX_STEP = 4   # Quelle nur an jedem 4. Offset indizieren (spart RAM)
+MIN_COPY = 24    # Kürzere Treffer lohnen den 9-Byte-COPY-Kopf nicht
+
+
+def _match_length(a, ai, b, bi, limit):
+    """Länge der Übereinstimmung ab a[ai] / b[bi], erst in großen Schritten"""
+    n = 0
+    step = 64
+    while n < limit:
+        k = min(step, limit - n)
+        if a[ai + n:ai + n + k] == b[bi + n:bi + n + k]:
+            n += k
+            step = min(step * 2, 4096)
+        elif k > 1:
+            step = max(k // 4, 1)
+        else:
+            break
+    return n
+
+
+def make_patch(old, new):
+    """Greedy-Abgleich: bevorzugt die Fortsetzung des letzten COPY, sonst der Index"""
+    index = {}
+    for i in range(0, len(old) - SEED + 1, INDEX_STEP):
+        index.setdefault(old[i:i + SEED], i)
+
+    ops = []
+    literal_start = 0
+    shift = None   # new_offset - old_offset des letzten COPY
+    t = 0
+    while t + SEED <= len(new):
+        window = new[t:t + SEED]
+        candidates = []
+        if shift is not None and 0 <= t - shift <= len(old) - SEED:
+            candidates.append(t - shift)
+        hit = index.get(window)
+        if hit is not None:
+            candidates.append(hit)
+
+        best_s, best_len, best_t = None, 0, t
+        for s in candidates:
+            if old[s:s + SEED] != window:
+                continue
+            length = _match_length(old, s, new, t, min(len(old) - s, len(new) - t))
+            # Rückwärts in noch offene Literal-Bytes verlängern
+            back = 0
+            while t - back > literal_start and s - back > 0 and new[t - back - 1] == old[s - back - 1]:
+                back += 1
+            if length + back > best_len:
+                best_s, best_len, best_t = s - back, length + back, t - back
+            if best_len >= 4096:
+                break
+
+        if best_len >= MIN_COPY:
+            if best_t > literal_start:
+                ops.append((OP_INSERT, new[literal_start:best_t]))
+            ops.append((OP_COPY, best_s, best_len))
+            t = best_t + best_len
+            literal_start = t
+            shift = best_t - best_s
+        else:
+            t += 1
+
+    if literal_start < len(new):
+        ops.append((OP_INSERT, new[literal_start:]))
+
+    out = bytearray(HBD_MAGIC)
+    out += struct.pack("<I", len(old)) + hashlib.sha256(old).digest()
+    out += struct.pack("<I", len(new)) + hashlib.sha256(new).digest()
+    for op in ops:
+        if op[0] == OP_COPY:
+            out += struct.pack("<BII", OP_COPY, op[1], op[2])
+        else:
+            out += struct.pack("<BI", OP_INSERT, len(op[1])) + op[1]
+    return bytes(out)
+
+
+def apply_patch(old, patch):
+    """Referenz zu OTADelta: gleiche Prüfungen, gleiche Reihenfolge"""
+    if patch[:4] != HBD_MAGIC:
+        raise ValueError("kein HBD1-Patch")
+    pos = 4
+    old_size, = struct.unpack_from("<I", patch, pos)
+    old_hash = patch[pos + 4:pos + 36]
+    pos += 36
+    new_size, = struct.unpack_from("<I", patch, pos)
+    new_hash = patch[pos + 4:pos + 36]
+    pos += 36
+
+    if old_size > len(old) or hashlib.sha256(old[:old_size]).digest() != old_hash:
+        raise ValueError("Patch passt nicht zur Ausgangs-Firmware")
+
+    out = bytearray()
+    while len(out) < new_size:
+        op = patch[pos]
+        if op == OP_COPY:
+            offset, length = struct.unpack_from("<II", patch, pos + 1)
+            pos += 9
+            if offset + length > old_size:
+                raise ValueError("COPY außerhalb der Ausgangs-Firmware")
+            out += old[offset:offset + length]
+        elif op == OP_INSERT:
+            length, = struct.unpack_from("<I", patch, pos + 1)
+            pos += 5
+            out += patch[pos:pos + length]
+            pos += length
+        else:
+            raise ValueError(f"unbekannte Operation 0x{op:02x}")
+        if length == 0 or len(out) > new_size:
+            raise ValueError("Operation passt nicht zur Zielgröße")
+
+    if hashlib.sha256(out).digest() != new_hash:
+        raise ValueError("Ergebnis stimmt nicht mit dem Ziel-SHA-256 überein")
+    return bytes(out)
+
+
+def _stats(patch):
+    copied = inserted = count = 0
+    pos = 76
+    while pos < len(patch):
+        if patch[pos] == OP_COPY:
+            copied += struct.unpack_from("<I", patch, pos + 5)[0]
+            pos += 9
+        else:
+            length, = struct.unpack_from("<I", patch, pos + 1)
+            inserted += length
+            pos += 5 + length
+        count += 1
+    return copied, inserted, count
+
+
+def verify(old, new):
+    from build_ota_package import pack_member
+
+    patch = make_patch(old, new)
+    if apply_patch(old, patch) != new:
+        print("❌ Patch erzeugt nicht das neue Image")
+        return False
+    copied, inserted, count = _stats(patch)
+    packed = pack_member(patch)
+    print(f"✓ Hin- und Rückweg OK: {len(old)} -> {len(new)} Bytes")
+    print(f"  {count} Operationen, {copied} Bytes kopiert, {inserted} Bytes neu")
+    print(f"  Patch {len(patch)} Bytes, komprimiert {len(packed)} Bytes "
+          f"({len(packed) * 100 / max(len(new), 1):.1f} % des Images)")
+
+    # Gegenprobe: gegen eine andere Ausgangs-Firmware muss der Patch abgelehnt werden
+    tampered = bytearray(old)
+    tampered[len(tampered) // 2] ^= 0xFF
+    try:
+        apply_patch(bytes(tampered), patch)
+        print("❌ Patch wurde auf eine fremde Firmware angewendet")
+        return False
+    except ValueError:
+        print("✓ Fremde Ausgangs-Firmware wird abgelehnt")
+    return True
+
+
+def main(argv):
+    if len(argv) == 4 and argv[0] == "diff":
+        patch = make_patch(Path(argv[1]).read_bytes(), Path(argv[2]).read_bytes())
+        Path(argv[3]).write_bytes(patch)
+        copied, inserted, count = _stats(patch)
+        print(f"{argv[3]}: {len(patch)} Bytes ({count} Operationen, {inserted} Bytes neu)")
+        return True
+    if len(argv) == 4 and argv[0] == "apply":
+        try:
+            result = apply_patch(Path(argv[1]).read_bytes(), Path(argv[2]).read_bytes())
+        except ValueError as e:
+            print(f"❌ {e}")
+            return False
+        Path(argv[3]).write_bytes(result)
+        print(f"{argv[3]}: {len(result)} Bytes, SHA-256 geprüft")
+        return True
+    if len(argv) == 3 and argv[0] == "verify":
+        return verify(Path(argv[1]).read_bytes(), Path(argv[2]).read_bytes())
+    print(__doc__)
+    return False
+
+
+if __name__ == "__main__":
+    sys.exit(0 if main(sys.argv[1:]) else 1)
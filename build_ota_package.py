@@ -2,10 +2,31 @@
 """
 Build Script für HeatBodyVentilator OTA Update Package
 Erstellt eine update.tar Datei mit firmware.bin und spiffs.bin
+
+Standardmäßig werden die Images komprimiert als firmware.bin.z / spiffs.bin.z
+abgelegt (siehe src/OTAInflate.h):
+  "HBZ1" | unkomprimierte Größe (uint32 LE) | rohes Deflate, Fenster 4 KB
+Das Gerät entpackt beim Empfang; das Fenster muss zu OTAInflate::WINDOW_SIZE passen.
+
+Als erstes Member liegt manifest.json mit Größe und SHA-256 jedes Images
+(nach dem Entpacken bzw. Anwenden des Patches):
+  {"version": 1, "firmware": {"member": "firmware.bin.z", "size": N, "sha256": "..."}, "spiffs": {...}}
+Das Gerät prüft die Images damit, bevor es bootet bzw. SPIFFS einhängt.
+Ältere Firmware überspringt die Datei.
+
+  python3 build_ota_package.py          # komprimiert
+  python3 build_ota_package.py --raw    # unkomprimiert, für Geräte mit älterer Firmware
+  python3 build_ota_package.py --base alt.bin   # firmware.hbd: Patch gegen alt.bin (build_ota_delta.py)
 """
 
+import argparse
+import hashlib
+import io
+import json
 import os
+import struct
 import tarfile
+import zlib
 from pathlib import Path
 
 # Pfade
@@ -15,7 +36,31 @@ FIRMWARE_BIN = BUILD_DIR / "firmware.bin"
 SPIFFS_BIN = BUILD_DIR / "spiffs.bin"
 OUTPUT_TAR = PROJECT_ROOT / "update.tar"
 
-def create_ota_package():
+HBZ_MAGIC = b"HBZ1"
+WINDOW_BITS = 12   # 4 KB, OTAInflate::WINDOW_SIZE
+
+
+def pack_member(data):
+    """Image im HBZ1-Format: Kopf + rohes Deflate mit kleinem Fenster"""
+    compressor = zlib.compressobj(9, zlib.DEFLATED, -WINDOW_BITS, 9)
+    body = compressor.compress(data) + compressor.flush()
+    return HBZ_MAGIC + struct.pack("<I", len(data)) + body
+
+
+def add_member(tar, arcname, data, mtime):
+    info = tarfile.TarInfo(arcname)
+    info.size = len(data)
+    info.mtime = int(mtime)
+    info.mode = 0o644
+    tar.addfile(info, io.BytesIO(data))
+
+
+def manifest_entry(member, image):
+    """Erwartetes Ergebnis auf dem Gerät, nicht der Inhalt des Members"""
+    return {"member": member, "size": len(image), "sha256": hashlib.sha256(image).hexdigest()}
+
+
+def create_ota_package(compress=True, base=None):
     """Erstellt das OTA Update Package"""
     
     print("=" * 60)
@@ -55,15 +100,41 @@ def create_ota_package():
     if OUTPUT_TAR.exists():
         OUTPUT_TAR.unlink()
     
-    with tarfile.open(OUTPUT_TAR, 'w') as tar:
-        for arcname, filepath in files_to_package:
+    raw_total = 0
+    manifest = {"version": 1}
+    members = []
+    for arcname, filepath in files_to_package:
+        image = filepath.read_bytes()
+        raw_total += len(image)
+        mtime = filepath.stat().st_mtime
+        data = image
+        if base is not None and arcname == "firmware.bin":
+            from build_ota_delta import make_patch
+            patch = make_patch(base.read_bytes(), data)
+            print(f"  Patch gegen {base.name}: {len(data)} -> {len(patch)} Bytes")
+            arcname, data = "firmware.hbd", patch
+        if compress:
+            packed = pack_member(data)
+            print(f"  Adding {arcname}.z ({len(data)} -> {len(packed)} Bytes, "
+                  f"{100 - len(packed) * 100 // len(data)}% kleiner)...")
+            arcname, data = arcname + ".z", packed
+        else:
             print(f"  Adding {arcname}...")
-            tar.add(filepath, arcname=arcname)
+        key = "firmware" if arcname.startswith("firmware.") else "spiffs"
+        manifest[key] = manifest_entry(arcname, image)
+        members.append((arcname, data, mtime))
+    
+    # Manifest zuerst: das Gerät braucht die Prüfsummen, bevor es flasht
+    with tarfile.open(OUTPUT_TAR, 'w') as tar:
+        manifest_json = json.dumps(manifest, indent=1).encode()
+        add_member(tar, "manifest.json", manifest_json, max(m[2] for m in members))
+        for arcname, data, mtime in members:
+            add_member(tar, arcname, data, mtime)
     
     # Zeige Ergebnis
     tar_size_mb = OUTPUT_TAR.stat().st_size / (1024 * 1024)
     print(f"\n✅ Update Package erstellt: {OUTPUT_TAR}")
-    print(f"   Größe: {tar_size_mb:.2f} MB")
+    print(f"   Größe: {tar_size_mb:.2f} MB (Images unkomprimiert: {raw_total / (1024 * 1024):.2f} MB)")
     print(f"   Enthält: {', '.join([f[0] for f in files_to_package])}")
     
     print("\n" + "=" * 60)
@@ -77,5 +148,11 @@ def create_ota_package():
     return True
 
 if __name__ == "__main__":
-    success = create_ota_package()
+    parser = argparse.ArgumentParser(description="OTA Update Package (update.tar) erstellen")
+    parser.add_argument("--raw", action="store_true",
+                        help="Images unkomprimiert ablegen (Geräte mit älterer Firmware)")
+    parser.add_argument("--base", type=Path, metavar="ALT.bin",
+                        help="firmware.bin als Patch gegen diese, auf den Geräten laufende Firmware")
+    args = parser.parse_args()
+    success = create_ota_package(compress=not args.raw, base=args.base)
     exit(0 if success else 1)
@@ -0,0 +1,260 @@
+#!/usr/bin/env python3
+"""
+Build Script für das Web-Interface (SPIFFS)
+Erzeugt aus data/ je Seite eine einzelne HTML-Datei:
+  - HTML, CSS und JS werden verkleinert (konservativ, Zeilenumbrüche in JS bleiben)
+  - style.css wird in die Seite eingebettet
+  - das Logo wird als SVG (data/img/logo.svg) eingebettet statt logo.png nachzuladen
+
+Ausgabe: .pio/web  (wird von platformio.ini als data_dir verwendet)
+
+Eigenständig:   python3 build_web_bundle.py
+PlatformIO:     extra_scripts = pre:build_web_bundle.py  (läuft vor jedem Build)
+"""
+
+import base64
+import re
+import shutil
+from pathlib import Path
+
+# Pfade
+PROJECT_ROOT = Path(__file__).parent if "__file__" in globals() else Path.cwd()
+SOURCE_DIR = PROJECT_ROOT / "data"
+OUTPUT_DIR = PROJECT_ROOT / ".pio" / "web"
+
+PAGES = ("login.html", "main.html", "setting.html")
+STYLESHEET = "style.css"
+LOGO_PNG_URL = "/img/logo.png"
+LOGO_SVG = SOURCE_DIR / "img" / "logo.svg"
+
+# Zusätzlich ins Image, damit direkte Links weiter funktionieren
+EXTRA_FILES = (STYLESHEET, "img/logo.svg")
+
+
+# ---------------------------------------------------------------------------
+# CSS
+# ---------------------------------------------------------------------------
+
+def minify_css(css):
+    """Kommentare und überflüssige Leerzeichen entfernen; Strings bleiben unverändert"""
+    out = []
+    i = 0
+    while i < len(css):
+        c = css[i]
+        if c in "\"'":
+            end = i + 1
+            while end < len(css) and css[end] != c:
+                end += 2 if css[end] == "\\" else 1
+            out.append(css[i:end + 1])
+            i = end + 1
+        elif css.startswith("/*", i):
+            end = css.find("*/", i + 2)
+            i = len(css) if end < 0 else end + 2
+        elif c.isspace():
+            while i < len(css) and css[i].isspace():
+                i += 1
+            out.append(" ")
+        else:
+            out.append(c)
+            i += 1
+
+    text = "".join(out)
+    # Leerzeichen um Trennzeichen (nicht um ":" wegen Selektoren wie "a :hover")
+    text = re.sub(r"\s*([{};,>])\s*", r"\1", text)
+    text = re.sub(r":\s+", ":", text)
+    text = text.replace(";}", "}")
+    return text.strip()
+
+
+# ---------------------------------------------------------------------------
+# JavaScript
+# ---------------------------------------------------------------------------
+
+# Nach diesen Zeichen beginnt ein "/" einen Regex-Literal, keine Division
+REGEX_PREFIX = set("(,=:[!&|?{};+-*%<>~^")
+REGEX_KEYWORDS = ("return", "typeof", "case", "do", "else", "in", "of", "void")
+
+
+def _skip_string(js, i):
+    quote = js[i]
+    i += 1
+    while i < len(js) and js[i] != quote:
+        if js[i] == "\\":
+            i += 1
+        elif quote == "`" and js.startswith("${", i):
+            i = _skip_template_expr(js, i + 2)
+            continue
+        i += 1
+    return i + 1
+
+
+def _skip_template_expr(js, i):
+    depth = 1
+    while i < len(js) and depth:
+        c = js[i]
+        if c in "\"'`":
+            i = _skip_string(js, i)
+            continue
+        if c == "{":
+            depth += 1
+        elif c == "}":
+            depth -= 1
+        i += 1
+    return i
+
+
+def _skip_regex(js, i):
+    i += 1
+    in_class = False
+    while i < len(js) and js[i] != "\n":
+        c = js[i]
+        if c == "\\":
+            i += 1
+        elif c == "[":
+            in_class = True
+        elif c == "]":
+            in_class = False
+        elif c == "/" and not in_class:
+            i += 1
+            while i < len(js) and (js[i].isalpha()):
+                i += 1
+            return i
+        i += 1
+    return i
+
+
+def _regex_allowed(out):
+    text = "".join(out[-12:]).rstrip()
+    if not text:
+        return True
+    if text[-1] in REGEX_PREFIX:
+        return True
+    return any(text.endswith(k) and (len(text) == len(k) or not (text[-len(k) - 1].isalnum() or text[-len(k) - 1] in "_$"))
+               for k in REGEX_KEYWORDS)
+
+
+def minify_js(js):
+    """Kommentare entfernen, Einrückung und Leerzeilen streichen.
+    Zeilenumbrüche bleiben erhalten, damit die automatische Semikolon-Einfügung unverändert greift."""
+    out = []
+    i = 0
+    while i < len(js):
+        c = js[i]
+        if c in "\"'`":
+            end = _skip_string(js, i)
+            out.append(js[i:end])
+            i = end
+        elif js.startswith("//", i):
+            end = js.find("\n", i)
+            i = len(js) if end < 0 else end
+        elif js.startswith("/*", i):
+            end = js.find("*/", i + 2)
+            i = len(js) if end < 0 else end + 2
+            out.append(" ")
+        elif c == "/" and _regex_allowed(out):
+            end = _skip_regex(js, i)
+            out.append(js[i:end])
+            i = end
+        else:
+            out.append(c)
+            i += 1
+
+    lines = []
+    for line in "".join(out).split("\n"):
+        line = line.strip()
+        if line:
+            lines.append(line)
+    return "\n".join(lines)
+
+
+# ---------------------------------------------------------------------------
+# HTML
+# ---------------------------------------------------------------------------
+
+BLOCK_RE = re.compile(r"(<(script|style|pre|textarea)\b[^>]*>)(.*?)(</\2\s*>)", re.S | re.I)
+
+
+def minify_html(html, stylesheet_css, logo_data_url):
+    # Externes Stylesheet einbetten
+    if stylesheet_css is not None:
+        html = re.sub(r'<link\s+rel="stylesheet"\s+href="/?%s"\s*/?>' % re.escape(STYLESHEET),
+                      lambda m: "<style>" + stylesheet_css + "</style>", html)
+    # Logo einbetten
+    if logo_data_url is not None:
+        html = html.replace('src="%s"' % LOGO_PNG_URL, 'src="%s"' % logo_data_url)
+
+    # Blöcke mit eigenem Inhalt herauslösen, damit die HTML-Regeln sie nicht verändern
+    blocks = []
+
+    def stash(match):
+        open_tag, tag, body, close_tag = match.group(1), match.group(2).lower(), match.group(3), match.group(4)
+        if tag == "script" and "src=" not in open_tag:
+            body = minify_js(body)
+            body = "\n" + body + "\n" if body else ""
+        elif tag == "style":
+            body = minify_css(body)
+        blocks.append(open_tag + body + close_tag)
+        return "\x00%d\x00" % (len(blocks) - 1)
+
+    html = BLOCK_RE.sub(stash, html)
+    html = re.sub(r"<!--(?!\[if).*?-->", "", html, flags=re.S)
+    # Whitespace zusammenfassen; ein Leerzeichen bleibt, da es zwischen Inline-Elementen sichtbar ist
+    html = re.sub(r"\s*\n\s*", "\n", html)
+    html = re.sub(r"[ \t]+", " ", html)
+    html = re.sub(r">\n<", "><", html)
+    html = re.sub(r"\x00(\d+)\x00", lambda m: blocks[int(m.group(1))], html)
+    return html.strip() + "\n"
+
+
+# ---------------------------------------------------------------------------
+
+def build():
+    print("=" * 60)
+    print("HeatBodyVentilator Web Bundle")
+    print("=" * 60)
+
+    stylesheet = SOURCE_DIR / STYLESHEET
+    stylesheet_css = minify_css(stylesheet.read_text(encoding="utf-8")) if stylesheet.exists() else None
+    logo_data_url = None
+    if LOGO_SVG.exists():
+        svg = LOGO_SVG.read_bytes().strip()
+        logo_data_url = "data:image/svg+xml;base64," + base64.b64encode(svg).decode("ascii")
+
+    if OUTPUT_DIR.exists():
+        shutil.rmtree(OUTPUT_DIR)
+    OUTPUT_DIR.mkdir(parents=True)
+
+    for page in PAGES:
+        source = SOURCE_DIR / page
+        html = source.read_text(encoding="utf-8")
+        bundled = minify_html(html, stylesheet_css, logo_data_url)
+        (OUTPUT_DIR / page).write_text(bundled, encoding="utf-8")
+        size_in = source.stat().st_size
+        size_out = len(bundled.encode("utf-8"))
+        print(f"  {page:<16}{size_in:>8} -> {size_out:>8} Bytes")
+
+    for name in EXTRA_FILES:
+        source = SOURCE_DIR / name
+        if not source.exists():
+            continue
+        target = OUTPUT_DIR / name
+        target.parent.mkdir(parents=True, exist_ok=True)
+        if name.endswith(".css"):
+            target.write_text(minify_css(source.read_text(encoding="utf-8")), encoding="utf-8")
+        else:
+            shutil.copyfile(source, target)
+
+    # Ursprünglich im Image: alle Dateien aus data/ (inkl. logo.png)
+    original = sum(p.stat().st_size for p in SOURCE_DIR.rglob("*") if p.is_file())
+    bundled = sum(p.stat().st_size for p in OUTPUT_DIR.rglob("*") if p.is_file())
+    print(f"\nSPIFFS-Inhalt: {original} -> {bundled} Bytes")
+    print(f"Ausgabe: {OUTPUT_DIR}")
+    return True
+
+
+try:
+    Import("env")  # noqa: F821 - von PlatformIO bereitgestellt
+    build()
+except NameError:
+    if __name__ == "__main__":
+        build()
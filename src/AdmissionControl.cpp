@@ -0,0 +1,136 @@
+#include "AdmissionControl.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "lwip/sockets.h"
+#include <string.h>
+
+static const uint32_t TOKEN = 1000;  // One request in milli-tokens
+
+// Held only for bucket arithmetic
+static portMUX_TYPE admission_lock = portMUX_INITIALIZER_UNLOCKED;
+
+AdmissionControl::AdmissionControl() {
+    memset(clients, 0, sizeof(clients));
+    memset(&stats, 0, sizeof(stats));
+    global.tokens = GLOBAL_BURST * TOKEN;
+    global.updatedUs = 0;
+}
+
+// IPv4 address of the peer; httpd listens dual-stack, so IPv4 arrives IPv4-mapped
+uint32_t AdmissionControl::clientAddress(httpd_req_t* req) {
+    int sockfd = httpd_req_to_sockfd(req);
+    struct sockaddr_storage addr;
+    socklen_t len = sizeof(addr);
+    if (sockfd < 0 || getpeername(sockfd, (struct sockaddr*)&addr, &len) != 0) {
+        return 1;  // Unknown peers share one bucket
+    }
+
+    uint32_t key = 0;
+    if (addr.ss_family == AF_INET) {
+        key = ((struct sockaddr_in*)&addr)->sin_addr.s_addr;
+    } else if (addr.ss_family == AF_INET6) {
+        const uint8_t* a = ((struct sockaddr_in6*)&addr)->sin6_addr.s6_addr;
+        for (int i = 0; i < 16; i += 4) {
+            uint32_t word;
+            memcpy(&word, a + i, 4);
+            key ^= word;
+        }
+    }
+    return key != 0 ? key : 1;
+}
+
+void AdmissionControl::refill(Bucket& bucket, int64_t now, uint16_t rate, uint16_t burst) {
+    int64_t elapsedUs = now - bucket.updatedUs;
+    if (elapsedUs <= 0) {
+        return;
+    }
+    // rate tokens per second = rate milli-tokens per millisecond
+    int64_t added = (elapsedUs / 1000) * rate;
+    if (added <= 0) {
+        return;  // Less than a millisecond; keep updatedUs so the time is not lost
+    }
+    int64_t tokens = bucket.tokens + added;
+    bucket.tokens = tokens > (int64_t)burst * TOKEN ? burst * TOKEN : (uint32_t)tokens;
+    bucket.updatedUs += (elapsedUs / 1000) * 1000;
+}
+
+uint32_t AdmissionControl::secondsUntilToken(const Bucket& bucket, uint16_t rate) {
+    uint32_t missing = bucket.tokens >= TOKEN ? 0 : TOKEN - bucket.tokens;
+    uint32_t seconds = (missing + rate * 1000 - 1) / (rate * 1000);
+    return seconds > 0 ? seconds : 1;
+}
+
+AdmissionControl::Client& AdmissionControl::clientFor(uint32_t addr, int64_t now) {
+    Client* oldest = &clients[0];
+    for (uint8_t i = 0; i < MAX_CLIENTS; i++) {
+        if (clients[i].addr == addr) {
+            return clients[i];
+        }
+        if (clients[i].addr == 0) {
+            if (oldest->addr != 0) {
+                oldest = &clients[i];
+            }
+        } else if (oldest->addr != 0 && clients[i].lastSeenUs < oldest->lastSeenUs) {
+            oldest = &clients[i];
+        }
+    }
+
+    // New client takes a free entry or the one seen least recently, with a full bucket
+    oldest->addr = addr;
+    oldest->bucket.tokens = PRIORITY_BURST * TOKEN;
+    oldest->bucket.updatedUs = now;
+    return *oldest;
+}
+
+AdmissionControl::Result AdmissionControl::admit(httpd_req_t* req, bool priority, uint32_t* retryAfterS) {
+    uint32_t addr = clientAddress(req);
+    int64_t now = esp_timer_get_time();
+    Result result = ADMIT;
+
+    portENTER_CRITICAL(&admission_lock);
+    Client& client = clientFor(addr, now);
+    client.lastSeenUs = now;
+
+    // Normal requests may only use the lower part of the client bucket;
+    // the rest is headroom that only priority requests can spend
+    refill(client.bucket, now, CLIENT_RATE, PRIORITY_BURST);
+    uint32_t reserve = priority ? 0 : (PRIORITY_BURST - CLIENT_BURST) * TOKEN;
+    refill(global, now, GLOBAL_RATE, GLOBAL_BURST);
+
+    if (client.bucket.tokens < TOKEN + reserve) {
+        result = REJECT_CLIENT;
+        stats.rejectedClient++;
+        Bucket shortfall = client.bucket;
+        shortfall.tokens = client.bucket.tokens > reserve ? client.bucket.tokens - reserve : 0;
+        *retryAfterS = secondsUntilToken(shortfall, CLIENT_RATE);
+    } else if (!priority && global.tokens < TOKEN) {
+        result = REJECT_GLOBAL;
+        stats.rejectedGlobal++;
+        *retryAfterS = secondsUntilToken(global, GLOBAL_RATE);
+    } else {
+        client.bucket.tokens -= TOKEN;
+        if (priority) {
+            stats.servedPriority++;
+            // Still counted against the device total, but never blocked by it
+            global.tokens = global.tokens >= TOKEN ? global.tokens - TOKEN : 0;
+        } else {
+            global.tokens -= TOKEN;
+        }
+        stats.served++;
+    }
+    portEXIT_CRITICAL(&admission_lock);
+
+    return result;
+}
+
+void AdmissionControl::getStats(Stats* out) {
+    portENTER_CRITICAL(&admission_lock);
+    *out = stats;
+    out->trackedClients = 0;
+    for (uint8_t i = 0; i < MAX_CLIENTS; i++) {
+        if (clients[i].addr != 0) {
+            out->trackedClients++;
+        }
+    }
+    portEXIT_CRITICAL(&admission_lock);
+}
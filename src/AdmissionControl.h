@@ -0,0 +1,69 @@
+#pragma once
+#include <stdint.h>
+#include "esp_http_server.h"
+
+/**
+ * Token-bucket admission control for API requests.
+ *
+ * Every client (by IP address) has its own bucket, and normal requests must
+ * also draw from a global bucket so that the sum of all clients cannot
+ * saturate the httpd task and the WiFi stack. Priority requests (fan/LED
+ * control, login) skip the global bucket and get a larger per-client burst,
+ * so a flood of polling cannot lock out control.
+ */
+class AdmissionControl {
+public:
+    enum Result : uint8_t {
+        ADMIT,
+        REJECT_CLIENT,   // This client exceeded its own rate
+        REJECT_GLOBAL    // Device-wide rate exceeded
+    };
+
+    struct Stats {
+        uint32_t served;
+        uint32_t servedPriority;
+        uint32_t rejectedClient;
+        uint32_t rejectedGlobal;
+        uint8_t trackedClients;
+    };
+
+    // Rates in requests per second, bursts in requests
+    static const uint16_t GLOBAL_RATE = 20;
+    static const uint16_t GLOBAL_BURST = 40;
+    static const uint16_t CLIENT_RATE = 8;
+    static const uint16_t CLIENT_BURST = 16;
+    static const uint16_t PRIORITY_BURST = 24;
+    static const uint8_t MAX_CLIENTS = 8;
+
+    AdmissionControl();
+
+    /**
+     * Take a token for this request
+     * @param retryAfterS Set to the seconds until a token is available when rejected
+     */
+    Result admit(httpd_req_t* req, bool priority, uint32_t* retryAfterS);
+
+    void getStats(Stats* out);
+
+private:
+    // Tokens in milli-requests so refill needs no floating point
+    struct Bucket {
+        uint32_t tokens;
+        int64_t updatedUs;
+    };
+
+    struct Client {
+        uint32_t addr;          // 0 = unused
+        Bucket bucket;
+        int64_t lastSeenUs;
+    };
+
+    Bucket global;
+    Client clients[MAX_CLIENTS];
+    Stats stats;
+
+    static uint32_t clientAddress(httpd_req_t* req);
+    static void refill(Bucket& bucket, int64_t now, uint16_t rate, uint16_t burst);
+    static uint32_t secondsUntilToken(const Bucket& bucket, uint16_t rate);
+    Client& clientFor(uint32_t addr, int64_t now);
+};
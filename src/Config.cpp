@@ -8,6 +8,7 @@
 
 static const char *TAG = "CONFIG";
 static nvs_handle_t config_handle;
+static volatile uint32_t config_version = 1;  // Erhöht bei jeder Änderung (Cache-Invalidierung)
 
 namespace Config {
     char WEB_PASSWORD[32] = "smarthome-assistant.info";
@@ -34,6 +35,12 @@ namespace Config {
     // Bluetooth Proxy settings
     bool BT_PROXY_ENABLED = false;    // Disabled by default
     char BT_PROXY_NAME[32] = "HeatBodyVentilator-BT";
+    
+    // OTA Pull settings
+    char OTA_PULL_URL[128] = "";      // Disabled by default
+    uint16_t OTA_PULL_INTERVAL = 60;  // Minutes
+    uint16_t OTA_PULL_RATE = 0;       // Unlimited
+    char OTA_PULL_INSTALLED[65] = "";
 
     // Helper: String aus NVS lesen
     static void nvs_get_string(nvs_handle_t handle, const char* key, char* dest, size_t dest_size, const char* default_val) {
@@ -114,7 +121,19 @@ namespace Config {
         }
         nvs_get_string(config_handle, "bt_proxy_name", BT_PROXY_NAME, sizeof(BT_PROXY_NAME), "HeatBodyVentilator-BT");
         
+        // OTA Pull settings
+        nvs_get_string(config_handle, "ota_pull_url", OTA_PULL_URL, sizeof(OTA_PULL_URL), "");
+        uint16_t pull_tmp = 60;
+        if (nvs_get_u16(config_handle, "ota_pull_int", &pull_tmp) == ESP_OK) {
+            OTA_PULL_INTERVAL = pull_tmp;
+        }
+        if (nvs_get_u16(config_handle, "ota_pull_rate", &pull_tmp) == ESP_OK) {
+            OTA_PULL_RATE = pull_tmp;
+        }
+        nvs_get_string(config_handle, "ota_pull_pkg", OTA_PULL_INSTALLED, sizeof(OTA_PULL_INSTALLED), "");
+        
         nvs_close(config_handle);
+        config_version++;
         ESP_LOGI(TAG, "Einstellungen geladen");
     }
 
@@ -140,6 +159,7 @@ namespace Config {
         
         nvs_commit(config_handle);
         nvs_close(config_handle);
+        config_version++;
         ESP_LOGI(TAG, "Passwort gespeichert");
     }
 
@@ -153,6 +173,7 @@ namespace Config {
         
         nvs_commit(config_handle);
         nvs_close(config_handle);
+        config_version++;
         ESP_LOGI(TAG, "Device Name gespeichert: %s", newName);
     }
 
@@ -178,6 +199,7 @@ namespace Config {
         
         nvs_commit(config_handle);
         nvs_close(config_handle);
+        config_version++;
         ESP_LOGI(TAG, "MQTT Einstellungen gespeichert");
     }
 
@@ -191,6 +213,7 @@ namespace Config {
         
         nvs_commit(config_handle);
         nvs_close(config_handle);
+        config_version++;
         ESP_LOGI(TAG, "Temperatureinheit gespeichert: %s", unit);
     }
 
@@ -203,6 +226,7 @@ namespace Config {
         
         nvs_commit(config_handle);
         nvs_close(config_handle);
+        config_version++;
         ESP_LOGI(TAG, "AP Modus gespeichert: %s", enabled ? "AN" : "AUS");
     }
 
@@ -245,6 +269,11 @@ namespace Config {
         MANUAL_PWM_DUTY = 0;
         BT_PROXY_ENABLED = false;
         strcpy(BT_PROXY_NAME, "HeatBodyVentilator-BT");
+        strcpy(OTA_PULL_URL, "");
+        OTA_PULL_INTERVAL = 60;
+        OTA_PULL_RATE = 0;
+        strcpy(OTA_PULL_INSTALLED, "");
+        config_version++;
         
         ESP_LOGI(TAG, "Factory Reset abgeschlossen");
     }
@@ -261,6 +290,7 @@ namespace Config {
         
         nvs_commit(config_handle);
         nvs_close(config_handle);
+        config_version++;
         ESP_LOGI(TAG, "Temperatur-Mapping gespeichert: Start=%.1f°C, Max=%.1f°C", startTemp, maxTemp);
     }
 
@@ -273,6 +303,7 @@ namespace Config {
         
         nvs_commit(config_handle);
         nvs_close(config_handle);
+        config_version++;
         ESP_LOGI(TAG, "Auto PWM Einstellung gespeichert: %s", enabled ? "AN" : "AUS");
     }
 
@@ -280,6 +311,10 @@ namespace Config {
         return LAST_PASSWORD_CHANGE;
     }
 
+    uint32_t getVersion() {
+        return config_version;
+    }
+
     void saveManualPWMMode(bool enabled) {
         esp_err_t err = nvs_open("settings", NVS_READWRITE, &config_handle);
         if (err != ESP_OK) return;
@@ -289,6 +324,7 @@ namespace Config {
         
         nvs_commit(config_handle);
         nvs_close(config_handle);
+        config_version++;
         ESP_LOGI(TAG, "Manueller PWM Modus gespeichert: %s", enabled ? "MANUAL" : "AUTO");
     }
 
@@ -304,6 +340,7 @@ namespace Config {
         
         nvs_commit(config_handle);
         nvs_close(config_handle);
+        config_version++;
         ESP_LOGI(TAG, "Manuelle PWM Einstellungen gespeichert: Freq=%u Hz, Duty=%u%%", frequency, dutyCycle);
     }
 
@@ -316,6 +353,7 @@ namespace Config {
         
         nvs_commit(config_handle);
         nvs_close(config_handle);
+        config_version++;
         ESP_LOGI(TAG, "Bluetooth Proxy Aktivierung gespeichert: %s", enabled ? "AN" : "AUS");
     }
 
@@ -329,6 +367,187 @@ namespace Config {
         
         nvs_commit(config_handle);
         nvs_close(config_handle);
+        config_version++;
         ESP_LOGI(TAG, "Bluetooth Proxy Name gespeichert: %s", name);
     }
-}
\ No newline at end of file
+
+    void saveOTAPullSettings(const char* url, uint16_t intervalMinutes, uint16_t rateKBps) {
+        esp_err_t err = nvs_open("settings", NVS_READWRITE, &config_handle);
+        if (err != ESP_OK) return;
+        
+        nvs_set_str(config_handle, "ota_pull_url", url);
+        nvs_set_u16(config_handle, "ota_pull_int", intervalMinutes);
+        nvs_set_u16(config_handle, "ota_pull_rate", rateKBps);
+        strncpy(OTA_PULL_URL, url, sizeof(OTA_PULL_URL) - 1);
+        OTA_PULL_URL[sizeof(OTA_PULL_URL) - 1] = '\0';
+        OTA_PULL_INTERVAL = intervalMinutes;
+        OTA_PULL_RATE = rateKBps;
+        
+        nvs_commit(config_handle);
+        nvs_close(config_handle);
+        config_version++;
+        ESP_LOGI(TAG, "OTA Pull gespeichert: %s, alle %u min, %u KB/s", url[0] ? url : "aus",
+                 intervalMinutes, rateKBps);
+    }
+
+    void saveOTAPullInstalled(const char* sha256Hex) {
+        esp_err_t err = nvs_open("settings", NVS_READWRITE, &config_handle);
+        if (err != ESP_OK) return;
+        
+        nvs_set_str(config_handle, "ota_pull_pkg", sha256Hex);
+        strncpy(OTA_PULL_INSTALLED, sha256Hex, sizeof(OTA_PULL_INSTALLED) - 1);
+        OTA_PULL_INSTALLED[sizeof(OTA_PULL_INSTALLED) - 1] = '\0';
+        
+        nvs_commit(config_handle);
+        nvs_close(config_handle);
+    }
+
+    const char* validateBatch(const Batch& batch) {
+        if (batch.hasDeviceName && batch.deviceName[0] == '\0') {
+            return "device_name";
+        }
+        if (batch.hasMQTT && (batch.mqttServer[0] == '\0' || batch.mqttPort == 0)) {
+            return "mqtt";
+        }
+        if (batch.hasTempUnit && batch.tempUnit[0] == '\0') {
+            return "temp_unit";
+        }
+        if (batch.hasTempMapping && !(batch.tempStart > 0 && batch.tempMax > batch.tempStart)) {
+            return "temp_mapping";
+        }
+        if (batch.hasManualPWM && (batch.manualFreq == 0 || batch.manualDuty > 100)) {
+            return "manual_pwm";
+        }
+        return nullptr;
+    }
+
+    // Helper: Felder der Sammeländerung schreiben, bricht beim ersten Fehler ab
+    static esp_err_t nvs_set_batch(nvs_handle_t handle, const Batch& batch) {
+        esp_err_t err = ESP_OK;
+        if (batch.hasDeviceName && err == ESP_OK) {
+            err = nvs_set_str(handle, "device_name", batch.deviceName);
+        }
+        if (batch.hasMQTT && err == ESP_OK) {
+            err = nvs_set_str(handle, "mqtt_server", batch.mqttServer);
+            if (err == ESP_OK) err = nvs_set_u16(handle, "mqtt_port", batch.mqttPort);
+            if (err == ESP_OK) err = nvs_set_str(handle, "mqtt_user", batch.mqttUser);
+            if (err == ESP_OK && batch.hasMQTTPass) err = nvs_set_str(handle, "mqtt_pass", batch.mqttPass);
+            if (err == ESP_OK && batch.mqttTopic[0] != '\0') err = nvs_set_str(handle, "mqtt_topic", batch.mqttTopic);
+        }
+        if (batch.hasTempUnit && err == ESP_OK) {
+            err = nvs_set_str(handle, "temp_unit", batch.tempUnit);
+        }
+        if (batch.hasTempMapping && err == ESP_OK) {
+            err = nvs_set_i32(handle, "temp_start", (int32_t)(batch.tempStart * 100));
+            if (err == ESP_OK) err = nvs_set_i32(handle, "temp_max", (int32_t)(batch.tempMax * 100));
+        }
+        if (batch.hasAutoPWM && err == ESP_OK) {
+            err = nvs_set_u8(handle, "auto_pwm", batch.autoPWM ? 1 : 0);
+        }
+        if (batch.hasManualMode && err == ESP_OK) {
+            err = nvs_set_u8(handle, "manual_mode", batch.manualMode ? 1 : 0);
+        }
+        if (batch.hasManualPWM && err == ESP_OK) {
+            err = nvs_set_u32(handle, "manual_freq", batch.manualFreq);
+            if (err == ESP_OK) err = nvs_set_u8(handle, "manual_duty", batch.manualDuty);
+        }
+        return err;
+    }
+
+    // Helper: aktuelle RAM-Werte derselben Felder, zum Zurückschreiben
+    static void current_batch(const Batch& batch, Batch* out) {
+        *out = batch;
+        strncpy(out->deviceName, DEVICE_NAME, sizeof(out->deviceName));
+        strncpy(out->mqttServer, MQTT_SERVER, sizeof(out->mqttServer));
+        out->mqttPort = MQTT_PORT;
+        strncpy(out->mqttUser, MQTT_USER, sizeof(out->mqttUser));
+        strncpy(out->mqttPass, MQTT_PASS, sizeof(out->mqttPass));
+        strncpy(out->mqttTopic, MQTT_TOPIC, sizeof(out->mqttTopic));
+        strncpy(out->tempUnit, TEMP_UNIT, sizeof(out->tempUnit));
+        out->tempStart = TEMP_START;
+        out->tempMax = TEMP_MAX;
+        out->autoPWM = AUTO_PWM_ENABLED;
+        out->manualMode = MANUAL_PWM_MODE;
+        out->manualFreq = MANUAL_PWM_FREQ;
+        out->manualDuty = MANUAL_PWM_DUTY;
+    }
+
+    BatchResult saveBatch(const Batch& batch) {
+        if (validateBatch(batch) != nullptr) {
+            return BATCH_FAILED;
+        }
+        
+        esp_err_t err = nvs_open("settings", NVS_READWRITE, &config_handle);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Fehler beim Öffnen von NVS");
+            return BATCH_FAILED;
+        }
+        
+        // NVS kennt keine Transaktion: jedes nvs_set_* steht sofort im Flash. Scheitert
+        // ein Feld, werden die schon geschriebenen auf die bisherigen Werte zurückgesetzt
+        err = nvs_set_batch(config_handle, batch);
+        if (err == ESP_OK) {
+            err = nvs_commit(config_handle);
+        }
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Sammeländerung nicht gespeichert: %s", esp_err_to_name(err));
+            Batch previous;
+            current_batch(batch, &previous);
+            esp_err_t restored = nvs_set_batch(config_handle, previous);
+            if (restored == ESP_OK) {
+                restored = nvs_commit(config_handle);
+            }
+            nvs_close(config_handle);
+            if (restored == ESP_OK) {
+                return BATCH_FAILED;
+            }
+            // Flash hält eine Mischung: RAM daran angleichen statt still abzuweichen
+            ESP_LOGE(TAG, "Zurücksetzen fehlgeschlagen (%s), lade Einstellungen neu", esp_err_to_name(restored));
+            load();
+            return BATCH_PARTIAL;
+        }
+        nvs_close(config_handle);
+        
+        if (batch.hasDeviceName) {
+            strncpy(DEVICE_NAME, batch.deviceName, sizeof(DEVICE_NAME) - 1);
+            DEVICE_NAME[sizeof(DEVICE_NAME) - 1] = '\0';
+        }
+        if (batch.hasMQTT) {
+            strncpy(MQTT_SERVER, batch.mqttServer, sizeof(MQTT_SERVER) - 1);
+            MQTT_SERVER[sizeof(MQTT_SERVER) - 1] = '\0';
+            MQTT_PORT = batch.mqttPort;
+            strncpy(MQTT_USER, batch.mqttUser, sizeof(MQTT_USER) - 1);
+            MQTT_USER[sizeof(MQTT_USER) - 1] = '\0';
+            if (batch.hasMQTTPass) {
+                strncpy(MQTT_PASS, batch.mqttPass, sizeof(MQTT_PASS) - 1);
+                MQTT_PASS[sizeof(MQTT_PASS) - 1] = '\0';
+            }
+            if (batch.mqttTopic[0] != '\0') {
+                strncpy(MQTT_TOPIC, batch.mqttTopic, sizeof(MQTT_TOPIC) - 1);
+                MQTT_TOPIC[sizeof(MQTT_TOPIC) - 1] = '\0';
+            }
+        }
+        if (batch.hasTempUnit) {
+            strncpy(TEMP_UNIT, batch.tempUnit, sizeof(TEMP_UNIT) - 1);
+            TEMP_UNIT[sizeof(TEMP_UNIT) - 1] = '\0';
+        }
+        if (batch.hasTempMapping) {
+            TEMP_START = batch.tempStart;
+            TEMP_MAX = batch.tempMax;
+        }
+        if (batch.hasAutoPWM) {
+            AUTO_PWM_ENABLED = batch.autoPWM;
+        }
+        if (batch.hasManualMode) {
+            MANUAL_PWM_MODE = batch.manualMode;
+        }
+        if (batch.hasManualPWM) {
+            MANUAL_PWM_FREQ = batch.manualFreq;
+            MANUAL_PWM_DUTY = batch.manualDuty;
+        }
+        
+        config_version++;
+        ESP_LOGI(TAG, "Sammeländerung gespeichert");
+        return BATCH_SAVED;
+    }
+}
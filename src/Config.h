@@ -35,6 +35,43 @@ namespace Config {
     // Bluetooth Proxy settings
     extern bool BT_PROXY_ENABLED;
     extern char BT_PROXY_NAME[32];
+    
+    // OTA Pull (siehe OTAPull): Gerät holt Updates selbst von einem lokalen Server
+    extern char OTA_PULL_URL[128];       // URL der manifest.json, leer = aus
+    extern uint16_t OTA_PULL_INTERVAL;   // Minuten zwischen zwei Prüfungen (±25% Jitter)
+    extern uint16_t OTA_PULL_RATE;       // KB/s beim Download, 0 = unbegrenzt
+    extern char OTA_PULL_INSTALLED[65];  // SHA-256 des zuletzt installierten Pakets
+
+    // Sammeländerung für /api/settings/batch: nur Felder mit gesetztem has*-Flag werden übernommen
+    struct Batch {
+        bool hasDeviceName;
+        char deviceName[32];
+        
+        bool hasMQTT;
+        char mqttServer[64];
+        uint16_t mqttPort;
+        char mqttUser[32];
+        bool hasMQTTPass;        // Ohne Passwort bleibt das gespeicherte erhalten
+        char mqttPass[32];
+        char mqttTopic[64];
+        
+        bool hasTempUnit;
+        char tempUnit[16];
+        
+        bool hasTempMapping;
+        float tempStart;
+        float tempMax;
+        
+        bool hasAutoPWM;
+        bool autoPWM;
+        
+        bool hasManualMode;
+        bool manualMode;
+        
+        bool hasManualPWM;
+        uint32_t manualFreq;
+        uint8_t manualDuty;
+    };
 
     void load();  // Umbenennt von loadSettings()
     void saveWebPassword(const char* newPassword);
@@ -48,6 +85,13 @@ namespace Config {
     void saveManualPWMSettings(uint32_t frequency, uint8_t dutyCycle);
     void saveBTProxyEnabled(bool enabled);
     void saveBTProxyName(const char* name);
+    void saveOTAPullSettings(const char* url, uint16_t intervalMinutes, uint16_t rateKBps);
+    void saveOTAPullInstalled(const char* sha256Hex);
+    const char* validateBatch(const Batch& batch);  // nullptr wenn gültig, sonst Name des fehlerhaften Feldes
+    // BATCH_PARTIAL: Schreiben und Zurückschreiben scheiterten, RAM wurde aus NVS neu geladen
+    enum BatchResult { BATCH_SAVED = 0, BATCH_FAILED, BATCH_PARTIAL };
+    BatchResult saveBatch(const Batch& batch);       // Ein NVS-Öffnen/Commit für alle Felder
     void factoryReset();
     const char* getLastPasswordChange();  // Geändert von String zu const char*
+    uint32_t getVersion();  // Wird von load() und jedem save*() erhöht
 }
@@ -0,0 +1,231 @@
+#include "ConnectionTable.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "lwip/sockets.h"
+#include <string.h>
+#include <unistd.h>
+
+static const char* TAG = "CONN";
+
+// Guards slots and stats; held only for short bookkeeping
+static portMUX_TYPE connection_lock = portMUX_INITIALIZER_UNLOCKED;
+
+ConnectionTable::ConnectionTable() : lastReapUs(0), reapServer(nullptr) {
+    memset(slots, 0, sizeof(slots));
+    memset(&stats, 0, sizeof(stats));
+    for (uint8_t i = 0; i < CAPACITY; i++) {
+        slots[i].fd = -1;
+    }
+}
+
+uint32_t ConnectionTable::peerAddress(int sockfd) {
+    struct sockaddr_storage addr;
+    socklen_t len = sizeof(addr);
+    if (getpeername(sockfd, (struct sockaddr*)&addr, &len) != 0) {
+        return 0;
+    }
+    if (addr.ss_family == AF_INET) {
+        return ((struct sockaddr_in*)&addr)->sin_addr.s_addr;
+    }
+    if (addr.ss_family == AF_INET6) {
+        // IPv4-mapped (::ffff:a.b.c.d), which is how the dual-stack listener sees IPv4 peers
+        uint32_t word;
+        memcpy(&word, ((struct sockaddr_in6*)&addr)->sin6_addr.s6_addr + 12, 4);
+        return word;
+    }
+    return 0;
+}
+
+// Slots live in the table; httpd must not free() them
+void ConnectionTable::free_ctx(void* ctx) {
+}
+
+ConnectionTable::Connection* ConnectionTable::find(int sockfd) {
+    for (uint8_t i = 0; i < CAPACITY; i++) {
+        if (slots[i].fd == sockfd) {
+            return &slots[i];
+        }
+    }
+    return nullptr;
+}
+
+ConnectionTable::Connection* ConnectionTable::slotOf(httpd_req_t* req) {
+    int sockfd = httpd_req_to_sockfd(req);
+    Connection* conn = (Connection*)req->sess_ctx;
+    if (conn >= slots && conn < slots + CAPACITY && conn->fd == sockfd) {
+        return conn;
+    }
+    return sockfd >= 0 ? find(sockfd) : nullptr;
+}
+
+esp_err_t ConnectionTable::onOpen(httpd_handle_t hd, int sockfd) {
+    int64_t now = esp_timer_get_time();
+    uint32_t peer = peerAddress(sockfd);
+    Connection* conn = nullptr;
+
+    portENTER_CRITICAL(&connection_lock);
+    conn = find(-1);
+    if (conn != nullptr) {
+        memset(conn, 0, sizeof(Connection));
+        conn->fd = sockfd;
+        conn->peer = peer;
+        conn->openedUs = now;
+        conn->lastActiveUs = now;
+        stats.opened++;
+        stats.open++;
+        if (stats.open > stats.peakOpen) {
+            stats.peakOpen = stats.open;
+        }
+    } else {
+        stats.rejected++;
+    }
+    portEXIT_CRITICAL(&connection_lock);
+
+    if (conn == nullptr) {
+        // Still served, just not tracked; means CAPACITY < max_open_sockets
+        ESP_LOGW(TAG, "No slot for socket %d", sockfd);
+        return ESP_OK;
+    }
+    httpd_sess_set_ctx(hd, sockfd, conn, free_ctx);
+    return ESP_OK;
+}
+
+void ConnectionTable::onClose(httpd_handle_t hd, int sockfd) {
+    portENTER_CRITICAL(&connection_lock);
+    Connection* conn = find(sockfd);
+    if (conn != nullptr) {
+        stats.requestsClosed += conn->requests;
+        stats.closed++;
+        stats.open--;
+        memset(conn, 0, sizeof(Connection));
+        conn->fd = -1;
+    }
+    portEXIT_CRITICAL(&connection_lock);
+
+    // With close_fn set, closing the socket is up to us
+    close(sockfd);
+}
+
+ConnectionTable::Connection* ConnectionTable::touch(httpd_req_t* req) {
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&connection_lock);
+    Connection* conn = slotOf(req);
+    if (conn != nullptr) {
+        conn->requests++;
+        conn->lastActiveUs = now;
+    }
+    portEXIT_CRITICAL(&connection_lock);
+    return conn;
+}
+
+ConnectionTable::Connection* ConnectionTable::of(httpd_req_t* req) {
+    portENTER_CRITICAL(&connection_lock);
+    Connection* conn = slotOf(req);
+    portEXIT_CRITICAL(&connection_lock);
+    return conn;
+}
+
+bool ConnectionTable::authorized(Connection* conn, const char* token, uint32_t generation) {
+    if (conn == nullptr) {
+        return false;
+    }
+    const size_t length = SessionStore::TOKEN_STRING_SIZE - 1;
+    bool wellFormed = strlen(token) == length;
+    int64_t now = esp_timer_get_time();
+    bool hit = false;
+
+    portENTER_CRITICAL(&connection_lock);
+    stats.authChecks++;
+    if (wellFormed && conn->authToken[0] != '\0' && conn->authGeneration == generation &&
+        now - conn->authCheckedUs < AUTH_CACHE_US) {
+        // Constant time, like SessionStore
+        uint8_t diff = 0;
+        for (size_t i = 0; i < length; i++) {
+            diff |= (uint8_t)conn->authToken[i] ^ (uint8_t)token[i];
+        }
+        hit = diff == 0;
+    }
+    if (hit) {
+        conn->authHits++;
+        stats.authHits++;
+    }
+    portEXIT_CRITICAL(&connection_lock);
+    return hit;
+}
+
+void ConnectionTable::rememberAuth(Connection* conn, const char* token, uint32_t generation) {
+    if (conn == nullptr || strlen(token) != SessionStore::TOKEN_STRING_SIZE - 1) {
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&connection_lock);
+    memcpy(conn->authToken, token, SessionStore::TOKEN_STRING_SIZE);
+    conn->authGeneration = generation;
+    conn->authCheckedUs = now;
+    portEXIT_CRITICAL(&connection_lock);
+}
+
+void ConnectionTable::forgetAuth(Connection* conn) {
+    if (conn == nullptr) {
+        return;
+    }
+    portENTER_CRITICAL(&connection_lock);
+    conn->authToken[0] = '\0';
+    portEXIT_CRITICAL(&connection_lock);
+}
+
+// Runs on the httpd task, so no request of this server is being parsed meanwhile
+void ConnectionTable::reap_work(void* arg) {
+    ConnectionTable* table = (ConnectionTable*)arg;
+    int64_t now = esp_timer_get_time();
+    int idle[CAPACITY];
+    uint8_t count = 0;
+
+    portENTER_CRITICAL(&connection_lock);
+    for (uint8_t i = 0; i < CAPACITY; i++) {
+        const Connection& conn = table->slots[i];
+        if (conn.fd >= 0 && now - conn.lastActiveUs > IDLE_TIMEOUT_US) {
+            idle[count++] = conn.fd;
+        }
+    }
+    table->stats.reaped += count;
+    portEXIT_CRITICAL(&connection_lock);
+
+    for (uint8_t i = 0; i < count; i++) {
+        ESP_LOGD(TAG, "Closing idle socket %d", idle[i]);
+        httpd_sess_trigger_close(table->reapServer, idle[i]);
+    }
+}
+
+void ConnectionTable::reapIdle(httpd_handle_t hd) {
+    int64_t now = esp_timer_get_time();
+    if (hd == nullptr || now - lastReapUs < REAP_INTERVAL_US) {
+        return;
+    }
+    lastReapUs = now;
+    reapServer = hd;
+    httpd_queue_work(hd, reap_work, this);
+}
+
+void ConnectionTable::getStats(Stats* out) {
+    portENTER_CRITICAL(&connection_lock);
+    *out = stats;
+    portEXIT_CRITICAL(&connection_lock);
+}
+
+uint8_t ConnectionTable::list(Connection* out, uint8_t max) {
+    uint8_t count = 0;
+    portENTER_CRITICAL(&connection_lock);
+    for (uint8_t i = 0; i < CAPACITY && count < max; i++) {
+        if (slots[i].fd >= 0) {
+            out[count] = slots[i];
+            out[count].authToken[0] = '\0';
+            count++;
+        }
+    }
+    portEXIT_CRITICAL(&connection_lock);
+    return count;
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include <stdint.h>
+#include "esp_http_server.h"
+#include "SessionStore.h"
+
+/**
+ * Per-socket state of the HTTP server.
+ *
+ * httpd calls onOpen()/onClose() for every TCP connection (config.open_fn and
+ * config.close_fn); the slot is attached as the session context, so handlers
+ * reach it through req->sess_ctx.
+ *
+ * - Request counters per connection, for sizing max_open_sockets from data
+ * - A positive auth result is remembered per connection, so a polling client
+ *   does not re-validate its token on every request
+ * - Connections idle longer than IDLE_TIMEOUT_US are closed by reapIdle(),
+ *   before LRU purging has to evict a socket that is still in use
+ */
+class ConnectionTable {
+public:
+    static const uint8_t CAPACITY = 7;                       // >= httpd max_open_sockets
+    static const uint16_t KEEP_ALIVE_S = 30;                 // Advertised in the Keep-Alive header
+    static const int64_t IDLE_TIMEOUT_US = (KEEP_ALIVE_S + 5) * 1000000LL;
+    static const int64_t REAP_INTERVAL_US = 5 * 1000000LL;
+    static const int64_t AUTH_CACHE_US = 60 * 1000000LL;     // Re-validate at least this often
+
+    struct Connection {
+        int fd;                 // -1 = unused
+        uint32_t peer;          // IPv4 address, 0 if unknown
+        int64_t openedUs;
+        int64_t lastActiveUs;
+        uint32_t requests;
+        uint32_t authHits;      // Requests authorized from the cache
+
+        // Cached auth result (see authorized)
+        char authToken[SessionStore::TOKEN_STRING_SIZE];
+        uint32_t authGeneration;
+        int64_t authCheckedUs;
+    };
+
+    struct Stats {
+        uint32_t opened;
+        uint32_t closed;
+        uint32_t reaped;              // Closed by reapIdle()
+        uint32_t rejected;            // No free slot in onOpen()
+        uint32_t requestsClosed;      // Requests served on connections that are closed by now
+        uint32_t authChecks;
+        uint32_t authHits;
+        uint8_t open;
+        uint8_t peakOpen;
+    };
+
+    ConnectionTable();
+
+    // httpd callbacks (run on the httpd task)
+    esp_err_t onOpen(httpd_handle_t hd, int sockfd);
+    void onClose(httpd_handle_t hd, int sockfd);
+
+    // Slot of the request's connection, marked active; nullptr if untracked
+    Connection* touch(httpd_req_t* req);
+
+    // Slot of the request's connection without counting a request
+    Connection* of(httpd_req_t* req);
+
+    /**
+     * Cached auth for this connection
+     * @param generation Current SessionStore::generation()
+     * @return true if the token was validated on this connection recently
+     *         and no session has ended since
+     */
+    bool authorized(Connection* conn, const char* token, uint32_t generation);
+
+    // Remember a successful validate(); generation must be read before it
+    void rememberAuth(Connection* conn, const char* token, uint32_t generation);
+    void forgetAuth(Connection* conn);
+
+    // Close idle connections; call periodically from any task
+    void reapIdle(httpd_handle_t hd);
+
+    void getStats(Stats* out);
+
+    // Copy of the open connections (without cached tokens); returns count
+    uint8_t list(Connection* out, uint8_t max);
+
+private:
+    Connection slots[CAPACITY];
+    Stats stats;
+    int64_t lastReapUs;
+    httpd_handle_t reapServer;
+
+    Connection* find(int sockfd);
+    Connection* slotOf(httpd_req_t* req);
+    static uint32_t peerAddress(int sockfd);
+    static void reap_work(void* arg);
+    static void free_ctx(void* ctx);
+};
@@ -0,0 +1,78 @@
+#include "HttpWorkerPool.h"
+#include "esp_log.h"
+#include "freertos/task.h"
+#include <string.h>
+
+static const char* TAG = "HTTP_WORKER";
+
+HttpWorkerPool::HttpWorkerPool() : queue(nullptr) {
+}
+
+bool HttpWorkerPool::begin(uint8_t workers, uint32_t stackSize) {
+    if (queue != nullptr) {
+        return true;  // Already running (server restart)
+    }
+
+    queue = xQueueCreate(QUEUE_LENGTH, sizeof(Job));
+    if (queue == nullptr) {
+        ESP_LOGE(TAG, "Failed to create job queue");
+        return false;
+    }
+
+    uint8_t started = 0;
+    for (uint8_t i = 0; i < workers; i++) {
+        char name[16];
+        snprintf(name, sizeof(name), "http_worker%u", (unsigned int)i);
+        // Same priority as the httpd task so neither starves the other
+        if (xTaskCreate(workerTask, name, stackSize, this, tskIDLE_PRIORITY + 5, NULL) == pdPASS) {
+            started++;
+        } else {
+            ESP_LOGE(TAG, "Failed to start %s", name);
+        }
+    }
+
+    ESP_LOGI(TAG, "%u workers started", (unsigned int)started);
+    return started > 0;
+}
+
+bool HttpWorkerPool::submitJob(JobFunction fn, void* arg, uint32_t delayMs) {
+    if (queue == nullptr) {
+        ESP_LOGW(TAG, "Pool not started, running job inline");
+        if (delayMs > 0) {
+            vTaskDelay(pdMS_TO_TICKS(delayMs));
+        }
+        fn(arg);
+        return true;
+    }
+
+    Job job = {};
+    job.fn = fn;
+    job.arg = arg;
+    job.delayMs = delayMs;
+    if (xQueueSend(queue, &job, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "Job queue full");
+        return false;
+    }
+    return true;
+}
+
+void HttpWorkerPool::run(const Job& job) {
+    if (job.delayMs > 0) {
+        vTaskDelay(pdMS_TO_TICKS(job.delayMs));
+    }
+
+    if (job.fn != nullptr) {
+        job.fn(job.arg);
+    }
+}
+
+void HttpWorkerPool::workerTask(void* param) {
+    HttpWorkerPool* pool = (HttpWorkerPool*)param;
+    Job job;
+
+    while (true) {
+        if (xQueueReceive(pool->queue, &job, portMAX_DELAY) == pdTRUE) {
+            pool->run(job);
+        }
+    }
+}
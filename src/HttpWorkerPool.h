@@ -0,0 +1,49 @@
+#pragma once
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+/**
+ * Small pool of worker tasks for work that must not run on the httpd task:
+ * a reboot after the response went out, an MQTT reconnect.
+ *
+ * Request handlers themselves always run on the httpd task. Detaching a
+ * request (httpd_req_async_handler_begin) needs IDF 5.1, this firmware is
+ * built on IDF 4.4; long transfers use the chunked upload session instead
+ * (see OTAUploadSession), so the server gets a turn between chunks.
+ */
+class HttpWorkerPool {
+public:
+    typedef void (*JobFunction)(void* arg);
+
+    static const uint8_t DEFAULT_WORKERS = 2;
+    static const uint8_t QUEUE_LENGTH = 4;
+
+    HttpWorkerPool();
+
+    /**
+     * Create queue and worker tasks
+     * @param workers Number of worker tasks
+     * @param stackSize Stack per worker (same budget as the httpd task)
+     * @return true if at least one worker is running
+     */
+    bool begin(uint8_t workers = DEFAULT_WORKERS, uint32_t stackSize = 8192);
+
+    /**
+     * Queue a job; the worker waits delayMs before running it
+     * @return false if the queue is full
+     */
+    bool submitJob(JobFunction fn, void* arg, uint32_t delayMs = 0);
+
+private:
+    struct Job {
+        JobFunction fn;
+        void* arg;
+        uint32_t delayMs;
+    };
+
+    QueueHandle_t queue;
+
+    static void workerTask(void* param);
+    void run(const Job& job);
+};
@@ -0,0 +1,436 @@
+#include "JsonStream.h"
+#include "esp_log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+static const char* TAG = "JSON";
+
+// ============================================================================
+// JsonStreamWriter
+// ============================================================================
+
+JsonStreamWriter::JsonStreamWriter(httpd_req_t* req)
+    : req(req), target(buffer), capacity(BUFFER_SIZE), length(0), err(ESP_OK),
+      chunked(false), depth(0), hasMembers(0) {
+    httpd_resp_set_type(req, "application/json");
+}
+
+JsonStreamWriter::JsonStreamWriter(char* out, size_t outSize)
+    : req(nullptr), target(out), capacity(outSize), length(0), err(ESP_OK),
+      chunked(false), depth(0), hasMembers(0) {
+}
+
+void JsonStreamWriter::flush() {
+    if (req == nullptr) {
+        // Memory target cannot drain - a flush means it is full
+        if (length == capacity) {
+            err = ESP_ERR_NO_MEM;
+        }
+        return;
+    }
+    if (length == 0 || err != ESP_OK) {
+        length = 0;
+        return;
+    }
+    err = httpd_resp_send_chunk(req, buffer, length);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Chunk send failed: %s", esp_err_to_name(err));
+    }
+    chunked = true;
+    length = 0;
+}
+
+void JsonStreamWriter::write(const char* data, size_t len) {
+    while (len > 0) {
+        if (length == capacity) {
+            flush();
+            if (length == capacity) {
+                return;  // Memory target full
+            }
+        }
+        size_t space = capacity - length;
+        size_t n = len < space ? len : space;
+        memcpy(target + length, data, n);
+        length += n;
+        data += n;
+        len -= n;
+    }
+}
+
+void JsonStreamWriter::writeChar(char c) {
+    if (length == capacity) {
+        flush();
+        if (length == capacity) {
+            return;  // Memory target full
+        }
+    }
+    target[length++] = c;
+}
+
+void JsonStreamWriter::writeString(const char* str) {
+    writeChar('"');
+    if (str) {
+        const char* run = str;
+        for (const char* p = str; *p; p++) {
+            unsigned char c = (unsigned char)*p;
+            if (c >= 0x20 && c != '"' && c != '\\') {
+                continue;
+            }
+            // Copy the clean run in one go, then the escape sequence
+            write(run, p - run);
+            run = p + 1;
+            switch (c) {
+                case '"':  write("\\\"", 2); break;
+                case '\\': write("\\\\", 2); break;
+                case '\n': write("\\n", 2); break;
+                case '\r': write("\\r", 2); break;
+                case '\t': write("\\t", 2); break;
+                default: {
+                    char esc[7];
+                    snprintf(esc, sizeof(esc), "\\u%04x", c);
+                    write(esc, 6);
+                    break;
+                }
+            }
+        }
+        write(run, strlen(run));
+    }
+    writeChar('"');
+}
+
+void JsonStreamWriter::writeKey(const char* key) {
+    uint32_t bit = 1UL << depth;
+    if (hasMembers & bit) {
+        writeChar(',');
+    }
+    hasMembers |= bit;
+
+    if (key) {
+        writeString(key);
+        writeChar(':');
+    }
+}
+
+void JsonStreamWriter::writeRaw(const char* key, const char* raw) {
+    writeKey(key);
+    write(raw, strlen(raw));
+}
+
+void JsonStreamWriter::beginObject(const char* key) {
+    if (depth > 0) {
+        writeKey(key);
+    }
+    writeChar('{');
+    if (depth < MAX_DEPTH - 1) {
+        depth++;
+    }
+    hasMembers &= ~(1UL << depth);
+}
+
+void JsonStreamWriter::endObject() {
+    writeChar('}');
+    if (depth > 0) {
+        depth--;
+    }
+}
+
+void JsonStreamWriter::beginArray(const char* key) {
+    if (depth > 0) {
+        writeKey(key);
+    }
+    writeChar('[');
+    if (depth < MAX_DEPTH - 1) {
+        depth++;
+    }
+    hasMembers &= ~(1UL << depth);
+}
+
+void JsonStreamWriter::endArray() {
+    writeChar(']');
+    if (depth > 0) {
+        depth--;
+    }
+}
+
+void JsonStreamWriter::continueObject() {
+    depth = 1;
+    hasMembers |= (1UL << depth);
+}
+
+void JsonStreamWriter::add(const char* key, const char* value) {
+    if (!value) {
+        addNull(key);
+        return;
+    }
+    writeKey(key);
+    writeString(value);
+}
+
+void JsonStreamWriter::add(const char* key, bool value) {
+    writeRaw(key, value ? "true" : "false");
+}
+
+void JsonStreamWriter::add(const char* key, int value) {
+    add(key, (long long)value);
+}
+
+void JsonStreamWriter::add(const char* key, unsigned int value) {
+    add(key, (unsigned long long)value);
+}
+
+void JsonStreamWriter::add(const char* key, long value) {
+    add(key, (long long)value);
+}
+
+void JsonStreamWriter::add(const char* key, unsigned long value) {
+    add(key, (unsigned long long)value);
+}
+
+void JsonStreamWriter::add(const char* key, long long value) {
+    char num[24];
+    snprintf(num, sizeof(num), "%lld", value);
+    writeRaw(key, num);
+}
+
+void JsonStreamWriter::add(const char* key, unsigned long long value) {
+    char num[24];
+    snprintf(num, sizeof(num), "%llu", value);
+    writeRaw(key, num);
+}
+
+void JsonStreamWriter::add(const char* key, double value) {
+    // JSON has no NaN/Infinity - same as ArduinoJson, emit null
+    if (isnan(value) || isinf(value)) {
+        addNull(key);
+        return;
+    }
+    char num[32];
+    snprintf(num, sizeof(num), "%.7g", value);
+    writeRaw(key, num);
+}
+
+void JsonStreamWriter::addNull(const char* key) {
+    writeRaw(key, "null");
+}
+
+esp_err_t JsonStreamWriter::finish() {
+    if (req == nullptr) {
+        return err;
+    }
+    if (!chunked) {
+        // Everything fit into the buffer: single send with Content-Length
+        if (err == ESP_OK) {
+            err = httpd_resp_send(req, buffer, length);
+        }
+        length = 0;
+        return err;
+    }
+
+    flush();
+    esp_err_t endErr = httpd_resp_send_chunk(req, NULL, 0);
+    if (err == ESP_OK) {
+        err = endErr;
+    }
+    return err;
+}
+
+// ============================================================================
+// JsonLookup
+// ============================================================================
+
+const char* JsonLookup::skipWhitespace(const char* p) {
+    while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') {
+        p++;
+    }
+    return p;
+}
+
+// p points at the opening quote; returns the position after the closing quote
+const char* JsonLookup::skipString(const char* p) {
+    p++;
+    while (*p && *p != '"') {
+        if (*p == '\\' && p[1]) {
+            p++;
+        }
+        p++;
+    }
+    return *p == '"' ? p + 1 : p;
+}
+
+const char* JsonLookup::skipValue(const char* p) {
+    p = skipWhitespace(p);
+    if (*p == '"') {
+        return skipString(p);
+    }
+    if (*p == '{' || *p == '[') {
+        int level = 0;
+        while (*p) {
+            if (*p == '"') {
+                p = skipString(p);
+                continue;
+            }
+            if (*p == '{' || *p == '[') {
+                level++;
+            } else if (*p == '}' || *p == ']') {
+                if (--level == 0) {
+                    return p + 1;
+                }
+            }
+            p++;
+        }
+        return p;
+    }
+    // Number, true, false, null
+    while (*p && *p != ',' && *p != '}' && *p != ']' &&
+           *p != ' ' && *p != '\t' && *p != '\n' && *p != '\r') {
+        p++;
+    }
+    return p;
+}
+
+// Returns a pointer to the value of the member named by path, or nullptr
+const char* JsonLookup::find(const char* json, const char* path) {
+    if (!json || !path) {
+        return nullptr;
+    }
+
+    const char* p = skipWhitespace(json);
+    const char* segment = path;
+
+    while (true) {
+        if (*p != '{') {
+            return nullptr;
+        }
+        const char* dot = strchr(segment, '.');
+        size_t segLen = dot ? (size_t)(dot - segment) : strlen(segment);
+
+        p = skipWhitespace(p + 1);
+        const char* value = nullptr;
+        while (*p == '"') {
+            const char* keyStart = p + 1;
+            const char* keyEnd = skipString(p) - 1;
+            p = skipWhitespace(keyEnd + 1);
+            if (*p != ':') {
+                return nullptr;
+            }
+            p = skipWhitespace(p + 1);
+
+            // Keys are compared raw; escaped characters in keys are not expected
+            if ((size_t)(keyEnd - keyStart) == segLen && strncmp(keyStart, segment, segLen) == 0) {
+                value = p;
+                break;
+            }
+
+            p = skipWhitespace(skipValue(p));
+            if (*p != ',') {
+                return nullptr;
+            }
+            p = skipWhitespace(p + 1);
+        }
+
+        if (!value) {
+            return nullptr;
+        }
+        if (!dot) {
+            return value;
+        }
+        segment = dot + 1;
+        p = value;
+    }
+}
+
+bool JsonLookup::has(const char* json, const char* path) {
+    return find(json, path) != nullptr;
+}
+
+bool JsonLookup::getString(const char* json, const char* path, char* out, size_t outSize) {
+    const char* p = find(json, path);
+    if (!p || *p != '"' || outSize == 0) {
+        return false;
+    }
+    p++;
+
+    size_t n = 0;
+    while (*p && *p != '"') {
+        char c = *p++;
+        if (c == '\\') {
+            char esc = *p++;
+            switch (esc) {
+                case 'n': c = '\n'; break;
+                case 'r': c = '\r'; break;
+                case 't': c = '\t'; break;
+                case 'b': c = '\b'; break;
+                case 'f': c = '\f'; break;
+                case 'u': {
+                    char hex[5] = {0};
+                    for (int i = 0; i < 4 && *p; i++) {
+                        hex[i] = *p++;
+                    }
+                    unsigned long cp = strtoul(hex, NULL, 16);
+                    // Encode the code point as UTF-8 (BMP only)
+                    char utf8[3];
+                    size_t len;
+                    if (cp < 0x80) {
+                        utf8[0] = (char)cp;
+                        len = 1;
+                    } else if (cp < 0x800) {
+                        utf8[0] = (char)(0xC0 | (cp >> 6));
+                        utf8[1] = (char)(0x80 | (cp & 0x3F));
+                        len = 2;
+                    } else {
+                        utf8[0] = (char)(0xE0 | (cp >> 12));
+                        utf8[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+                        utf8[2] = (char)(0x80 | (cp & 0x3F));
+                        len = 3;
+                    }
+                    if (n + len >= outSize) {
+                        out[0] = '\0';
+                        return false;
+                    }
+                    memcpy(out + n, utf8, len);
+                    n += len;
+                    continue;
+                }
+                case '\0':
+                    out[0] = '\0';
+                    return false;
+                default: c = esc; break; // \" \\ \/
+            }
+        }
+        if (n + 1 >= outSize) {
+            out[0] = '\0';
+            return false;
+        }
+        out[n++] = c;
+    }
+
+    out[n] = '\0';
+    return *p == '"';
+}
+
+double JsonLookup::getNumber(const char* json, const char* path, double defaultValue) {
+    const char* p = find(json, path);
+    if (!p || !(*p == '-' || (*p >= '0' && *p <= '9'))) {
+        return defaultValue;
+    }
+    return strtod(p, NULL);
+}
+
+bool JsonLookup::getBool(const char* json, const char* path, bool defaultValue) {
+    const char* p = find(json, path);
+    if (!p) {
+        return defaultValue;
+    }
+    if (strncmp(p, "true", 4) == 0) {
+        return true;
+    }
+    if (strncmp(p, "false", 5) == 0) {
+        return false;
+    }
+    if (*p == '-' || (*p >= '0' && *p <= '9')) {
+        return strtod(p, NULL) != 0;
+    }
+    return defaultValue;
+}
@@ -0,0 +1,109 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_http_server.h"
+
+/**
+ * Streaming JSON writer for HTTP responses.
+ *
+ * Writes directly into a small fixed buffer that is flushed with
+ * httpd_resp_send_chunk() when full - no heap, no intermediate document.
+ * Responses that fit into the buffer go out as one httpd_resp_send() with
+ * a Content-Length header.
+ *
+ * Usage:
+ *   JsonStreamWriter json(req);
+ *   json.beginObject();
+ *   json.add("status", "online");
+ *   json.beginArray("networks");
+ *   ...
+ *   json.endArray();
+ *   json.endObject();
+ *   return json.finish();
+ *
+ * Passing a null key writes a bare value (array elements).
+ *
+ * The memory constructor renders into a caller buffer instead (used by
+ * ResponseCache); running out of space marks the writer as failed.
+ */
+class JsonStreamWriter {
+public:
+    static const size_t BUFFER_SIZE = 256;
+    static const uint8_t MAX_DEPTH = 16;
+
+    explicit JsonStreamWriter(httpd_req_t* req);
+    JsonStreamWriter(char* out, size_t outSize);
+
+    void beginObject(const char* key = nullptr);
+    void endObject();
+    void beginArray(const char* key = nullptr);
+    void endArray();
+    
+    // Continue an object whose opening brace and first members were written elsewhere
+    void continueObject();
+
+    void add(const char* key, const char* value);
+    void add(const char* key, bool value);
+    void add(const char* key, int value);
+    void add(const char* key, unsigned int value);
+    void add(const char* key, long value);
+    void add(const char* key, unsigned long value);
+    void add(const char* key, long long value);
+    void add(const char* key, unsigned long long value);
+    void add(const char* key, double value);
+    void addNull(const char* key);
+
+    /**
+     * Flush the remaining buffer and terminate the response
+     * @return ESP_OK if every send succeeded
+     */
+    esp_err_t finish();
+
+    bool failed() const { return err != ESP_OK; }
+    size_t size() const { return length; }  // Bytes written (memory target)
+
+private:
+    httpd_req_t* req;      // nullptr when rendering into memory
+    char buffer[BUFFER_SIZE];
+    char* target;
+    size_t capacity;
+    size_t length;
+    esp_err_t err;
+    bool chunked;        // At least one chunk already went out
+    uint8_t depth;
+    uint32_t hasMembers; // Bit n: current container at depth n already has a member
+
+    void flush();
+    void write(const char* data, size_t len);
+    void writeChar(char c);
+    void writeString(const char* str);
+    void writeKey(const char* key);
+    void writeRaw(const char* key, const char* raw);
+};
+
+/**
+ * Zero-allocation lookups in a JSON request body.
+ *
+ * Keys are resolved in the top-level object; a dotted path ("mqtt.server")
+ * descends into nested objects. Values of the wrong type are treated as
+ * missing, like reading a mismatched type from an ArduinoJson document.
+ */
+class JsonLookup {
+public:
+    static bool has(const char* json, const char* path);
+
+    /**
+     * Copy a string value (unescaped) into out
+     * @return false if the key is missing, not a string or does not fit
+     */
+    static bool getString(const char* json, const char* path, char* out, size_t outSize);
+
+    static double getNumber(const char* json, const char* path, double defaultValue = 0);
+    static bool getBool(const char* json, const char* path, bool defaultValue = false);
+
+private:
+    static const char* find(const char* json, const char* path);
+    static const char* skipWhitespace(const char* p);
+    static const char* skipString(const char* p);
+    static const char* skipValue(const char* p);
+};
@@ -0,0 +1,213 @@
+#include "OTADelta.h"
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char* TAG = "OTA_DELTA";
+
+static const char HBD_MAGIC[4] = { 'H', 'B', 'D', '1' };
+
+static uint32_t read_le32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+OTADelta::OTADelta(OTASink& next)
+    : next(next), headerFill(0), running(nullptr), sourceSize(0), targetSize(0), produced(0), argsFill(0),
+      op(OP_NONE), opRemaining(0), copyFrom(0), copyBuffer(nullptr), error(nullptr) {
+    memset(targetHash, 0, sizeof(targetHash));
+}
+
+OTADelta::~OTADelta() {
+    free(copyBuffer);
+}
+
+bool OTADelta::isPatch(const char* name, size_t baseLen) {
+    return baseLen == 12 && strncmp(name, "firmware.hbd", 12) == 0;
+}
+
+bool OTADelta::fail(const char* message) {
+    ESP_LOGE(TAG, "%s", message);
+    error = message;
+    return false;
+}
+
+bool OTADelta::begin(size_t size) {
+    (void)size;   // Patch size; the image size comes from the header
+    return true;
+}
+
+// Header complete: check the running image, then announce the target size
+bool OTADelta::start() {
+    if (memcmp(header, HBD_MAGIC, sizeof(HBD_MAGIC)) != 0) {
+        return fail("Missing HBD1 header");
+    }
+    sourceSize = read_le32(header + 4);
+    const uint8_t* sourceHash = header + 8;
+    targetSize = read_le32(header + 8 + Sha256::DIGEST_SIZE);
+    memcpy(targetHash, header + 12 + Sha256::DIGEST_SIZE, sizeof(targetHash));
+
+    running = esp_ota_get_running_partition();
+    if (!running || sourceSize == 0 || sourceSize > running->size) {
+        ESP_LOGE(TAG, "Patch source (%u bytes) does not fit the running partition", (unsigned)sourceSize);
+        return fail("Patch does not fit the running partition");
+    }
+    copyBuffer = (uint8_t*)malloc(COPY_BUFFER_SIZE);
+    if (!copyBuffer) {
+        return fail("Failed to allocate copy buffer");
+    }
+    if (!hashRunning(sourceHash)) {
+        return false;
+    }
+
+    ESP_LOGI(TAG, "Patch for %s verified: %u -> %u bytes", running->label, (unsigned)sourceSize,
+             (unsigned)targetSize);
+    digest.reset();
+    return next.begin(targetSize);
+}
+
+// One pass over the running image before anything is written: a patch for
+// another build must be rejected, not applied to the wrong bytes
+bool OTADelta::hashRunning(const uint8_t expected[Sha256::DIGEST_SIZE]) {
+    Sha256 hash;
+    for (size_t offset = 0; offset < sourceSize; offset += COPY_BUFFER_SIZE) {
+        size_t len = sourceSize - offset < COPY_BUFFER_SIZE ? sourceSize - offset : COPY_BUFFER_SIZE;
+        if (esp_partition_read(running, offset, copyBuffer, len) != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to read running partition at 0x%x", (unsigned)offset);
+            return fail("Failed to read running partition");
+        }
+        hash.update(copyBuffer, len);
+    }
+
+    uint8_t actual[Sha256::DIGEST_SIZE];
+    hash.finish(actual);
+    if (memcmp(actual, expected, sizeof(actual)) != 0) {
+        char hex[Sha256::DIGEST_SIZE * 2 + 1];
+        Sha256::toHex(actual, hex);
+        ESP_LOGE(TAG, "Running image sha256 %s", hex);
+        return fail("Patch was built for another firmware");
+    }
+    return true;
+}
+
+// args holds a complete op
+bool OTADelta::decodeOp() {
+    if (args[0] == OP_COPY) {
+        copyFrom = read_le32(args + 1);
+        opRemaining = read_le32(args + 5);
+        if (copyFrom > sourceSize || opRemaining > sourceSize - copyFrom) {
+            ESP_LOGE(TAG, "COPY 0x%x+%u outside the source image", (unsigned)copyFrom, (unsigned)opRemaining);
+            return fail("COPY outside the source image");
+        }
+    } else {
+        opRemaining = read_le32(args + 1);
+    }
+    if (opRemaining == 0 || opRemaining > targetSize - produced) {
+        ESP_LOGE(TAG, "Patch op of %u bytes overruns the image", (unsigned)opRemaining);
+        return fail("Patch op overruns the image");
+    }
+    op = (Op)args[0];
+    return true;
+}
+
+bool OTADelta::emit(const uint8_t* data, size_t len) {
+    digest.update(data, len);
+    if (!next.write(data, len)) {
+        return false;   // The next stage has its own error
+    }
+    produced += len;
+    return true;
+}
+
+// A COPY needs no patch bytes, so it runs to completion as soon as it is decoded
+bool OTADelta::copy() {
+    while (opRemaining > 0) {
+        size_t n = opRemaining < COPY_BUFFER_SIZE ? opRemaining : COPY_BUFFER_SIZE;
+        if (esp_partition_read(running, copyFrom, copyBuffer, n) != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to read running partition at 0x%x", (unsigned)copyFrom);
+            return fail("Failed to read running partition");
+        }
+        if (!emit(copyBuffer, n)) {
+            return false;
+        }
+        copyFrom += n;
+        opRemaining -= n;
+    }
+    op = OP_NONE;
+    return true;
+}
+
+bool OTADelta::write(const uint8_t* data, size_t len) {
+    if (error) {
+        return false;
+    }
+    if (headerFill < HEADER_SIZE) {
+        size_t n = HEADER_SIZE - headerFill < len ? HEADER_SIZE - headerFill : len;
+        memcpy(header + headerFill, data, n);
+        headerFill += n;
+        data += n;
+        len -= n;
+        if (headerFill < HEADER_SIZE) {
+            return true;
+        }
+        if (!start()) {
+            return false;
+        }
+    }
+
+    while (len > 0) {
+        if (op == OP_INSERT) {
+            size_t n = len < opRemaining ? len : opRemaining;
+            if (!emit(data, n)) {
+                return false;
+            }
+            data += n;
+            len -= n;
+            opRemaining -= n;
+            if (opRemaining == 0) {
+                op = OP_NONE;
+            }
+            continue;
+        }
+
+        if (produced == targetSize) {
+            return fail("Data after the end of the patch");
+        }
+        if (argsFill == 0 && data[0] != OP_COPY && data[0] != OP_INSERT) {
+            ESP_LOGE(TAG, "Unknown patch op 0x%02x", data[0]);
+            return fail("Unknown patch op");
+        }
+        size_t need = (argsFill > 0 ? args[0] : data[0]) == OP_COPY ? 9 : 5;
+        size_t n = need - argsFill < len ? need - argsFill : len;
+        memcpy(args + argsFill, data, n);
+        argsFill += n;
+        data += n;
+        len -= n;
+        if (argsFill < need) {
+            break;
+        }
+        argsFill = 0;
+        if (!decodeOp() || (op == OP_COPY && !copy())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool OTADelta::end() {
+    if (error) {
+        return false;
+    }
+    if (headerFill < HEADER_SIZE || produced != targetSize || argsFill > 0) {
+        ESP_LOGE(TAG, "Patch ended at %u of %u bytes", (unsigned)produced, (unsigned)targetSize);
+        return fail("Patch truncated");
+    }
+
+    uint8_t actual[Sha256::DIGEST_SIZE];
+    digest.finish(actual);
+    if (memcmp(actual, targetHash, sizeof(actual)) != 0) {
+        return fail("Rebuilt image does not match the target sha256");
+    }
+    ESP_LOGI(TAG, "Rebuilt image verified");
+    return next.end();
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "OTASink.h"
+#include "Sha256.h"
+#include "esp_partition.h"
+
+/**
+ * Rebuilds a firmware image from a delta patch and the running partition
+ * while the patch streams in, and passes the image on to the next sink.
+ * Written by build_ota_delta.py.
+ *
+ * Patch layout (integers uint32 LE):
+ *   "HBD1" | source size | source SHA-256 | target size | target SHA-256 | ops
+ *   op 0x01 COPY:   source offset, length   -> bytes from the running image
+ *   op 0x02 INSERT: length, then the bytes  -> literal data from the patch
+ *
+ * INSERT data is forwarded straight from the caller's chunks; COPY goes
+ * through a small buffer read from the running partition. The running image
+ * is hashed once the header is in, before anything reaches flash; the
+ * result is hashed as it is produced and a mismatch fails end(), so
+ * OTAManager never switches the boot partition to a wrong image.
+ */
+class OTADelta : public OTASink {
+public:
+    static const size_t HEADER_SIZE = 4 + 4 + Sha256::DIGEST_SIZE + 4 + Sha256::DIGEST_SIZE;
+    static const size_t COPY_BUFFER_SIZE = 1024;
+
+    explicit OTADelta(OTASink& next);
+    ~OTADelta();
+
+    bool begin(size_t size) override;
+    bool write(const uint8_t* data, size_t len) override;
+    bool end() override;
+
+    /**
+     * Why this stage failed; nullptr if it did not, or the next stage did
+     */
+    const char* getError() const { return error; }
+
+    /**
+     * Base name "firmware.hbd" (optionally packed, see OTAInflate)
+     */
+    static bool isPatch(const char* name, size_t baseLen);
+
+private:
+    enum Op : uint8_t { OP_NONE = 0, OP_COPY = 0x01, OP_INSERT = 0x02 };
+    static const size_t MAX_ARGS = 9;   // Op byte + two uint32
+
+    OTASink& next;
+    uint8_t header[HEADER_SIZE];
+    size_t headerFill;
+    const esp_partition_t* running;
+    size_t sourceSize;
+    size_t targetSize;
+    size_t produced;         // Image bytes passed on so far
+    uint8_t args[MAX_ARGS];  // Op being assembled from the stream
+    size_t argsFill;
+    Op op;
+    size_t opRemaining;
+    size_t copyFrom;         // Next running-partition offset of a COPY
+    uint8_t* copyBuffer;
+    uint8_t targetHash[Sha256::DIGEST_SIZE];
+    Sha256 digest;
+    const char* error;
+
+    bool start();
+    bool hashRunning(const uint8_t expected[Sha256::DIGEST_SIZE]);
+    bool decodeOp();
+    bool emit(const uint8_t* data, size_t len);
+    bool copy();
+    bool fail(const char* message);
+};
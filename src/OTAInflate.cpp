@@ -0,0 +1,112 @@
+#include "OTAInflate.h"
+#include "esp_log.h"
+#include "esp32/rom/miniz.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char* TAG = "OTA_INFLATE";
+
+static const char HBZ_MAGIC[4] = { 'H', 'B', 'Z', '1' };
+
+OTAInflate::OTAInflate(OTASink& next)
+    : next(next), headerFill(0), memberSize(0), rawSize(0), produced(0), decompressor(nullptr), window(nullptr),
+      outPos(0), finished(false), error(nullptr) {
+}
+
+OTAInflate::~OTAInflate() {
+    free(decompressor);
+    free(window);
+}
+
+bool OTAInflate::isPacked(const char* name) {
+    size_t len = strlen(name);
+    return len > 2 && strcmp(name + len - 2, ".z") == 0;
+}
+
+bool OTAInflate::fail(const char* message) {
+    ESP_LOGE(TAG, "%s", message);
+    error = message;
+    return false;
+}
+
+bool OTAInflate::begin(size_t size) {
+    memberSize = size;
+    return true;
+}
+
+// Header complete: set up the decoder and announce the real image size
+bool OTAInflate::start() {
+    if (memcmp(header, HBZ_MAGIC, sizeof(HBZ_MAGIC)) != 0) {
+        return fail("Missing HBZ1 header");
+    }
+    rawSize = (size_t)header[4] | ((size_t)header[5] << 8) | ((size_t)header[6] << 16) | ((size_t)header[7] << 24);
+
+    decompressor = malloc(sizeof(tinfl_decompressor));
+    window = (uint8_t*)malloc(WINDOW_SIZE);
+    if (!decompressor || !window) {
+        return fail("Failed to allocate decoder");
+    }
+    tinfl_init((tinfl_decompressor*)decompressor);
+
+    ESP_LOGI(TAG, "Packed member: %u -> %u bytes", (unsigned)memberSize, (unsigned)rawSize);
+    return next.begin(rawSize);
+}
+
+bool OTAInflate::write(const uint8_t* data, size_t len) {
+    if (error) {
+        return false;
+    }
+    if (headerFill < HEADER_SIZE) {
+        size_t n = HEADER_SIZE - headerFill < len ? HEADER_SIZE - headerFill : len;
+        memcpy(header + headerFill, data, n);
+        headerFill += n;
+        data += n;
+        len -= n;
+        if (headerFill < HEADER_SIZE) {
+            return true;
+        }
+        if (!start()) {
+            return false;
+        }
+    }
+
+    // The decoder writes from outPos up to the end of the ring at most, so
+    // each call leaves one contiguous run to pass on
+    while (!finished) {
+        size_t inBytes = len;
+        size_t outBytes = WINDOW_SIZE - outPos;
+        tinfl_status status = tinfl_decompress((tinfl_decompressor*)decompressor, data, &inBytes,
+                                               window, window + outPos, &outBytes, TINFL_FLAG_HAS_MORE_INPUT);
+        data += inBytes;
+        len -= inBytes;
+        if (outBytes > 0) {
+            if (produced + outBytes > rawSize) {
+                return fail("Deflate stream longer than announced");
+            }
+            if (!next.write(window + outPos, outBytes)) {
+                return false;   // The next stage has its own error
+            }
+            produced += outBytes;
+            outPos = (outPos + outBytes) & (WINDOW_SIZE - 1);
+        }
+
+        if (status == TINFL_STATUS_DONE) {
+            finished = true;
+        } else if (status < 0) {
+            return fail("Corrupt deflate stream");
+        } else if (status == TINFL_STATUS_NEEDS_MORE_INPUT) {
+            break;   // All of this chunk is consumed
+        }
+    }
+    return true;
+}
+
+bool OTAInflate::end() {
+    if (error) {
+        return false;
+    }
+    if (!finished || produced != rawSize) {
+        return fail("Deflate stream truncated");
+    }
+    return next.end();
+}
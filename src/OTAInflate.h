@@ -0,0 +1,54 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "OTASink.h"
+
+/**
+ * Decompresses a packed TAR member ("firmware.bin.z", "spiffs.bin.z") while
+ * it streams in and passes the image on to the next sink.
+ *
+ * Member layout, written by build_ota_package.py:
+ *   "HBZ1" | uncompressed size (uint32 LE) | raw deflate stream
+ *
+ * The packer limits the deflate window to WINDOW_SIZE, so the ROM tinfl
+ * decoder can run with a WINDOW_SIZE ring instead of the usual 32 KB. Input
+ * is decoded straight from the caller's chunks.
+ */
+class OTAInflate : public OTASink {
+public:
+    static const size_t HEADER_SIZE = 8;
+    static const size_t WINDOW_SIZE = 4096;   // 2^12, matches WINDOW_BITS in the packer
+
+    explicit OTAInflate(OTASink& next);
+    ~OTAInflate();
+
+    bool begin(size_t size) override;
+    bool write(const uint8_t* data, size_t len) override;
+    bool end() override;
+
+    /**
+     * Why this stage failed; nullptr if it did not, or the next stage did
+     */
+    const char* getError() const { return error; }
+
+    /**
+     * Name ends in ".z": the packed variant of a known member
+     */
+    static bool isPacked(const char* name);
+
+private:
+    OTASink& next;
+    uint8_t header[HEADER_SIZE];
+    size_t headerFill;
+    size_t memberSize;
+    size_t rawSize;
+    size_t produced;
+    void* decompressor;      // tinfl_decompressor, ~11 KB, only while in use
+    uint8_t* window;
+    size_t outPos;           // Next write position of the decoder in window
+    bool finished;
+    const char* error;
+
+    bool start();
+    bool fail(const char* message);
+};
@@ -1,25 +1,48 @@
 #include "OTAManager.h"
+#include "OTAPackage.h"
 #include "esp_log.h"
-#include "esp_ota_ops.h"
-#include "esp_partition.h"
 #include "esp_spiffs.h"
+#include "freertos/FreeRTOS.h"
+#include <stdlib.h>
 #include <string.h>
 
 static const char* TAG = "OTA";
 
+static portMUX_TYPE status_lock = portMUX_INITIALIZER_UNLOCKED;
+
 // Maximum file size in ZIP (10MB for firmware, 2MB for SPIFFS)
 #define MAX_FIRMWARE_SIZE (10 * 1024 * 1024)
 #define MAX_SPIFFS_SIZE (2 * 1024 * 1024)
 
-OTAManager::OTAManager() : progress(0) {
+// Flash erase / program units. A 64 KB block erase costs about as much as
+// two or three 4 KB sector erases, so whole blocks are erased where possible.
+static const size_t ERASE_BLOCK_SIZE = 64 * 1024;
+static const size_t FLASH_PAGE_SIZE = 256;
+
+// Erased flash reads 0xFF, so a page of nothing else needs no programming
+static bool is_blank(const uint8_t* data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (data[i] != 0xFF) {
+            return false;
+        }
+    }
+    return true;
+}
+
+OTAManager::OTAManager()
+    : progress(0), state(STATE_IDLE), target(TARGET_NONE), packageOpen(false), writtenBytes(0), totalBytes(0), otaHandle(0),
+      updatePartition(nullptr), streamBuffer(nullptr), streamFill(0), streamReceived(0),
+      checkDigest(false) {
     memset(lastError, 0, sizeof(lastError));
+    beginPartition(&cursor, nullptr, 0);
 }
 
 OTAManager::~OTAManager() {
+    abortStream();
 }
 
 bool OTAManager::processTarUpdate(const uint8_t* tarData, size_t tarSize) {
-    ESP_LOGI(TAG, "Processing TAR update, size: %d bytes", tarSize);
+    ESP_LOGI(TAG, "Processing TAR update, size: %u bytes", (unsigned)tarSize);
     progress = 0;
     
     if (!tarData || tarSize == 0) {
@@ -27,7 +50,12 @@ bool OTAManager::processTarUpdate(const uint8_t* tarData, size_t tarSize) {
         return false;
     }
     
-    return extractAndFlashTar(tarData, tarSize);
+    OTAPackage package(*this);
+    if (!package.push(tarData, tarSize) || !package.finish()) {
+        snprintf(lastError, sizeof(lastError), "%s", package.getError());
+        return false;
+    }
+    return true;
 }
 
 bool OTAManager::processTarUpdateFromFile(const char* tarFilePath) {
@@ -40,284 +68,31 @@ bool OTAManager::processTarUpdateFromFile(const char* tarFilePath) {
         return false;
     }
     
-    // Get file size
-    fseek(tarFile, 0, SEEK_END);
-    size_t tarSize = ftell(tarFile);
-    fseek(tarFile, 0, SEEK_SET);
-    
-    ESP_LOGI(TAG, "TAR file size: %d bytes", tarSize);
-    
-    bool result = extractAndFlashTarFromFile(tarFile, tarSize);
-    fclose(tarFile);
-    
-    return result;
-}
-
-size_t OTAManager::parseOctal(const char* str, size_t len) {
-    size_t result = 0;
-    for (size_t i = 0; i < len && str[i] != '\0' && str[i] != ' '; i++) {
-        if (str[i] >= '0' && str[i] <= '7') {
-            result = result * 8 + (str[i] - '0');
-        }
-    }
-    return result;
-}
-
-bool OTAManager::extractAndFlashTarFromFile(FILE* tarFile, size_t tarSize) {
-    bool firmwareFound = false;
-    bool spiffsFound = false;
-    bool success = true;
-    size_t offset = 0;
-    
-    // Allocate buffer for reading TAR headers and file data
-    const size_t BUFFER_SIZE = 32 * 1024; // 32KB buffer for file data
+    // One flash sector per read; the package never needs more than the current chunk
+    const size_t BUFFER_SIZE = 4096;
     uint8_t* buffer = (uint8_t*)malloc(BUFFER_SIZE);
     if (!buffer) {
+        fclose(tarFile);
         snprintf(lastError, sizeof(lastError), "Failed to allocate buffer");
         return false;
     }
     
-    TarHeader header;
-    
-    while (offset < tarSize) {
-        // Read TAR header
-        if (fread(&header, 1, 512, tarFile) != 512) {
-            ESP_LOGE(TAG, "Failed to read TAR header");
-            free(buffer);
-            return false;
-        }
-        offset += 512;
-        
-        // Check for end of archive (zero block)
-        bool allZero = true;
-        uint8_t* headerBytes = (uint8_t*)&header;
-        for (size_t i = 0; i < 512; i++) {
-            if (headerBytes[i] != 0) {
-                allZero = false;
-                break;
-            }
-        }
-        if (allZero) {
-            ESP_LOGI(TAG, "Reached end of TAR archive");
-            break;
-        }
-        
-        // Verify TAR magic
-        if (strncmp(header.magic, "ustar", 5) != 0) {
-            ESP_LOGW(TAG, "Invalid TAR magic at offset %d", offset - 512);
-            free(buffer);
-            return false;
-        }
-        
-        // Parse file size
-        size_t fileSize = parseOctal(header.size, 12);
-        char filename[256];
-        snprintf(filename, sizeof(filename), "%s", header.name);
-        
-        ESP_LOGI(TAG, "Found file: %s (%u bytes)", filename, fileSize);
-        
-        // Check if it's a regular file
-        if (header.typeflag == '0' || header.typeflag == '\0') {
-            if (strcmp(filename, "firmware.bin") == 0) {
-                ESP_LOGI(TAG, "Flashing firmware.bin...");
-                progress = 25;
-                
-                // Allocate buffer for firmware (we need entire firmware in RAM for flashing)
-                uint8_t* fwBuffer = (uint8_t*)malloc(fileSize);
-                if (!fwBuffer) {
-                    ESP_LOGE(TAG, "Failed to allocate %d bytes for firmware", fileSize);
-                    free(buffer);
-                    snprintf(lastError, sizeof(lastError), "Out of memory for firmware");
-                    return false;
-                }
-                
-                // Read firmware into buffer
-                size_t read = fread(fwBuffer, 1, fileSize, tarFile);
-                if (read != fileSize) {
-                    ESP_LOGE(TAG, "Failed to read firmware data");
-                    free(fwBuffer);
-                    free(buffer);
-                    return false;
-                }
-                
-                if (flashFirmware(fwBuffer, fileSize)) {
-                    firmwareFound = true;
-                    progress = 50;
-                    ESP_LOGI(TAG, "Firmware flashed successfully");
-                } else {
-                    success = false;
-                }
-                
-                free(fwBuffer);
-                if (!success) break;
-                
-            } else if (strcmp(filename, "spiffs.bin") == 0) {
-                ESP_LOGI(TAG, "Flashing spiffs.bin...");
-                progress = 75;
-                
-                // Allocate buffer for SPIFFS
-                uint8_t* spiffsBuffer = (uint8_t*)malloc(fileSize);
-                if (!spiffsBuffer) {
-                    ESP_LOGE(TAG, "Failed to allocate %d bytes for SPIFFS", fileSize);
-                    free(buffer);
-                    snprintf(lastError, sizeof(lastError), "Out of memory for SPIFFS");
-                    return false;
-                }
-                
-                // Read SPIFFS into buffer
-                size_t read = fread(spiffsBuffer, 1, fileSize, tarFile);
-                if (read != fileSize) {
-                    ESP_LOGE(TAG, "Failed to read SPIFFS data");
-                    free(spiffsBuffer);
-                    free(buffer);
-                    return false;
-                }
-                
-                if (flashSPIFFS(spiffsBuffer, fileSize)) {
-                    spiffsFound = true;
-                    progress = 100;
-                    ESP_LOGI(TAG, "SPIFFS flashed successfully");
-                } else {
-                    success = false;
-                }
-                
-                free(spiffsBuffer);
-                if (!success) break;
-                
-            } else {
-                ESP_LOGW(TAG, "Ignoring file: %s", filename);
-                // Skip file data
-                fseek(tarFile, fileSize, SEEK_CUR);
-            }
-        } else {
-            // Skip non-regular files
-            fseek(tarFile, fileSize, SEEK_CUR);
-        }
-        
-        // Move to next file (data is padded to 512-byte boundary)
-        size_t paddedSize = (fileSize + 511) & ~511;
-        offset += paddedSize;
-        
-        // Align file position to 512-byte boundary
-        long currentPos = ftell(tarFile);
-        long alignedPos = (currentPos + 511) & ~511;
-        if (alignedPos != currentPos) {
-            fseek(tarFile, alignedPos, SEEK_SET);
-        }
-    }
-    
-    free(buffer);
-    
-    if (!firmwareFound && !spiffsFound) {
-        snprintf(lastError, sizeof(lastError), "TAR must contain firmware.bin and/or spiffs.bin");
-        return false;
-    }
-    
-    if (success) {
-        ESP_LOGI(TAG, "Update successful! Firmware: %s, SPIFFS: %s", 
-                 firmwareFound ? "YES" : "NO", 
-                 spiffsFound ? "YES" : "NO");
-    }
-    
-    return success;
-}
-
-bool OTAManager::extractAndFlashTar(const uint8_t* tarData, size_t tarSize) {
-    size_t offset = 0;
-    bool firmwareFound = false;
-    bool spiffsFound = false;
+    OTAPackage package(*this);
     bool success = true;
-    
-    while (offset < tarSize) {
-        // Check if we've reached end of archive (two consecutive zero blocks)
-        if (offset + 1024 > tarSize) break;
-        
-        bool allZero = true;
-        for (size_t i = 0; i < 512; i++) {
-            if (tarData[offset + i] != 0) {
-                allZero = false;
-                break;
-            }
-        }
-        if (allZero) break; // End of archive
-        
-        // Read TAR header
-        TarHeader* header = (TarHeader*)(tarData + offset);
-        
-        // Verify TAR magic
-        if (strncmp(header->magic, "ustar", 5) != 0) {
-            ESP_LOGW(TAG, "Invalid TAR magic at offset %d", offset);
-            offset += 512;
-            continue;
-        }
-        
-        // Parse file size
-        size_t fileSize = parseOctal(header->size, 12);
-        
-        // Get filename
-        char filename[256];
-        snprintf(filename, sizeof(filename), "%s", header->name);
-        
-        ESP_LOGI(TAG, "Found file: %s (%u bytes)", filename, fileSize);
-        
-        // Move to file data (skip header)
-        offset += 512;
-        
-        if (offset + fileSize > tarSize) {
-            snprintf(lastError, sizeof(lastError), "TAR file truncated");
-            return false;
-        }
-        
-        // Check if it's a regular file
-        if (header->typeflag == '0' || header->typeflag == '\0') {
-            const uint8_t* fileData = tarData + offset;
-            
-            // Check filename and flash accordingly
-            if (strcmp(filename, "firmware.bin") == 0) {
-                ESP_LOGI(TAG, "Flashing firmware.bin...");
-                progress = 25;
-                if (flashFirmware(fileData, fileSize)) {
-                    firmwareFound = true;
-                    progress = 50;
-                    ESP_LOGI(TAG, "Firmware flashed successfully");
-                } else {
-                    success = false;
-                    break;
-                }
-            } 
-            else if (strcmp(filename, "spiffs.bin") == 0) {
-                ESP_LOGI(TAG, "Flashing spiffs.bin...");
-                progress = 75;
-                if (flashSPIFFS(fileData, fileSize)) {
-                    spiffsFound = true;
-                    progress = 100;
-                    ESP_LOGI(TAG, "SPIFFS flashed successfully");
-                } else {
-                    success = false;
-                    break;
-                }
-            }
-            else {
-                ESP_LOGW(TAG, "Ignoring file: %s", filename);
-            }
-        }
-        
-        // Move to next file (data is padded to 512-byte boundary)
-        size_t paddedSize = (fileSize + 511) & ~511;
-        offset += paddedSize;
+    size_t read;
+    while (success && (read = fread(buffer, 1, BUFFER_SIZE, tarFile)) > 0) {
+        success = package.push(buffer, read);
     }
-    
-    if (!firmwareFound && !spiffsFound) {
-        snprintf(lastError, sizeof(lastError), "TAR must contain firmware.bin and/or spiffs.bin");
-        return false;
-    }
-    
-    if (success) {
-        ESP_LOGI(TAG, "Update successful! Firmware: %s, SPIFFS: %s", 
-                 firmwareFound ? "YES" : "NO", 
-                 spiffsFound ? "YES" : "NO");
+    if (success && ferror(tarFile)) {
+        success = false;
+        snprintf(lastError, sizeof(lastError), "Failed to read TAR file");
+    } else if (!success || !package.finish()) {
+        success = false;
+        snprintf(lastError, sizeof(lastError), "%s", package.getError());
     }
     
+    free(buffer);
+    fclose(tarFile);
     return success;
 }
 
@@ -330,10 +105,10 @@ bool OTAManager::flashSPIFFSDirect(const uint8_t* data, size_t size) {
 }
 
 bool OTAManager::flashFirmware(const uint8_t* data, size_t size) {
-    ESP_LOGI(TAG, "Flashing firmware (%d bytes)...", size);
+    ESP_LOGI(TAG, "Flashing firmware (%u bytes)...", (unsigned)size);
     
     if (size > MAX_FIRMWARE_SIZE) {
-        snprintf(lastError, sizeof(lastError), "Firmware too large: %d bytes", size);
+        snprintf(lastError, sizeof(lastError), "Firmware too large: %u bytes", (unsigned)size);
         return false;
     }
     
@@ -373,8 +148,7 @@ bool OTAManager::flashFirmware(const uint8_t* data, size_t size) {
     }
     
     // Verify
-    if (!verifyPartition("factory")) {
-        snprintf(lastError, sizeof(lastError), "Firmware verification failed");
+    if (!verifyWritten(update_partition, data, size)) {
         return false;
     }
     
@@ -383,16 +157,13 @@ bool OTAManager::flashFirmware(const uint8_t* data, size_t size) {
 }
 
 bool OTAManager::flashSPIFFS(const uint8_t* data, size_t size) {
-    ESP_LOGI(TAG, "Flashing SPIFFS (%d bytes)...", size);
+    ESP_LOGI(TAG, "Flashing SPIFFS (%u bytes)...", (unsigned)size);
     
     if (size > MAX_SPIFFS_SIZE) {
-        snprintf(lastError, sizeof(lastError), "SPIFFS too large: %d bytes", size);
+        snprintf(lastError, sizeof(lastError), "SPIFFS too large: %u bytes", (unsigned)size);
         return false;
     }
     
-    // Unmount SPIFFS first
-    esp_vfs_spiffs_unregister(NULL);
-    
     // Find SPIFFS partition
     const esp_partition_t* spiffs_partition = esp_partition_find_first(
         ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_SPIFFS, NULL);
@@ -402,20 +173,29 @@ bool OTAManager::flashSPIFFS(const uint8_t* data, size_t size) {
         return false;
     }
     
+    if (size > spiffs_partition->size) {
+        snprintf(lastError, sizeof(lastError), "SPIFFS image too large: %u > %u bytes", (unsigned)size,
+                 (unsigned)spiffs_partition->size);
+        return false;
+    }
+    
+    // Unmount SPIFFS first
+    esp_vfs_spiffs_unregister(NULL);
+    
     ESP_LOGI(TAG, "Writing to SPIFFS partition (offset: 0x%x, size: 0x%x)", 
              spiffs_partition->address, spiffs_partition->size);
     
-    // Erase partition
-    ESP_LOGI(TAG, "Erasing SPIFFS partition...");
-    esp_err_t err = esp_partition_erase_range(spiffs_partition, 0, spiffs_partition->size);
-    if (err != ESP_OK) {
-        snprintf(lastError, sizeof(lastError), "Failed to erase SPIFFS: %s", esp_err_to_name(err));
-        return false;
+    // Same path as the streaming flash: erase ahead of each sector, then the tail
+    PartitionCursor writer;
+    beginPartition(&writer, spiffs_partition, size);
+    esp_err_t err = ESP_OK;
+    for (size_t offset = 0; offset < size && err == ESP_OK; offset += SPI_FLASH_SEC_SIZE) {
+        size_t len = size - offset < SPI_FLASH_SEC_SIZE ? size - offset : SPI_FLASH_SEC_SIZE;
+        err = writePartitionBlock(data + offset, len, &writer);
+    }
+    if (err == ESP_OK) {
+        err = eraseTail(&writer);
     }
-    
-    // Write SPIFFS
-    ESP_LOGI(TAG, "Writing SPIFFS data...");
-    err = esp_partition_write(spiffs_partition, 0, data, size);
     if (err != ESP_OK) {
         snprintf(lastError, sizeof(lastError), "Failed to write SPIFFS: %s", esp_err_to_name(err));
         return false;
@@ -435,34 +215,370 @@ bool OTAManager::flashSPIFFS(const uint8_t* data, size_t size) {
     return true;
 }
 
-bool OTAManager::verifyPartition(const char* partitionLabel) {
-    const esp_partition_t* partition = esp_partition_find_first(
-        ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_FACTORY, partitionLabel);
-    
-    if (!partition) {
+// The Direct API has no manifest, but the image is still in RAM: compare the
+// flash against it
+bool OTAManager::verifyWritten(const esp_partition_t* partition, const uint8_t* data, size_t size) {
+    uint8_t sample[256];
+    for (size_t offset = 0; offset < size; offset += sizeof(sample)) {
+        size_t len = size - offset < sizeof(sample) ? size - offset : sizeof(sample);
+        esp_err_t err = esp_partition_read(partition, offset, sample, len);
+        if (err != ESP_OK) {
+            snprintf(lastError, sizeof(lastError), "Failed to read back firmware: %s", esp_err_to_name(err));
+            return false;
+        }
+        if (memcmp(sample, data + offset, len) != 0) {
+            snprintf(lastError, sizeof(lastError), "Firmware verification failed at 0x%x", (unsigned)offset);
+            return false;
+        }
+    }
+    return true;
+}
+
+void OTAManager::getStatus(Status* out) const {
+    portENTER_CRITICAL(&status_lock);
+    out->state = state;
+    out->target = target;
+    out->written = writtenBytes;
+    out->total = totalBytes;
+    portEXIT_CRITICAL(&status_lock);
+    out->progress = out->total > 0 ? (uint8_t)((uint64_t)out->written * 100 / out->total) : 0;
+    out->error[0] = '\0';
+    if (out->state == STATE_FAILED) {
+        // Written before the state flipped to failed and not touched until the next begin
+        strncpy(out->error, lastError, sizeof(out->error) - 1);
+        out->error[sizeof(out->error) - 1] = '\0';
+    }
+}
+
+bool OTAManager::claimPackage() {
+    portENTER_CRITICAL(&status_lock);
+    bool claimed = !packageOpen;
+    packageOpen = true;
+    portEXIT_CRITICAL(&status_lock);
+    return claimed;
+}
+
+void OTAManager::releasePackage() {
+    portENTER_CRITICAL(&status_lock);
+    packageOpen = false;
+    portEXIT_CRITICAL(&status_lock);
+}
+
+// Only one streaming flash at a time: both targets share the chunk path and lastError
+bool OTAManager::beginStatus(Target which, size_t total) {
+    portENTER_CRITICAL(&status_lock);
+    if (state == STATE_RUNNING) {
+        portEXIT_CRITICAL(&status_lock);
+        return false;
+    }
+    state = STATE_RUNNING;
+    target = which;
+    writtenBytes = 0;
+    totalBytes = total;
+    portEXIT_CRITICAL(&status_lock);
+    progress = 0;
+    lastError[0] = '\0';
+    return true;
+}
+
+void OTAManager::updateStatus(size_t written) {
+    portENTER_CRITICAL(&status_lock);
+    writtenBytes = written;
+    portEXIT_CRITICAL(&status_lock);
+    
+    // Reads return whatever the socket had, so log on crossing each 10% step
+    uint8_t percent = totalBytes > 0 ? (uint8_t)((uint64_t)written * 100 / totalBytes) : 100;
+    if (percent / 10 != progress / 10) {
+        ESP_LOGI(TAG, "%s flash progress: %u / %u bytes (%u%%)",
+                 target == TARGET_FIRMWARE ? "Firmware" : "SPIFFS",
+                 (unsigned)written, (unsigned)totalBytes, percent);
+    }
+    progress = percent;
+}
+
+void OTAManager::endStatus(bool success) {
+    portENTER_CRITICAL(&status_lock);
+    state = success ? STATE_DONE : STATE_FAILED;
+    portEXIT_CRITICAL(&status_lock);
+}
+
+bool OTAManager::flashFirmwareStreaming(size_t totalSize, ReadCallback readCallback, void* userData) {
+    return flashStreaming(TARGET_FIRMWARE, totalSize, readCallback, userData);
+}
+
+bool OTAManager::flashSPIFFSStreaming(size_t totalSize, ReadCallback readCallback, void* userData) {
+    return flashStreaming(TARGET_FILESYSTEM, totalSize, readCallback, userData);
+}
+
+bool OTAManager::flashStreaming(Target which, size_t totalSize, ReadCallback readCallback, void* userData) {
+    if (!beginStream(which, totalSize)) {
+        return false;
+    }
+    if (!pumpStream(readCallback, userData)) {
+        abortStream();
         return false;
     }
+    return endStream();
+}
+
+// Fills each ring buffer completely before submitting it: socket reads return
+// whatever arrived, flash writes are cheapest in whole sectors. The callback
+// reads straight into the ring, so this path copies nothing. Progress counts
+// received bytes and runs at most one ring (16 KB) ahead of the flash.
+bool OTAManager::pumpStream(ReadCallback readCallback, void* userData) {
+    while (streamReceived < totalBytes) {
+        uint8_t* buffer = pipeline.acquire();
+        if (!buffer) {
+            return false;  // Write failed, reported by abortStream()
+        }
+        
+        size_t want = totalBytes - streamReceived;
+        if (want > OTAPipeline::BUFFER_SIZE) {
+            want = OTAPipeline::BUFFER_SIZE;
+        }
+        size_t filled = 0;
+        while (filled < want) {
+            size_t read = readCallback(buffer + filled, want - filled, userData);
+            if (read == 0) {
+                break;
+            }
+            filled += read;
+        }
+        
+        streamDigest.update(buffer, filled);
+        pipeline.submit(buffer, filled);
+        streamReceived += filled;
+        if (filled < want) {
+            snprintf(lastError, sizeof(lastError), "Failed to read %s data", streamName());
+            return false;
+        }
+        updateStatus(streamReceived);
+    }
+    return true;
+}
+
+bool OTAManager::beginStream(Target which, size_t totalSize, const uint8_t* expectedSha256) {
+    if (!beginStatus(which, totalSize)) {
+        ESP_LOGW(TAG, "%s flash rejected: another update is running",
+                 which == TARGET_FIRMWARE ? "Firmware" : "SPIFFS");
+        return false;
+    }
+    streamBuffer = nullptr;
+    streamFill = 0;
+    streamReceived = 0;
+    streamDigest.reset();
+    checkDigest = expectedSha256 != nullptr;
+    if (checkDigest) {
+        memcpy(expectedDigest, expectedSha256, sizeof(expectedDigest));
+    }
     
-    // Basic verification - check if partition is not all 0xFF (erased)
-    uint8_t sample[32];
-    esp_partition_read(partition, 0, sample, sizeof(sample));
+    bool opened = which == TARGET_FIRMWARE ? openFirmware(totalSize) : openSPIFFS(totalSize);
+    if (!opened) {
+        endStatus(false);
+    }
+    return opened;
+}
+
+// Copies into the ring: the caller's chunk is gone once this returns, the
+// writer task flashes the ring buffer later
+bool OTAManager::writeStream(const uint8_t* data, size_t len) {
+    if (state != STATE_RUNNING) {
+        return false;
+    }
+    if (len > totalBytes - streamReceived) {
+        snprintf(lastError, sizeof(lastError), "More %s data than the announced %u bytes",
+                 streamName(), (unsigned)totalBytes);
+        return false;
+    }
+    streamDigest.update(data, len);
     
-    bool allFF = true;
-    for (int i = 0; i < sizeof(sample); i++) {
-        if (sample[i] != 0xFF) {
-            allFF = false;
-            break;
+    while (len > 0) {
+        if (!streamBuffer) {
+            streamBuffer = pipeline.acquire();
+            streamFill = 0;
+            if (!streamBuffer) {
+                return false;  // Write failed, reported by abortStream()
+            }
         }
+        size_t n = OTAPipeline::BUFFER_SIZE - streamFill;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(streamBuffer + streamFill, data, n);
+        streamFill += n;
+        streamReceived += n;
+        data += n;
+        len -= n;
+        
+        if (streamFill == OTAPipeline::BUFFER_SIZE || streamReceived == totalBytes) {
+            pipeline.submit(streamBuffer, streamFill);
+            streamBuffer = nullptr;
+            updateStatus(streamReceived);
+        }
+    }
+    return true;
+}
+
+bool OTAManager::endStream() {
+    if (state != STATE_RUNNING) {
+        return false;
+    }
+    bool success = finishPipeline();
+    if (success && streamReceived != totalBytes) {
+        snprintf(lastError, sizeof(lastError), "%s data truncated: %u of %u bytes",
+                 streamName(), (unsigned)streamReceived, (unsigned)totalBytes);
+        success = false;
     }
     
-    return !allFF; // Should not be all erased
+    if (success) {
+        pipeline.logStats(target == TARGET_FIRMWARE ? "Firmware" : "SPIFFS");
+        success = verifyDigest();
+    }
+    
+    // A mismatch leaves the boot partition as it was and SPIFFS unmounted
+    if (success) {
+        success = target == TARGET_FIRMWARE ? closeFirmware() : closeSPIFFS();
+    } else if (target == TARGET_FIRMWARE) {
+        esp_ota_abort(otaHandle);
+    }
+    endStatus(success);
+    return success;
 }
 
-bool OTAManager::flashFirmwareStreaming(size_t totalSize, ReadCallback readCallback, void* userData) {
-    ESP_LOGI(TAG, "Streaming firmware flash (%d bytes)...", totalSize);
+void OTAManager::abortStream() {
+    if (state != STATE_RUNNING) {
+        return;
+    }
+    finishPipeline();
+    if (lastError[0] == '\0') {
+        snprintf(lastError, sizeof(lastError), "%s update aborted", streamName());
+    }
+    if (target == TARGET_FIRMWARE) {
+        esp_ota_abort(otaHandle);
+    }
+    ESP_LOGE(TAG, "%s", lastError);
+    endStatus(false);
+}
+
+// Drains the ring; a write error is the root cause of whatever failed after it
+bool OTAManager::finishPipeline() {
+    if (streamBuffer) {
+        pipeline.submit(streamBuffer, 0);
+        streamBuffer = nullptr;
+    }
+    esp_err_t err = pipeline.finish();
+    if (err != ESP_OK) {
+        snprintf(lastError, sizeof(lastError), "Failed to write %s: %s", streamName(), esp_err_to_name(err));
+        return false;
+    }
+    return true;
+}
+
+// The digest is updated on the receiving side, where the data is hot in the
+// cache and the writer task's flash time stays free for the next buffer
+bool OTAManager::verifyDigest() {
+    uint8_t actual[Sha256::DIGEST_SIZE];
+    char hex[Sha256::DIGEST_SIZE * 2 + 1];
+    streamDigest.finish(actual);
+    Sha256::toHex(actual, hex);
+    if (!checkDigest) {
+        ESP_LOGW(TAG, "%s sha256 %s (not verified, no expected digest)", streamName(), hex);
+        return true;
+    }
+    if (memcmp(actual, expectedDigest, sizeof(actual)) != 0) {
+        ESP_LOGE(TAG, "%s sha256 %s does not match the manifest", streamName(), hex);
+        snprintf(lastError, sizeof(lastError), "%s sha256 mismatch", streamName());
+        return false;
+    }
+    ESP_LOGI(TAG, "%s sha256 verified: %s", streamName(), hex);
+    return true;
+}
+
+// OTAPipeline write functions, called on the writer task
+esp_err_t OTAManager::writeOtaBlock(const uint8_t* data, size_t len, void* ctx) {
+    return esp_ota_write(*(esp_ota_handle_t*)ctx, data, len);
+}
+
+// Erases just ahead of the data instead of the whole partition up front, so
+// the erase time is spread over the upload and overlaps with receiving
+esp_err_t OTAManager::writePartitionBlock(const uint8_t* data, size_t len, void* ctx) {
+    PartitionCursor* cursor = (PartitionCursor*)ctx;
+    esp_err_t err = eraseAhead(cursor, cursor->offset + len);
+    
+    // Program only runs of pages with data; a SPIFFS image is mostly blank pages
+    size_t pos = 0;
+    while (err == ESP_OK && pos < len) {
+        size_t page = FLASH_PAGE_SIZE - (cursor->offset + pos) % FLASH_PAGE_SIZE;
+        if (page > len - pos) {
+            page = len - pos;
+        }
+        if (is_blank(data + pos, page)) {
+            cursor->blankBytes += page;
+            pos += page;
+            continue;
+        }
+        size_t run = page;
+        while (pos + run < len) {
+            size_t next = len - pos - run < FLASH_PAGE_SIZE ? len - pos - run : FLASH_PAGE_SIZE;
+            if (is_blank(data + pos + run, next)) {
+                break;
+            }
+            run += next;
+        }
+        err = esp_partition_write(cursor->partition, cursor->offset + pos, data + pos, run);
+        pos += run;
+    }
+    cursor->offset += len;
+    return err;
+}
+
+void OTAManager::beginPartition(PartitionCursor* cursor, const esp_partition_t* partition, size_t imageSize) {
+    cursor->partition = partition;
+    cursor->offset = 0;
+    cursor->erased = 0;
+    cursor->imageSize = imageSize;
+    cursor->blankBytes = 0;
+}
+
+// Whole 64 KB blocks where the flash address is block aligned and the image
+// still fills the block, single sectors otherwise
+esp_err_t OTAManager::eraseAhead(PartitionCursor* cursor, size_t end) {
+    while (cursor->erased < end) {
+        size_t size = SPI_FLASH_SEC_SIZE;
+        if ((cursor->partition->address + cursor->erased) % ERASE_BLOCK_SIZE == 0 &&
+            cursor->erased + ERASE_BLOCK_SIZE <= cursor->imageSize) {
+            size = ERASE_BLOCK_SIZE;
+        }
+        esp_err_t err = esp_partition_erase_range(cursor->partition, cursor->erased, size);
+        if (err != ESP_OK) {
+            return err;
+        }
+        cursor->erased += size;
+    }
+    return ESP_OK;
+}
+
+// Stale data behind a short image would otherwise look like filesystem pages
+esp_err_t OTAManager::eraseTail(PartitionCursor* cursor) {
+    size_t tail = cursor->partition->size - cursor->erased;
+    ESP_LOGI(TAG, "SPIFFS: %u bytes written, %u blank bytes skipped, %u byte tail erased",
+             (unsigned)(cursor->offset - cursor->blankBytes), (unsigned)cursor->blankBytes, (unsigned)tail);
+    if (tail == 0) {
+        return ESP_OK;
+    }
+    esp_err_t err = esp_partition_erase_range(cursor->partition, cursor->erased, tail);
+    if (err == ESP_OK) {
+        cursor->erased += tail;
+    }
+    return err;
+}
+
+// Peak RAM is the OTAPipeline ring, independent of the image size
+bool OTAManager::openFirmware(size_t totalSize) {
+    ESP_LOGI(TAG, "Streaming firmware flash (%u bytes)...", (unsigned)totalSize);
     
     if (totalSize > MAX_FIRMWARE_SIZE) {
-        snprintf(lastError, sizeof(lastError), "Firmware too large: %d bytes", totalSize);
+        snprintf(lastError, sizeof(lastError), "Firmware too large: %u bytes", (unsigned)totalSize);
         return false;
     }
     
@@ -476,91 +592,64 @@ bool OTAManager::flashFirmwareStreaming(size_t totalSize, ReadCallback readCallb
     ESP_LOGI(TAG, "Running partition: %s at offset 0x%x", running->label, running->address);
     
     // Get next OTA partition to update
-    const esp_partition_t* update_partition = esp_ota_get_next_update_partition(NULL);
-    if (!update_partition) {
+    updatePartition = esp_ota_get_next_update_partition(NULL);
+    if (!updatePartition) {
         snprintf(lastError, sizeof(lastError), "No OTA partition found");
         return false;
     }
     
+    if (totalSize > updatePartition->size) {
+        snprintf(lastError, sizeof(lastError), "Firmware too large for %s: %u > %u bytes",
+                 updatePartition->label, (unsigned)totalSize, (unsigned)updatePartition->size);
+        return false;
+    }
+    
     ESP_LOGI(TAG, "Writing to OTA partition: %s (offset: 0x%x, size: 0x%x)", 
-             update_partition->label, update_partition->address, update_partition->size);
+             updatePartition->label, updatePartition->address, updatePartition->size);
     
     // Begin OTA update
-    esp_ota_handle_t ota_handle;
-    esp_err_t err = esp_ota_begin(update_partition, totalSize, &ota_handle);
+    esp_err_t err = esp_ota_begin(updatePartition, totalSize, &otaHandle);
     if (err != ESP_OK) {
         snprintf(lastError, sizeof(lastError), "Failed to begin OTA: %s", esp_err_to_name(err));
         return false;
     }
     
-    // Write firmware in chunks
-    const size_t CHUNK_SIZE = 4096; // 4KB chunks
-    uint8_t* chunk = (uint8_t*)malloc(CHUNK_SIZE);
-    if (!chunk) {
-        esp_ota_abort(ota_handle);
+    // Receive into the ring while the writer task flashes behind it
+    if (!pipeline.begin(writeOtaBlock, &otaHandle)) {
+        esp_ota_abort(otaHandle);
         snprintf(lastError, sizeof(lastError), "Failed to allocate chunk buffer");
         return false;
     }
-    
-    size_t written = 0;
-    while (written < totalSize) {
-        size_t toRead = (totalSize - written > CHUNK_SIZE) ? CHUNK_SIZE : (totalSize - written);
-        size_t read = readCallback(chunk, toRead, userData);
-        
-        if (read == 0) {
-            free(chunk);
-            esp_ota_abort(ota_handle);
-            snprintf(lastError, sizeof(lastError), "Failed to read firmware data");
-            return false;
-        }
-        
-        err = esp_ota_write(ota_handle, chunk, read);
-        if (err != ESP_OK) {
-            free(chunk);
-            esp_ota_abort(ota_handle);
-            snprintf(lastError, sizeof(lastError), "Failed to write firmware: %s", esp_err_to_name(err));
-            return false;
-        }
-        
-        written += read;
-        
-        if (written % (64 * 1024) == 0 || written == totalSize) {
-            ESP_LOGI(TAG, "Firmware flash progress: %d / %d bytes (%.1f%%)", 
-                     written, totalSize, (written * 100.0f) / totalSize);
-        }
-    }
-    
-    free(chunk);
-    
+    return true;
+}
+
+bool OTAManager::closeFirmware() {
     // Finalize OTA
-    err = esp_ota_end(ota_handle);
+    esp_err_t err = esp_ota_end(otaHandle);
     if (err != ESP_OK) {
         snprintf(lastError, sizeof(lastError), "OTA end failed: %s", esp_err_to_name(err));
         return false;
     }
     
     // Set boot partition
-    err = esp_ota_set_boot_partition(update_partition);
+    err = esp_ota_set_boot_partition(updatePartition);
     if (err != ESP_OK) {
         snprintf(lastError, sizeof(lastError), "Failed to set boot partition: %s", esp_err_to_name(err));
         return false;
     }
     
-    ESP_LOGI(TAG, "Firmware flashed successfully, boot partition set to %s", update_partition->label);
+    ESP_LOGI(TAG, "Firmware flashed successfully, boot partition set to %s", updatePartition->label);
     return true;
 }
 
-bool OTAManager::flashSPIFFSStreaming(size_t totalSize, ReadCallback readCallback, void* userData) {
-    ESP_LOGI(TAG, "Streaming SPIFFS flash (%d bytes)...", totalSize);
+bool OTAManager::openSPIFFS(size_t totalSize) {
+    ESP_LOGI(TAG, "Streaming SPIFFS flash (%u bytes)...", (unsigned)totalSize);
     
     if (totalSize > MAX_SPIFFS_SIZE) {
-        snprintf(lastError, sizeof(lastError), "SPIFFS too large: %d bytes", totalSize);
+        snprintf(lastError, sizeof(lastError), "SPIFFS too large: %u bytes", (unsigned)totalSize);
         return false;
     }
     
-    // Unmount SPIFFS first
-    esp_vfs_spiffs_unregister(NULL);
-    
     // Find SPIFFS partition
     const esp_partition_t* spiffs_partition = esp_partition_find_first(
         ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_SPIFFS, NULL);
@@ -570,52 +659,34 @@ bool OTAManager::flashSPIFFSStreaming(size_t totalSize, ReadCallback readCallbac
         return false;
     }
     
-    ESP_LOGI(TAG, "Writing to SPIFFS partition (offset: 0x%x, size: 0x%x)", 
-             spiffs_partition->address, spiffs_partition->size);
-    
-    // Erase partition
-    ESP_LOGI(TAG, "Erasing SPIFFS partition...");
-    esp_err_t err = esp_partition_erase_range(spiffs_partition, 0, spiffs_partition->size);
-    if (err != ESP_OK) {
-        snprintf(lastError, sizeof(lastError), "Failed to erase SPIFFS: %s", esp_err_to_name(err));
+    // Reject before unmounting, so a bad upload leaves the web UI intact
+    if (totalSize > spiffs_partition->size) {
+        snprintf(lastError, sizeof(lastError), "SPIFFS image too large: %u > %u bytes",
+                 (unsigned)totalSize, (unsigned)spiffs_partition->size);
         return false;
     }
     
-    // Write SPIFFS in chunks
-    const size_t CHUNK_SIZE = 4096; // 4KB chunks
-    uint8_t* chunk = (uint8_t*)malloc(CHUNK_SIZE);
-    if (!chunk) {
+    beginPartition(&cursor, spiffs_partition, totalSize);
+    if (!pipeline.begin(writePartitionBlock, &cursor)) {
         snprintf(lastError, sizeof(lastError), "Failed to allocate chunk buffer");
         return false;
     }
     
-    size_t written = 0;
-    while (written < totalSize) {
-        size_t toRead = (totalSize - written > CHUNK_SIZE) ? CHUNK_SIZE : (totalSize - written);
-        size_t read = readCallback(chunk, toRead, userData);
-        
-        if (read == 0) {
-            free(chunk);
-            snprintf(lastError, sizeof(lastError), "Failed to read SPIFFS data");
-            return false;
-        }
-        
-        err = esp_partition_write(spiffs_partition, written, chunk, read);
-        if (err != ESP_OK) {
-            free(chunk);
-            snprintf(lastError, sizeof(lastError), "Failed to write SPIFFS: %s", esp_err_to_name(err));
-            return false;
-        }
-        
-        written += read;
-        
-        if (written % (64 * 1024) == 0 || written == totalSize) {
-            ESP_LOGI(TAG, "SPIFFS flash progress: %d / %d bytes (%.1f%%)", 
-                     written, totalSize, (written * 100.0f) / totalSize);
-        }
-    }
+    // Unmount SPIFFS first
+    esp_vfs_spiffs_unregister(NULL);
     
-    free(chunk);
+    // Sectors are erased by the writer task just ahead of the data
+    ESP_LOGI(TAG, "Writing to SPIFFS partition (offset: 0x%x, size: 0x%x)", 
+             spiffs_partition->address, spiffs_partition->size);
+    return true;
+}
+
+bool OTAManager::closeSPIFFS() {
+    esp_err_t err = eraseTail(&cursor);
+    if (err != ESP_OK) {
+        snprintf(lastError, sizeof(lastError), "Failed to erase SPIFFS: %s", esp_err_to_name(err));
+        return false;
+    }
     
     ESP_LOGI(TAG, "SPIFFS flashed successfully");
     
@@ -4,6 +4,11 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <stdio.h>
+#include "OTAPipeline.h"
+#include "OTASink.h"
+#include "Sha256.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
 
 class OTAManager {
 public:
@@ -11,7 +16,8 @@ public:
     ~OTAManager();
     
     /**
-     * Process TAR file containing firmware.bin and/or spiffs.bin
+     * Process TAR file containing firmware.bin and/or spiffs.bin (or their
+     * packed / delta variants, see OTAPackage)
      * @param tarData Pointer to TAR file data
      * @param tarSize Size of TAR file
      * @return true if successful
@@ -52,6 +58,48 @@ public:
     bool flashFirmwareStreaming(size_t totalSize, ReadCallback readCallback, void* userData);
     bool flashSPIFFSStreaming(size_t totalSize, ReadCallback readCallback, void* userData);
     
+    enum Target : uint8_t { TARGET_NONE = 0, TARGET_FIRMWARE, TARGET_FILESYSTEM };
+    
+    /**
+     * Push side of the streaming flash, for data that arrives in chunks the
+     * caller does not control (TAR members, decoders). Exactly totalSize
+     * bytes go through writeStream(), then endStream() commits: boot
+     * partition for firmware, remount for SPIFFS.
+     * With expectedSha256 set, endStream() commits only if the data hashed
+     * to it; the digest is computed as the data comes in, nothing is read back.
+     * After any failure call abortStream(); getLastError() has the reason.
+     */
+    bool beginStream(Target which, size_t totalSize, const uint8_t* expectedSha256 = nullptr);
+    bool writeStream(const uint8_t* data, size_t len);
+    bool endStream();
+    void abortStream();
+    
+    /**
+     * State of the current (or last) streaming flash. Written by the task
+     * that flashes, readable from any other task, e.g. for /api/ota/status.
+     */
+    enum State : uint8_t { STATE_IDLE = 0, STATE_RUNNING, STATE_DONE, STATE_FAILED };
+    struct Status {
+        State state;
+        Target target;
+        size_t written;
+        size_t total;
+        uint8_t progress;
+        char error[96];   // Set when state is STATE_FAILED
+    };
+    void getStatus(Status* out) const;
+    bool isBusy() const { return state == STATE_RUNNING; }
+    
+    /**
+     * One update package at a time, whatever its source (upload, upload
+     * session, pull). An OTAPackage holds the claim for its whole life, so
+     * it also covers the gaps between members where isBusy() is false.
+     * @return false if another package holds it
+     */
+    bool claimPackage();
+    void releasePackage();
+    bool isPackageOpen() const { return packageOpen; }
+    
     /**
      * Get last error message
      */
@@ -66,33 +114,111 @@ private:
     char lastError[256];
     uint8_t progress;
     
-    // TAR parsing structures
-    struct TarHeader {
-        char name[100];
-        char mode[8];
-        char uid[8];
-        char gid[8];
-        char size[12];
-        char mtime[12];
-        char checksum[8];
-        char typeflag;
-        char linkname[100];
-        char magic[6];
-        char version[2];
-        char uname[32];
-        char gname[32];
-        char devmajor[8];
-        char devminor[8];
-        char prefix[155];
-        char padding[12];
+    // Streaming status (see getStatus)
+    volatile State state;
+    volatile Target target;
+    volatile bool packageOpen;   // See claimPackage()
+    size_t writtenBytes;
+    size_t totalBytes;
+    
+    // Open stream (beginStream .. endStream / abortStream)
+    // Raw partition writes (SPIFFS): erased lazily just ahead of offset
+    struct PartitionCursor {
+        const esp_partition_t* partition;
+        size_t offset;       // Next write
+        size_t erased;       // Everything below is erased; sector aligned
+        size_t imageSize;
+        size_t blankBytes;   // Skipped because they were all 0xFF
     };
+    OTAPipeline pipeline;
+    esp_ota_handle_t otaHandle;
+    const esp_partition_t* updatePartition;
+    PartitionCursor cursor;
+    uint8_t* streamBuffer;   // Ring buffer being filled by writeStream()
+    size_t streamFill;
+    size_t streamReceived;
+    Sha256 streamDigest;   // Of everything received so far
+    uint8_t expectedDigest[Sha256::DIGEST_SIZE];
+    bool checkDigest;
+    
+    bool beginStatus(Target which, size_t total);
+    void updateStatus(size_t written);
+    void endStatus(bool success);
+    bool flashStreaming(Target which, size_t totalSize, ReadCallback readCallback, void* userData);
+    bool pumpStream(ReadCallback readCallback, void* userData);
+    bool openFirmware(size_t totalSize);
+    bool openSPIFFS(size_t totalSize);
+    bool closeFirmware();
+    bool closeSPIFFS();
+    bool finishPipeline();
+    bool verifyDigest();
+    const char* streamName() const { return target == TARGET_FIRMWARE ? "firmware" : "SPIFFS"; }
+    static esp_err_t writeOtaBlock(const uint8_t* data, size_t len, void* ctx);
+    static esp_err_t writePartitionBlock(const uint8_t* data, size_t len, void* ctx);
+    static void beginPartition(PartitionCursor* cursor, const esp_partition_t* partition, size_t imageSize);
+    static esp_err_t eraseAhead(PartitionCursor* cursor, size_t end);
+    static esp_err_t eraseTail(PartitionCursor* cursor);
     
-    size_t parseOctal(const char* str, size_t len);
-    bool extractAndFlashTar(const uint8_t* tarData, size_t tarSize);
-    bool extractAndFlashTarFromFile(FILE* tarFile, size_t tarSize);
     bool flashFirmware(const uint8_t* data, size_t size);
     bool flashSPIFFS(const uint8_t* data, size_t size);
-    bool verifyPartition(const char* partitionLabel);
+    bool verifyWritten(const esp_partition_t* partition, const uint8_t* data, size_t size);
+};
+
+/**
+ * OTAManager's push stream as the last stage of an OTASink chain. Destroying
+ * it with the stream still open aborts the stream.
+ */
+class OTAFlashSink : public OTASink {
+public:
+    OTAFlashSink(OTAManager& ota, OTAManager::Target target)
+        : ota(ota), target(target), open(false), expectedSize(0), expectedSha256(nullptr), error(nullptr) {}
+    ~OTAFlashSink() { abort(); }
+
+    /**
+     * Size and digest the image must have (from manifest.json); the digest
+     * must stay valid until end()
+     */
+    void expect(size_t size, const uint8_t* sha256) {
+        expectedSize = size;
+        expectedSha256 = sha256;
+    }
+
+    bool begin(size_t size) override {
+        if (expectedSha256 && size != expectedSize) {
+            error = "Image size does not match manifest.json";
+            return false;
+        }
+        open = ota.beginStream(target, size, expectedSha256);
+        return open;
+    }
+    bool write(const uint8_t* data, size_t len) override { return ota.writeStream(data, len); }
+    bool end() override {
+        open = false;
+        return ota.endStream();
+    }
+
+    /**
+     * Give up on the stream this sink opened; never touches anyone else's
+     */
+    void abort() {
+        if (open) {
+            open = false;
+            ota.abortStream();
+        }
+    }
+
+    /**
+     * Why begin() refused before the stream was opened; nullptr otherwise
+     */
+    const char* getError() const { return error; }
+
+private:
+    OTAManager& ota;
+    OTAManager::Target target;
+    bool open;
+    size_t expectedSize;
+    const uint8_t* expectedSha256;
+    const char* error;
 };
 
 #endif // OTAMANAGER_H
@@ -0,0 +1,259 @@
+#include "OTAPackage.h"
+#include "OTADelta.h"
+#include "OTAInflate.h"
+#include "OTAManager.h"
+#include "JsonStream.h"
+#include "esp_log.h"
+#include <new>
+#include <stdlib.h>
+#include <string.h>
+
+static const char* TAG = "OTA_PKG";
+
+// member -> [inflate] -> [apply patch] -> flash
+struct OTAPackage::Chain {
+    OTAFlashSink flash;
+    OTADelta delta;
+    OTAInflate inflate;
+    OTASink* head;
+    bool firmware;
+
+    Chain(OTAManager& ota, bool firmware, bool packed, bool patch)
+        : flash(ota, firmware ? OTAManager::TARGET_FIRMWARE : OTAManager::TARGET_FILESYSTEM), delta(flash),
+          inflate(patch ? (OTASink&)delta : (OTASink&)flash), firmware(firmware) {
+        head = packed ? (OTASink*)&inflate : patch ? (OTASink*)&delta : (OTASink*)&flash;
+    }
+
+    // Error of the stage that failed first; nullptr if it was OTAManager
+    const char* filterError() const {
+        if (inflate.getError()) {
+            return inflate.getError();
+        }
+        return delta.getError() ? delta.getError() : flash.getError();
+    }
+};
+
+OTAPackage::OTAPackage(OTAManager& ota)
+    : ota(ota), claimed(ota.claimPackage()), tar(onEntry, onData, onEnd, this), chain(nullptr), manifest(nullptr), manifestFill(0),
+      hasManifest(false), manifestRequired(false), firmwareDone(false), filesystemDone(false) {
+    memset(&firmwareImage, 0, sizeof(firmwareImage));
+    memset(&filesystemImage, 0, sizeof(filesystemImage));
+    error[0] = '\0';
+}
+
+OTAPackage::~OTAPackage() {
+    closeMember();   // Aborts a member left half-flashed
+    if (claimed) {
+        ota.releasePackage();
+    }
+}
+
+// Tear down after a failure anywhere in the chain; the first reason wins
+void OTAPackage::fail(const char* reason) {
+    if (chain) {
+        chain->flash.abort();   // Sets OTAManager's error if the flash has none yet
+    }
+    if (error[0] == '\0') {
+        const char* message = reason;
+        if (!message && chain) {
+            message = chain->filterError();
+        }
+        if (!message && ota.getLastError()[0] != '\0') {
+            message = ota.getLastError();
+        }
+        // OTAManager errors are longer than ours; cut on purpose
+        snprintf(error, sizeof(error), "%.*s", (int)sizeof(error) - 1, message ? message : "Update failed");
+        ESP_LOGE(TAG, "Update failed: %s", error);
+    }
+    closeMember();
+}
+
+void OTAPackage::closeMember() {
+    delete chain;
+    chain = nullptr;
+    free(manifest);
+    manifest = nullptr;
+}
+
+// The manifest has to be complete before the first image starts flashing,
+// otherwise that image could no longer be rejected
+TarStream::Decision OTAPackage::openManifest(const TarStream::Entry& entry) {
+    if (hasManifest) {
+        fail("Duplicate manifest.json");
+        return TarStream::ENTRY_ABORT;
+    }
+    if (firmwareDone || filesystemDone) {
+        ESP_LOGW(TAG, "manifest.json after the images, ignored");
+        return TarStream::ENTRY_SKIP;
+    }
+    if (entry.size >= MANIFEST_SIZE) {
+        fail("manifest.json too large");
+        return TarStream::ENTRY_ABORT;
+    }
+    manifest = (char*)malloc(MANIFEST_SIZE);
+    if (!manifest) {
+        fail("Out of memory");
+        return TarStream::ENTRY_ABORT;
+    }
+    manifestFill = 0;
+    return TarStream::ENTRY_ACCEPT;
+}
+
+bool OTAPackage::readExpected(const char* json, const char* key, Expected* out) {
+    char path[24];
+    char hex[Sha256::DIGEST_SIZE * 2 + 1];
+    out->listed = JsonLookup::has(json, key);
+    if (!out->listed) {
+        return true;
+    }
+    snprintf(path, sizeof(path), "%s.size", key);
+    double size = JsonLookup::getNumber(json, path, -1);
+    snprintf(path, sizeof(path), "%s.sha256", key);
+    if (size < 0 || !JsonLookup::getString(json, path, hex, sizeof(hex)) || !Sha256::fromHex(hex, out->sha256)) {
+        ESP_LOGE(TAG, "manifest.json: invalid entry for %s", key);
+        return false;
+    }
+    out->size = (size_t)size;
+    return true;
+}
+
+bool OTAPackage::readManifest() {
+    manifest[manifestFill] = '\0';
+    if (!readExpected(manifest, "firmware", &firmwareImage) || !readExpected(manifest, "spiffs", &filesystemImage)) {
+        fail("Invalid manifest.json");
+        return false;
+    }
+    if (!firmwareImage.listed && !filesystemImage.listed) {
+        fail("manifest.json lists no image");
+        return false;
+    }
+    hasManifest = true;
+    ESP_LOGI(TAG, "manifest.json: firmware %s, SPIFFS %s", firmwareImage.listed ? "listed" : "-",
+             filesystemImage.listed ? "listed" : "-");
+    return true;
+}
+
+TarStream::Decision OTAPackage::openMember(const TarStream::Entry& entry) {
+    // "./firmware.bin" from tar run inside the build directory
+    const char* name = entry.name;
+    if (strncmp(name, "./", 2) == 0) {
+        name += 2;
+    }
+    if (strcmp(name, "manifest.json") == 0) {
+        return openManifest(entry);
+    }
+    bool packed = OTAInflate::isPacked(name);
+    size_t baseLen = strlen(name) - (packed ? 2 : 0);
+    bool patch = OTADelta::isPatch(name, baseLen);
+    bool firmware = patch || (baseLen == 12 && strncmp(name, "firmware.bin", 12) == 0);
+    bool filesystem = baseLen == 10 && strncmp(name, "spiffs.bin", 10) == 0;
+    if (!firmware && !filesystem) {
+        ESP_LOGW(TAG, "Ignoring file: %s", entry.name);
+        return TarStream::ENTRY_SKIP;
+    }
+
+    if (!claimed || ota.isBusy()) {
+        fail("Another update is in progress");
+        return TarStream::ENTRY_ABORT;
+    }
+
+    const Expected& expected = firmware ? firmwareImage : filesystemImage;
+    if (manifestRequired && !hasManifest) {
+        fail("Package has no manifest.json");
+        return TarStream::ENTRY_ABORT;
+    }
+    if (hasManifest && !expected.listed) {
+        ESP_LOGE(TAG, "%s is not listed in manifest.json", entry.name);
+        fail("Image not listed in manifest.json");
+        return TarStream::ENTRY_ABORT;
+    }
+
+    ESP_LOGI(TAG, "Processing %s (%u bytes)...", entry.name, (unsigned)entry.size);
+    chain = new (std::nothrow) Chain(ota, firmware, packed, patch);
+    if (!chain) {
+        fail("Out of memory");
+        return TarStream::ENTRY_ABORT;
+    }
+    if (hasManifest) {
+        chain->flash.expect(expected.size, expected.sha256);
+    }
+    if (!chain->head->begin(entry.size)) {
+        fail(nullptr);
+        return TarStream::ENTRY_ABORT;
+    }
+    return TarStream::ENTRY_ACCEPT;
+}
+
+TarStream::Decision OTAPackage::onEntry(const TarStream::Entry& entry, void* ctx) {
+    if (entry.type != '0') {
+        return TarStream::ENTRY_SKIP;   // Directories, links
+    }
+    return ((OTAPackage*)ctx)->openMember(entry);
+}
+
+bool OTAPackage::onData(const uint8_t* data, size_t len, void* ctx) {
+    OTAPackage* self = (OTAPackage*)ctx;
+    if (self->manifest) {
+        memcpy(self->manifest + self->manifestFill, data, len);   // Size checked in openManifest()
+        self->manifestFill += len;
+        return true;
+    }
+    if (!self->chain->head->write(data, len)) {
+        self->fail(nullptr);
+        return false;
+    }
+    return true;
+}
+
+bool OTAPackage::onEnd(const TarStream::Entry& entry, void* ctx) {
+    OTAPackage* self = (OTAPackage*)ctx;
+    if (self->manifest) {
+        bool valid = self->readManifest();
+        self->closeMember();
+        return valid;
+    }
+    if (!self->chain->head->end()) {
+        self->fail(nullptr);
+        return false;
+    }
+    if (self->chain->firmware) {
+        self->firmwareDone = true;
+    } else {
+        self->filesystemDone = true;
+    }
+    ESP_LOGI(TAG, "%s flashed successfully", entry.name);
+    self->closeMember();
+    return true;
+}
+
+bool OTAPackage::push(const uint8_t* data, size_t len) {
+    if (error[0] != '\0') {
+        return false;
+    }
+    if (!tar.push(data, len)) {
+        fail(tar.getError());
+        return false;
+    }
+    return true;
+}
+
+bool OTAPackage::finish() {
+    if (error[0] != '\0') {
+        return false;
+    }
+    if (!tar.finish()) {
+        fail(tar.getError());
+        return false;
+    }
+    if (!firmwareDone && !filesystemDone) {
+        snprintf(error, sizeof(error), "TAR must contain firmware.bin and/or spiffs.bin");
+        return false;
+    }
+    if ((firmwareImage.listed && !firmwareDone) || (filesystemImage.listed && !filesystemDone)) {
+        snprintf(error, sizeof(error), "Image listed in manifest.json is missing");
+        return false;
+    }
+    ESP_LOGI(TAG, "Update successful! Firmware: %s, SPIFFS: %s",
+             firmwareDone ? "YES" : "NO", filesystemDone ? "YES" : "NO");
+    return true;
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "Sha256.h"
+#include "TarStream.h"
+
+class OTAManager;
+
+/**
+ * An update.tar on its way to flash, fed in chunks of any size. Every OTA
+ * path (HTTP upload, file, memory) pushes through this, so they all accept
+ * the same members:
+ *   firmware.bin[.z]   firmware image, optionally packed (OTAInflate)
+ *   firmware.hbd[.z]   delta patch against the running firmware (OTADelta)
+ *   spiffs.bin[.z]     filesystem image
+ *   manifest.json      size and sha256 of each image, ahead of the images
+ * Members are flashed one after the other as they arrive; anything else in
+ * the archive is skipped. With a manifest, an image whose digest does not
+ * match is not booted or mounted; without one the images are flashed
+ * unverified, as from older build scripts.
+ */
+class OTAPackage {
+public:
+    /**
+     * Claims the package slot of ota (OTAManager::claimPackage) until
+     * destroyed; without it every image is refused, see isClaimed()
+     */
+    explicit OTAPackage(OTAManager& ota);
+    ~OTAPackage();
+
+    /**
+     * false: another package was open when this one was created
+     */
+    bool isClaimed() const { return claimed; }
+
+    /**
+     * Next part of the archive
+     * @return false once the update failed (see getError())
+     */
+    bool push(const uint8_t* data, size_t len);
+
+    /**
+     * Input is over
+     * @return true if the archive was complete and contained at least one image
+     */
+    bool finish();
+
+    /**
+     * Refuse images that are not covered by a manifest.json (unattended
+     * installs, see OTAPull); call before the first push()
+     */
+    void requireManifest() { manifestRequired = true; }
+
+    bool flashedFirmware() const { return firmwareDone; }
+    bool flashedFilesystem() const { return filesystemDone; }
+    const char* getError() const { return error; }
+
+private:
+    struct Chain;
+
+    // One image entry of manifest.json (size and digest after unpacking)
+    struct Expected {
+        bool listed;
+        size_t size;
+        uint8_t sha256[Sha256::DIGEST_SIZE];
+    };
+
+    static const size_t MANIFEST_SIZE = 1024;
+
+    OTAManager& ota;
+    bool claimed;
+    TarStream tar;
+    Chain* chain;     // Sinks of the member being flashed
+    char* manifest;   // manifest.json while it is being received
+    size_t manifestFill;
+    bool hasManifest;
+    bool manifestRequired;
+    Expected firmwareImage;
+    Expected filesystemImage;
+    bool firmwareDone;
+    bool filesystemDone;
+    char error[96];
+
+    static TarStream::Decision onEntry(const TarStream::Entry& entry, void* ctx);
+    static bool onData(const uint8_t* data, size_t len, void* ctx);
+    static bool onEnd(const TarStream::Entry& entry, void* ctx);
+    TarStream::Decision openMember(const TarStream::Entry& entry);
+    TarStream::Decision openManifest(const TarStream::Entry& entry);
+    bool readManifest();
+    static bool readExpected(const char* json, const char* key, Expected* out);
+    void closeMember();
+    void fail(const char* reason);
+};
@@ -0,0 +1,183 @@
+#include "OTAPipeline.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/task.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char* TAG = "OTA_PIPE";
+
+OTAPipeline::OTAPipeline()
+    : write(nullptr), writeCtx(nullptr), ring(nullptr), freeQueue(nullptr), filledQueue(nullptr), done(nullptr),
+      writeError(ESP_OK), running(false), startUs(0), acquiredUs(0) {
+    memset(&stats, 0, sizeof(stats));
+}
+
+OTAPipeline::~OTAPipeline() {
+    finish();
+}
+
+bool OTAPipeline::begin(WriteFunction fn, void* ctx) {
+    write = fn;
+    writeCtx = ctx;
+    writeError = ESP_OK;
+    memset(&stats, 0, sizeof(stats));
+    startUs = 0;
+
+    if (startWriter()) {
+        stats.pipelined = true;
+    } else {
+        release();
+        ring = (uint8_t*)malloc(BUFFER_SIZE);
+        if (!ring) {
+            ESP_LOGE(TAG, "Failed to allocate buffer");
+            return false;
+        }
+        ESP_LOGW(TAG, "Writer task unavailable, writing inline");
+    }
+    running = true;
+    return true;
+}
+
+bool OTAPipeline::startWriter() {
+    // The filled queue also has to take the stop marker on top of every buffer
+    freeQueue = xQueueCreate(BUFFER_COUNT, sizeof(uint8_t*));
+    filledQueue = xQueueCreate(BUFFER_COUNT + 1, sizeof(Block));
+    done = xSemaphoreCreateBinary();
+    if (!freeQueue || !filledQueue || !done) {
+        return false;
+    }
+
+    ring = (uint8_t*)malloc(BUFFER_SIZE * BUFFER_COUNT);
+    if (!ring) {
+        ESP_LOGW(TAG, "No RAM for %u buffers", (unsigned)BUFFER_COUNT);
+        return false;
+    }
+    for (uint8_t i = 0; i < BUFFER_COUNT; i++) {
+        uint8_t* buffer = ring + i * BUFFER_SIZE;
+        xQueueSend(freeQueue, &buffer, 0);
+    }
+
+    // The receiving task runs wherever httpd put it; the writer takes the
+    // other core so socket reads and flash writes actually overlap
+    BaseType_t core = tskNO_AFFINITY;
+    if (portNUM_PROCESSORS > 1) {
+        core = xPortGetCoreID() == 0 ? 1 : 0;
+    }
+    if (xTaskCreatePinnedToCore(writerTask, "ota_writer", 4096, this, tskIDLE_PRIORITY + 5, NULL, core) != pdPASS) {
+        return false;
+    }
+    ESP_LOGI(TAG, "Writer task started on core %d, %u x %u byte buffers", (int)core,
+             (unsigned)BUFFER_COUNT, (unsigned)BUFFER_SIZE);
+    return true;
+}
+
+void OTAPipeline::release() {
+    if (freeQueue) {
+        vQueueDelete(freeQueue);
+        freeQueue = nullptr;
+    }
+    if (filledQueue) {
+        vQueueDelete(filledQueue);
+        filledQueue = nullptr;
+    }
+    if (done) {
+        vSemaphoreDelete(done);
+        done = nullptr;
+    }
+    free(ring);
+    ring = nullptr;
+}
+
+uint8_t* OTAPipeline::acquire() {
+    if (!running || writeError != ESP_OK) {
+        return nullptr;
+    }
+
+    if (startUs == 0) {
+        startUs = esp_timer_get_time();   // Not at begin(): a partition erase may come in between
+    }
+    uint8_t* buffer = ring;
+    if (stats.pipelined) {
+        int64_t waitStart = esp_timer_get_time();
+        bool stalled = uxQueueMessagesWaiting(freeQueue) == 0;
+        // The writer returns every buffer, failed or not, so this cannot hang
+        xQueueReceive(freeQueue, &buffer, portMAX_DELAY);
+        if (stalled) {
+            stats.stalls++;
+            stats.stallUs += esp_timer_get_time() - waitStart;
+        }
+        if (writeError != ESP_OK) {
+            xQueueSend(freeQueue, &buffer, 0);
+            return nullptr;
+        }
+    }
+    acquiredUs = esp_timer_get_time();
+    return buffer;
+}
+
+void OTAPipeline::submit(uint8_t* buffer, size_t len) {
+    stats.fillUs += esp_timer_get_time() - acquiredUs;
+    stats.bytes += len;
+
+    Block block = { buffer, len };
+    if (stats.pipelined) {
+        xQueueSend(filledQueue, &block, portMAX_DELAY);
+    } else {
+        writeBlock(block);
+    }
+}
+
+void OTAPipeline::writeBlock(const Block& block) {
+    // After a failure the rest is only drained, the caller aborts anyway
+    if (block.len == 0 || writeError != ESP_OK) {
+        return;
+    }
+    int64_t start = esp_timer_get_time();
+    esp_err_t err = write(block.data, block.len, writeCtx);
+    stats.writeUs += esp_timer_get_time() - start;
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Write failed: %s", esp_err_to_name(err));
+        writeError = err;
+    }
+}
+
+void OTAPipeline::writerTask(void* param) {
+    OTAPipeline* self = (OTAPipeline*)param;
+    Block block;
+    while (xQueueReceive(self->filledQueue, &block, portMAX_DELAY) == pdTRUE) {
+        if (block.data == nullptr) {
+            break;
+        }
+        self->writeBlock(block);
+        xQueueSend(self->freeQueue, &block.data, portMAX_DELAY);
+    }
+    // Last access to self: finish() frees everything once this is given
+    xSemaphoreGive(self->done);
+    vTaskDelete(NULL);
+}
+
+esp_err_t OTAPipeline::finish() {
+    if (!running) {
+        return writeError;
+    }
+    if (stats.pipelined) {
+        Block stop = { nullptr, 0 };
+        xQueueSend(filledQueue, &stop, portMAX_DELAY);
+        xSemaphoreTake(done, portMAX_DELAY);
+    }
+    release();
+    running = false;
+    stats.elapsedUs = startUs != 0 ? esp_timer_get_time() - startUs : 0;
+    return writeError;
+}
+
+void OTAPipeline::logStats(const char* what) const {
+    uint32_t elapsedMs = (uint32_t)(stats.elapsedUs / 1000);
+    uint32_t kbps = elapsedMs > 0 ? (uint32_t)((uint64_t)stats.bytes * 1000 / 1024 / elapsedMs) : 0;
+    ESP_LOGI(TAG, "%s: %u bytes in %u ms (%u KB/s), receive %u ms, flash %u ms, %u stalls for %u ms (%s)",
+             what, (unsigned)stats.bytes, (unsigned)elapsedMs, (unsigned)kbps,
+             (unsigned)(stats.fillUs / 1000), (unsigned)(stats.writeUs / 1000),
+             (unsigned)stats.stalls, (unsigned)(stats.stallUs / 1000),
+             stats.pipelined ? "pipelined" : "inline");
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+
+/**
+ * Producer/consumer ring between the network and the flash.
+ *
+ * The receiving task fills buffers (acquire -> fill -> submit) while a writer
+ * task, pinned to the other core, hands filled buffers to the write function.
+ * When all buffers are waiting for the flash, acquire() blocks: that is the
+ * backpressure towards the socket.
+ *
+ * If the queues or the task cannot be created, the pipeline degrades to one
+ * buffer written inline by submit(), i.e. the old receive/write alternation.
+ */
+class OTAPipeline {
+public:
+    typedef esp_err_t (*WriteFunction)(const uint8_t* data, size_t len, void* ctx);
+
+    static const size_t BUFFER_SIZE = 4096;   // One flash sector
+    static const uint8_t BUFFER_COUNT = 4;
+
+    struct Stats {
+        size_t bytes;
+        int64_t elapsedUs;   // First acquire() to finish()
+        int64_t fillUs;      // Receiving task between acquire() and submit()
+        int64_t stallUs;     // Receiving task blocked on a full ring
+        int64_t writeUs;     // Inside the write function
+        uint32_t stalls;
+        bool pipelined;
+    };
+
+    OTAPipeline();
+    ~OTAPipeline();
+
+    /**
+     * Allocate the ring and start the writer task
+     * @return false only if not even a single buffer could be allocated
+     */
+    bool begin(WriteFunction write, void* ctx);
+
+    /**
+     * Next empty buffer of BUFFER_SIZE bytes; blocks while the ring is full
+     * @return nullptr once a write failed (see finish())
+     */
+    uint8_t* acquire();
+
+    /**
+     * Hand a buffer from acquire() to the writer; len 0 just returns it
+     */
+    void submit(uint8_t* buffer, size_t len);
+
+    /**
+     * Wait until every submitted buffer is written, stop the writer task and
+     * free the ring
+     * @return First error of the write function, ESP_OK otherwise
+     */
+    esp_err_t finish();
+
+    const Stats& getStats() const { return stats; }
+
+    /**
+     * Log throughput and where the time went, e.g. "Firmware: ..."
+     */
+    void logStats(const char* what) const;
+
+private:
+    struct Block {
+        uint8_t* data;   // nullptr stops the writer
+        size_t len;
+    };
+
+    WriteFunction write;
+    void* writeCtx;
+    uint8_t* ring;
+    QueueHandle_t freeQueue;
+    QueueHandle_t filledQueue;
+    SemaphoreHandle_t done;
+    volatile esp_err_t writeError;
+    bool running;
+    int64_t startUs;
+    int64_t acquiredUs;
+    Stats stats;
+
+    static void writerTask(void* param);
+    void writeBlock(const Block& block);
+    bool startWriter();
+    void release();
+};
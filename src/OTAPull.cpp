@@ -0,0 +1,420 @@
+#include "OTAPull.h"
+#include "Config.h"
+#include "JsonStream.h"
+#include "OTAManager.h"
+#include "OTAPackage.h"
+#include "Sha256.h"
+#include "esp_http_client.h"
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include <new>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+static const char* TAG = "OTA_PULL";
+
+static portMUX_TYPE pull_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static const int HTTP_TIMEOUT_MS = 10000;
+static const uint32_t FIRST_CHECK_MIN_MS = 30000;   // WiFi and time to settle after boot
+static const uint32_t RETRY_DELAY_MS = 2000;        // Doubled per reconnect without progress
+static const uint32_t WAIT_SLICE_MS = 10 * 60000;    // pdMS_TO_TICKS is 32 bit: overflows past 71 min
+
+// Response headers esp_http_client only reports through its event handler
+struct ResponseHeaders {
+    char etag[72];
+    bool hasRange;
+    size_t rangeStart;   // Content-Range: bytes <start>-<end>/<size>
+};
+
+static esp_err_t on_http_event(esp_http_client_event_t* evt) {
+    if (evt->event_id != HTTP_EVENT_ON_HEADER || !evt->user_data) {
+        return ESP_OK;
+    }
+    ResponseHeaders* headers = (ResponseHeaders*)evt->user_data;
+    if (strcasecmp(evt->header_key, "ETag") == 0) {
+        snprintf(headers->etag, sizeof(headers->etag), "%s", evt->header_value);
+    } else if (strcasecmp(evt->header_key, "Content-Range") == 0) {
+        unsigned long start = 0;
+        headers->hasRange = sscanf(evt->header_value, "bytes %lu-", &start) == 1;
+        headers->rangeStart = start;
+    }
+    return ESP_OK;
+}
+
+static esp_http_client_handle_t open_url(const char* url, ResponseHeaders* headers) {
+    memset(headers, 0, sizeof(*headers));
+    esp_http_client_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.url = url;
+    config.timeout_ms = HTTP_TIMEOUT_MS;
+    config.event_handler = on_http_event;
+    config.user_data = headers;
+    return esp_http_client_init(&config);
+}
+
+// "package" from the manifest: absolute, host-absolute or next to the manifest
+static bool resolve_url(const char* base, const char* ref, char* out, size_t outSize) {
+    size_t prefix;
+    if (strncmp(ref, "http://", 7) == 0 || strncmp(ref, "https://", 8) == 0) {
+        prefix = 0;
+    } else if (ref[0] == '/') {
+        const char* host = strstr(base, "://");
+        const char* path = host ? strchr(host + 3, '/') : nullptr;
+        prefix = path ? (size_t)(path - base) : strlen(base);
+    } else {
+        const char* slash = strrchr(base, '/');
+        prefix = slash ? (size_t)(slash - base) + 1 : 0;
+    }
+    return snprintf(out, outSize, "%.*s%s", (int)prefix, base, ref) < (int)outSize;
+}
+
+OTAPull::OTAPull(OTAManager& ota) : ota(ota), task(nullptr), nextCheckUs(0), failures(0) {
+    memset(&status, 0, sizeof(status));
+    failedPackage[0] = '\0';
+}
+
+bool OTAPull::begin() {
+    if (task) {
+        return true;
+    }
+    // Below everything else: the download only uses time nobody else needs
+    if (xTaskCreate(taskMain, "ota_pull", 6144, this, tskIDLE_PRIORITY + 1, &task) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create task");
+        task = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void OTAPull::checkNow() {
+    if (task) {
+        xTaskNotifyGive(task);
+    }
+}
+
+void OTAPull::getStatus(Status* out) const {
+    portENTER_CRITICAL(&pull_lock);
+    *out = status;
+    int64_t nextCheck = nextCheckUs;
+    portEXIT_CRITICAL(&pull_lock);
+    int64_t remaining = nextCheck - esp_timer_get_time();
+    out->nextCheckSeconds = out->state == STATE_WAITING && remaining > 0 ? (uint32_t)(remaining / 1000000) : 0;
+}
+
+void OTAPull::setState(State state) {
+    portENTER_CRITICAL(&pull_lock);
+    status.state = state;
+    portEXIT_CRITICAL(&pull_lock);
+}
+
+void OTAPull::setProgress(size_t received) {
+    portENTER_CRITICAL(&pull_lock);
+    status.received = received;
+    portEXIT_CRITICAL(&pull_lock);
+}
+
+void OTAPull::setResult(const char* format, ...) {
+    char result[sizeof(status.result)];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(result, sizeof(result), format, args);
+    va_end(args);
+    ESP_LOGI(TAG, "%s", result);
+    portENTER_CRITICAL(&pull_lock);
+    memcpy(status.result, result, sizeof(result));
+    portEXIT_CRITICAL(&pull_lock);
+}
+
+void OTAPull::taskMain(void* arg) {
+    ((OTAPull*)arg)->run();
+}
+
+// Interval +-25%; the first check anywhere in the first interval
+uint32_t OTAPull::nextDelayMs(bool first) {
+    uint32_t minutes = Config::OTA_PULL_INTERVAL > 0 ? Config::OTA_PULL_INTERVAL : 1;
+    uint32_t interval = minutes * 60000;
+    if (first) {
+        return FIRST_CHECK_MIN_MS + esp_random() % interval;
+    }
+    return interval - interval / 4 + esp_random() % (interval / 2);
+}
+
+void OTAPull::run() {
+    bool first = true;
+    for (;;) {
+        if (Config::OTA_PULL_URL[0] == '\0') {
+            setState(STATE_DISABLED);
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);   // checkNow() after the settings changed
+            continue;
+        }
+
+        uint32_t delayMs = nextDelayMs(first);
+        first = false;
+        portENTER_CRITICAL(&pull_lock);
+        nextCheckUs = esp_timer_get_time() + (int64_t)delayMs * 1000;
+        status.state = STATE_WAITING;
+        portEXIT_CRITICAL(&pull_lock);
+        // Wait in slices against the deadline; checkNow() ends the wait early
+        for (;;) {
+            int64_t remainingMs = (nextCheckUs - esp_timer_get_time()) / 1000;
+            if (remainingMs <= 0) {
+                break;
+            }
+            uint32_t sliceMs = remainingMs < WAIT_SLICE_MS ? (uint32_t)remainingMs : WAIT_SLICE_MS;
+            if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(sliceMs)) > 0) {
+                break;
+            }
+        }
+
+        if (Config::OTA_PULL_URL[0] != '\0') {
+            check();
+        }
+    }
+}
+
+bool OTAPull::fetchManifest(const char* url, Manifest* out) {
+    ResponseHeaders headers;
+    esp_http_client_handle_t client = open_url(url, &headers);
+    if (!client) {
+        setResult("Invalid URL");
+        return false;
+    }
+
+    char* json = (char*)malloc(MANIFEST_SIZE);
+    bool valid = false;
+    esp_err_t err = json ? esp_http_client_open(client, 0) : ESP_ERR_NO_MEM;
+    if (err != ESP_OK) {
+        setResult("Server not reachable: %s", esp_err_to_name(err));
+    } else if (esp_http_client_fetch_headers(client) < 0 || esp_http_client_get_status_code(client) != 200) {
+        setResult("Manifest: HTTP %d", esp_http_client_get_status_code(client));
+    } else {
+        size_t len = 0;
+        int n;
+        while (len < MANIFEST_SIZE - 1 && (n = esp_http_client_read(client, json + len, MANIFEST_SIZE - 1 - len)) > 0) {
+            len += n;
+        }
+        json[len] = '\0';
+
+        char package[128];
+        double size = JsonLookup::getNumber(json, "size", -1);
+        valid = JsonLookup::getString(json, "version", out->version, sizeof(out->version)) &&
+                JsonLookup::getString(json, "package", package, sizeof(package)) &&
+                JsonLookup::getString(json, "sha256", out->sha256, sizeof(out->sha256)) &&
+                strlen(out->sha256) == 64 && size > 0 &&
+                resolve_url(url, package, out->packageUrl, sizeof(out->packageUrl));
+        out->size = valid ? (size_t)size : 0;
+        if (!valid) {
+            setResult("Invalid manifest");
+        }
+    }
+    free(json);
+    esp_http_client_close(client);
+    esp_http_client_cleanup(client);
+    return valid;
+}
+
+void OTAPull::check() {
+    setState(STATE_CHECKING);
+    char url[sizeof(Config::OTA_PULL_URL)];
+    snprintf(url, sizeof(url), "%s", Config::OTA_PULL_URL);
+
+    Manifest manifest;
+    if (!fetchManifest(url, &manifest)) {
+        return;
+    }
+    portENTER_CRITICAL(&pull_lock);
+    memcpy(status.offered, manifest.version, sizeof(status.offered));
+    portEXIT_CRITICAL(&pull_lock);
+
+    // The version alone misses filesystem-only packages
+    if (strcmp(manifest.version, Config::FIRMWARE_VERSION) == 0 ||
+        strcmp(manifest.sha256, Config::OTA_PULL_INSTALLED) == 0) {
+        setResult("Up to date (%s)", manifest.version);
+        return;
+    }
+    if (strcmp(manifest.sha256, failedPackage) == 0 && failures >= MAX_FAILURES) {
+        setResult("%s failed %u times, waiting for another package", manifest.version, (unsigned)failures);
+        return;
+    }
+    // An upload session or TAR upload may sit between two members
+    if (ota.isBusy() || ota.isPackageOpen()) {
+        setResult("Another update is in progress");
+        return;
+    }
+
+    uint8_t* buffer = (uint8_t*)malloc(BUFFER_SIZE);
+    if (!buffer) {
+        setResult("Out of memory");
+        return;
+    }
+    ESP_LOGI(TAG, "Updating %s -> %s from %s", Config::FIRMWARE_VERSION, manifest.version, manifest.packageUrl);
+    bool installed = download(manifest, buffer);
+    free(buffer);
+
+    if (!installed) {
+        if (strcmp(manifest.sha256, failedPackage) != 0) {
+            memcpy(failedPackage, manifest.sha256, sizeof(failedPackage));
+            failures = 0;
+        }
+        failures++;
+        return;
+    }
+    Config::saveOTAPullInstalled(manifest.sha256);
+    setState(STATE_INSTALLED);
+    setResult("Installed %s, restarting", manifest.version);
+    vTaskDelay(pdMS_TO_TICKS(2000));
+    esp_restart();
+}
+
+bool OTAPull::download(const Manifest& manifest, uint8_t* buffer) {
+    OTAPackage* package = new (std::nothrow) OTAPackage(ota);
+    if (!package) {
+        setResult("Out of memory");
+        return false;
+    }
+    package->requireManifest();
+
+    portENTER_CRITICAL(&pull_lock);
+    status.state = STATE_DOWNLOADING;
+    status.received = 0;
+    status.total = manifest.size;
+    status.resumes = 0;
+    portEXIT_CRITICAL(&pull_lock);
+
+    // One request per connection; a dropped one continues where it stopped,
+    // so the digest runs on across them
+    Sha256 digest;
+    char etag[72] = "";
+    bool fatal = false;
+    uint8_t retries = 0;
+    while (!fatal && status.received < manifest.size) {
+        size_t before = status.received;
+        if (before > 0) {
+            portENTER_CRITICAL(&pull_lock);
+            status.resumes++;
+            portEXIT_CRITICAL(&pull_lock);
+            ESP_LOGW(TAG, "Resuming at %u of %u bytes", (unsigned)before, (unsigned)manifest.size);
+        }
+        if (pushRange(package, &digest, manifest, buffer, etag, sizeof(etag), &fatal) || fatal) {
+            continue;
+        }
+        retries = status.received > before ? 0 : retries + 1;
+        if (retries >= MAX_RETRIES) {
+            setResult("Download failed at %u of %u bytes", (unsigned)status.received, (unsigned)manifest.size);
+            fatal = true;
+            break;
+        }
+        vTaskDelay(pdMS_TO_TICKS(RETRY_DELAY_MS << retries));
+    }
+
+    bool installed = false;
+    if (!fatal) {
+        uint8_t expected[Sha256::DIGEST_SIZE];
+        uint8_t actual[Sha256::DIGEST_SIZE];
+        digest.finish(actual);
+        if (!Sha256::fromHex(manifest.sha256, expected) || memcmp(actual, expected, sizeof(actual)) != 0) {
+            char hex[Sha256::DIGEST_SIZE * 2 + 1];
+            Sha256::toHex(actual, hex);
+            ESP_LOGE(TAG, "Package sha256 %s, manifest says %s", hex, manifest.sha256);
+            setResult("Package sha256 does not match the manifest");
+        } else {
+            installed = package->finish();
+            if (!installed) {
+                setResult("%s", package->getError());
+            }
+        }
+    }
+    delete package;   // Aborts a half-flashed image
+    return installed;
+}
+
+// One GET from status.received to the end. Returns true if the server sent
+// everything; false with *fatal unset for a dropped connection worth resuming.
+bool OTAPull::pushRange(OTAPackage* package, Sha256* digest, const Manifest& manifest, uint8_t* buffer,
+                        char* etag, size_t etagSize, bool* fatal) {
+    size_t offset = status.received;
+    ResponseHeaders headers;
+    esp_http_client_handle_t client = open_url(manifest.packageUrl, &headers);
+    if (!client) {
+        setResult("Invalid package URL");
+        *fatal = true;
+        return false;
+    }
+    if (offset > 0) {
+        char range[32];
+        snprintf(range, sizeof(range), "bytes=%u-", (unsigned)offset);
+        esp_http_client_set_header(client, "Range", range);
+        if (etag[0] != '\0') {
+            esp_http_client_set_header(client, "If-Range", etag);
+        }
+    }
+
+    bool complete = false;
+    esp_err_t err = esp_http_client_open(client, 0);
+    int status_code = 0;
+    if (err == ESP_OK && esp_http_client_fetch_headers(client) >= 0) {
+        status_code = esp_http_client_get_status_code(client);
+    }
+
+    if (err != ESP_OK || status_code == 0) {
+        ESP_LOGW(TAG, "Package request failed: %s", esp_err_to_name(err));
+    } else if (offset == 0 && status_code != 200) {
+        setResult("Package: HTTP %d", status_code);
+        *fatal = true;
+    } else if (offset > 0 && (status_code != 206 || !headers.hasRange || headers.rangeStart != offset)) {
+        // 200 to If-Range means the file was replaced; a server without Range support ends up here too
+        if (status_code == 200) {
+            setResult("Package changed on the server");
+        } else {
+            setResult("Resume refused: HTTP %d", status_code);
+        }
+        *fatal = true;
+    } else {
+        if (offset == 0) {
+            snprintf(etag, etagSize, "%s", headers.etag);
+        }
+
+        // Rate limit: sleep whenever this connection got ahead of the budget
+        uint32_t rate = Config::OTA_PULL_RATE;
+        size_t chunk = BUFFER_SIZE;
+        if (rate > 0 && rate * 1024 / 8 < chunk) {
+            chunk = rate * 1024 / 8 > 512 ? rate * 1024 / 8 : 512;
+        }
+        int64_t startUs = esp_timer_get_time();
+        size_t received = 0;
+
+        while (status.received < manifest.size) {
+            size_t want = manifest.size - status.received < chunk ? manifest.size - status.received : chunk;
+            int n = esp_http_client_read(client, (char*)buffer, want);
+            if (n <= 0) {
+                break;
+            }
+            if (!package->push(buffer, n)) {
+                setResult("%s", package->getError());
+                *fatal = true;
+                break;
+            }
+            digest->update(buffer, n);
+            setProgress(status.received + n);
+            received += n;
+            if (rate > 0) {
+                int64_t dueUs = (int64_t)received * 1000000 / ((int64_t)rate * 1024);
+                int64_t aheadUs = dueUs - (esp_timer_get_time() - startUs);
+                if (aheadUs > 1000) {
+                    vTaskDelay(pdMS_TO_TICKS(aheadUs / 1000) + 1);
+                }
+            }
+        }
+        complete = !*fatal && status.received == manifest.size;
+    }
+
+    esp_http_client_close(client);
+    esp_http_client_cleanup(client);
+    return complete;
+}
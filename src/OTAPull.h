@@ -0,0 +1,90 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+class OTAManager;
+class OTAPackage;
+class Sha256;
+
+/**
+ * Pull mode of the OTA: a low-priority task that periodically fetches a
+ * manifest from Config::OTA_PULL_URL and, if it offers another package,
+ * streams that through OTAPackage and restarts. tools/ota_pull_server.py
+ * serves a build directory this way:
+ *   {"version": "0.0.2", "package": "update.tar", "size": 123, "sha256": "..."}
+ * "package" is relative to the manifest URL or absolute. The package must
+ * carry its own manifest.json (build_ota_package.py), nothing unverified is
+ * installed unattended. The whole download must also hash to "sha256", or the
+ * package is not activated: a stale manifest or a file replaced under the same
+ * ETag would otherwise pass as complete once "size" bytes arrived.
+ *
+ * A dropped connection continues with a Range request where it stopped; the
+ * OTA handle stays open in between. If-Range with the ETag of the first
+ * response makes sure both parts belong to the same file.
+ *
+ * Checks run every Config::OTA_PULL_INTERVAL minutes +-25%, the first one at
+ * a random point of the first interval, so a fleet powered up together does
+ * not hit the server at once. Config::OTA_PULL_RATE limits the download.
+ */
+class OTAPull {
+public:
+    enum State : uint8_t { STATE_DISABLED = 0, STATE_WAITING, STATE_CHECKING, STATE_DOWNLOADING, STATE_INSTALLED };
+
+    struct Status {
+        State state;
+        uint32_t nextCheckSeconds;   // STATE_WAITING
+        size_t received;             // Package bytes of the current / last download
+        size_t total;
+        uint16_t resumes;            // Range requests after a dropped connection
+        char offered[32];            // Version in the last manifest
+        char result[96];             // Outcome of the last check
+    };
+
+    explicit OTAPull(OTAManager& ota);
+
+    /**
+     * Start the task; it sleeps while no URL is configured
+     */
+    bool begin();
+
+    /**
+     * Check now instead of at the scheduled time (settings changed, button)
+     */
+    void checkNow();
+
+    void getStatus(Status* out) const;
+
+private:
+    struct Manifest {
+        char version[32];
+        char packageUrl[192];
+        size_t size;
+        char sha256[65];
+    };
+
+    static const size_t BUFFER_SIZE = 4096;
+    static const size_t MANIFEST_SIZE = 1024;
+    static const uint8_t MAX_FAILURES = 3;   // Per package; then skipped until the server offers another
+    static const uint8_t MAX_RETRIES = 5;    // Reconnects in a row without progress
+
+    OTAManager& ota;
+    TaskHandle_t task;
+    Status status;
+    int64_t nextCheckUs;
+    char failedPackage[65];
+    uint8_t failures;
+
+    static void taskMain(void* arg);
+    void run();
+    uint32_t nextDelayMs(bool first);
+    void check();
+    bool fetchManifest(const char* url, Manifest* out);
+    bool download(const Manifest& manifest, uint8_t* buffer);
+    bool pushRange(OTAPackage* package, Sha256* digest, const Manifest& manifest, uint8_t* buffer, char* etag,
+                   size_t etagSize, bool* fatal);
+    void setState(State state);
+    void setProgress(size_t received);
+    void setResult(const char* format, ...);
+};
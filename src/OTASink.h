@@ -0,0 +1,29 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Push side of an image on its way to flash. OTAManager's streaming flash
+ * (OTAFlashSink), OTAInflate and OTADelta all take data this way, so they
+ * chain: TAR member -> [OTAInflate] -> [OTADelta] -> OTAFlashSink.
+ *
+ * A failed call leaves cleanup to the owner of the chain, which aborts the
+ * OTAManager stream (OTAManager::abortStream).
+ */
+class OTASink {
+public:
+    virtual ~OTASink() {}
+
+    /**
+     * Start of the data; size is what will be written, as far as known here.
+     * Filters announce the real image size downstream once their header is in.
+     */
+    virtual bool begin(size_t size) = 0;
+
+    virtual bool write(const uint8_t* data, size_t len) = 0;
+
+    /**
+     * All data written: verify and commit
+     */
+    virtual bool end() = 0;
+};
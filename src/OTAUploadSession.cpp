@@ -0,0 +1,237 @@
+#include "OTAUploadSession.h"
+#include "OTAManager.h"
+#include "OTAPackage.h"
+#include "esp_crc.h"
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include <new>
+#include <stdio.h>
+#include <string.h>
+
+static const char* TAG = "OTA_SESSION";
+
+OTAUploadSession::OTAUploadSession(OTAManager& ota)
+    : ota(ota), mutex(nullptr), package(nullptr), size(0), offset(0), lastActivityUs(0),
+      finishedSize(0), finishedResult(RESULT_UNKNOWN) {
+    id[0] = '\0';
+    label[0] = '\0';
+    finishedId[0] = '\0';
+    finishedLabel[0] = '\0';
+    finishedError[0] = '\0';
+}
+
+OTAUploadSession::~OTAUploadSession() {
+    close();
+    if (mutex) {
+        vSemaphoreDelete(mutex);
+    }
+}
+
+void OTAUploadSession::begin() {
+    if (mutex == nullptr) {
+        mutex = xSemaphoreCreateMutex();
+    }
+}
+
+OTAUploadSession::Result OTAUploadSession::open(size_t packageSize, const char* packageLabel, Info* out) {
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    bool same = package && packageSize == size && packageLabel[0] != '\0' &&
+                strncmp(packageLabel, label, LABEL_SIZE) == 0;
+    if (package && !same && esp_timer_get_time() - lastActivityUs > (int64_t)IDLE_TIMEOUT_S * 1000000) {
+        ESP_LOGW(TAG, "Replacing idle session %s", id);
+        close();
+    }
+    if (package) {
+        fillInfo(out);
+        xSemaphoreGive(mutex);
+        if (!same) {
+            snprintf(out->error, sizeof(out->error), "Another upload is in progress");
+            return RESULT_BUSY;
+        }
+        ESP_LOGI(TAG, "Resuming session %s at %u of %u bytes", out->id, (unsigned)out->offset, (unsigned)out->size);
+        return RESULT_OK;
+    }
+    // Reopened after the final answer got lost: report it instead of flashing again.
+    // Anything else waits for the restart, the new image must not be overwritten.
+    if (finishedResult == RESULT_COMPLETE) {
+        bool again = packageSize == finishedSize && packageLabel[0] != '\0' &&
+                     strncmp(packageLabel, finishedLabel, LABEL_SIZE) == 0;
+        fillFinished(out);
+        xSemaphoreGive(mutex);
+        if (!again) {
+            snprintf(out->error, sizeof(out->error), "Update complete, restart pending");
+            return RESULT_BUSY;
+        }
+        return RESULT_DONE;
+    }
+    if (ota.isBusy()) {
+        fillInfo(out);
+        xSemaphoreGive(mutex);
+        snprintf(out->error, sizeof(out->error), "Another update is in progress");
+        return RESULT_BUSY;
+    }
+
+    package = new (std::nothrow) OTAPackage(ota);
+    if (!package) {
+        fillInfo(out);
+        xSemaphoreGive(mutex);
+        snprintf(out->error, sizeof(out->error), "Out of memory");
+        return RESULT_FAILED;
+    }
+    // Held until the session closes, so a pull or TAR upload cannot start in between
+    if (!package->isClaimed()) {
+        delete package;
+        package = nullptr;
+        fillInfo(out);
+        xSemaphoreGive(mutex);
+        snprintf(out->error, sizeof(out->error), "Another update is in progress");
+        return RESULT_BUSY;
+    }
+    uint8_t random[ID_SIZE / 2];
+    esp_fill_random(random, sizeof(random));
+    for (size_t i = 0; i < sizeof(random); i++) {
+        snprintf(id + 2 * i, 3, "%02x", random[i]);
+    }
+    snprintf(label, sizeof(label), "%s", packageLabel);
+    size = packageSize;
+    offset = 0;
+    lastActivityUs = esp_timer_get_time();
+    fillInfo(out);
+    xSemaphoreGive(mutex);
+    ESP_LOGI(TAG, "Session %s opened for %u bytes (%s)", out->id, (unsigned)out->size, out->label);
+    return RESULT_OK;
+}
+
+OTAUploadSession::Result OTAUploadSession::write(const char* sessionId, size_t chunkOffset, const uint8_t* data,
+                                                 size_t len, uint32_t crc, Info* out) {
+    // Before the lock: a damaged chunk never touches the session
+    bool intact = esp_crc32_le(0, data, len) == crc;
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    if (!package || strcmp(sessionId, id) != 0) {
+        Result result = RESULT_UNKNOWN;
+        if (finishedId[0] != '\0' && strcmp(sessionId, finishedId) == 0) {
+            fillFinished(out);
+            result = finishedResult == RESULT_COMPLETE ? RESULT_DONE : RESULT_FAILED;
+        } else {
+            fillInfo(out);
+        }
+        xSemaphoreGive(mutex);
+        return result;
+    }
+    lastActivityUs = esp_timer_get_time();
+
+    // Already acknowledged: the client retried because our response was lost
+    if (chunkOffset + len <= offset && chunkOffset < offset) {
+        fillInfo(out);
+        xSemaphoreGive(mutex);
+        return RESULT_OK;
+    }
+    if (chunkOffset != offset || len > size - offset) {
+        fillInfo(out);
+        xSemaphoreGive(mutex);
+        return RESULT_OFFSET;
+    }
+    if (!intact) {
+        ESP_LOGW(TAG, "CRC mismatch in chunk at %u, waiting for it again", (unsigned)chunkOffset);
+        fillInfo(out);
+        xSemaphoreGive(mutex);
+        return RESULT_CRC;
+    }
+
+    Result result = RESULT_OK;
+    char error[sizeof(out->error)] = "";
+    if (!package->push(data, len)) {
+        snprintf(error, sizeof(error), "%s", package->getError());
+        result = RESULT_FAILED;
+    } else {
+        offset += len;
+        if (offset == size) {
+            if (package->finish()) {
+                result = RESULT_COMPLETE;
+            } else {
+                snprintf(error, sizeof(error), "%s", package->getError());
+                result = RESULT_FAILED;
+            }
+        }
+    }
+    fillInfo(out);
+    if (result != RESULT_OK) {
+        memcpy(finishedId, id, sizeof(finishedId));
+        memcpy(finishedLabel, label, sizeof(finishedLabel));
+        finishedSize = size;
+        finishedResult = result;
+        memcpy(finishedError, error, sizeof(finishedError));
+        if (result == RESULT_COMPLETE) {
+            ESP_LOGI(TAG, "Session %s complete", id);
+        } else {
+            ESP_LOGE(TAG, "Session %s failed at %u bytes: %s", id, (unsigned)offset, error);
+        }
+        close();
+    }
+    xSemaphoreGive(mutex);
+    memcpy(out->error, error, sizeof(out->error));
+    return result;
+}
+
+bool OTAUploadSession::abort(const char* sessionId) {
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    bool found = package && strcmp(sessionId, id) == 0;
+    if (found) {
+        ESP_LOGW(TAG, "Session %s aborted at %u of %u bytes", id, (unsigned)offset, (unsigned)size);
+        close();
+    }
+    xSemaphoreGive(mutex);
+    return found;
+}
+
+void OTAUploadSession::expireIdle() {
+    // Never wait here: a chunk being flashed is activity anyway
+    if (!package || xSemaphoreTake(mutex, 0) != pdTRUE) {
+        return;
+    }
+    if (package && esp_timer_get_time() - lastActivityUs > (int64_t)IDLE_TIMEOUT_S * 1000000) {
+        ESP_LOGW(TAG, "Session %s idle for %u s, aborted at %u of %u bytes", id, (unsigned)IDLE_TIMEOUT_S,
+                 (unsigned)offset, (unsigned)size);
+        close();
+    }
+    xSemaphoreGive(mutex);
+}
+
+void OTAUploadSession::getInfo(Info* out) {
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    fillInfo(out);
+    xSemaphoreGive(mutex);
+}
+
+// Deleting the package aborts a member left half-flashed
+void OTAUploadSession::close() {
+    delete package;
+    package = nullptr;
+    id[0] = '\0';
+    label[0] = '\0';
+    size = 0;
+    offset = 0;
+}
+
+void OTAUploadSession::fillInfo(Info* out) const {
+    out->active = package != nullptr;
+    memcpy(out->id, id, sizeof(out->id));
+    memcpy(out->label, label, sizeof(out->label));
+    out->size = size;
+    out->offset = offset;
+    int64_t idle = package ? esp_timer_get_time() - lastActivityUs : 0;
+    out->idleSeconds = idle > 0 ? (uint32_t)(idle / 1000000) : 0;
+    out->error[0] = '\0';
+}
+
+void OTAUploadSession::fillFinished(Info* out) const {
+    out->active = false;
+    memcpy(out->id, finishedId, sizeof(out->id));
+    memcpy(out->label, finishedLabel, sizeof(out->label));
+    out->size = finishedSize;
+    out->offset = finishedResult == RESULT_COMPLETE ? finishedSize : 0;
+    out->idleSeconds = 0;
+    memcpy(out->error, finishedError, sizeof(out->error));
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+class OTAManager;
+class OTAPackage;
+
+/**
+ * Resumable upload of an update.tar over many HTTP requests.
+ *
+ * The client opens a session for the package size and then posts it in
+ * chunks, each with its offset and CRC-32. The OTAPackage, and with it the
+ * open OTA handle, lives in the session between requests, so after a WiFi
+ * drop the client asks for the acknowledged offset and continues there
+ * instead of starting over. A chunk only reaches the package once it is
+ * complete and its CRC matches; nothing is ever flashed twice or out of
+ * order. A repeated chunk (the response got lost) is acknowledged again,
+ * also after the last one: the last finished session is kept until the
+ * restart, so a client whose final response was lost gets its result
+ * instead of "unknown session" and cannot open it again and flash twice.
+ *
+ * One session at a time. The label (file name, size, date) lets a reloaded
+ * page find its session again; a session idle for IDLE_TIMEOUT_S is
+ * aborted, so an abandoned upload does not block updates forever.
+ */
+class OTAUploadSession {
+public:
+    static const size_t CHUNK_SIZE = 16 * 1024;   // Largest chunk accepted, held in RAM until checked
+    static const size_t ID_SIZE = 16;             // Hex characters
+    static const size_t LABEL_SIZE = 64;
+    static const uint32_t IDLE_TIMEOUT_S = 600;
+
+    enum Result : uint8_t {
+        RESULT_OK = 0,     // Chunk accepted (or already had it)
+        RESULT_COMPLETE,   // Last chunk accepted, package flashed; session closed
+        RESULT_UNKNOWN,    // No session with this id
+        RESULT_OFFSET,     // Chunk does not continue at the acknowledged offset
+        RESULT_CRC,        // Chunk damaged, send it again
+        RESULT_BUSY,       // Another session or update is running
+        RESULT_FAILED,     // Package rejected or flash failed; session closed
+        RESULT_DONE        // Session already completed, the restart is pending
+    };
+
+    struct Info {
+        bool active;
+        char id[ID_SIZE + 1];
+        char label[LABEL_SIZE + 1];
+        size_t size;
+        size_t offset;         // Acknowledged bytes; the next chunk starts here
+        uint32_t idleSeconds;
+        char error[96];        // RESULT_FAILED / RESULT_BUSY
+    };
+
+    explicit OTAUploadSession(OTAManager& ota);
+    ~OTAUploadSession();
+
+    void begin();
+
+    /**
+     * Start a session for a package of size bytes. If the running session
+     * has the same size and label it is returned instead (resume).
+     */
+    Result open(size_t size, const char* label, Info* out);
+
+    /**
+     * Chunk [offset, offset + len) of the package; out gets the state after it
+     */
+    Result write(const char* id, size_t offset, const uint8_t* data, size_t len, uint32_t crc, Info* out);
+
+    /**
+     * Drop the session; a partly flashed image is aborted, nothing boots it
+     */
+    bool abort(const char* id);
+
+    /**
+     * Abort a session nobody has sent to for IDLE_TIMEOUT_S; called from the
+     * control loop
+     */
+    void expireIdle();
+
+    bool isActive() const { return package != nullptr; }
+    void getInfo(Info* out);
+
+private:
+    OTAManager& ota;
+    SemaphoreHandle_t mutex;
+    OTAPackage* package;   // nullptr: no session
+    char id[ID_SIZE + 1];
+    char label[LABEL_SIZE + 1];
+    size_t size;
+    size_t offset;
+    int64_t lastActivityUs;
+    char finishedId[ID_SIZE + 1];   // Last session that completed or failed
+    char finishedLabel[LABEL_SIZE + 1];
+    size_t finishedSize;
+    Result finishedResult;
+    char finishedError[sizeof(Info::error)];
+
+    void close();
+    void fillInfo(Info* out) const;
+    void fillFinished(Info* out) const;
+};
@@ -0,0 +1,116 @@
+#include "ResponseCache.h"
+#include "Config.h"
+#include "esp_log.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char* TAG = "RESP_CACHE";
+
+// Room kept free behind the static prefix for the volatile members
+static const size_t VOLATILE_RESERVE = 384;
+
+ResponseCache::ResponseCache() : mutex(nullptr), useCounter(0) {
+    memset(slots, 0, sizeof(slots));
+}
+
+void ResponseCache::begin() {
+    if (mutex == nullptr) {
+        mutex = xSemaphoreCreateMutex();
+    }
+}
+
+ResponseCache::Slot* ResponseCache::acquireSlot(const char* key) {
+    Slot* victim = &slots[0];
+    for (uint8_t i = 0; i < SLOT_COUNT; i++) {
+        if (slots[i].key == key) {
+            return &slots[i];
+        }
+        if (slots[i].key == nullptr) {
+            victim = &slots[i];
+        } else if (victim->key != nullptr && slots[i].lastUsed < victim->lastUsed) {
+            victim = &slots[i];
+        }
+    }
+
+    // Least recently used slot gets the new key; version 0 forces a render
+    victim->key = key;
+    victim->configVersion = 0;
+    victim->prefixLength = 0;
+    return victim;
+}
+
+// FNV-1a
+uint32_t ResponseCache::hash(const char* data, size_t len, uint32_t seed) {
+    uint32_t h = 2166136261UL ^ seed;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (uint8_t)data[i];
+        h *= 16777619UL;
+    }
+    return h;
+}
+
+esp_err_t ResponseCache::sendUncached(httpd_req_t* req, RenderFn renderStatic, RenderFn renderVolatile, void* ctx) {
+    JsonStreamWriter json(req);
+    json.beginObject();
+    renderStatic(json, ctx);
+    renderVolatile(json, ctx);
+    json.endObject();
+    return json.finish();
+}
+
+esp_err_t ResponseCache::send(httpd_req_t* req, const char* key, RenderFn renderStatic, RenderFn renderVolatile, void* ctx) {
+    if (mutex == nullptr || xSemaphoreTake(mutex, pdMS_TO_TICKS(1000)) != pdTRUE) {
+        return sendUncached(req, renderStatic, renderVolatile, ctx);
+    }
+
+    Slot* slot = acquireSlot(key);
+    slot->lastUsed = ++useCounter;
+
+    // Read the version before rendering: a save during rendering re-renders next time
+    uint32_t version = Config::getVersion();
+    if (slot->configVersion != version) {
+        JsonStreamWriter prefix(slot->data, SLOT_SIZE - VOLATILE_RESERVE);
+        prefix.beginObject();
+        renderStatic(prefix, ctx);
+        if (prefix.failed()) {
+            ESP_LOGW(TAG, "%s does not fit into a cache slot", key);
+            slot->key = nullptr;
+            xSemaphoreGive(mutex);
+            return sendUncached(req, renderStatic, renderVolatile, ctx);
+        }
+        slot->prefixLength = prefix.size();
+        slot->configVersion = version;
+        ESP_LOGD(TAG, "%s rendered for config version %lu (%u bytes)", key,
+                 (unsigned long)version, (unsigned int)slot->prefixLength);
+    }
+
+    // Volatile members go straight behind the cached prefix
+    JsonStreamWriter tail(slot->data + slot->prefixLength, SLOT_SIZE - slot->prefixLength);
+    tail.continueObject();
+    renderVolatile(tail, ctx);
+    tail.endObject();
+    if (tail.failed()) {
+        xSemaphoreGive(mutex);
+        return sendUncached(req, renderStatic, renderVolatile, ctx);
+    }
+
+    char etag[24];
+    snprintf(etag, sizeof(etag), "\"%lx-%08lx\"", (unsigned long)version,
+             (unsigned long)hash(slot->data + slot->prefixLength, tail.size(), version));
+    httpd_resp_set_hdr(req, "ETag", etag);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+
+    esp_err_t err;
+    char if_none_match[48] = {0};
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", if_none_match, sizeof(if_none_match)) == ESP_OK &&
+        strstr(if_none_match, etag) != NULL) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        err = httpd_resp_send(req, NULL, 0);
+    } else {
+        httpd_resp_set_type(req, "application/json");
+        err = httpd_resp_send(req, slot->data, slot->prefixLength + tail.size());
+    }
+
+    xSemaphoreGive(mutex);
+    return err;
+}
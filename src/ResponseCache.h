@@ -0,0 +1,53 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_http_server.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "JsonStream.h"
+
+/**
+ * Cache for semi-static JSON endpoints.
+ *
+ * The static part of a response (everything derived from Config) is rendered
+ * once per Config::getVersion() into a fixed slot and kept as an unterminated
+ * JSON object. On every request the volatile fields (uptime, heap, link state)
+ * are appended right behind it in the same slot, so a hit is one
+ * httpd_resp_send() without re-rendering.
+ *
+ * ETag = config version + hash of the volatile fields; If-None-Match gets 304.
+ */
+class ResponseCache {
+public:
+    typedef void (*RenderFn)(JsonStreamWriter& json, void* ctx);
+
+    static const uint8_t SLOT_COUNT = 2;
+    static const size_t SLOT_SIZE = 1536;
+
+    ResponseCache();
+    void begin();
+
+    /**
+     * Send a cached response for key (an endpoint path literal)
+     * @param renderStatic Writes the members that only change with the config version
+     * @param renderVolatile Writes the members that are fresh on every request
+     */
+    esp_err_t send(httpd_req_t* req, const char* key, RenderFn renderStatic, RenderFn renderVolatile, void* ctx);
+
+private:
+    struct Slot {
+        const char* key;        // nullptr = free
+        uint32_t configVersion;
+        uint32_t lastUsed;
+        size_t prefixLength;    // Static part, object left open
+        char data[SLOT_SIZE];
+    };
+
+    Slot slots[SLOT_COUNT];
+    SemaphoreHandle_t mutex;
+    uint32_t useCounter;
+
+    Slot* acquireSlot(const char* key);
+    static uint32_t hash(const char* data, size_t len, uint32_t seed);
+    static esp_err_t sendUncached(httpd_req_t* req, RenderFn renderStatic, RenderFn renderVolatile, void* ctx);
+};
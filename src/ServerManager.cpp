@@ -3,7 +3,12 @@
 #include "MQTTManager.h"
 #include "LEDManager.h"
 #include "KMeterIsoComponent.h"  // Arduino sensor for hybrid mode
-#include "ArduinoJson.h"
+#include "JsonStream.h"
+#include "SessionStore.h"
+#include "StatusFields.h"
+#include "StatusBinary.h"
+#include "OTAPackage.h"
+#include <new>
 #include <string.h>
 #include "esp_spiffs.h"
 #include "nvs_flash.h"
@@ -18,17 +23,6 @@
 
 static const char *TAG = "SERVER";
 
-// Macro for token validation in protected handlers
-#define REQUIRE_AUTH() \
-    do { \
-        if (!check_auth(req)) { \
-            ESP_LOGW(TAG, "Unauthorized API access to %s", req->uri); \
-            httpd_resp_set_status(req, "401 Unauthorized"); \
-            send_json_response(req, "{\"error\":\"Unauthorized - invalid or missing token\"}"); \
-            return ESP_OK; \
-        } \
-    } while(0)
-
 extern LEDManager led;
 extern MQTTManager mqttManager;
 extern WiFiManager wifi;
@@ -36,7 +30,9 @@ extern WiFiManager wifi;
 static ServerManager* serverInstance = nullptr;
 
 ServerManager::ServerManager() : server(nullptr), externalSensor(nullptr), ledManager(nullptr), 
-                                 ledState(false), ledColorR(255), ledColorG(255), ledColorB(255) {
+                                 otaPull(otaManager), otaUpload(otaManager), ledState(false), ledColorR(255), ledColorG(255), ledColorB(255),
+                                 snapshotMutex(nullptr), controlTick(0) {
+    memset(&snapshot, 0, sizeof(snapshot));
     serverInstance = this;
 }
 
@@ -56,12 +52,18 @@ void ServerManager::begin() {
         size_t total = 0, used = 0;
         ret = esp_spiffs_info(NULL, &total, &used);
         if (ret == ESP_OK) {
-            ESP_LOGI(TAG, "SPIFFS: Total: %d, Used: %d", total, used);
+            ESP_LOGI(TAG, "SPIFFS: Total: %u, Used: %u", (unsigned)total, (unsigned)used);
         }
     }
     
     initializePWM();
     
+    // Dashboard snapshot: random initial version so ETags from before a reboot never match
+    snapshotMutex = xSemaphoreCreateMutex();
+    snapshot.version = esp_random();
+    snapshot.tick = controlTick - 1;  // Force rebuild on first request
+    StatusFields::resetVersions(snapshot);
+    
     // HINWEIS: KMeter-Sensor wird jetzt im Hybrid-Mode über Arduino-Library initialisiert (main.cpp)
     // Der alte ESP-IDF KMeterManager würde einen I2C-Konflikt verursachen
     ESP_LOGI(TAG, "KMeter-ISO sensor: Using Arduino-based sensor from main.cpp (hybrid mode)");
@@ -69,210 +71,277 @@ void ServerManager::begin() {
     Config::saveAutoPWMEnabled(true);
     ESP_LOGI(TAG, "Auto-PWM enabled for fan control");
     
+    workers.begin();
+    responseCache.begin();
+    otaPull.begin();
+    otaUpload.begin();
+    
+    if (startServer()) {
+        ESP_LOGI(TAG, "Web server started on port %d", Config::HTTP_PORT);
+        ESP_LOGI(TAG, "Server listening on all network interfaces (0.0.0.0:%d)", Config::HTTP_PORT);
+    } else {
+        ESP_LOGE(TAG, "Failed to start web server");
+    }
+}
+
+// Single source of the server configuration for begin() and restart()
+httpd_config_t ServerManager::makeServerConfig() {
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
     config.server_port = Config::HTTP_PORT;
-    config.max_uri_handlers = 50;  // Increased to accommodate all routes
+    config.max_uri_handlers = 4;     // Catch-alls only, routing happens in dispatch_handler
+    config.max_resp_headers = 10;    // Room for Keep-Alive next to cache and cookie headers
     config.stack_size = 8192;
     config.uri_match_fn = httpd_uri_match_wildcard;  // Enable wildcard/query string matching
-    config.lru_purge_enable = true;  // Enable connection purging
     config.recv_wait_timeout = 10;   // Timeout for receiving data
     config.send_wait_timeout = 10;   // Timeout for sending data
-    config.max_open_sockets = 7;     // Allow more concurrent connections
     config.backlog_conn = 5;         // Increase connection backlog
     
-    if (httpd_start(&server, &config) == ESP_OK) {
-        setupRoutes();
-        ESP_LOGI(TAG, "All routes registered");
-        ESP_LOGI(TAG, "Web server started on port %d", Config::HTTP_PORT);
-        ESP_LOGI(TAG, "Server listening on all network interfaces (0.0.0.0:%d)", Config::HTTP_PORT);
-    } else {
-        ESP_LOGE(TAG, "Failed to start web server");
+    // Connections stay open between polls. 7 sockets is the LWIP limit minus
+    // the three httpd keeps for itself; idle ones are closed by
+    // ConnectionTable::reapIdle, LRU purging is the fallback when all are busy.
+    config.max_open_sockets = ConnectionTable::CAPACITY;
+    config.lru_purge_enable = true;
+    config.open_fn = on_socket_open;
+    config.close_fn = on_socket_close;
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+    // TCP keep-alive finds peers that vanished without closing (WiFi roaming)
+    config.keep_alive_enable = true;
+    config.keep_alive_idle = ConnectionTable::KEEP_ALIVE_S;
+    config.keep_alive_interval = 5;
+    config.keep_alive_count = 3;
+#endif
+    return config;
+}
+
+bool ServerManager::startServer() {
+    httpd_config_t config = makeServerConfig();
+    if (httpd_start(&server, &config) != ESP_OK) {
+        server = NULL;
+        return false;
     }
+    setupRoutes();
+    return true;
 }
 
+// Recovery only: the listener is bound to the wildcard address and keeps
+// serving across STA/AP changes, so a new IP needs no restart.
 void ServerManager::restart() {
-    ESP_LOGI(TAG, "Restarting HTTP server to bind to new network interface...");
+    ESP_LOGI(TAG, "Restarting HTTP server...");
     
-    // Stop existing server
+    // httpd_stop joins the server task and closes all sockets, so the port is
+    // free again as soon as it returns; the route table is static
     if (server != NULL) {
         httpd_stop(server);
         server = NULL;
         ESP_LOGI(TAG, "HTTP server stopped");
     }
     
-    // Wait a moment for cleanup
-    vTaskDelay(pdMS_TO_TICKS(500));
-    
-    // Start server again
-    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
-    config.server_port = Config::HTTP_PORT;
-    config.max_uri_handlers = 50;
-    config.stack_size = 8192;
-    config.uri_match_fn = httpd_uri_match_wildcard;
-    config.lru_purge_enable = true;
-    config.recv_wait_timeout = 10;
-    config.send_wait_timeout = 10;
-    config.max_open_sockets = 7;
-    config.backlog_conn = 5;
-    
-    if (httpd_start(&server, &config) == ESP_OK) {
-        setupRoutes();
+    if (startServer()) {
         ESP_LOGI(TAG, "HTTP server restarted successfully");
-        ESP_LOGI(TAG, "Server now accessible on all network interfaces");
     } else {
         ESP_LOGE(TAG, "Failed to restart HTTP server");
     }
 }
 
 void ServerManager::setupRoutes() {
-    // Static files
-    httpd_uri_t root_uri = {.uri = "/", .method = HTTP_GET, .handler = root_handler, .user_ctx = this};
-    httpd_register_uri_handler(server, &root_uri);
-    
-    httpd_uri_t login_uri = {.uri = "/login.html", .method = HTTP_GET, .handler = login_handler, .user_ctx = this};
-    httpd_register_uri_handler(server, &login_uri);
-    
-    // Allow users to reach the login page via /login (without .html)
-    httpd_uri_t login_alias_uri = {.uri = "/login", .method = HTTP_GET, .handler = login_handler, .user_ctx = this};
-    httpd_register_uri_handler(server, &login_alias_uri);
-    
-    httpd_uri_t main_uri = {.uri = "/main.html", .method = HTTP_GET, .handler = main_handler, .user_ctx = this};
-    httpd_register_uri_handler(server, &main_uri);
-    
-    // Alias for main page without .html extension
-    httpd_uri_t main_alias_uri = {.uri = "/main", .method = HTTP_GET, .handler = main_handler, .user_ctx = this};
-    httpd_register_uri_handler(server, &main_alias_uri);
-    
-    httpd_uri_t style_uri = {.uri = "/style.css", .method = HTTP_GET, .handler = style_handler, .user_ctx = this};
-    httpd_register_uri_handler(server, &style_uri);
-    
-    httpd_uri_t logo_uri = {.uri = "/img/logo.png", .method = HTTP_GET, .handler = logo_handler, .user_ctx = this};
-    httpd_register_uri_handler(server, &logo_uri);
-    
-    httpd_uri_t setting_uri = {.uri = "/setting.html", .method = HTTP_GET, .handler = setting_handler, .user_ctx = this};
-    httpd_register_uri_handler(server, &setting_uri);
-    
-    // Alias for setting page without .html extension
-    httpd_uri_t setting_alias_uri = {.uri = "/setting", .method = HTTP_GET, .handler = setting_handler, .user_ctx = this};
-    httpd_register_uri_handler(server, &setting_alias_uri);
-    
-    // API endpoints
-    httpd_uri_t api_status = {.uri = "/api/status", .method = HTTP_GET, .handler = api_status_handler, .user_ctx = this};
-    httpd_register_uri_handler(server, &api_status);
-    
-    httpd_uri_t api_device_name = {.uri = "/api/device-name", .method = HTTP_POST, .handler = api_device_name_handler, .user_ctx = this};
-    httpd_register_uri_handler(server, &api_device_name);
-    
-    httpd_uri_t api_reboot = {.uri = "/api/reboot", .method = HTTP_POST, .handler = api_reboot_handler, .user_ctx = this};
-    httpd_register_uri_handler(server, &api_reboot);
-    
-    httpd_uri_t api_wifi_status = {.uri = "/api/wifi/status", .method = HTTP_GET, .handler = api_wifi_status_handler, .user_ctx = this};
-    httpd_register_uri_handler(server, &api_wifi_status);
-    
-    // Alias for compatibility with HTML files
-    httpd_uri_t api_wifi_status_alt = {.uri = "/api/wifi-status", .method = HTTP_GET, .handler = api_wifi_status_handler, .user_ctx = this};
-    httpd_register_uri_handler(server, &api_wifi_status_alt);
-    
-    httpd_uri_t api_pwm_status = {.uri = "/api/pwm/status", .method = HTTP_GET, .handler = api_pwm_status_handler, .user_ctx = this};
-    httpd_register_uri_handler(server, &api_pwm_status);
-    
-    // Alias for compatibility with HTML files
-    httpd_uri_t api_pwm_status_alt = {.uri = "/api/pwm-status", .method = HTTP_GET, .handler = api_pwm_status_handler, .user_ctx = this};
-    httpd_register_uri_handler(server, &api_pwm_status_alt);
-    
-    httpd_uri_t api_pwm_control = {.uri = "/api/pwm/control", .method = HTTP_POST, .handler = api_pwm_control_handler, .user_ctx = this};
-    httpd_register_uri_handler(server, &api_pwm_control);
-    
-    // OTA Update - TAR file (recommended) or separate files
-    httpd_uri_t api_ota_tar = {.uri = "/api/ota/upload", .method = HTTP_POST, .handler = api_ota_tar_handler, .user_ctx = this};
-    httpd_register_uri_handler(server, &api_ota_tar);
-    
-    httpd_uri_t api_ota_firmware = {.uri = "/api/ota/firmware", .method = HTTP_POST, .handler = api_ota_firmware_handler, .user_ctx = this};
-    httpd_register_uri_handler(server, &api_ota_firmware);
-    
-    httpd_uri_t api_ota_filesystem = {.uri = "/api/ota/filesystem", .method = HTTP_POST, .handler = api_ota_filesystem_handler, .user_ctx = this};
-    httpd_register_uri_handler(server, &api_ota_filesystem);
-    
-    httpd_uri_t api_login = {.uri = "/api/login", .method = HTTP_POST, .handler = api_login_handler, .user_ctx = this};
-    httpd_register_uri_handler(server, &api_login);
-    
-    // POST handler for login form
-    httpd_uri_t login_post = {.uri = "/login", .method = HTTP_POST, .handler = login_post_handler, .user_ctx = this};
-    httpd_register_uri_handler(server, &login_post);
-    
-    // System & Device APIs
-    httpd_uri_t api_system_info = {.uri = "/api/system-info", .method = HTTP_GET, .handler = api_system_info_handler, .user_ctx = this};
-    httpd_register_uri_handler(server, &api_system_info);
-    
-    httpd_uri_t api_settings = {.uri = "/api/settings", .method = HTTP_GET, .handler = api_settings_handler, .user_ctx = this};
-    httpd_register_uri_handler(server, &api_settings);
-    
-    httpd_uri_t api_restart = {.uri = "/api/restart", .method = HTTP_POST, .handler = api_restart_handler, .user_ctx = this};
-    httpd_register_uri_handler(server, &api_restart);
-    
-    httpd_uri_t api_factory_reset = {.uri = "/api/factory-reset", .method = HTTP_POST, .handler = api_factory_reset_handler, .user_ctx = this};
-    httpd_register_uri_handler(server, &api_factory_reset);
-    
-    // WiFi APIs
-    httpd_uri_t api_wifi_scan = {.uri = "/api/wifi-scan*", .method = HTTP_GET, .handler = api_wifi_scan_handler, .user_ctx = this};
-    httpd_register_uri_handler(server, &api_wifi_scan);
-    
-    httpd_uri_t wifi_connect = {.uri = "/wifi_connect", .method = HTTP_POST, .handler = api_wifi_connect_handler, .user_ctx = this};
-    httpd_register_uri_handler(server, &wifi_connect);
-    
-    httpd_uri_t api_wifi_disconnect = {.uri = "/api/wifi-disconnect", .method = HTTP_POST, .handler = api_wifi_disconnect_handler, .user_ctx = this};
-    httpd_register_uri_handler(server, &api_wifi_disconnect);
-    
-    httpd_uri_t api_wifi_clear = {.uri = "/api/wifi-clear", .method = HTTP_POST, .handler = api_wifi_clear_handler, .user_ctx = this};
-    httpd_register_uri_handler(server, &api_wifi_clear);
-    
-    httpd_uri_t api_toggle_ap = {.uri = "/api/toggle-ap", .method = HTTP_POST, .handler = api_toggle_ap_handler, .user_ctx = this};
-    httpd_register_uri_handler(server, &api_toggle_ap);
-    
-    // MQTT APIs
-    httpd_uri_t api_mqtt_settings = {.uri = "/api/mqtt-settings", .method = HTTP_POST, .handler = api_mqtt_settings_handler, .user_ctx = this};
-    httpd_register_uri_handler(server, &api_mqtt_settings);
-    
-    httpd_uri_t api_mqtt_test = {.uri = "/api/mqtt-test", .method = HTTP_POST, .handler = api_mqtt_test_handler, .user_ctx = this};
-    httpd_register_uri_handler(server, &api_mqtt_test);
-    
-    // PWM & Sensor APIs
-    httpd_uri_t api_manual_pwm_mode = {.uri = "/api/manual-pwm-mode", .method = HTTP_POST, .handler = api_manual_pwm_mode_handler, .user_ctx = this};
-    httpd_register_uri_handler(server, &api_manual_pwm_mode);
-    
-    httpd_uri_t api_manual_pwm_settings = {.uri = "/api/manual-pwm-settings", .method = HTTP_POST, .handler = api_manual_pwm_settings_handler, .user_ctx = this};
-    httpd_register_uri_handler(server, &api_manual_pwm_settings);
-    
-    httpd_uri_t api_temp_mapping = {.uri = "/api/temp-mapping", .method = HTTP_POST, .handler = api_temp_mapping_handler, .user_ctx = this};
-    httpd_register_uri_handler(server, &api_temp_mapping);
+    // Every request goes through dispatch_handler, which looks the path up in
+    // the route table below. Only the two catch-alls occupy httpd handler slots.
+    httpd_uri_t get_uri = {.uri = "/*", .method = HTTP_GET, .handler = dispatch_handler, .user_ctx = this};
+    httpd_register_uri_handler(server, &get_uri);
     
-    httpd_uri_t api_temp_mapping_status = {.uri = "/api/temp-mapping-status*", .method = HTTP_GET, .handler = api_temp_mapping_status_handler, .user_ctx = this};
-    httpd_register_uri_handler(server, &api_temp_mapping_status);
+    httpd_uri_t post_uri = {.uri = "/*", .method = HTTP_POST, .handler = dispatch_handler, .user_ctx = this};
+    httpd_register_uri_handler(server, &post_uri);
     
-    httpd_uri_t api_kmeter_status = {.uri = "/api/kmeter-status*", .method = HTTP_GET, .handler = api_kmeter_status_handler, .user_ctx = this};
-    httpd_register_uri_handler(server, &api_kmeter_status);
-    
-    httpd_uri_t api_kmeter_config = {.uri = "/api/kmeter-config", .method = HTTP_POST, .handler = api_kmeter_config_handler, .user_ctx = this};
-    httpd_register_uri_handler(server, &api_kmeter_config);
-    
-    // LED & Auth APIs
-    httpd_uri_t api_led_toggle = {.uri = "/api/led-toggle", .method = HTTP_POST, .handler = api_led_toggle_handler, .user_ctx = this};
-    httpd_register_uri_handler(server, &api_led_toggle);
+    ESP_LOGI(TAG, "All routes registered");
+}
+
+// Byte-wise strcmp usable in constant expressions (C++11: single return, recursion)
+constexpr int ServerManager::compare_paths(const char* a, const char* b) {
+    return (*a != *b) ? ((unsigned char)*a < (unsigned char)*b ? -1 : 1)
+         : (*a == '\0') ? 0
+         : compare_paths(a + 1, b + 1);
+}
+
+// Table must be ordered by path, then method, for the binary search
+constexpr bool ServerManager::routes_sorted(const Route* routes, size_t count) {
+    return count < 2 ? true
+         : (compare_paths(routes[0].path, routes[1].path) < 0 ||
+            (compare_paths(routes[0].path, routes[1].path) == 0 && routes[0].method < routes[1].method))
+           && routes_sorted(routes + 1, count - 1);
+}
+
+const ServerManager::Route* ServerManager::find_route(httpd_method_t method, const char* path, size_t len, bool* path_known) {
+    // Sorted by path, then method. Wildcard entries of the old table
+    // ("/api/wifi-scan*" etc.) only existed to tolerate query strings,
+    // which dispatch_handler strips before the lookup.
+    static constexpr Route routes[] = {
+        { HTTP_GET,  "/",                         root_handler,                      ROUTE_AUTH_NONE, ROUTE_FLAG_NONE },
+        { HTTP_POST, "/api/change-password",      api_change_password_handler,       ROUTE_AUTH_API,  ROUTE_FLAG_NONE },
+        { HTTP_GET,  "/api/dashboard",            api_dashboard_handler,             ROUTE_AUTH_API,  ROUTE_FLAG_NONE },
+        { HTTP_POST, "/api/device-name",          api_device_name_handler,           ROUTE_AUTH_API,  ROUTE_FLAG_NONE },
+        { HTTP_POST, "/api/factory-reset",        api_factory_reset_handler,         ROUTE_AUTH_API,  ROUTE_FLAG_NONE },
+        { HTTP_POST, "/api/kmeter-config",        api_kmeter_config_handler,         ROUTE_AUTH_API,  ROUTE_FLAG_NONE },
+        { HTTP_GET,  "/api/kmeter-status",        api_kmeter_status_handler,         ROUTE_AUTH_API,  ROUTE_FLAG_NONE },
+        { HTTP_POST, "/api/led-color",            api_led_color_handler,             ROUTE_AUTH_API,  ROUTE_FLAG_PRIORITY },
+        { HTTP_POST, "/api/led-toggle",           api_led_toggle_handler,            ROUTE_AUTH_API,  ROUTE_FLAG_PRIORITY },
+        { HTTP_POST, "/api/login",                api_login_handler,                 ROUTE_AUTH_NONE, ROUTE_FLAG_PRIORITY },
+        { HTTP_GET,  "/api/logout",               api_logout_handler,                ROUTE_AUTH_API,  ROUTE_FLAG_NONE },
+        { HTTP_POST, "/api/logout",               api_logout_handler,                ROUTE_AUTH_API,  ROUTE_FLAG_NONE },
+        { HTTP_POST, "/api/manual-pwm-mode",      api_manual_pwm_mode_handler,       ROUTE_AUTH_API,  ROUTE_FLAG_PRIORITY },
+        { HTTP_POST, "/api/manual-pwm-settings",  api_manual_pwm_settings_handler,   ROUTE_AUTH_API,  ROUTE_FLAG_PRIORITY },
+        { HTTP_POST, "/api/mqtt-settings",        api_mqtt_settings_handler,         ROUTE_AUTH_API,  ROUTE_FLAG_NONE },
+        { HTTP_POST, "/api/mqtt-test",            api_mqtt_test_handler,             ROUTE_AUTH_API,  ROUTE_FLAG_NONE },
+        { HTTP_POST, "/api/ota/filesystem",       api_ota_filesystem_handler,        ROUTE_AUTH_API,  ROUTE_FLAG_NONE },
+        { HTTP_POST, "/api/ota/firmware",         api_ota_firmware_handler,          ROUTE_AUTH_API,  ROUTE_FLAG_NONE },
+        { HTTP_GET,  "/api/ota/pull",             api_ota_pull_handler,              ROUTE_AUTH_API,  ROUTE_FLAG_NONE },
+        { HTTP_POST, "/api/ota/pull",             api_ota_pull_settings_handler,     ROUTE_AUTH_API,  ROUTE_FLAG_NONE },
+        { HTTP_GET,  "/api/ota/session",          api_ota_session_handler,           ROUTE_AUTH_API,  ROUTE_FLAG_NONE },
+        { HTTP_POST, "/api/ota/session",          api_ota_session_open_handler,      ROUTE_AUTH_API,  ROUTE_FLAG_NONE },
+        { HTTP_POST, "/api/ota/session/abort",    api_ota_session_abort_handler,     ROUTE_AUTH_API,  ROUTE_FLAG_NONE },
+        { HTTP_POST, "/api/ota/session/chunk",    api_ota_session_chunk_handler,     ROUTE_AUTH_API,  ROUTE_FLAG_NONE },
+        { HTTP_GET,  "/api/ota/status",           api_ota_status_handler,            ROUTE_AUTH_API,  ROUTE_FLAG_NONE },
+        { HTTP_POST, "/api/ota/upload",           api_ota_tar_handler,               ROUTE_AUTH_API,  ROUTE_FLAG_NONE },
+        { HTTP_GET,  "/api/pwm-status",           api_pwm_status_handler,            ROUTE_AUTH_API,  ROUTE_FLAG_NONE },
+        { HTTP_POST, "/api/pwm/control",          api_pwm_control_handler,           ROUTE_AUTH_API,  ROUTE_FLAG_PRIORITY },
+        { HTTP_GET,  "/api/pwm/status",           api_pwm_status_handler,            ROUTE_AUTH_API,  ROUTE_FLAG_NONE },
+        { HTTP_POST, "/api/reboot",               api_reboot_handler,                ROUTE_AUTH_API,  ROUTE_FLAG_NONE },
+        { HTTP_POST, "/api/restart",              api_restart_handler,               ROUTE_AUTH_API,  ROUTE_FLAG_NONE },
+        { HTTP_GET,  "/api/server-stats",         api_server_stats_handler,          ROUTE_AUTH_API,  ROUTE_FLAG_NONE },
+        { HTTP_GET,  "/api/settings",             api_settings_handler,              ROUTE_AUTH_API,  ROUTE_FLAG_NONE },
+        { HTTP_POST, "/api/settings/batch",       api_settings_batch_handler,        ROUTE_AUTH_API,  ROUTE_FLAG_NONE },
+        { HTTP_GET,  "/api/status",               api_status_handler,                ROUTE_AUTH_API,  ROUTE_FLAG_NONE },
+        { HTTP_GET,  "/api/status.bin",           api_status_bin_handler,            ROUTE_AUTH_API,  ROUTE_FLAG_NONE },
+        { HTTP_GET,  "/api/system-info",          api_system_info_handler,           ROUTE_AUTH_NONE, ROUTE_FLAG_NONE },
+        { HTTP_POST, "/api/temp-mapping",         api_temp_mapping_handler,          ROUTE_AUTH_API,  ROUTE_FLAG_PRIORITY },
+        { HTTP_GET,  "/api/temp-mapping-status",  api_temp_mapping_status_handler,   ROUTE_AUTH_API,  ROUTE_FLAG_NONE },
+        { HTTP_POST, "/api/toggle-ap",            api_toggle_ap_handler,             ROUTE_AUTH_API,  ROUTE_FLAG_NONE },
+        { HTTP_POST, "/api/wifi-clear",           api_wifi_clear_handler,            ROUTE_AUTH_API,  ROUTE_FLAG_NONE },
+        { HTTP_POST, "/api/wifi-disconnect",      api_wifi_disconnect_handler,       ROUTE_AUTH_API,  ROUTE_FLAG_NONE },
+        { HTTP_GET,  "/api/wifi-scan",            api_wifi_scan_handler,             ROUTE_AUTH_API,  ROUTE_FLAG_NONE },
+        { HTTP_GET,  "/api/wifi-status",          api_wifi_status_handler,           ROUTE_AUTH_API,  ROUTE_FLAG_NONE },
+        { HTTP_GET,  "/api/wifi/status",          api_wifi_status_handler,           ROUTE_AUTH_API,  ROUTE_FLAG_NONE },
+        { HTTP_GET,  "/img/logo.png",             logo_handler,                      ROUTE_AUTH_NONE, ROUTE_FLAG_NONE },
+        { HTTP_GET,  "/img/logo.svg",             logo_handler,                      ROUTE_AUTH_NONE, ROUTE_FLAG_NONE },
+        { HTTP_GET,  "/login",                    login_handler,                     ROUTE_AUTH_NONE, ROUTE_FLAG_NONE },
+        { HTTP_POST, "/login",                    login_post_handler,                ROUTE_AUTH_NONE, ROUTE_FLAG_NONE },
+        { HTTP_GET,  "/login.html",               login_handler,                     ROUTE_AUTH_NONE, ROUTE_FLAG_NONE },
+        { HTTP_GET,  "/main",                     main_handler,                      ROUTE_AUTH_PAGE, ROUTE_FLAG_NONE },
+        { HTTP_GET,  "/main.html",                main_handler,                      ROUTE_AUTH_PAGE, ROUTE_FLAG_NONE },
+        { HTTP_GET,  "/setting",                  setting_handler,                   ROUTE_AUTH_PAGE, ROUTE_FLAG_NONE },
+        { HTTP_GET,  "/setting.html",             setting_handler,                   ROUTE_AUTH_PAGE, ROUTE_FLAG_NONE },
+        { HTTP_GET,  "/style.css",                style_handler,                     ROUTE_AUTH_NONE, ROUTE_FLAG_NONE },
+        { HTTP_POST, "/wifi_connect",             api_wifi_connect_handler,          ROUTE_AUTH_API,  ROUTE_FLAG_NONE },
+    };
+    static constexpr size_t ROUTE_COUNT = sizeof(routes) / sizeof(routes[0]);
+    static_assert(routes_sorted(routes, ROUTE_COUNT), "Route table must be sorted by path and method");
+    
+    *path_known = false;
+    size_t lo = 0;
+    size_t hi = ROUTE_COUNT;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        int cmp = strncmp(routes[mid].path, path, len);
+        if (cmp == 0 && routes[mid].path[len] != '\0') {
+            cmp = 1;  // Table path is longer than the request path
+        }
+        if (cmp < 0) {
+            lo = mid + 1;
+        } else if (cmp > 0) {
+            hi = mid;
+        } else {
+            // Same path may be listed for several methods; they are adjacent
+            *path_known = true;
+            size_t first = mid;
+            while (first > 0 && strcmp(routes[first - 1].path, routes[mid].path) == 0) {
+                first--;
+            }
+            for (size_t i = first; i < ROUTE_COUNT && strcmp(routes[i].path, routes[mid].path) == 0; i++) {
+                if (routes[i].method == method) {
+                    return &routes[i];
+                }
+            }
+            return nullptr;
+        }
+    }
+    return nullptr;
+}
+
+esp_err_t ServerManager::on_socket_open(httpd_handle_t hd, int sockfd) {
+    return serverInstance->connections.onOpen(hd, sockfd);
+}
+
+void ServerManager::on_socket_close(httpd_handle_t hd, int sockfd) {
+    serverInstance->connections.onClose(hd, sockfd);
+}
+
+esp_err_t ServerManager::dispatch_handler(httpd_req_t *req) {
+    ServerManager* manager = (ServerManager*)req->user_ctx;
+    manager->connections.touch(req);
     
-    httpd_uri_t api_led_color = {.uri = "/api/led-color", .method = HTTP_POST, .handler = api_led_color_handler, .user_ctx = this};
-    httpd_register_uri_handler(server, &api_led_color);
+    // Tell polling clients how long an idle connection is kept
+    static const char keep_alive[] = "timeout=30";
+    static_assert(ConnectionTable::KEEP_ALIVE_S == 30, "Keep-Alive header out of sync");
+    httpd_resp_set_hdr(req, "Keep-Alive", keep_alive);
     
-    httpd_uri_t api_change_password = {.uri = "/api/change-password", .method = HTTP_POST, .handler = api_change_password_handler, .user_ctx = this};
-    httpd_register_uri_handler(server, &api_change_password);
+    size_t len = strcspn(req->uri, "?");
+    bool path_known = false;
+    const Route* route = find_route((httpd_method_t)req->method, req->uri, len, &path_known);
     
-    httpd_uri_t api_logout = {.uri = "/api/logout", .method = HTTP_POST, .handler = api_logout_handler, .user_ctx = this};
-    httpd_register_uri_handler(server, &api_logout);
+    if (route == nullptr) {
+        if (path_known) {
+            return httpd_resp_send_err(req, HTTPD_405_METHOD_NOT_ALLOWED, "Method not allowed");
+        }
+        ESP_LOGW(TAG, "No route for %s", req->uri);
+        return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Not found");
+    }
+    
+    // Admission before auth, so floods are turned away before any real work
+    if (strncmp(route->path, "/api/", 5) == 0) {
+        uint32_t retry_after = 1;
+        AdmissionControl::Result result = manager->admission.admit(req, route->flags & ROUTE_FLAG_PRIORITY, &retry_after);
+        if (result != AdmissionControl::ADMIT) {
+            ESP_LOGW(TAG, "Rate limited (%s) %s", result == AdmissionControl::REJECT_CLIENT ? "client" : "global", req->uri);
+            char retry[12];
+            snprintf(retry, sizeof(retry), "%lu", (unsigned long)retry_after);
+            httpd_resp_set_status(req, "429 Too Many Requests");
+            httpd_resp_set_hdr(req, "Retry-After", retry);
+            send_json_response(req, "{\"error\":\"Too many requests\"}");
+            return ESP_OK;
+        }
+    }
     
-    // Also support GET for logout
-    httpd_uri_t api_logout_get = {.uri = "/api/logout", .method = HTTP_GET, .handler = api_logout_handler, .user_ctx = this};
-    httpd_register_uri_handler(server, &api_logout_get);
+    if (route->auth != ROUTE_AUTH_NONE && !check_auth(req)) {
+        if (route->auth == ROUTE_AUTH_PAGE) {
+            ESP_LOGW(TAG, "Unauthorized access to %s - redirecting to login", req->uri);
+            httpd_resp_set_status(req, "302 Found");
+            httpd_resp_set_hdr(req, "Location", "/login.html");
+            httpd_resp_send(req, NULL, 0);
+        } else {
+            ESP_LOGW(TAG, "Unauthorized API access to %s", req->uri);
+            httpd_resp_set_status(req, "401 Unauthorized");
+            send_json_response(req, "{\"error\":\"Unauthorized - invalid or missing token\"}");
+        }
+        return ESP_OK;
+    }
     
-    ESP_LOGI(TAG, "All routes registered");
+    return route->handler(req);
+}
+
+void ServerManager::restart_job(void* arg) {
+    ESP_LOGI(TAG, "Restarting ESP32...");
+    esp_restart();
+}
+
+void ServerManager::mqtt_reconnect_job(void* arg) {
+    mqttManager.reconnect();
+}
+
+// Reboot once the response has had time to leave - without blocking the calling task
+void ServerManager::schedule_restart(uint32_t delay_ms) {
+    if (serverInstance == nullptr || !serverInstance->workers.submitJob(restart_job, NULL, delay_ms)) {
+        vTaskDelay(pdMS_TO_TICKS(delay_ms));
+        esp_restart();
+    }
 }
 
 void ServerManager::handleClient() {
@@ -286,9 +355,9 @@ static esp_err_t serve_spiffs_file(httpd_req_t *req, const char* filepath, const
     
     // Log request headers size
     size_t hdr_len = httpd_req_get_hdr_value_len(req, "User-Agent");
-    ESP_LOGI(TAG, "[DEBUG] User-Agent header length: %d", hdr_len);
+    ESP_LOGI(TAG, "[DEBUG] User-Agent header length: %u", (unsigned)hdr_len);
     hdr_len = httpd_req_get_hdr_value_len(req, "Cookie");
-    ESP_LOGI(TAG, "[DEBUG] Cookie header length: %d", hdr_len);
+    ESP_LOGI(TAG, "[DEBUG] Cookie header length: %u", (unsigned)hdr_len);
     
     FILE* f = fopen(filepath, "r");
     if (f == NULL) {
@@ -472,6 +541,11 @@ void ServerManager::setPWMDuty(int duty) {
 }
 
 void ServerManager::updateSensors() {
+    // Called once per control tick from the main loop; invalidates the dashboard snapshot
+    controlTick++;
+    connections.reapIdle(server);
+    otaUpload.expireIdle();
+    
     // In hybrid mode, use external Arduino sensor (no update needed - reads on demand)
     if (externalSensor) {
         // Arduino sensor updates automatically, no explicit update() needed
@@ -506,6 +580,77 @@ void ServerManager::updateAutoPWM() {
     }
 }
 
+void ServerManager::rebuildSnapshot() {
+    DashboardSnapshot fresh;
+    memset(&fresh, 0, sizeof(fresh));  // Deterministic padding for memcmp below
+    
+    if (externalSensor) {
+        fresh.temperatureC = externalSensor->getTemperatureCelsius();
+        fresh.temperatureF = externalSensor->getTemperatureFahrenheit();
+        fresh.internalTemperature = externalSensor->getInternalTemperature();
+        fresh.sensorInitialized = (fresh.temperatureC > -100.0f);
+        fresh.sensorReady = fresh.sensorInitialized;
+        fresh.sensorError = 0;
+    } else {
+        fresh.temperatureC = kmeterManager.getTemperatureCelsius();
+        fresh.temperatureF = kmeterManager.getTemperatureFahrenheit();
+        fresh.internalTemperature = kmeterManager.getInternalTemperature();
+        fresh.sensorInitialized = kmeterManager.isInitialized();
+        fresh.sensorReady = kmeterManager.isReady();
+        fresh.sensorError = kmeterManager.getErrorStatus();
+    }
+    
+    fresh.dutyRaw = ledc_get_duty(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_0);
+    fresh.dutyPercent = (fresh.dutyRaw * 100) / 255;
+    fresh.manualMode = Config::MANUAL_PWM_MODE;
+    fresh.manualFreq = Config::MANUAL_PWM_FREQ;
+    fresh.manualDuty = Config::MANUAL_PWM_DUTY;
+    fresh.autoPWM = Config::AUTO_PWM_ENABLED;
+    fresh.tempStart = Config::TEMP_START;
+    fresh.tempMax = Config::TEMP_MAX;
+    
+    fresh.wifiConnected = wifi.isConnected();
+    fresh.mqttConnected = mqttManager.isConnected();
+    wifi_ap_record_t ap_info;
+    if (fresh.wifiConnected && esp_wifi_sta_get_ap_info(&ap_info) == ESP_OK) {
+        fresh.wifiRssi = ap_info.rssi;
+    }
+    
+    fresh.ledState = ledState;
+    fresh.ledR = ledColorR;
+    fresh.ledG = ledColorG;
+    fresh.ledB = ledColorB;
+    fresh.uptimeMinutes = (uint32_t)(esp_timer_get_time() / 60000000ULL);
+    snprintf(fresh.deviceName, sizeof(fresh.deviceName), "%s", Config::DEVICE_NAME);
+    snprintf(fresh.tempUnit, sizeof(fresh.tempUnit), "%s", Config::TEMP_UNIT);
+    
+    // Only bump the version if something visible actually changed
+    fresh.version = snapshot.version;
+    fresh.tick = snapshot.tick;
+    fresh.baseVersion = snapshot.baseVersion;
+    memcpy(fresh.memberVersion, snapshot.memberVersion, sizeof(fresh.memberVersion));
+    if (memcmp(&fresh, &snapshot, sizeof(fresh)) != 0) {
+        fresh.version++;
+        StatusFields::markChanges(snapshot, fresh);
+    }
+    fresh.tick = controlTick;
+    snapshot = fresh;
+}
+
+void ServerManager::getDashboardSnapshot(DashboardSnapshot* out) {
+    if (!snapshotMutex) {
+        memset(out, 0, sizeof(*out));
+        return;
+    }
+    
+    xSemaphoreTake(snapshotMutex, portMAX_DELAY);
+    if (snapshot.tick != controlTick) {
+        rebuildSnapshot();
+    }
+    *out = snapshot;
+    xSemaphoreGive(snapshotMutex);
+}
+
 // Static HTTP Handlers
 void ServerManager::send_json_response(httpd_req_t *req, const char* json) {
     httpd_resp_set_type(req, "application/json");
@@ -537,53 +682,67 @@ void ServerManager::url_decode(char* dst, const char* src, size_t dst_size) {
     dst[dst_index] = '\0';
 }
 
-bool ServerManager::check_auth(httpd_req_t *req) {
-    // Check for token in URL parameter
+// Login sessions (in memory, reset on reboot)
+static SessionStore sessions;
+
+// Token from ?token=, "Authorization: Bearer", X-Auth-Token or the session cookie
+bool ServerManager::extract_token(httpd_req_t *req, char* token, size_t size) {
     char query[128] = {0};
-    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
-        char token[32] = {0};
-        if (httpd_query_key_value(query, "token", token, sizeof(token)) == ESP_OK) {
-            return is_valid_token(token);
-        }
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+        httpd_query_key_value(query, "token", token, size) == ESP_OK) {
+        return true;
     }
-    return false; // Not authenticated
-}
-
-// Token storage (simple in-memory storage, will be reset on reboot)
-static char current_token[9] = {0};
-static uint64_t token_created = 0;
-static const uint64_t TOKEN_EXPIRY = 24ULL * 60ULL * 60ULL * 1000000ULL; // 24 hours in microseconds
-
-char* ServerManager::generate_token() {
-    // Generate a simple 4-character hex token (like "83f8" in your screenshot)
-    uint32_t random_num = esp_random() & 0xFFFF; // 16-bit random number
-    snprintf(current_token, sizeof(current_token), "%04lx", (unsigned long)random_num);
-    token_created = esp_timer_get_time();
-    ESP_LOGI(TAG, "Generated new token: %s", current_token);
-    return current_token;
+    
+    char header[48] = {0};
+    if (httpd_req_get_hdr_value_str(req, "Authorization", header, sizeof(header)) == ESP_OK &&
+        strncasecmp(header, "Bearer ", 7) == 0) {
+        strncpy(token, header + 7, size - 1);
+        token[size - 1] = '\0';
+        return true;
+    }
+    
+    if (httpd_req_get_hdr_value_str(req, "X-Auth-Token", token, size) == ESP_OK) {
+        return true;
+    }
+    
+    size_t cookie_len = size;
+    return httpd_req_get_cookie_val(req, "token", token, &cookie_len) == ESP_OK;
 }
 
-bool ServerManager::is_valid_token(const char* token) {
-    if (!token || strlen(token) == 0) {
-        return false;
+bool ServerManager::check_auth(httpd_req_t *req) {
+    char token[SessionStore::TOKEN_STRING_SIZE + 1] = {0};
+    if (!extract_token(req, token, sizeof(token))) {
+        return false; // Not authenticated
     }
     
-    // Check if token matches
-    if (strcmp(token, current_token) != 0) {
-        ESP_LOGI(TAG, "Invalid token: %s (expected: %s)", token, current_token);
-        return false;
+    // A polling client sends the same token on the same socket over and over
+    ConnectionTable::Connection* conn = serverInstance ? serverInstance->connections.of(req) : nullptr;
+    uint32_t generation = sessions.generation();
+    if (conn != nullptr && serverInstance->connections.authorized(conn, token, generation)) {
+        return true;
     }
     
-    // Check if token is expired (24 hours)
-    uint64_t current_time = esp_timer_get_time();
-    if (current_time - token_created > TOKEN_EXPIRY) {
-        ESP_LOGI(TAG, "Token expired");
+    if (!sessions.validate(token)) {
+        if (conn != nullptr) {
+            serverInstance->connections.forgetAuth(conn);
+        }
         return false;
     }
-    
+    if (conn != nullptr) {
+        serverInstance->connections.rememberAuth(conn, token, generation);
+    }
     return true;
 }
 
+// Cookie lets plain page loads and scripts authenticate without ?token=
+void ServerManager::set_session_cookie(httpd_req_t *req, const char* token) {
+    // httpd keeps the pointer until the response is sent
+    static char cookie[96];
+    snprintf(cookie, sizeof(cookie), "token=%s; Path=/; Max-Age=%lu; HttpOnly; SameSite=Strict",
+             token, (unsigned long)(SessionStore::DEFAULT_TTL_US / 1000000ULL));
+    httpd_resp_set_hdr(req, "Set-Cookie", cookie);
+}
+
 bool ServerManager::check_token(httpd_req_t *req) {
     return check_auth(req);
 }
@@ -611,26 +770,10 @@ esp_err_t ServerManager::login_handler(httpd_req_t *req) {
 }
 
 esp_err_t ServerManager::main_handler(httpd_req_t *req) {
-    // Require valid token to access main page
-    if (!check_auth(req)) {
-        ESP_LOGW(TAG, "Unauthorized access to main.html - redirecting to login");
-        httpd_resp_set_status(req, "302 Found");
-        httpd_resp_set_hdr(req, "Location", "/login.html");
-        httpd_resp_send(req, NULL, 0);
-        return ESP_OK;
-    }
     return serve_spiffs_file(req, "/spiffs/main.html", "text/html");
 }
 
 esp_err_t ServerManager::setting_handler(httpd_req_t *req) {
-    // Require valid token to access settings page
-    if (!check_auth(req)) {
-        ESP_LOGW(TAG, "Unauthorized access to setting.html - redirecting to login");
-        httpd_resp_set_status(req, "302 Found");
-        httpd_resp_set_hdr(req, "Location", "/login.html");
-        httpd_resp_send(req, NULL, 0);
-        return ESP_OK;
-    }
     return serve_spiffs_file(req, "/spiffs/setting.html", "text/html");
 }
 
@@ -639,25 +782,25 @@ esp_err_t ServerManager::style_handler(httpd_req_t *req) {
 }
 
 esp_err_t ServerManager::logo_handler(httpd_req_t *req) {
-    return serve_spiffs_file(req, "/spiffs/img/logo.png", "image/png");
+    // The pages embed the logo; /img/logo.png stays as an alias for old bookmarks
+    return serve_spiffs_file(req, "/spiffs/img/logo.svg", "image/svg+xml");
 }
 
 esp_err_t ServerManager::api_status_handler(httpd_req_t *req) {
-    REQUIRE_AUTH();
-    
-    DynamicJsonDocument doc(768);
-    doc["status"] = "online";
-    doc["device_name"] = Config::DEVICE_NAME;
-    doc["firmware"] = Config::FIRMWARE_VERSION;
-    doc["wifi_connected"] = wifi.isConnected();
-    doc["mqtt_connected"] = mqttManager.isConnected();
+    JsonStreamWriter json(req);
+    json.beginObject();
+    json.add("status", "online");
+    json.add("device_name", Config::DEVICE_NAME);
+    json.add("firmware", Config::FIRMWARE_VERSION);
+    json.add("wifi_connected", wifi.isConnected());
+    json.add("mqtt_connected", mqttManager.isConnected());
     
     // Get WiFi RSSI
     wifi_ap_record_t ap_info;
     if (esp_wifi_sta_get_ap_info(&ap_info) == ESP_OK) {
-        doc["wifi_rssi"] = ap_info.rssi;
+        json.add("wifi_rssi", (int)ap_info.rssi);
     } else {
-        doc["wifi_rssi"] = 0;
+        json.add("wifi_rssi", 0);
     }
     
     // Uptime in human readable format
@@ -673,27 +816,61 @@ esp_err_t ServerManager::api_status_handler(httpd_req_t *req) {
     } else {
         snprintf(uptime_str, sizeof(uptime_str), "%um", (unsigned int)minutes);
     }
-    doc["uptime"] = uptime_str;
+    json.add("uptime", uptime_str);
     
     // Memory info
-    doc["free_memory"] = esp_get_free_heap_size() / 1024; // KB
+    json.add("free_memory", (unsigned long)(esp_get_free_heap_size() / 1024)); // KB
     
     // LED state from ServerManager
     ServerManager* manager = (ServerManager*)req->user_ctx;
-    doc["led_state"] = manager->ledState;
-    doc["led_r"] = manager->ledColorR;
-    doc["led_g"] = manager->ledColorG;
-    doc["led_b"] = manager->ledColorB;
-    
-    char json[768];
-    serializeJson(doc, json, sizeof(json));
-    send_json_response(req, json);
-    return ESP_OK;
+    json.add("led_state", manager->ledState);
+    json.add("led_r", (unsigned int)manager->ledColorR);
+    json.add("led_g", (unsigned int)manager->ledColorG);
+    json.add("led_b", (unsigned int)manager->ledColorB);
+    json.endObject();
+    
+    return json.finish() == ESP_OK ? ESP_OK : ESP_FAIL;
 }
 
-esp_err_t ServerManager::api_device_name_handler(httpd_req_t *req) {
-    REQUIRE_AUTH();
+// Aggregated dashboard data - one coherent snapshot instead of four separate requests
+esp_err_t ServerManager::api_dashboard_handler(httpd_req_t *req) {
+    ServerManager* manager = (ServerManager*)req->user_ctx;
+    DashboardSnapshot snap;
+    manager->getDashboardSnapshot(&snap);
+    
+    char etag[16];
+    snprintf(etag, sizeof(etag), "\"%08lx\"", (unsigned long)snap.version);
+    httpd_resp_set_hdr(req, "ETag", etag);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    
+    // Unchanged since the client's last fetch: no body at all
+    char if_none_match[48] = {0};
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", if_none_match, sizeof(if_none_match)) == ESP_OK &&
+        strstr(if_none_match, etag) != NULL) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        httpd_resp_send(req, NULL, 0);
+        return ESP_OK;
+    }
+    
+    return StatusFields::send(req, snap, StatusFields::VIEW_DASHBOARD) == ESP_OK ? ESP_OK : ESP_FAIL;
+}
+
+// Binary status for machine clients - fixed little-endian record, see StatusBinary.h
+esp_err_t ServerManager::api_status_bin_handler(httpd_req_t *req) {
+    ServerManager* manager = (ServerManager*)req->user_ctx;
+    DashboardSnapshot snap;
+    manager->getDashboardSnapshot(&snap);
+    
+    uint8_t record[StatusBinary::RECORD_SIZE];
+    size_t len = StatusBinary::encode(snap, (uint32_t)(esp_timer_get_time() / 1000000),
+                                      esp_get_free_heap_size(), esp_get_minimum_free_heap_size(), record);
     
+    httpd_resp_set_type(req, "application/octet-stream");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    return httpd_resp_send(req, (const char*)record, len) == ESP_OK ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t ServerManager::api_device_name_handler(httpd_req_t *req) {
     char buf[128];
     int ret = httpd_req_recv(req, buf, sizeof(buf));
     if (ret <= 0) {
@@ -718,13 +895,7 @@ esp_err_t ServerManager::api_device_name_handler(httpd_req_t *req) {
         }
     } else {
         // Parse JSON
-        DynamicJsonDocument doc(128);
-        deserializeJson(doc, buf);
-        
-        const char* newName = doc["name"];
-        if (newName) {
-            strncpy(name, newName, sizeof(name) - 1);
-        }
+        JsonLookup::getString(buf, "name", name, sizeof(name));
     }
     
     if (strlen(name) > 0) {
@@ -738,32 +909,28 @@ esp_err_t ServerManager::api_device_name_handler(httpd_req_t *req) {
 }
 
 esp_err_t ServerManager::api_reboot_handler(httpd_req_t *req) {
-    REQUIRE_AUTH();
-    
     send_json_response(req, "{\"success\":true,\"message\":\"Rebooting...\"}");
-    vTaskDelay(pdMS_TO_TICKS(1000));
-    esp_restart();
+    schedule_restart(1000);
     return ESP_OK;
 }
 
 esp_err_t ServerManager::api_wifi_status_handler(httpd_req_t *req) {
-    REQUIRE_AUTH();
-    
-    DynamicJsonDocument doc(512);
+    JsonStreamWriter json(req);
+    json.beginObject();
     bool isConnected = wifi.isConnected();
-    doc["connected"] = isConnected;
+    json.add("connected", isConnected);
     
     char ip[16];
     wifi.getLocalIP(ip, sizeof(ip));
-    doc["ip"] = ip;
+    json.add("ip", ip);
     
     if (isConnected) {
         // Get SSID
         wifi_config_t wifi_config;
         if (esp_wifi_get_config(WIFI_IF_STA, &wifi_config) == ESP_OK) {
-            doc["ssid"] = (char*)wifi_config.sta.ssid;
+            json.add("ssid", (const char*)wifi_config.sta.ssid);
         } else {
-            doc["ssid"] = "Unknown";
+            json.add("ssid", "Unknown");
         }
         
         // Get MAC address
@@ -772,17 +939,17 @@ esp_err_t ServerManager::api_wifi_status_handler(httpd_req_t *req) {
         char macStr[18];
         snprintf(macStr, sizeof(macStr), "%02X:%02X:%02X:%02X:%02X:%02X",
                  mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
-        doc["mac"] = macStr;
+        json.add("mac", macStr);
         
         // Get RSSI (signal strength)
         wifi_ap_record_t ap_info;
         if (esp_wifi_sta_get_ap_info(&ap_info) == ESP_OK) {
-            doc["rssi"] = ap_info.rssi;
+            json.add("rssi", (int)ap_info.rssi);
         } else {
-            doc["rssi"] = 0;
+            json.add("rssi", 0);
         }
     } else {
-        doc["ssid"] = "Nicht verbunden";
+        json.add("ssid", "Nicht verbunden");
         
         // Still provide MAC even when disconnected
         uint8_t mac[6];
@@ -790,59 +957,38 @@ esp_err_t ServerManager::api_wifi_status_handler(httpd_req_t *req) {
         char macStr[18];
         snprintf(macStr, sizeof(macStr), "%02X:%02X:%02X:%02X:%02X:%02X",
                  mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
-        doc["mac"] = macStr;
-        doc["rssi"] = 0;
+        json.add("mac", macStr);
+        json.add("rssi", 0);
     }
+    json.endObject();
     
-    char json[512];
-    serializeJson(doc, json, sizeof(json));
-    send_json_response(req, json);
-    return ESP_OK;
+    return json.finish() == ESP_OK ? ESP_OK : ESP_FAIL;
 }
 
 esp_err_t ServerManager::api_pwm_status_handler(httpd_req_t *req) {
-    REQUIRE_AUTH();
-    
-    DynamicJsonDocument doc(512);
-    doc["manual_mode"] = Config::MANUAL_PWM_MODE;
-    doc["manual_freq"] = Config::MANUAL_PWM_FREQ;
-    doc["manual_duty"] = Config::MANUAL_PWM_DUTY;
-    doc["frequency"] = Config::MANUAL_PWM_FREQ; // Alias
-    doc["duty"] = Config::MANUAL_PWM_DUTY; // Alias
-    doc["auto_pwm"] = Config::AUTO_PWM_ENABLED;
-    
-    // Get current duty cycle from hardware
-    uint32_t duty_raw = ledc_get_duty(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_0);
-    doc["duty_raw"] = duty_raw;
-    doc["duty_percent"] = (duty_raw * 100) / 255;
-    
-    char json[512];
-    serializeJson(doc, json, sizeof(json));
-    send_json_response(req, json);
-    return ESP_OK;
+    ServerManager* manager = (ServerManager*)req->user_ctx;
+    DashboardSnapshot snap;
+    manager->getDashboardSnapshot(&snap);
+    return StatusFields::send(req, snap, StatusFields::VIEW_PWM) == ESP_OK ? ESP_OK : ESP_FAIL;
 }
 
 esp_err_t ServerManager::api_pwm_control_handler(httpd_req_t *req) {
-    REQUIRE_AUTH();
-    
     char buf[256];
-    int ret = httpd_req_recv(req, buf, sizeof(buf));
+    int ret = httpd_req_recv(req, buf, sizeof(buf) - 1);
     if (ret <= 0) {
         httpd_resp_send_500(req);
         return ESP_FAIL;
     }
+    buf[ret] = '\0';
     
-    DynamicJsonDocument doc(256);
-    deserializeJson(doc, buf);
-    
-    if (doc.containsKey("duty")) {
-        int duty = doc["duty"];
+    if (JsonLookup::has(buf, "duty")) {
+        int duty = (int)JsonLookup::getNumber(buf, "duty");
         duty = (duty * 255) / 100; // Convert 0-100 to 0-255
         serverInstance->setPWMDuty(duty);
     }
     
-    if (doc.containsKey("frequency")) {
-        uint32_t freq = doc["frequency"];
+    if (JsonLookup::has(buf, "frequency")) {
+        uint32_t freq = (uint32_t)JsonLookup::getNumber(buf, "frequency");
         serverInstance->reconfigurePWM(freq);
         Config::saveManualPWMSettings(freq, Config::MANUAL_PWM_DUTY);
     }
@@ -860,17 +1006,17 @@ esp_err_t ServerManager::api_login_handler(httpd_req_t *req) {
     }
     buf[ret] = '\0';
     
-    DynamicJsonDocument doc(256);
-    deserializeJson(doc, buf);
-    
-    const char* password = doc["password"];
+    char password[64];
+    bool hasPassword = JsonLookup::getString(buf, "password", password, sizeof(password));
     
     // Validate password against Config::WEB_PASSWORD
-    bool isValid = (password != nullptr && strcmp(password, Config::WEB_PASSWORD) == 0);
+    bool isValid = (hasPassword && strcmp(password, Config::WEB_PASSWORD) == 0);
     
     if (isValid) {
-        // Generate new token
-        char* token = generate_token();
+        // Start a new session; other clients stay logged in
+        char token[SessionStore::TOKEN_STRING_SIZE];
+        sessions.create(token, sizeof(token));
+        set_session_cookie(req, token);
         
         // Return token in JSON response
         char response[128];
@@ -887,7 +1033,7 @@ esp_err_t ServerManager::api_login_handler(httpd_req_t *req) {
 esp_err_t ServerManager::login_post_handler(httpd_req_t *req) {
     ESP_LOGI(TAG, "[DEBUG] ===== LOGIN POST HANDLER CALLED =====");
     ESP_LOGI(TAG, "[DEBUG] URI: %s", req->uri);
-    ESP_LOGI(TAG, "[DEBUG] Content length: %d", req->content_len);
+    ESP_LOGI(TAG, "[DEBUG] Content length: %u", (unsigned)req->content_len);
     
     char buf[256];
     int ret = httpd_req_recv(req, buf, sizeof(buf) - 1);
@@ -913,7 +1059,7 @@ esp_err_t ServerManager::login_post_handler(httpd_req_t *req) {
             
             // URL decode (replace %20 with space, etc.)
             // Simple implementation - just check for basic chars
-            ESP_LOGI(TAG, "Password received (length: %d)", strlen(password));
+            ESP_LOGI(TAG, "Password received (length: %u)", (unsigned)strlen(password));
         }
     }
     
@@ -923,8 +1069,10 @@ esp_err_t ServerManager::login_post_handler(httpd_req_t *req) {
     if (isValid) {
         ESP_LOGI(TAG, "Login successful");
         
-        // Generate new token
-        char* token = generate_token();
+        // Start a new session; other clients stay logged in
+        char token[SessionStore::TOKEN_STRING_SIZE];
+        sessions.create(token, sizeof(token));
+        set_session_cookie(req, token);
         
         // Redirect to index page with token
         char location[128];
@@ -944,102 +1092,106 @@ esp_err_t ServerManager::login_post_handler(httpd_req_t *req) {
     return ESP_OK;
 }
 
-// System Info Handler
-esp_err_t ServerManager::api_system_info_handler(httpd_req_t *req) {
-    DynamicJsonDocument doc(1024);
-    
+// System Info Handler - chip/device part cached per config version
+void ServerManager::render_system_info_static(JsonStreamWriter& json, void* ctx) {
     esp_chip_info_t chip_info;
     esp_chip_info(&chip_info);
     
     // Basic chip info
-    doc["chipModel"] = "ESP32-PICO-D4";
-    doc["chipCores"] = chip_info.cores;
-    doc["chipRevision"] = chip_info.revision;
+    json.add("chipModel", "ESP32-PICO-D4");
+    json.add("chipCores", (unsigned int)chip_info.cores);
+    json.add("chipRevision", (unsigned int)chip_info.revision);
     
     uint32_t flash_size;
     esp_flash_get_size(NULL, &flash_size);
-    doc["flashSize"] = flash_size / (1024 * 1024);
-    
-    doc["freeHeap"] = esp_get_free_heap_size();
-    doc["minFreeHeap"] = esp_get_minimum_free_heap_size();
-    doc["uptime"] = esp_timer_get_time() / 1000000;
-    doc["sdkVersion"] = esp_get_idf_version();
+    json.add("flashSize", (unsigned long)(flash_size / (1024 * 1024)));
+    json.add("sdkVersion", esp_get_idf_version());
     
     // Device info needed by HTML
-    doc["device_name"] = Config::DEVICE_NAME;
-    doc["firmware_version"] = Config::FIRMWARE_VERSION;
+    json.add("device_name", Config::DEVICE_NAME);
+    json.add("firmware_version", Config::FIRMWARE_VERSION);
+    
+    // Get MAC address
+    uint8_t mac[6];
+    esp_wifi_get_mac(WIFI_IF_STA, mac);
+    char macStr[18];
+    snprintf(macStr, sizeof(macStr), "%02X:%02X:%02X:%02X:%02X:%02X",
+             mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    json.add("wifi_mac", macStr);
+}
+
+void ServerManager::render_system_info_volatile(JsonStreamWriter& json, void* ctx) {
+    json.add("freeHeap", (unsigned long)esp_get_free_heap_size());
+    json.add("minFreeHeap", (unsigned long)esp_get_minimum_free_heap_size());
+    json.add("uptime", (long long)(esp_timer_get_time() / 1000000));
     
     // WiFi info
     char ip[16];
     wifi.getLocalIP(ip, sizeof(ip));
-    doc["wifi_ip"] = ip;
-    doc["wifi_connected"] = wifi.isConnected();
+    json.add("wifi_ip", ip);
+    json.add("wifi_connected", wifi.isConnected());
     
     // Get WiFi SSID and other info
     wifi_config_t wifi_config;
     if (esp_wifi_get_config(WIFI_IF_STA, &wifi_config) == ESP_OK) {
-        doc["wifi_ssid"] = (char*)wifi_config.sta.ssid;
+        json.add("wifi_ssid", (const char*)wifi_config.sta.ssid);
     } else {
-        doc["wifi_ssid"] = "Unknown";
+        json.add("wifi_ssid", "Unknown");
     }
     
-    // Get MAC address
-    uint8_t mac[6];
-    esp_wifi_get_mac(WIFI_IF_STA, mac);
-    char macStr[18];
-    snprintf(macStr, sizeof(macStr), "%02X:%02X:%02X:%02X:%02X:%02X",
-             mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
-    doc["wifi_mac"] = macStr;
-    
     // Get RSSI (signal strength)
     wifi_ap_record_t ap_info;
     if (esp_wifi_sta_get_ap_info(&ap_info) == ESP_OK) {
-        doc["wifi_rssi"] = ap_info.rssi;
+        json.add("wifi_rssi", (int)ap_info.rssi);
     } else {
-        doc["wifi_rssi"] = 0;
+        json.add("wifi_rssi", 0);
     }
     
     // MQTT status
-    doc["mqtt_connected"] = mqttManager.isConnected();
-    
-    char response[1024];
-    serializeJson(doc, response, sizeof(response));
-    send_json_response(req, response);
-    return ESP_OK;
+    json.add("mqtt_connected", mqttManager.isConnected());
 }
 
-// Settings Handler - returns all current settings
-esp_err_t ServerManager::api_settings_handler(httpd_req_t *req) {
-    REQUIRE_AUTH();
-    
-    DynamicJsonDocument doc(1536);
-    doc["device_name"] = Config::DEVICE_NAME;
-    doc["deviceName"] = Config::DEVICE_NAME; // Alias for compatibility
-    doc["mqtt_server"] = Config::MQTT_SERVER;
-    doc["mqttServer"] = Config::MQTT_SERVER; // Alias
-    doc["mqtt_port"] = Config::MQTT_PORT;
-    doc["mqttPort"] = Config::MQTT_PORT; // Alias
-    doc["mqtt_user"] = Config::MQTT_USER;
-    doc["mqttUser"] = Config::MQTT_USER; // Alias
-    doc["mqtt_pass"] = ""; // Don't send password back
-    doc["mqttPass"] = ""; // Alias
-    doc["mqtt_topic"] = Config::MQTT_TOPIC;
-    doc["mqttTopic"] = Config::MQTT_TOPIC; // Alias
-    doc["mqtt_connected"] = mqttManager.isConnected();
-    doc["manual_freq"] = Config::MANUAL_PWM_FREQ;
-    doc["manualPWMFreq"] = Config::MANUAL_PWM_FREQ; // Alias
-    doc["manual_duty"] = Config::MANUAL_PWM_DUTY;
-    doc["manualPWMDuty"] = Config::MANUAL_PWM_DUTY; // Alias
-    doc["manual_mode"] = Config::MANUAL_PWM_MODE;
-    doc["manualPWMMode"] = Config::MANUAL_PWM_MODE; // Alias
-    doc["auto_pwm"] = Config::AUTO_PWM_ENABLED;
-    doc["autoPWMEnabled"] = Config::AUTO_PWM_ENABLED; // Alias
-    doc["startTemp"] = Config::TEMP_START;
-    doc["tempStart"] = Config::TEMP_START; // Alias
-    doc["maxTemp"] = Config::TEMP_MAX;
-    doc["tempMax"] = Config::TEMP_MAX; // Alias
-    doc["temp_unit"] = Config::TEMP_UNIT;
-    doc["tempUnit"] = Config::TEMP_UNIT; // Alias
+esp_err_t ServerManager::api_system_info_handler(httpd_req_t *req) {
+    ServerManager* manager = (ServerManager*)req->user_ctx;
+    esp_err_t err = manager->responseCache.send(req, "/api/system-info", render_system_info_static,
+                                                render_system_info_volatile, manager);
+    return err == ESP_OK ? ESP_OK : ESP_FAIL;
+}
+
+// Settings Handler - returns all current settings, Config part cached per config version
+void ServerManager::render_settings_static(JsonStreamWriter& json, void* ctx) {
+    json.add("device_name", Config::DEVICE_NAME);
+    json.add("deviceName", Config::DEVICE_NAME); // Alias for compatibility
+    json.add("mqtt_server", Config::MQTT_SERVER);
+    json.add("mqttServer", Config::MQTT_SERVER); // Alias
+    json.add("mqtt_port", (unsigned int)Config::MQTT_PORT);
+    json.add("mqttPort", (unsigned int)Config::MQTT_PORT); // Alias
+    json.add("mqtt_user", Config::MQTT_USER);
+    json.add("mqttUser", Config::MQTT_USER); // Alias
+    json.add("mqtt_pass", ""); // Don't send password back
+    json.add("mqttPass", ""); // Alias
+    json.add("mqtt_topic", Config::MQTT_TOPIC);
+    json.add("mqttTopic", Config::MQTT_TOPIC); // Alias
+    json.add("manual_freq", (unsigned long)Config::MANUAL_PWM_FREQ);
+    json.add("manualPWMFreq", (unsigned long)Config::MANUAL_PWM_FREQ); // Alias
+    json.add("manual_duty", (unsigned int)Config::MANUAL_PWM_DUTY);
+    json.add("manualPWMDuty", (unsigned int)Config::MANUAL_PWM_DUTY); // Alias
+    json.add("manual_mode", Config::MANUAL_PWM_MODE);
+    json.add("manualPWMMode", Config::MANUAL_PWM_MODE); // Alias
+    json.add("auto_pwm", Config::AUTO_PWM_ENABLED);
+    json.add("autoPWMEnabled", Config::AUTO_PWM_ENABLED); // Alias
+    json.add("startTemp", Config::TEMP_START);
+    json.add("tempStart", Config::TEMP_START); // Alias
+    json.add("maxTemp", Config::TEMP_MAX);
+    json.add("tempMax", Config::TEMP_MAX); // Alias
+    json.add("temp_unit", Config::TEMP_UNIT);
+    json.add("tempUnit", Config::TEMP_UNIT); // Alias
+    json.add("firmware_version", Config::FIRMWARE_VERSION);
+    json.add("last_password_change", "Nie"); // TODO: Track this in NVS
+}
+
+void ServerManager::render_settings_volatile(JsonStreamWriter& json, void* ctx) {
+    json.add("mqtt_connected", mqttManager.isConnected());
     
     // Get actual AP status from WiFi mode
     wifi_mode_t mode;
@@ -1047,40 +1199,261 @@ esp_err_t ServerManager::api_settings_handler(httpd_req_t *req) {
     if (esp_wifi_get_mode(&mode) == ESP_OK) {
         ap_running = (mode == WIFI_MODE_AP || mode == WIFI_MODE_APSTA);
     }
-    doc["ap_enabled"] = ap_running;
-    doc["apEnabled"] = ap_running; // Alias
+    json.add("ap_enabled", ap_running);
+    json.add("apEnabled", ap_running); // Alias
     
     // LED state and color
+    ServerManager* manager = (ServerManager*)ctx;
+    json.add("led_state", manager->ledState);
+    json.add("led_r", (unsigned int)manager->ledColorR);
+    json.add("led_g", (unsigned int)manager->ledColorG);
+    json.add("led_b", (unsigned int)manager->ledColorB);
+}
+
+esp_err_t ServerManager::api_settings_handler(httpd_req_t *req) {
+    ServerManager* manager = (ServerManager*)req->user_ctx;
+    esp_err_t err = manager->responseCache.send(req, "/api/settings", render_settings_static,
+                                                render_settings_volatile, manager);
+    return err == ESP_OK ? ESP_OK : ESP_FAIL;
+}
+
+// Request body as an OTAManager::ReadCallback source
+struct UploadStream {
+    httpd_req_t* req;
+    size_t remaining;
+    uint32_t timeouts;   // Total retried timeouts, for the log
+};
+
+// A timeout only means the client is slow (WiFi retries, busy PC); each one
+// already waited recv_wait_timeout, so give up after a few in a row
+static const uint8_t UPLOAD_MAX_TIMEOUTS = 5;
+
+static size_t read_upload(uint8_t* buffer, size_t size, void* userData) {
+    UploadStream* stream = (UploadStream*)userData;
+    if (stream->remaining == 0) return 0;
+    
+    size_t toRead = (size > stream->remaining) ? stream->remaining : size;
+    uint8_t consecutive = 0;
+    while (true) {
+        int ret = httpd_req_recv(stream->req, (char*)buffer, toRead);
+        if (ret > 0) {
+            stream->remaining -= ret;
+            return ret;
+        }
+        if (ret == HTTPD_SOCK_ERR_TIMEOUT && ++consecutive <= UPLOAD_MAX_TIMEOUTS) {
+            stream->timeouts++;
+            ESP_LOGW(TAG, "Upload receive timeout, retrying (%u/%u)", consecutive, UPLOAD_MAX_TIMEOUTS);
+            continue;
+        }
+        ESP_LOGE(TAG, "Upload receive failed (%d), %u bytes outstanding", ret, (unsigned)stream->remaining);
+        return 0;
+    }
+}
+
+// Batch Settings Handler - validates every section first, then persists all of them
+// with one NVS commit and notifies PWM/MQTT/LED once. Only sections present are changed:
+// {"device_name":"..", "mqtt":{"server","port","user","pass","topic"}, "temp_unit":"..",
+//  "temp_mapping":{"start","max"}, "auto_pwm":bool,
+//  "manual_pwm":{"mode":bool,"frequency","duty"}, "led":{"state":bool,"r","g","b"}}
+esp_err_t ServerManager::api_settings_batch_handler(httpd_req_t *req) {
     ServerManager* manager = (ServerManager*)req->user_ctx;
-    doc["led_state"] = manager->ledState;
-    doc["led_r"] = manager->ledColorR;
-    doc["led_g"] = manager->ledColorG;
-    doc["led_b"] = manager->ledColorB;
     
-    doc["firmware_version"] = Config::FIRMWARE_VERSION;
-    doc["last_password_change"] = "Nie"; // TODO: Track this in NVS
+    char buf[1024];
+    if (req->content_len <= 0 || req->content_len >= sizeof(buf)) {
+        httpd_resp_set_status(req, "413 Payload Too Large");
+        send_json_response(req, "{\"success\":false,\"error\":\"Body missing or too large\"}");
+        return ESP_OK;
+    }
+    // Bounded like uploads: a client that stalls mid-body must not hold the server task
+    UploadStream stream = { req, req->content_len, 0 };
+    size_t received = 0;
+    while (stream.remaining > 0) {
+        size_t ret = read_upload((uint8_t*)buf + received, sizeof(buf) - 1 - received, &stream);
+        if (ret == 0) {
+            httpd_resp_set_status(req, "408 Request Timeout");
+            send_json_response(req, "{\"success\":false,\"error\":\"Body incomplete\"}");
+            return ESP_FAIL;
+        }
+        received += ret;
+    }
+    buf[received] = '\0';
     
-    char response[1536];
-    serializeJson(doc, response, sizeof(response));
-    send_json_response(req, response);
+    Config::Batch batch;
+    memset(&batch, 0, sizeof(batch));
+    const char* invalid = nullptr;
+    
+    if (JsonLookup::has(buf, "device_name")) {
+        batch.hasDeviceName = JsonLookup::getString(buf, "device_name", batch.deviceName, sizeof(batch.deviceName));
+        if (!batch.hasDeviceName) invalid = "device_name";
+    }
+    
+    if (JsonLookup::has(buf, "mqtt")) {
+        batch.hasMQTT = JsonLookup::getString(buf, "mqtt.server", batch.mqttServer, sizeof(batch.mqttServer));
+        double port = JsonLookup::getNumber(buf, "mqtt.port", 1883);
+        batch.mqttPort = (port >= 1 && port <= 65535) ? (uint16_t)port : 0;
+        JsonLookup::getString(buf, "mqtt.user", batch.mqttUser, sizeof(batch.mqttUser));
+        if (JsonLookup::has(buf, "mqtt.pass")) {
+            batch.hasMQTTPass = JsonLookup::getString(buf, "mqtt.pass", batch.mqttPass, sizeof(batch.mqttPass));
+            if (!batch.hasMQTTPass) invalid = "mqtt";
+        }
+        JsonLookup::getString(buf, "mqtt.topic", batch.mqttTopic, sizeof(batch.mqttTopic));
+        if (!batch.hasMQTT) invalid = "mqtt";
+    }
+    
+    if (JsonLookup::has(buf, "temp_unit")) {
+        batch.hasTempUnit = JsonLookup::getString(buf, "temp_unit", batch.tempUnit, sizeof(batch.tempUnit));
+        if (!batch.hasTempUnit) invalid = "temp_unit";
+    }
+    
+    if (JsonLookup::has(buf, "temp_mapping")) {
+        batch.hasTempMapping = true;
+        batch.tempStart = JsonLookup::getNumber(buf, "temp_mapping.start", Config::TEMP_START);
+        batch.tempMax = JsonLookup::getNumber(buf, "temp_mapping.max", Config::TEMP_MAX);
+    }
+    
+    if (JsonLookup::has(buf, "auto_pwm")) {
+        batch.hasAutoPWM = true;
+        batch.autoPWM = JsonLookup::getBool(buf, "auto_pwm");
+    }
+    
+    if (JsonLookup::has(buf, "manual_pwm.mode")) {
+        batch.hasManualMode = true;
+        batch.manualMode = JsonLookup::getBool(buf, "manual_pwm.mode");
+    }
+    if (JsonLookup::has(buf, "manual_pwm.frequency") || JsonLookup::has(buf, "manual_pwm.duty")) {
+        batch.hasManualPWM = true;
+        double freq = JsonLookup::getNumber(buf, "manual_pwm.frequency", Config::MANUAL_PWM_FREQ);
+        double duty = JsonLookup::getNumber(buf, "manual_pwm.duty", Config::MANUAL_PWM_DUTY);
+        batch.manualFreq = (freq >= 1 && freq <= 40000000) ? (uint32_t)freq : 0;
+        batch.manualDuty = (duty >= 0 && duty <= 100) ? (uint8_t)duty : 101;
+    }
+    
+    // LED is runtime state only (not persisted), validated together with the rest
+    bool hasLed = JsonLookup::has(buf, "led");
+    bool ledState = JsonLookup::getBool(buf, "led.state", manager->ledState);
+    double rgb[3] = {
+        JsonLookup::getNumber(buf, "led.r", manager->ledColorR),
+        JsonLookup::getNumber(buf, "led.g", manager->ledColorG),
+        JsonLookup::getNumber(buf, "led.b", manager->ledColorB)
+    };
+    for (int i = 0; i < 3 && hasLed; i++) {
+        if (rgb[i] < 0 || rgb[i] > 255) invalid = "led";
+    }
+    
+    if (invalid == nullptr) {
+        invalid = Config::validateBatch(batch);
+    }
+    if (invalid != nullptr) {
+        ESP_LOGW(TAG, "Batch rejected, invalid section: %s", invalid);
+        httpd_resp_set_status(req, "400 Bad Request");
+        JsonStreamWriter json(req);
+        json.beginObject();
+        json.add("success", false);
+        json.add("error", "Invalid value");
+        json.add("field", invalid);
+        json.endObject();
+        json.finish();
+        return ESP_OK;
+    }
+    
+    Config::BatchResult saved = Config::saveBatch(batch);
+    if (saved != Config::BATCH_SAVED) {
+        httpd_resp_set_status(req, "500 Internal Server Error");
+        send_json_response(req, saved == Config::BATCH_PARTIAL
+            ? "{\"success\":false,\"error\":\"Settings only partially saved, reload to see the stored values\"}"
+            : "{\"success\":false,\"error\":\"Could not save settings\"}");
+        return ESP_OK;
+    }
+    
+    // Dependent subsystems, each notified once
+    if (batch.hasManualPWM) {
+        manager->reconfigurePWM(batch.manualFreq);  // Also restores the duty in manual mode
+    }
+    if (hasLed && manager->ledManager) {
+        manager->ledState = ledState;
+        manager->ledColorR = (uint8_t)rgb[0];
+        manager->ledColorG = (uint8_t)rgb[1];
+        manager->ledColorB = (uint8_t)rgb[2];
+        if (ledState) {
+            manager->ledManager->setColor(manager->ledColorR, manager->ledColorG, manager->ledColorB);
+        } else {
+            manager->ledManager->off();
+        }
+    }
+    if (batch.hasMQTT) {
+        manager->workers.submitJob(mqtt_reconnect_job, NULL);
+    }
+    
+    ESP_LOGI(TAG, "Batch settings applied");
+    send_json_response(req, "{\"success\":true}");
     return ESP_OK;
 }
 
+// Server Stats Handler - admission, session and per-socket counters, for monitoring
+esp_err_t ServerManager::api_server_stats_handler(httpd_req_t *req) {
+    ServerManager* manager = (ServerManager*)req->user_ctx;
+    AdmissionControl::Stats stats;
+    manager->admission.getStats(&stats);
+    
+    JsonStreamWriter json(req);
+    json.beginObject();
+    json.add("served", (unsigned long)stats.served);
+    json.add("served_priority", (unsigned long)stats.servedPriority);
+    json.add("rejected_client", (unsigned long)stats.rejectedClient);
+    json.add("rejected_global", (unsigned long)stats.rejectedGlobal);
+    json.add("tracked_clients", (unsigned int)stats.trackedClients);
+    json.add("sessions", (unsigned int)sessions.activeCount());
+    json.add("free_heap", (unsigned long)esp_get_free_heap_size());
+    
+    ConnectionTable::Stats conn_stats;
+    manager->connections.getStats(&conn_stats);
+    json.beginObject("connections");
+    json.add("open", (unsigned int)conn_stats.open);
+    json.add("peak_open", (unsigned int)conn_stats.peakOpen);
+    json.add("capacity", (unsigned int)ConnectionTable::CAPACITY);
+    json.add("opened", (unsigned long)conn_stats.opened);
+    json.add("closed", (unsigned long)conn_stats.closed);
+    json.add("reaped", (unsigned long)conn_stats.reaped);
+    json.add("untracked", (unsigned long)conn_stats.rejected);
+    json.add("requests_per_connection",
+             conn_stats.closed > 0 ? (double)conn_stats.requestsClosed / conn_stats.closed : 0.0);
+    json.add("auth_checks", (unsigned long)conn_stats.authChecks);
+    json.add("auth_cache_hits", (unsigned long)conn_stats.authHits);
+    json.endObject();
+    
+    ConnectionTable::Connection open[ConnectionTable::CAPACITY];
+    uint8_t count = manager->connections.list(open, ConnectionTable::CAPACITY);
+    int64_t now = esp_timer_get_time();
+    json.beginArray("sockets");
+    for (uint8_t i = 0; i < count; i++) {
+        char peer[16];
+        const uint8_t* a = (const uint8_t*)&open[i].peer;
+        snprintf(peer, sizeof(peer), "%u.%u.%u.%u", a[0], a[1], a[2], a[3]);
+        json.beginObject();
+        json.add("fd", open[i].fd);
+        json.add("peer", peer);
+        json.add("age_s", (unsigned long)((now - open[i].openedUs) / 1000000));
+        json.add("idle_s", (unsigned long)((now - open[i].lastActiveUs) / 1000000));
+        json.add("requests", (unsigned long)open[i].requests);
+        json.add("auth_cache_hits", (unsigned long)open[i].authHits);
+        json.endObject();
+    }
+    json.endArray();
+    json.endObject();
+    
+    return json.finish() == ESP_OK ? ESP_OK : ESP_FAIL;
+}
+
 // Restart Handler
 esp_err_t ServerManager::api_restart_handler(httpd_req_t *req) {
-    REQUIRE_AUTH();
-    
     ESP_LOGI(TAG, "Restart requested");
     send_json_response(req, "{\"success\":true,\"message\":\"Restarting...\"}");
-    vTaskDelay(pdMS_TO_TICKS(1000));
-    esp_restart();
+    schedule_restart(1000);
     return ESP_OK;
 }
 
 // Factory Reset Handler
 esp_err_t ServerManager::api_factory_reset_handler(httpd_req_t *req) {
-    REQUIRE_AUTH();
-    
     ESP_LOGI(TAG, "Factory reset requested");
     
     // Clear NVS
@@ -1093,129 +1466,50 @@ esp_err_t ServerManager::api_factory_reset_handler(httpd_req_t *req) {
     }
     
     send_json_response(req, "{\"success\":true,\"message\":\"Factory reset complete. Restarting...\"}");
-    vTaskDelay(pdMS_TO_TICKS(1000));
-    esp_restart();
+    schedule_restart(1000);
     return ESP_OK;
 }
 
-// WiFi Scan Handler
+// WiFi Scan Handler - answers from the background scan cache, never blocks
 esp_err_t ServerManager::api_wifi_scan_handler(httpd_req_t *req) {
-    REQUIRE_AUTH();
-    
-    ESP_LOGI(TAG, "WiFi scan requested");
-    
-    // Check if WiFi is initialized
-    wifi_mode_t mode;
-    esp_err_t err = esp_wifi_get_mode(&mode);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to get WiFi mode: %s", esp_err_to_name(err));
-        send_json_response(req, "{\"networks\":[],\"error\":\"WiFi not initialized\"}");
-        return ESP_OK;
-    }
-    
-    ESP_LOGI(TAG, "WiFi mode before scan: %d (AP=2, STA=1, APSTA=3)", mode);
-    
-    // Ensure WiFi is in STA or APSTA mode for scanning
-    if (mode == WIFI_MODE_AP) {
-        // Create STA interface if it doesn't exist
-        esp_netif_t* sta_netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
-        if (sta_netif == NULL) {
-            ESP_LOGI(TAG, "Creating STA network interface for scanning");
-            sta_netif = esp_netif_create_default_wifi_sta();
-        }
-        
-        // Switch to APSTA mode temporarily to allow scanning
-        ESP_LOGI(TAG, "Switching from AP to APSTA mode for scanning");
-        err = esp_wifi_set_mode(WIFI_MODE_APSTA);
-        if (err != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to set APSTA mode: %s", esp_err_to_name(err));
-            send_json_response(req, "{\"networks\":[],\"error\":\"Failed to enable STA mode\"}");
-            return ESP_OK;
+    // ?refresh=1 asks for a new scan unless the cache is only a few seconds old
+    uint32_t max_age_ms = 30000;
+    char query[64];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        char refresh[4];
+        if (httpd_query_key_value(query, "refresh", refresh, sizeof(refresh)) == ESP_OK && refresh[0] == '1') {
+            max_age_ms = 5000;
         }
-        vTaskDelay(pdMS_TO_TICKS(500)); // Give it time to switch and initialize
-    }
-    
-    // Start WiFi scan optimized for APSTA mode
-    // Use ACTIVE scan with minimal time to reduce disruption
-    wifi_scan_config_t scan_config = {
-        .ssid = NULL,
-        .bssid = NULL,
-        .channel = 0,
-        .show_hidden = false,
-        .scan_type = WIFI_SCAN_TYPE_ACTIVE,
-        .scan_time = {
-            .active = {
-                .min = 0,      // Minimal time per channel
-                .max = 120     // Max 120ms per channel (reduced from default 300ms)
-            },
-            .passive = 0
-        },
-        .home_chan_dwell_time = 30  // Return to AP channel every 30ms to service clients
-    };
-    
-    err = esp_wifi_scan_start(&scan_config, true);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "WiFi scan failed: %s", esp_err_to_name(err));
-        char error_response[256];
-        snprintf(error_response, sizeof(error_response), 
-                 "{\"networks\":[],\"error\":\"Scan failed: %s\"}", 
-                 esp_err_to_name(err));
-        send_json_response(req, error_response);
-        return ESP_OK;
-    }
-    
-    // Get scan results
-    uint16_t ap_count = 0;
-    esp_wifi_scan_get_ap_num(&ap_count);
-    
-    ESP_LOGI(TAG, "WiFi scan found %d networks", ap_count);
-    
-    if (ap_count == 0) {
-        send_json_response(req, "{\"networks\":[]}");
-        return ESP_OK;
-    }
-    
-    // Limit to 20 networks to avoid memory issues
-    if (ap_count > 20) {
-        ap_count = 20;
-    }
-    
-    wifi_ap_record_t* ap_records = (wifi_ap_record_t*)malloc(sizeof(wifi_ap_record_t) * ap_count);
-    if (ap_records == NULL) {
-        ESP_LOGE(TAG, "Failed to allocate memory for scan results");
-        send_json_response(req, "{\"networks\":[]}");
-        return ESP_OK;
-    }
-    
-    esp_wifi_scan_get_ap_records(&ap_count, ap_records);
-    
-    // Build JSON response
-    DynamicJsonDocument doc(4096);
-    JsonArray networks = doc.createNestedArray("networks");
-    
-    for (int i = 0; i < ap_count; i++) {
-        JsonObject network = networks.createNestedObject();
-        network["ssid"] = (char*)ap_records[i].ssid;
-        network["rssi"] = ap_records[i].rssi;
-        network["channel"] = ap_records[i].primary;
-        network["encryption"] = ap_records[i].authmode;
-        network["security"] = (ap_records[i].authmode != WIFI_AUTH_OPEN);
     }
-    
-    free(ap_records);
-    
-    char response[4096];
-    size_t len = serializeJson(doc, response, sizeof(response));
-    ESP_LOGI(TAG, "WiFi scan response length: %d bytes", len);
-    send_json_response(req, response);
-    
-    return ESP_OK;
+    wifi.requestScanIfStale(max_age_ms);
+    
+    WiFiScanEntry networks[WiFiManager::SCAN_CACHE_SIZE];
+    int64_t age_ms = -1;
+    bool scanning = false;
+    uint8_t count = wifi.getScanResults(networks, WiFiManager::SCAN_CACHE_SIZE, &age_ms, &scanning);
+    
+    JsonStreamWriter json(req);
+    json.beginObject();
+    json.beginArray("networks");
+    for (uint8_t i = 0; i < count; i++) {
+        json.beginObject();
+        json.add("ssid", networks[i].ssid);
+        json.add("rssi", (int)networks[i].rssi);
+        json.add("channel", (unsigned int)networks[i].channel);
+        json.add("encryption", (unsigned int)networks[i].authmode);
+        json.add("security", networks[i].authmode != WIFI_AUTH_OPEN);
+        json.endObject();
+    }
+    json.endArray();
+    json.add("age_ms", (long long)age_ms);  // -1: no scan finished yet
+    json.add("scanning", scanning);
+    json.endObject();
+    
+    return json.finish() == ESP_OK ? ESP_OK : ESP_FAIL;
 }
 
 // WiFi Connect Handler (POST /wifi_connect)
 esp_err_t ServerManager::api_wifi_connect_handler(httpd_req_t *req) {
-    REQUIRE_AUTH();
-    
     char buf[256];
     int ret = httpd_req_recv(req, buf, sizeof(buf) - 1);
     if (ret <= 0) {
@@ -1257,14 +1551,8 @@ esp_err_t ServerManager::api_wifi_connect_handler(httpd_req_t *req) {
     
     // Fallback to JSON
     if (strlen(ssid) == 0) {
-        DynamicJsonDocument doc(512);
-        deserializeJson(doc, buf);
-        
-        const char* s = doc["ssid"];
-        const char* p = doc["password"];
-        
-        if (s) strncpy(ssid, s, sizeof(ssid) - 1);
-        if (p) strncpy(password, p, sizeof(password) - 1);
+        JsonLookup::getString(buf, "ssid", ssid, sizeof(ssid));
+        JsonLookup::getString(buf, "password", password, sizeof(password));
     }
     
     if (strlen(ssid) > 0 && strlen(password) > 0) {
@@ -1293,18 +1581,7 @@ esp_err_t ServerManager::api_wifi_connect_handler(httpd_req_t *req) {
         esp_wifi_connect();
         
         // Schedule ESP32 restart after sending response to ensure clean DHCP connection
-        xTaskCreate(
-            [](void* param) {
-                vTaskDelay(pdMS_TO_TICKS(3000));  // Wait 3 seconds for response to be sent
-                ESP_LOGI(TAG, "Restarting ESP32 for clean WiFi connection...");
-                esp_restart();
-            },
-            "wifi_restart",
-            2048,
-            NULL,
-            5,
-            NULL
-        );
+        schedule_restart(3000);
         
         // Return simple success message that HTML expects
         httpd_resp_send(req, "OK", 2);
@@ -1317,8 +1594,6 @@ esp_err_t ServerManager::api_wifi_connect_handler(httpd_req_t *req) {
 
 // WiFi Disconnect Handler
 esp_err_t ServerManager::api_wifi_disconnect_handler(httpd_req_t *req) {
-    REQUIRE_AUTH();
-    
     ESP_LOGI(TAG, "WiFi disconnect requested");
     wifi.disconnect();
     httpd_resp_send(req, "OK", 2);
@@ -1327,8 +1602,6 @@ esp_err_t ServerManager::api_wifi_disconnect_handler(httpd_req_t *req) {
 
 // WiFi Clear Handler
 esp_err_t ServerManager::api_wifi_clear_handler(httpd_req_t *req) {
-    REQUIRE_AUTH();
-    
     ESP_LOGI(TAG, "Clear WiFi credentials requested");
     wifi.clearCredentials();
     wifi.disconnect();
@@ -1338,8 +1611,6 @@ esp_err_t ServerManager::api_wifi_clear_handler(httpd_req_t *req) {
 
 // Toggle AP Handler
 esp_err_t ServerManager::api_toggle_ap_handler(httpd_req_t *req) {
-    REQUIRE_AUTH();
-    
     char buf[128];
     int ret = httpd_req_recv(req, buf, sizeof(buf) - 1);
     if (ret <= 0) {
@@ -1363,9 +1634,7 @@ esp_err_t ServerManager::api_toggle_ap_handler(httpd_req_t *req) {
         }
     } else {
         // Try JSON format
-        DynamicJsonDocument doc(256);
-        deserializeJson(doc, buf);
-        enable = doc["enable"];
+        enable = JsonLookup::getBool(buf, "enable");
     }
     
     ESP_LOGI(TAG, "Toggle AP: %s", enable ? "ON" : "OFF");
@@ -1414,8 +1683,6 @@ esp_err_t ServerManager::api_toggle_ap_handler(httpd_req_t *req) {
 
 // MQTT Settings Handler
 esp_err_t ServerManager::api_mqtt_settings_handler(httpd_req_t *req) {
-    REQUIRE_AUTH();
-    
     char buf[512];
     int ret = httpd_req_recv(req, buf, sizeof(buf) - 1);
     if (ret <= 0) {
@@ -1480,20 +1747,13 @@ esp_err_t ServerManager::api_mqtt_settings_handler(httpd_req_t *req) {
         }
     } else {
         // Parse JSON
-        DynamicJsonDocument doc(512);
-        deserializeJson(doc, buf);
+        uint16_t prt = (uint16_t)JsonLookup::getNumber(buf, "port");
         
-        const char* srv = doc["server"];
-        uint16_t prt = doc["port"];
-        const char* usr = doc["user"];
-        const char* pwd = doc["pass"];
-        const char* tpc = doc["topic"];
-        
-        if (srv) strncpy(server, srv, sizeof(server) - 1);
+        JsonLookup::getString(buf, "server", server, sizeof(server));
         if (prt > 0) snprintf(port_str, sizeof(port_str), "%d", prt);
-        if (usr) strncpy(user, usr, sizeof(user) - 1);
-        if (pwd) strncpy(pass, pwd, sizeof(pass) - 1);
-        if (tpc) strncpy(topic, tpc, sizeof(topic) - 1);
+        JsonLookup::getString(buf, "user", user, sizeof(user));
+        JsonLookup::getString(buf, "pass", pass, sizeof(pass));
+        JsonLookup::getString(buf, "topic", topic, sizeof(topic));
     }
     
     // Validate and save
@@ -1502,7 +1762,8 @@ esp_err_t ServerManager::api_mqtt_settings_handler(httpd_req_t *req) {
         Config::saveMQTTSettings(server, port, user, pass, strlen(topic) > 0 ? topic : Config::MQTT_TOPIC);
         
         ESP_LOGI(TAG, "MQTT settings saved, reconnecting...");
-        mqttManager.reconnect();
+        // reconnect() waits 2 s for socket cleanup - keep that off the httpd task
+        serverInstance->workers.submitJob(mqtt_reconnect_job, NULL);
         
         httpd_resp_send(req, "OK", 2);
         return ESP_OK;
@@ -1514,8 +1775,6 @@ esp_err_t ServerManager::api_mqtt_settings_handler(httpd_req_t *req) {
 
 // MQTT Test Handler
 esp_err_t ServerManager::api_mqtt_test_handler(httpd_req_t *req) {
-    REQUIRE_AUTH();
-    
     ESP_LOGI(TAG, "MQTT test connection requested");
     
     // Check current connection status
@@ -1538,8 +1797,6 @@ esp_err_t ServerManager::api_mqtt_test_handler(httpd_req_t *req) {
 
 // Manual PWM Mode Handler
 esp_err_t ServerManager::api_manual_pwm_mode_handler(httpd_req_t *req) {
-    REQUIRE_AUTH();
-    
     char buf[128];
     int ret = httpd_req_recv(req, buf, sizeof(buf) - 1);
     if (ret <= 0) {
@@ -1563,9 +1820,7 @@ esp_err_t ServerManager::api_manual_pwm_mode_handler(httpd_req_t *req) {
         }
     } else {
         // Try JSON format
-        DynamicJsonDocument doc(256);
-        deserializeJson(doc, buf);
-        enabled = doc["enabled"];
+        enabled = JsonLookup::getBool(buf, "enabled");
     }
     
     Config::saveManualPWMMode(enabled);
@@ -1577,8 +1832,6 @@ esp_err_t ServerManager::api_manual_pwm_mode_handler(httpd_req_t *req) {
 
 // Manual PWM Settings Handler
 esp_err_t ServerManager::api_manual_pwm_settings_handler(httpd_req_t *req) {
-    REQUIRE_AUTH();
-    
     char buf[256];
     int ret = httpd_req_recv(req, buf, sizeof(buf) - 1);
     if (ret <= 0) {
@@ -1619,17 +1872,14 @@ esp_err_t ServerManager::api_manual_pwm_settings_handler(httpd_req_t *req) {
     
     // Fallback to JSON if form parsing failed
     if (freq == 0 && duty == 0) {
-        DynamicJsonDocument doc(512);
-        deserializeJson(doc, buf);
-        
-        if (doc.containsKey("frequency")) {
-            freq = doc["frequency"];
+        if (JsonLookup::has(buf, "frequency")) {
+            freq = JsonLookup::getNumber(buf, "frequency");
         }
         
-        if (doc.containsKey("dutyCycle")) {
-            duty = doc["dutyCycle"];
-        } else if (doc.containsKey("duty")) {
-            duty = doc["duty"];
+        if (JsonLookup::has(buf, "dutyCycle")) {
+            duty = JsonLookup::getNumber(buf, "dutyCycle");
+        } else if (JsonLookup::has(buf, "duty")) {
+            duty = JsonLookup::getNumber(buf, "duty");
         }
     }
     
@@ -1650,8 +1900,6 @@ esp_err_t ServerManager::api_manual_pwm_settings_handler(httpd_req_t *req) {
 
 // Temperature Mapping Handler
 esp_err_t ServerManager::api_temp_mapping_handler(httpd_req_t *req) {
-    REQUIRE_AUTH();
-    
     char buf[256];
     int ret = httpd_req_recv(req, buf, sizeof(buf) - 1);
     if (ret <= 0) {
@@ -1690,11 +1938,8 @@ esp_err_t ServerManager::api_temp_mapping_handler(httpd_req_t *req) {
     
     // Fallback to JSON
     if (tempStart == 0 && tempMax == 0) {
-        DynamicJsonDocument doc(512);
-        deserializeJson(doc, buf);
-        
-        tempStart = doc["tempStart"];
-        tempMax = doc["tempMax"];
+        tempStart = JsonLookup::getNumber(buf, "tempStart");
+        tempMax = JsonLookup::getNumber(buf, "tempMax");
     }
     
     if (tempStart > 0 && tempMax > tempStart) {
@@ -1709,93 +1954,29 @@ esp_err_t ServerManager::api_temp_mapping_handler(httpd_req_t *req) {
 
 // Temperature Mapping Status Handler
 esp_err_t ServerManager::api_temp_mapping_status_handler(httpd_req_t *req) {
-    REQUIRE_AUTH();
-    
-    DynamicJsonDocument doc(384);
-    doc["tempStart"] = Config::TEMP_START;
-    doc["startTemp"] = Config::TEMP_START; // Alias
-    doc["tempMax"] = Config::TEMP_MAX;
-    doc["maxTemp"] = Config::TEMP_MAX; // Alias
-    doc["autoPWMEnabled"] = Config::AUTO_PWM_ENABLED;
-    doc["auto_pwm"] = Config::AUTO_PWM_ENABLED; // Alias
-    
-    char response[384];
-    serializeJson(doc, response, sizeof(response));
-    send_json_response(req, response);
-    return ESP_OK;
+    JsonStreamWriter json(req);
+    json.beginObject();
+    json.add("tempStart", Config::TEMP_START);
+    json.add("startTemp", Config::TEMP_START); // Alias
+    json.add("tempMax", Config::TEMP_MAX);
+    json.add("maxTemp", Config::TEMP_MAX); // Alias
+    json.add("autoPWMEnabled", Config::AUTO_PWM_ENABLED);
+    json.add("auto_pwm", Config::AUTO_PWM_ENABLED); // Alias
+    json.endObject();
+    
+    return json.finish() == ESP_OK ? ESP_OK : ESP_FAIL;
 }
 
-// KMeter Status Handler
+// KMeter Status Handler - served from the dashboard snapshot, supports ?fields= and ?since=
 esp_err_t ServerManager::api_kmeter_status_handler(httpd_req_t *req) {
-    REQUIRE_AUTH();
-    
-    ServerManager* serverInstance = (ServerManager*)req->user_ctx;
-    
-    DynamicJsonDocument doc(1024);
-    
-    // Get temperature data - use external Arduino sensor if available
-    bool initialized = false;
-    bool isReady = false;
-    float tempC = 0.0f;
-    float tempF = 0.0f;
-    float internalTemp = 0.0f;
-    uint8_t errorStatus = 0;
-    
-    if (serverInstance->externalSensor) {
-        // Use Arduino KMeterISO sensor (hybrid mode)
-        tempC = serverInstance->externalSensor->getTemperatureCelsius();
-        tempF = serverInstance->externalSensor->getTemperatureFahrenheit();
-        internalTemp = serverInstance->externalSensor->getInternalTemperature();
-        initialized = (tempC > -100.0f);  // Valid temperature indicates initialized sensor
-        isReady = initialized;
-        errorStatus = 0;  // Arduino library doesn't expose error status directly
-    } else {
-        // Fallback to old ESP-IDF KMeterManager
-        KMeterManager* kmeter = serverInstance->getKMeterManager();
-        initialized = kmeter->isInitialized();
-        isReady = kmeter->isReady();
-        tempC = kmeter->getTemperatureCelsius();
-        tempF = kmeter->getTemperatureFahrenheit();
-        internalTemp = kmeter->getInternalTemperature();
-        errorStatus = kmeter->getErrorStatus();
-    }
-    
-    doc["connected"] = initialized;
-    doc["initialized"] = initialized;
-    doc["ready"] = isReady;
-    doc["temperature"] = tempC; // Legacy field
-    doc["temperature_celsius"] = tempC;
-    doc["temperatureF"] = tempF;
-    doc["temperature_fahrenheit"] = tempF;
-    doc["internal_temperature"] = internalTemp;
-    doc["unit"] = Config::TEMP_UNIT;
-    doc["error_status"] = errorStatus;
-    
-    // Status string with detailed error info
-    if (!initialized) {
-        doc["status_string"] = "Sensor nicht initialisiert";
-    } else if (isReady) {
-        doc["status_string"] = "Bereit";
-    } else {
-        char statusBuf[64];
-        snprintf(statusBuf, sizeof(statusBuf), "Fehler (Status: %d)", errorStatus);
-        doc["status_string"] = statusBuf;
-    }
-    
-    // I2C configuration
-    doc["i2c_address"] = "0x66";
-    doc["read_interval"] = 5000; // 5 seconds
-    
-    char response[768];
-    serializeJson(doc, response, sizeof(response));
-    send_json_response(req, response);
-    return ESP_OK;
+    ServerManager* manager = (ServerManager*)req->user_ctx;
+    DashboardSnapshot snap;
+    manager->getDashboardSnapshot(&snap);
+    return StatusFields::send(req, snap, StatusFields::VIEW_KMETER) == ESP_OK ? ESP_OK : ESP_FAIL;
 }
 
 // KMeter Config Handler
 esp_err_t ServerManager::api_kmeter_config_handler(httpd_req_t *req) {
-    REQUIRE_AUTH();
-    
     char buf[256];
     int ret = httpd_req_recv(req, buf, sizeof(buf) - 1);
     if (ret <= 0) {
@@ -1848,11 +2029,8 @@ esp_err_t ServerManager::api_kmeter_config_handler(httpd_req_t *req) {
     }
     
     // Fallback to JSON
-    DynamicJsonDocument doc(512);
-    deserializeJson(doc, buf);
-    
-    const char* unit = doc["unit"];
-    if (unit) {
+    char unit[16];
+    if (JsonLookup::getString(buf, "unit", unit, sizeof(unit))) {
         Config::saveTempUnit(unit);
         httpd_resp_send(req, "OK", 2);
         return ESP_OK;
@@ -1864,8 +2042,6 @@ esp_err_t ServerManager::api_kmeter_config_handler(httpd_req_t *req) {
 
 // LED Toggle Handler
 esp_err_t ServerManager::api_led_toggle_handler(httpd_req_t *req) {
-    REQUIRE_AUTH();
-    
     ServerManager* manager = (ServerManager*)req->user_ctx;
     
     char buf[128];
@@ -1915,11 +2091,8 @@ esp_err_t ServerManager::api_led_toggle_handler(httpd_req_t *req) {
     }
     
     // Try JSON format as fallback
-    DynamicJsonDocument doc(256);
-    deserializeJson(doc, buf);
-    
-    if (doc.containsKey("enabled")) {
-        bool enabled = doc["enabled"];
+    if (JsonLookup::has(buf, "enabled")) {
+        bool enabled = JsonLookup::getBool(buf, "enabled");
         ESP_LOGI(TAG, "LED: %s", enabled ? "ON" : "OFF");
         
         if (manager->ledManager) {
@@ -1932,8 +2105,8 @@ esp_err_t ServerManager::api_led_toggle_handler(httpd_req_t *req) {
         }
     }
     
-    if (doc.containsKey("color")) {
-        const char* color = doc["color"];
+    char color[16];
+    if (JsonLookup::getString(buf, "color", color, sizeof(color))) {
         ESP_LOGI(TAG, "LED color: %s", color);
         // Note: Color is typically set via RGB values in api_led_color_handler
     }
@@ -1943,8 +2116,6 @@ esp_err_t ServerManager::api_led_toggle_handler(httpd_req_t *req) {
 }
 
 esp_err_t ServerManager::api_led_color_handler(httpd_req_t *req) {
-    REQUIRE_AUTH();
-    
     ServerManager* manager = (ServerManager*)req->user_ctx;
     
     char buf[128];
@@ -1993,8 +2164,6 @@ esp_err_t ServerManager::api_led_color_handler(httpd_req_t *req) {
 
 // Change Password Handler
 esp_err_t ServerManager::api_change_password_handler(httpd_req_t *req) {
-    REQUIRE_AUTH();
-    
     char buf[256];
     int ret = httpd_req_recv(req, buf, sizeof(buf) - 1);
     if (ret <= 0) {
@@ -2029,14 +2198,8 @@ esp_err_t ServerManager::api_change_password_handler(httpd_req_t *req) {
     
     // Fallback to JSON with camelCase
     if (strlen(currentPassword) == 0 || strlen(newPassword) == 0) {
-        DynamicJsonDocument doc(512);
-        deserializeJson(doc, buf);
-        
-        const char* currPwd = doc["currentPassword"];
-        const char* newPwd = doc["newPassword"];
-        
-        if (currPwd) strncpy(currentPassword, currPwd, sizeof(currentPassword) - 1);
-        if (newPwd) strncpy(newPassword, newPwd, sizeof(newPassword) - 1);
+        JsonLookup::getString(buf, "currentPassword", currentPassword, sizeof(currentPassword));
+        JsonLookup::getString(buf, "newPassword", newPassword, sizeof(newPassword));
     }
     
     if (strlen(currentPassword) == 0 || strlen(newPassword) == 0) {
@@ -2053,20 +2216,27 @@ esp_err_t ServerManager::api_change_password_handler(httpd_req_t *req) {
     // Save new password
     Config::saveWebPassword(newPassword);
     
+    // Tokens issued under the old password (possibly leaked) end; this client stays logged in
+    char token[SessionStore::TOKEN_STRING_SIZE + 1] = {0};
+    extract_token(req, token, sizeof(token));
+    sessions.clearExcept(token);
+    ESP_LOGI(TAG, "Password changed, other sessions ended");
+    
     httpd_resp_send(req, "OK", 2);
     return ESP_OK;
 }
 
 // Logout Handler
 esp_err_t ServerManager::api_logout_handler(httpd_req_t *req) {
-    REQUIRE_AUTH();
-    
-    ESP_LOGI(TAG, "Logout - invalidating token");
+    ESP_LOGI(TAG, "Logout - ending session");
     
-    // Invalidate the current token
-    current_token[0] = '\0';
-    token_created = 0;
+    // Only this client's session ends
+    char token[SessionStore::TOKEN_STRING_SIZE + 1] = {0};
+    if (extract_token(req, token, sizeof(token))) {
+        sessions.revoke(token);
+    }
     
+    httpd_resp_set_hdr(req, "Set-Cookie", "token=; Path=/; Max-Age=0; HttpOnly; SameSite=Strict");
     httpd_resp_set_status(req, "302 Found");
     httpd_resp_set_hdr(req, "Location", "/login.html");
     httpd_resp_send(req, NULL, 0);
@@ -2074,391 +2244,389 @@ esp_err_t ServerManager::api_logout_handler(httpd_req_t *req) {
     return ESP_OK;
 }
 
-// OTA TAR Update Handler - uploads single .tar file with streaming
+// OTA TAR Update Handler - update.tar streamed through OTAPackage: each
+// received chunk is parsed and flashed before the next is read, so RAM use
+// is one receive buffer plus the flash ring, whatever the archive holds
 esp_err_t ServerManager::api_ota_tar_handler(httpd_req_t *req) {
-    REQUIRE_AUTH();
-    
     ServerManager* self = (ServerManager*)req->user_ctx;
-    ESP_LOGI(TAG, "OTA TAR Upload started, content length: %d", req->content_len);
+    ESP_LOGI(TAG, "OTA TAR Upload started, content length: %u", (unsigned)req->content_len);
     ESP_LOGI(TAG, "Free heap before upload: %d bytes", esp_get_free_heap_size());
     
     if (req->content_len == 0 || req->content_len > 10 * 1024 * 1024) { // Max 10MB
-        ESP_LOGE(TAG, "Invalid content length: %d", req->content_len);
+        ESP_LOGE(TAG, "Invalid content length: %u", (unsigned)req->content_len);
         httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid file size (max 10MB)");
         return ESP_FAIL;
     }
     
-    // Process TAR directly from HTTP stream without saving to file
-    // This saves memory and SPIFFS space
+    if (self->otaManager.isBusy() || self->otaManager.isPackageOpen()) {
+        httpd_resp_set_status(req, "409 Conflict");
+        send_json_response(req, "{\"status\":\"error\",\"message\":\"Another update is in progress\"}");
+        return ESP_FAIL;
+    }
     
-    const size_t BUFFER_SIZE = 32 * 1024; // 32KB buffer
+    // Both live on the heap: the parser state is too large for a handler stack
+    const size_t BUFFER_SIZE = 4096;
     uint8_t* buffer = (uint8_t*)malloc(BUFFER_SIZE);
-    if (!buffer) {
+    OTAPackage* package = new (std::nothrow) OTAPackage(self->otaManager);
+    if (!buffer || !package) {
         ESP_LOGE(TAG, "Failed to allocate buffer");
+        free(buffer);
+        delete package;
         httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
         return ESP_FAIL;
     }
     
-    size_t totalReceived = 0;
-    size_t remaining = req->content_len;
-    bool firmwareFound = false;
-    bool spiffsFound = false;
+    UploadStream stream = { req, req->content_len, 0 };
     bool success = true;
-    
-    typedef struct {
-        char name[100];
-        char mode[8];
-        char uid[8];
-        char gid[8];
-        char size[12];
-        char mtime[12];
-        char checksum[8];
-        char typeflag;
-        char linkname[100];
-        char magic[6];
-        char version[2];
-        char uname[32];
-        char gname[32];
-        char devmajor[8];
-        char devminor[8];
-        char prefix[155];
-        char padding[12];
-    } TarHeader;
-    
-    auto parseOctal = [](const char* str, size_t len) -> size_t {
-        size_t result = 0;
-        for (size_t i = 0; i < len && str[i] != '\0' && str[i] != ' '; i++) {
-            if (str[i] >= '0' && str[i] <= '7') {
-                result = result * 8 + (str[i] - '0');
-            }
-        }
-        return result;
-    };
-    
-    while (remaining > 0 && success) {
-        // Read TAR header (512 bytes)
-        if (remaining < 512) break;
-        
-        TarHeader header;
-        int ret = httpd_req_recv(req, (char*)&header, 512);
-        if (ret != 512) {
-            ESP_LOGE(TAG, "Failed to read TAR header");
-            success = false;
-            break;
-        }
-        totalReceived += 512;
-        remaining -= 512;
-        
-        // Check for end of archive (zero block)
-        bool allZero = true;
-        uint8_t* headerBytes = (uint8_t*)&header;
-        for (size_t i = 0; i < 512; i++) {
-            if (headerBytes[i] != 0) {
-                allZero = false;
-                break;
-            }
-        }
-        if (allZero) {
-            ESP_LOGI(TAG, "Reached end of TAR archive");
+    bool interrupted = false;
+    while (success && stream.remaining > 0) {
+        size_t received = read_upload(buffer, BUFFER_SIZE, &stream);
+        if (received == 0) {
+            interrupted = true;
             break;
         }
-        
-        // Verify TAR magic
-        if (strncmp(header.magic, "ustar", 5) != 0) {
-            ESP_LOGW(TAG, "Invalid TAR magic, skipping");
-            // Skip this block and continue
-            continue;
-        }
-        
-        // Parse file size
-        size_t fileSize = parseOctal(header.size, 12);
-        ESP_LOGI(TAG, "Found file: %s (%u bytes)", header.name, fileSize);
-        
-        // Calculate padded size (512-byte aligned)
-        size_t paddedSize = (fileSize + 511) & ~511;
-        
-        if (header.typeflag == '0' || header.typeflag == '\0') {
-            // Regular file
-            if (strcmp(header.name, "firmware.bin") == 0) {
-                ESP_LOGI(TAG, "Processing firmware.bin (%u bytes)...", fileSize);
-                
-                // Stream firmware directly to flash without loading into RAM
-                struct StreamContext {
-                    httpd_req_t* req;
-                    size_t remaining;
-                    size_t paddedSize;
-                };
-                
-                StreamContext ctx;
-                ctx.req = req;
-                ctx.remaining = fileSize;
-                ctx.paddedSize = paddedSize;
-                
-                auto readFirmware = [](uint8_t* buffer, size_t size, void* userData) -> size_t {
-                    StreamContext* ctx = (StreamContext*)userData;
-                    if (ctx->remaining == 0) return 0;
-                    
-                    size_t toRead = (size > ctx->remaining) ? ctx->remaining : size;
-                    int ret = httpd_req_recv(ctx->req, (char*)buffer, toRead);
-                    if (ret <= 0) return 0;
-                    
-                    ctx->remaining -= ret;
-                    return ret;
-                };
-                
-                if (self->otaManager.flashFirmwareStreaming(fileSize, readFirmware, &ctx)) {
-                    firmwareFound = true;
-                    ESP_LOGI(TAG, "Firmware flashed successfully");
-                    
-                    // Skip padding if any
-                    size_t padding = paddedSize - fileSize;
-                    if (padding > 0 && remaining >= padding) {
-                        int ret = httpd_req_recv(req, (char*)buffer, padding);
-                        if (ret > 0) {
-                            totalReceived += ret;
-                            remaining -= ret;
-                        }
-                    }
-                    // Update counters for data already read
-                    totalReceived += fileSize - ctx.remaining;
-                    remaining -= (fileSize - ctx.remaining);
-                } else {
-                    ESP_LOGE(TAG, "Firmware flash failed");
-                    success = false;
-                }
-                
-            } else if (strcmp(header.name, "spiffs.bin") == 0) {
-                ESP_LOGI(TAG, "Processing spiffs.bin (%u bytes)...", fileSize);
-                
-                // Stream SPIFFS directly to flash without loading into RAM
-                struct StreamContext {
-                    httpd_req_t* req;
-                    size_t remaining;
-                    size_t paddedSize;
-                };
-                
-                StreamContext ctx;
-                ctx.req = req;
-                ctx.remaining = fileSize;
-                ctx.paddedSize = paddedSize;
-                
-                auto readSPIFFS = [](uint8_t* buffer, size_t size, void* userData) -> size_t {
-                    StreamContext* ctx = (StreamContext*)userData;
-                    if (ctx->remaining == 0) return 0;
-                    
-                    size_t toRead = (size > ctx->remaining) ? ctx->remaining : size;
-                    int ret = httpd_req_recv(ctx->req, (char*)buffer, toRead);
-                    if (ret <= 0) return 0;
-                    
-                    ctx->remaining -= ret;
-                    return ret;
-                };
-                
-                if (self->otaManager.flashSPIFFSStreaming(fileSize, readSPIFFS, &ctx)) {
-                    spiffsFound = true;
-                    ESP_LOGI(TAG, "SPIFFS flashed successfully");
-                    
-                    // Skip padding if any
-                    size_t padding = paddedSize - fileSize;
-                    if (padding > 0 && remaining >= padding) {
-                        int ret = httpd_req_recv(req, (char*)buffer, padding);
-                        if (ret > 0) {
-                            totalReceived += ret;
-                            remaining -= ret;
-                        }
-                    }
-                    // Update counters for data already read
-                    totalReceived += fileSize - ctx.remaining;
-                    remaining -= (fileSize - ctx.remaining);
-                } else {
-                    ESP_LOGE(TAG, "SPIFFS flash failed");
-                    success = false;
-                }
-                
-            } else {
-                // Skip unknown file
-                ESP_LOGI(TAG, "Skipping file: %s", header.name);
-                size_t toSkip = paddedSize;
-                while (toSkip > 0 && remaining > 0) {
-                    size_t chunkSize = (toSkip > BUFFER_SIZE) ? BUFFER_SIZE : toSkip;
-                    ret = httpd_req_recv(req, (char*)buffer, chunkSize);
-                    if (ret <= 0) break;
-                    toSkip -= ret;
-                    totalReceived += ret;
-                    remaining -= ret;
-                }
-            }
-        } else {
-            // Skip non-regular files
-            size_t toSkip = paddedSize;
-            while (toSkip > 0 && remaining > 0) {
-                size_t chunkSize = (toSkip > BUFFER_SIZE) ? BUFFER_SIZE : toSkip;
-                ret = httpd_req_recv(req, (char*)buffer, chunkSize);
-                if (ret <= 0) break;
-                toSkip -= ret;
-                totalReceived += ret;
-                remaining -= ret;
-            }
-        }
-        
-        if (!success) break;
+        success = package->push(buffer, received);
+    }
+    if (success && !interrupted) {
+        success = package->finish();
+    } else {
+        success = false;
     }
     
-    free(buffer);
-    
-    if (!firmwareFound && !spiffsFound) {
-        ESP_LOGE(TAG, "No firmware.bin or spiffs.bin found in TAR");
-        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid TAR content");
-        return ESP_FAIL;
+    if (stream.timeouts > 0) {
+        ESP_LOGI(TAG, "TAR upload needed %u receive retries", (unsigned)stream.timeouts);
     }
+    char error[96];
+    snprintf(error, sizeof(error), "%s", interrupted ? "Upload interrupted" : package->getError());
+    delete package;   // Aborts a member left half-flashed by an interrupted upload
+    free(buffer);
     
     if (success) {
         ESP_LOGI(TAG, "OTA Update successful, rebooting in 3 seconds...");
-        const char* response = "{\"status\":\"success\",\"message\":\"Update successful, rebooting...\"}";
-        httpd_resp_set_type(req, "application/json");
-        httpd_resp_send(req, response, strlen(response));
+        send_json_response(req, "{\"status\":\"success\",\"message\":\"Update successful, rebooting...\"}");
         
-        vTaskDelay(pdMS_TO_TICKS(3000));
-        esp_restart();
+        schedule_restart(3000);
         
         return ESP_OK;
     } else {
-        ESP_LOGE(TAG, "OTA Update failed");
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Update failed");
+        ESP_LOGE(TAG, "OTA Update failed: %s", error);
+        JsonStreamWriter json(req);
+        json.beginObject();
+        json.add("status", "error");
+        json.add("message", error);
+        json.endObject();
+        json.finish();
         return ESP_FAIL;
     }
 }
 
-// OTA Firmware Update Handler
-esp_err_t ServerManager::api_ota_firmware_handler(httpd_req_t *req) {
-    REQUIRE_AUTH();
-    
+// Firmware or filesystem image as the raw request body. It goes to flash
+// through OTAManager's fixed buffer ring, so RAM use does not depend on the
+// image size.
+esp_err_t ServerManager::stream_upload(httpd_req_t *req, bool filesystem) {
     ServerManager* self = (ServerManager*)req->user_ctx;
-    ESP_LOGI(TAG, "OTA Firmware Upload started, content length: %d", req->content_len);
+    const char* what = filesystem ? "Filesystem" : "Firmware";
+    ESP_LOGI(TAG, "OTA %s Upload started, content length: %u", what, (unsigned)req->content_len);
     
     if (req->content_len == 0 || req->content_len > 2 * 1024 * 1024) { // Max 2MB
-        ESP_LOGE(TAG, "Invalid content length: %d", req->content_len);
+        ESP_LOGE(TAG, "Invalid content length: %u", (unsigned)req->content_len);
         httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid file size");
         return ESP_FAIL;
     }
     
-    // Allocate buffer for firmware
-    uint8_t* fwBuffer = (uint8_t*)malloc(req->content_len);
-    if (!fwBuffer) {
-        ESP_LOGE(TAG, "Failed to allocate memory for firmware upload");
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
+    if (self->otaManager.isBusy() || self->otaManager.isPackageOpen()) {
+        httpd_resp_set_status(req, "409 Conflict");
+        send_json_response(req, "{\"status\":\"error\",\"message\":\"Another update is in progress\"}");
         return ESP_FAIL;
     }
     
-    // Read entire file
-    size_t received = 0;
-    while (received < req->content_len) {
-        int ret = httpd_req_recv(req, (char*)(fwBuffer + received), req->content_len - received);
-        if (ret <= 0) {
-            if (ret == HTTPD_SOCK_ERR_TIMEOUT) {
-                continue;
-            }
-            free(fwBuffer);
-            ESP_LOGE(TAG, "Failed to receive firmware data");
-            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Upload failed");
-            return ESP_FAIL;
-        }
-        received += ret;
-    }
-    
-    ESP_LOGI(TAG, "Received complete firmware: %d bytes", received);
-    
-    // Flash firmware
-    bool success = self->otaManager.flashFirmwareDirect(fwBuffer, received);
+    UploadStream stream = { req, req->content_len, 0 };
+    bool success = filesystem
+        ? self->otaManager.flashSPIFFSStreaming(req->content_len, read_upload, &stream)
+        : self->otaManager.flashFirmwareStreaming(req->content_len, read_upload, &stream);
     
-    free(fwBuffer);
+    if (stream.timeouts > 0) {
+        ESP_LOGI(TAG, "%s upload needed %u receive retries", what, (unsigned)stream.timeouts);
+    }
     
     if (success) {
-        ESP_LOGI(TAG, "Firmware Update successful, rebooting in 3 seconds...");
-        const char* response = "{\"status\":\"success\",\"message\":\"Firmware update successful, rebooting...\"}";
-        httpd_resp_set_type(req, "application/json");
-        httpd_resp_send(req, response, strlen(response));
+        ESP_LOGI(TAG, "%s Update successful, rebooting in 3 seconds...", what);
+        send_json_response(req, filesystem
+            ? "{\"status\":\"success\",\"message\":\"Filesystem update successful, rebooting...\"}"
+            : "{\"status\":\"success\",\"message\":\"Firmware update successful, rebooting...\"}");
         
-        vTaskDelay(pdMS_TO_TICKS(3000));
-        esp_restart();
+        schedule_restart(3000);
         
         return ESP_OK;
     } else {
-        ESP_LOGE(TAG, "Firmware Update failed: %s", self->otaManager.getLastError());
-        char errorMsg[512];
-        snprintf(errorMsg, sizeof(errorMsg), 
-                 "{\"status\":\"error\",\"message\":\"%s\"}", 
-                 self->otaManager.getLastError());
-        httpd_resp_set_type(req, "application/json");
-        httpd_resp_send(req, errorMsg, strlen(errorMsg));
+        ESP_LOGE(TAG, "%s Update failed: %s", what, self->otaManager.getLastError());
+        JsonStreamWriter json(req);
+        json.beginObject();
+        json.add("status", "error");
+        json.add("message", self->otaManager.getLastError());
+        json.endObject();
+        json.finish();
         return ESP_FAIL;
     }
 }
 
+// OTA Firmware Update Handler
+esp_err_t ServerManager::api_ota_firmware_handler(httpd_req_t *req) {
+    return stream_upload(req, false);
+}
+
 // OTA Filesystem Update Handler
 esp_err_t ServerManager::api_ota_filesystem_handler(httpd_req_t *req) {
-    REQUIRE_AUTH();
-    
+    return stream_upload(req, true);
+}
+
+// OTA status - progress of a running streaming flash, for polling during an upload
+esp_err_t ServerManager::api_ota_status_handler(httpd_req_t *req) {
+    ServerManager* self = (ServerManager*)req->user_ctx;
+    OTAManager::Status status;
+    self->otaManager.getStatus(&status);
+    
+    static const char* const states[] = { "idle", "running", "done", "failed" };
+    static const char* const targets[] = { "none", "firmware", "filesystem" };
+    
+    JsonStreamWriter json(req);
+    json.beginObject();
+    json.add("state", states[status.state]);
+    json.add("target", targets[status.target]);
+    json.add("written", (unsigned long)status.written);
+    json.add("total", (unsigned long)status.total);
+    json.add("progress", (unsigned int)status.progress);
+    if (status.state == OTAManager::STATE_FAILED) {
+        json.add("error", status.error);
+    }
+    json.endObject();
+    return json.finish();
+}
+
+// Pull mode (see OTAPull): settings and what the background task is doing
+esp_err_t ServerManager::api_ota_pull_handler(httpd_req_t *req) {
+    ServerManager* self = (ServerManager*)req->user_ctx;
+    OTAPull::Status status;
+    self->otaPull.getStatus(&status);
+    
+    static const char* const states[] = { "disabled", "waiting", "checking", "downloading", "installed" };
+    
+    JsonStreamWriter json(req);
+    json.beginObject();
+    json.add("url", Config::OTA_PULL_URL);
+    json.add("interval", (unsigned int)Config::OTA_PULL_INTERVAL);
+    json.add("rate", (unsigned int)Config::OTA_PULL_RATE);
+    json.add("state", states[status.state]);
+    json.add("next_check", (unsigned long)status.nextCheckSeconds);
+    json.add("offered", status.offered);
+    json.add("received", (unsigned long)status.received);
+    json.add("total", (unsigned long)status.total);
+    json.add("resumes", (unsigned int)status.resumes);
+    json.add("result", status.result);
+    json.endObject();
+    return json.finish();
+}
+
+// {"url":"http://host:8070/manifest.json", "interval":minutes, "rate":KB/s, "check":bool}
+// Missing fields keep their value; "url":"" switches the pull mode off.
+esp_err_t ServerManager::api_ota_pull_settings_handler(httpd_req_t *req) {
     ServerManager* self = (ServerManager*)req->user_ctx;
-    ESP_LOGI(TAG, "OTA Filesystem Upload started, content length: %d", req->content_len);
     
-    if (req->content_len == 0 || req->content_len > 2 * 1024 * 1024) { // Max 2MB
-        ESP_LOGE(TAG, "Invalid content length: %d", req->content_len);
-        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid file size");
+    char buf[512];
+    int ret = httpd_req_recv(req, buf, sizeof(buf) - 1);
+    if (ret <= 0) {
+        httpd_resp_send_500(req);
         return ESP_FAIL;
     }
+    buf[ret] = '\0';
     
-    // Allocate buffer for SPIFFS
-    uint8_t* fsBuffer = (uint8_t*)malloc(req->content_len);
-    if (!fsBuffer) {
-        ESP_LOGE(TAG, "Failed to allocate memory for filesystem upload");
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
+    char url[sizeof(Config::OTA_PULL_URL)];
+    if (!JsonLookup::getString(buf, "url", url, sizeof(url))) {
+        snprintf(url, sizeof(url), "%s", Config::OTA_PULL_URL);
+    }
+    double interval = JsonLookup::getNumber(buf, "interval", Config::OTA_PULL_INTERVAL);
+    double rate = JsonLookup::getNumber(buf, "rate", Config::OTA_PULL_RATE);
+    
+    // Plain HTTP only: the server is local and there is no CA bundle to check HTTPS against
+    if ((url[0] != '\0' && strncmp(url, "http://", 7) != 0) || interval < 1 || interval > 10080 ||
+        rate < 0 || rate > 10000) {
+        httpd_resp_set_status(req, "400 Bad Request");
+        send_json_response(req, "{\"success\":false,\"error\":\"Invalid url, interval (1-10080 min) or rate (0-10000 KB/s)\"}");
+        return ESP_OK;
+    }
+    
+    if (strcmp(url, Config::OTA_PULL_URL) != 0 || (uint16_t)interval != Config::OTA_PULL_INTERVAL ||
+        (uint16_t)rate != Config::OTA_PULL_RATE) {
+        Config::saveOTAPullSettings(url, (uint16_t)interval, (uint16_t)rate);
+        self->otaPull.checkNow();   // First check with the new settings right away
+    } else if (JsonLookup::getBool(buf, "check")) {
+        self->otaPull.checkNow();
+    }
+    send_json_response(req, "{\"success\":true}");
+    return ESP_OK;
+}
+
+// Resumable upload of an update.tar (see OTAUploadSession):
+//   POST /api/ota/session        {"size":N, "label":"update.tar|N|mtime"}: open, or find again after a reload
+//   POST /api/ota/session/chunk?session=ID&offset=N&crc=HEX   body: at most "chunk" bytes
+//   GET  /api/ota/session        running session
+//   POST /api/ota/session/abort  {"session":ID}
+// Every answer carries the acknowledged offset, the client always continues there.
+esp_err_t ServerManager::send_session_info(httpd_req_t *req, const char* status, const OTAUploadSession::Info& info) {
+    JsonStreamWriter json(req);
+    json.beginObject();
+    json.add("status", status);
+    json.add("active", info.active);
+    json.add("session", info.id);
+    json.add("label", info.label);
+    json.add("size", (unsigned long)info.size);
+    json.add("offset", (unsigned long)info.offset);
+    json.add("chunk", (unsigned long)OTAUploadSession::CHUNK_SIZE);
+    if (info.error[0] != '\0') {
+        json.add("message", info.error);
+    }
+    json.endObject();
+    return json.finish();
+}
+
+esp_err_t ServerManager::api_ota_session_handler(httpd_req_t *req) {
+    ServerManager* self = (ServerManager*)req->user_ctx;
+    OTAUploadSession::Info info;
+    self->otaUpload.getInfo(&info);
+    return send_session_info(req, "ok", info);
+}
+
+esp_err_t ServerManager::api_ota_session_open_handler(httpd_req_t *req) {
+    ServerManager* self = (ServerManager*)req->user_ctx;
+    
+    char buf[256];
+    int ret = httpd_req_recv(req, buf, sizeof(buf) - 1);
+    if (ret <= 0) {
+        httpd_resp_send_500(req);
         return ESP_FAIL;
     }
+    buf[ret] = '\0';
     
-    // Read entire file
-    size_t received = 0;
-    while (received < req->content_len) {
-        int ret = httpd_req_recv(req, (char*)(fsBuffer + received), req->content_len - received);
-        if (ret <= 0) {
-            if (ret == HTTPD_SOCK_ERR_TIMEOUT) {
-                continue;
-            }
-            free(fsBuffer);
-            ESP_LOGE(TAG, "Failed to receive filesystem data");
-            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Upload failed");
-            return ESP_FAIL;
-        }
-        received += ret;
+    double size = JsonLookup::getNumber(buf, "size", 0);
+    char label[OTAUploadSession::LABEL_SIZE + 1] = "";
+    JsonLookup::getString(buf, "label", label, sizeof(label));
+    if (size < 1 || size > 10 * 1024 * 1024) { // Max 10MB, as for /api/ota/upload
+        httpd_resp_set_status(req, "400 Bad Request");
+        send_json_response(req, "{\"status\":\"error\",\"message\":\"Invalid file size (max 10MB)\"}");
+        return ESP_OK;
     }
     
-    ESP_LOGI(TAG, "Received complete filesystem: %d bytes", received);
+    OTAUploadSession::Info info;
+    OTAUploadSession::Result result = self->otaUpload.open((size_t)size, label, &info);
+    if (result == OTAUploadSession::RESULT_OK) {
+        return send_session_info(req, "ok", info);
+    }
+    if (result == OTAUploadSession::RESULT_DONE) {
+        snprintf(info.error, sizeof(info.error), "Update successful, rebooting...");
+        return send_session_info(req, "success", info);
+    }
+    httpd_resp_set_status(req, result == OTAUploadSession::RESULT_BUSY ? "409 Conflict" : "500 Internal Server Error");
+    return send_session_info(req, "error", info);
+}
+
+esp_err_t ServerManager::api_ota_session_abort_handler(httpd_req_t *req) {
+    ServerManager* self = (ServerManager*)req->user_ctx;
+    
+    char buf[128];
+    int ret = httpd_req_recv(req, buf, sizeof(buf) - 1);
+    if (ret <= 0) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+    buf[ret] = '\0';
     
-    // Flash SPIFFS
-    bool success = self->otaManager.flashSPIFFSDirect(fsBuffer, received);
+    char id[OTAUploadSession::ID_SIZE + 1] = "";
+    JsonLookup::getString(buf, "session", id, sizeof(id));
+    send_json_response(req, self->otaUpload.abort(id) ? "{\"success\":true}" : "{\"success\":false}");
+    return ESP_OK;
+}
+
+// One chunk: received completely into RAM, then checked against its CRC and
+// only then handed to the package. Any answer but "ok"/"success" leaves the
+// session as it was, so the client resends from the returned offset.
+esp_err_t ServerManager::api_ota_session_chunk_handler(httpd_req_t *req) {
+    ServerManager* self = (ServerManager*)req->user_ctx;
     
-    free(fsBuffer);
+    char query[160];   // Room for the token=... the web UI appends
+    char id[OTAUploadSession::ID_SIZE + 1] = "";
+    char offsetText[12] = "";
+    char crcText[12] = "";
+    bool valid = httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+                 httpd_query_key_value(query, "session", id, sizeof(id)) == ESP_OK &&
+                 httpd_query_key_value(query, "offset", offsetText, sizeof(offsetText)) == ESP_OK &&
+                 httpd_query_key_value(query, "crc", crcText, sizeof(crcText)) == ESP_OK;
+    char* offsetEnd = nullptr;
+    char* crcEnd = nullptr;
+    unsigned long offset = strtoul(offsetText, &offsetEnd, 10);
+    unsigned long crc = strtoul(crcText, &crcEnd, 16);
+    if (!valid || offsetEnd == offsetText || *offsetEnd != '\0' || crcEnd == crcText || *crcEnd != '\0' ||
+        req->content_len > OTAUploadSession::CHUNK_SIZE) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid chunk request");
+        return ESP_FAIL;
+    }
     
-    if (success) {
-        ESP_LOGI(TAG, "Filesystem Update successful, rebooting in 3 seconds...");
-        const char* response = "{\"status\":\"success\",\"message\":\"Filesystem update successful, rebooting...\"}";
-        httpd_resp_set_type(req, "application/json");
-        httpd_resp_send(req, response, strlen(response));
-        
-        vTaskDelay(pdMS_TO_TICKS(3000));
-        esp_restart();
-        
-        return ESP_OK;
-    } else {
-        ESP_LOGE(TAG, "Filesystem Update failed: %s", self->otaManager.getLastError());
-        char errorMsg[512];
-        snprintf(errorMsg, sizeof(errorMsg), 
-                 "{\"status\":\"error\",\"message\":\"%s\"}", 
-                 self->otaManager.getLastError());
-        httpd_resp_set_type(req, "application/json");
-        httpd_resp_send(req, errorMsg, strlen(errorMsg));
+    uint8_t* buffer = (uint8_t*)malloc(req->content_len > 0 ? req->content_len : 1);
+    if (!buffer) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
         return ESP_FAIL;
     }
+    UploadStream stream = { req, req->content_len, 0 };
+    size_t filled = 0;
+    while (stream.remaining > 0) {
+        size_t received = read_upload(buffer + filled, req->content_len - filled, &stream);
+        if (received == 0) {
+            break;
+        }
+        filled += received;
+    }
+    
+    OTAUploadSession::Info info;
+    if (stream.remaining > 0) {
+        free(buffer);
+        self->otaUpload.getInfo(&info);
+        snprintf(info.error, sizeof(info.error), "Chunk incomplete");
+        httpd_resp_set_status(req, "400 Bad Request");
+        return send_session_info(req, "error", info);
+    }
+    
+    OTAUploadSession::Result result = self->otaUpload.write(id, offset, buffer, filled, (uint32_t)crc, &info);
+    free(buffer);
+    
+    switch (result) {
+        case OTAUploadSession::RESULT_OK:
+            return send_session_info(req, "ok", info);
+        case OTAUploadSession::RESULT_COMPLETE:
+            ESP_LOGI(TAG, "OTA Update successful, rebooting in 3 seconds...");
+            snprintf(info.error, sizeof(info.error), "Update successful, rebooting...");
+            send_session_info(req, "success", info);
+            schedule_restart(3000);
+            return ESP_OK;
+        case OTAUploadSession::RESULT_DONE:
+            // Retry of the final chunk whose answer got lost; the restart is already scheduled
+            snprintf(info.error, sizeof(info.error), "Update successful, rebooting...");
+            return send_session_info(req, "success", info);
+        case OTAUploadSession::RESULT_UNKNOWN:
+            snprintf(info.error, sizeof(info.error), "No such upload session");
+            httpd_resp_set_status(req, "404 Not Found");
+            return send_session_info(req, "error", info);
+        case OTAUploadSession::RESULT_OFFSET:
+            snprintf(info.error, sizeof(info.error), "Chunk does not continue at offset %u", (unsigned)info.offset);
+            httpd_resp_set_status(req, "409 Conflict");
+            return send_session_info(req, "error", info);
+        case OTAUploadSession::RESULT_CRC:
+            snprintf(info.error, sizeof(info.error), "Chunk CRC mismatch");
+            httpd_resp_set_status(req, "400 Bad Request");
+            return send_session_info(req, "error", info);
+        default:
+            // Package rejected: the session is gone, like a failed /api/ota/upload
+            ESP_LOGE(TAG, "OTA Update failed: %s", info.error);
+            return send_session_info(req, "error", info);
+    }
 }
 
 
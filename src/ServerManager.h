@@ -5,22 +5,95 @@
 #include "KMeterManager.h"
 #include "LEDManager.h"
 #include "OTAManager.h"
+#include "OTAPull.h"
+#include "OTAUploadSession.h"
+#include "HttpWorkerPool.h"
+#include "ResponseCache.h"
+#include "AdmissionControl.h"
+#include "ConnectionTable.h"
 #include "driver/ledc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 
 // Forward declaration for Arduino sensor component
 class KMeterIsoComponent;
 
+// Groups of snapshot members whose changes are tracked for ?since= (see StatusFields)
+enum SnapshotMember : uint8_t {
+    SNAP_SENSOR_STATE,
+    SNAP_TEMPERATURE_C,
+    SNAP_TEMPERATURE_F,
+    SNAP_INTERNAL_TEMPERATURE,
+    SNAP_DUTY,
+    SNAP_MANUAL_MODE,
+    SNAP_MANUAL_FREQ,
+    SNAP_MANUAL_DUTY,
+    SNAP_AUTO_PWM,
+    SNAP_TEMP_MAPPING,
+    SNAP_WIFI_CONNECTED,
+    SNAP_MQTT_CONNECTED,
+    SNAP_WIFI_RSSI,
+    SNAP_LED,
+    SNAP_UPTIME,
+    SNAP_DEVICE_NAME,
+    SNAP_TEMP_UNIT,
+    SNAP_MEMBER_COUNT
+};
+
+// Coherent view of everything the dashboard shows. Rebuilt at most once per
+// control tick and shared by all clients; version only changes with content.
+struct DashboardSnapshot {
+    uint32_t version;
+    uint32_t tick;
+    uint32_t baseVersion;                         // Version at boot; older ?since= values are stale
+    uint32_t memberVersion[SNAP_MEMBER_COUNT];    // Version in which each member last changed
+    
+    // Sensor
+    bool sensorInitialized;
+    bool sensorReady;
+    uint8_t sensorError;
+    float temperatureC;
+    float temperatureF;
+    float internalTemperature;
+    
+    // Fan / PWM
+    uint32_t dutyRaw;
+    uint8_t dutyPercent;
+    bool manualMode;
+    uint32_t manualFreq;
+    uint8_t manualDuty;
+    bool autoPWM;
+    float tempStart;
+    float tempMax;
+    
+    // Network
+    bool wifiConnected;
+    bool mqttConnected;
+    int8_t wifiRssi;
+    
+    // Device
+    bool ledState;
+    uint8_t ledR;
+    uint8_t ledG;
+    uint8_t ledB;
+    uint32_t uptimeMinutes;
+    char deviceName[32];
+    char tempUnit[16];
+};
+
 class ServerManager {
 public:
     ServerManager();
     void begin();
-    void restart();  // Restart HTTP server (needed after WiFi connects)
+    void restart();  // Stop and start the HTTP server (recovery; not needed for network changes)
+    bool isRunning() const { return server != nullptr; }
     void handleClient();  // Empty for ESP-IDF (async server)
     void initializePWM();
     void reconfigurePWM(uint32_t frequency);
     void setPWMDuty(int duty);
     void updateSensors();
     void updateAutoPWM();
+    void getDashboardSnapshot(DashboardSnapshot* out);
     KMeterManager* getKMeterManager() { return &kmeterManager; }
     void setExternalSensor(KMeterIsoComponent* sensor) { externalSensor = sensor; }  // Hybrid mode: Use Arduino sensor
     void setLEDManager(LEDManager* manager) { ledManager = manager; }
@@ -34,14 +107,66 @@ private:
     KMeterIsoComponent* externalSensor;  // Hybrid mode: Arduino sensor from main.cpp
     LEDManager* ledManager;
     OTAManager otaManager;
+    OTAPull otaPull;   // Background updates from Config::OTA_PULL_URL
+    OTAUploadSession otaUpload;   // Resumable chunked uploads
     bool ledState;
     uint8_t ledColorR;
     uint8_t ledColorG;
     uint8_t ledColorB;
     
+    // Dashboard snapshot (see getDashboardSnapshot)
+    SemaphoreHandle_t snapshotMutex;
+    DashboardSnapshot snapshot;
+    volatile uint32_t controlTick;
+    
+    // Slow handlers and deferred jobs (reboot, MQTT reconnect)
+    HttpWorkerPool workers;
+    
+    // Config part of /api/settings and /api/system-info (see ResponseCache)
+    ResponseCache responseCache;
+    
+    // Rate limits for /api/* (see AdmissionControl)
+    AdmissionControl admission;
+    
+    // Per-socket counters, cached auth and idle reaping (see ConnectionTable)
+    ConnectionTable connections;
+    
+    // Route table (see find_route) - one catch-all registration dispatches everything
+    enum RouteAuth : uint8_t {
+        ROUTE_AUTH_NONE,   // Public
+        ROUTE_AUTH_API,    // Token required, 401 JSON otherwise
+        ROUTE_AUTH_PAGE    // Token required, redirect to login otherwise
+    };
+    
+    enum RouteFlags : uint8_t {
+        ROUTE_FLAG_NONE     = 0,
+        ROUTE_FLAG_PRIORITY = 1 << 0   // Control endpoint or login, not blocked by the global rate limit
+    };
+    
+    struct Route {
+        httpd_method_t method;
+        const char* path;
+        esp_err_t (*handler)(httpd_req_t *req);
+        RouteAuth auth;
+        uint8_t flags;
+    };
+    
+    static httpd_config_t makeServerConfig();
+    bool startServer();
     void setupRoutes();
+    void rebuildSnapshot();
     int mapTemperatureToPWM(float temperature);
     
+    // Route dispatch
+    static constexpr int compare_paths(const char* a, const char* b);
+    static constexpr bool routes_sorted(const Route* routes, size_t count);
+    static const Route* find_route(httpd_method_t method, const char* path, size_t len, bool* path_known);
+    static esp_err_t dispatch_handler(httpd_req_t *req);
+    
+    // Socket lifecycle (httpd open_fn/close_fn)
+    static esp_err_t on_socket_open(httpd_handle_t hd, int sockfd);
+    static void on_socket_close(httpd_handle_t hd, int sockfd);
+    
     // HTTP Handler functions
     static esp_err_t root_handler(httpd_req_t *req);
     static esp_err_t login_handler(httpd_req_t *req);
@@ -54,8 +179,16 @@ private:
     // API endpoints
     static esp_err_t api_login_handler(httpd_req_t *req);
     static esp_err_t api_status_handler(httpd_req_t *req);
+    static esp_err_t api_dashboard_handler(httpd_req_t *req);
     static esp_err_t api_system_info_handler(httpd_req_t *req);
     static esp_err_t api_settings_handler(httpd_req_t *req);
+    static esp_err_t api_settings_batch_handler(httpd_req_t *req);
+    static esp_err_t api_server_stats_handler(httpd_req_t *req);
+    static esp_err_t api_status_bin_handler(httpd_req_t *req);
+    static void render_system_info_static(JsonStreamWriter& json, void* ctx);
+    static void render_system_info_volatile(JsonStreamWriter& json, void* ctx);
+    static void render_settings_static(JsonStreamWriter& json, void* ctx);
+    static void render_settings_volatile(JsonStreamWriter& json, void* ctx);
     static esp_err_t api_restart_handler(httpd_req_t *req);
     static esp_err_t api_device_name_handler(httpd_req_t *req);
     static esp_err_t api_reboot_handler(httpd_req_t *req);
@@ -84,13 +217,25 @@ private:
     static esp_err_t api_ota_tar_handler(httpd_req_t *req);
     static esp_err_t api_ota_firmware_handler(httpd_req_t *req);
     static esp_err_t api_ota_filesystem_handler(httpd_req_t *req);
+    static esp_err_t api_ota_status_handler(httpd_req_t *req);
+    static esp_err_t api_ota_pull_handler(httpd_req_t *req);
+    static esp_err_t api_ota_pull_settings_handler(httpd_req_t *req);
+    static esp_err_t api_ota_session_handler(httpd_req_t *req);
+    static esp_err_t api_ota_session_open_handler(httpd_req_t *req);
+    static esp_err_t api_ota_session_abort_handler(httpd_req_t *req);
+    static esp_err_t api_ota_session_chunk_handler(httpd_req_t *req);
+    static esp_err_t send_session_info(httpd_req_t *req, const char* status, const OTAUploadSession::Info& info);
+    static esp_err_t stream_upload(httpd_req_t *req, bool filesystem);
     
     // Helper functions
     static bool check_auth(httpd_req_t *req);
     static bool check_token(httpd_req_t *req);
-    static char* generate_token();
-    static bool is_valid_token(const char* token);
+    static bool extract_token(httpd_req_t *req, char* token, size_t size);
+    static void set_session_cookie(httpd_req_t *req, const char* token);
     static void send_json_response(httpd_req_t *req, const char* json);
     static void send_html_response(httpd_req_t *req, const uint8_t* html_start, const uint8_t* html_end);
     static void url_decode(char* dst, const char* src, size_t dst_size);
+    static void schedule_restart(uint32_t delay_ms);
+    static void restart_job(void* arg);
+    static void mqtt_reconnect_job(void* arg);
 };
@@ -0,0 +1,218 @@
+#include "SessionStore.h"
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char* TAG = "SESSION";
+
+// Guards the table; held only for a few dozen instructions
+static portMUX_TYPE session_lock = portMUX_INITIALIZER_UNLOCKED;
+
+SessionStore::SessionStore() : generationCount(0) {
+    memset(sessions, 0, sizeof(sessions));
+    memset(buckets, NONE, sizeof(buckets));
+}
+
+bool SessionStore::parseToken(const char* token, uint8_t* out) {
+    if (!token) {
+        return false;
+    }
+    for (uint8_t i = 0; i < TOKEN_BYTES * 2; i++) {
+        char c = token[i];
+        uint8_t v;
+        if (c >= '0' && c <= '9') {
+            v = c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            v = c - 'a' + 10;
+        } else if (c >= 'A' && c <= 'F') {
+            v = c - 'A' + 10;
+        } else {
+            return false;  // Also catches a token that is too short
+        }
+        if (i & 1) {
+            out[i / 2] |= v;
+        } else {
+            out[i / 2] = v << 4;
+        }
+    }
+    return token[TOKEN_BYTES * 2] == '\0';
+}
+
+// No early exit, so the time taken does not reveal how many bytes matched
+bool SessionStore::tokensEqual(const uint8_t* a, const uint8_t* b) {
+    uint8_t diff = 0;
+    for (uint8_t i = 0; i < TOKEN_BYTES; i++) {
+        diff |= a[i] ^ b[i];
+    }
+    return diff == 0;
+}
+
+// Tokens are random, so their first byte is already a good hash
+uint8_t SessionStore::bucketOf(const uint8_t* token) {
+    return token[0] & (BUCKETS - 1);
+}
+
+int SessionStore::find(const uint8_t* token) {
+    for (uint8_t i = buckets[bucketOf(token)]; i != NONE; i = sessions[i].next) {
+        if (tokensEqual(sessions[i].token, token)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void SessionStore::unlink(uint8_t index) {
+    uint8_t* link = &buckets[bucketOf(sessions[index].token)];
+    while (*link != NONE) {
+        if (*link == index) {
+            *link = sessions[index].next;
+            break;
+        }
+        link = &sessions[*link].next;
+    }
+    memset(&sessions[index], 0, sizeof(Session));
+    generationCount++;
+}
+
+void SessionStore::expire(int64_t now) {
+    for (uint8_t i = 0; i < CAPACITY; i++) {
+        if (sessions[i].active && now >= sessions[i].expiresUs) {
+            unlink(i);
+        }
+    }
+}
+
+bool SessionStore::create(char* tokenOut, size_t tokenSize, uint64_t ttlUs) {
+    if (tokenSize < TOKEN_STRING_SIZE) {
+        return false;
+    }
+
+    uint8_t token[TOKEN_BYTES];
+    for (uint8_t i = 0; i < TOKEN_BYTES; i += 4) {
+        uint32_t r = esp_random();
+        memcpy(token + i, &r, 4);
+    }
+
+    int64_t now = esp_timer_get_time();
+    bool evicted = false;
+
+    portENTER_CRITICAL(&session_lock);
+    expire(now);
+
+    // Free slot, otherwise the least recently used session makes room
+    uint8_t slot = 0;
+    for (uint8_t i = 0; i < CAPACITY; i++) {
+        if (!sessions[i].active) {
+            slot = i;
+            break;
+        }
+        if (sessions[i].lastUsedUs < sessions[slot].lastUsedUs) {
+            slot = i;
+        }
+    }
+    if (sessions[slot].active) {
+        unlink(slot);
+        evicted = true;
+    }
+
+    Session& s = sessions[slot];
+    memcpy(s.token, token, TOKEN_BYTES);
+    s.expiresUs = now + (int64_t)ttlUs;
+    s.lastUsedUs = now;
+    s.active = true;
+    uint8_t bucket = bucketOf(token);
+    s.next = buckets[bucket];
+    buckets[bucket] = slot;
+    portEXIT_CRITICAL(&session_lock);
+
+    for (uint8_t i = 0; i < TOKEN_BYTES; i++) {
+        snprintf(tokenOut + i * 2, 3, "%02x", token[i]);
+    }
+
+    if (evicted) {
+        ESP_LOGW(TAG, "Session table full, evicted least recently used session");
+    }
+    ESP_LOGI(TAG, "Session %u created (%.4s...)", (unsigned int)slot, tokenOut);
+    return true;
+}
+
+bool SessionStore::validate(const char* token) {
+    uint8_t bytes[TOKEN_BYTES];
+    if (!parseToken(token, bytes)) {
+        return false;
+    }
+
+    int64_t now = esp_timer_get_time();
+    bool valid = false;
+
+    portENTER_CRITICAL(&session_lock);
+    int index = find(bytes);
+    if (index >= 0) {
+        if (now >= sessions[index].expiresUs) {
+            unlink(index);
+        } else {
+            sessions[index].lastUsedUs = now;
+            valid = true;
+        }
+    }
+    portEXIT_CRITICAL(&session_lock);
+
+    return valid;
+}
+
+bool SessionStore::revoke(const char* token) {
+    uint8_t bytes[TOKEN_BYTES];
+    if (!parseToken(token, bytes)) {
+        return false;
+    }
+
+    portENTER_CRITICAL(&session_lock);
+    int index = find(bytes);
+    if (index >= 0) {
+        unlink(index);
+    }
+    portEXIT_CRITICAL(&session_lock);
+
+    return index >= 0;
+}
+
+void SessionStore::clear() {
+    portENTER_CRITICAL(&session_lock);
+    memset(sessions, 0, sizeof(sessions));
+    memset(buckets, NONE, sizeof(buckets));
+    generationCount++;
+    portEXIT_CRITICAL(&session_lock);
+}
+
+void SessionStore::clearExcept(const char* keep) {
+    uint8_t bytes[TOKEN_BYTES];
+    bool hasKeep = parseToken(keep, bytes);
+
+    portENTER_CRITICAL(&session_lock);
+    for (uint8_t i = 0; i < CAPACITY; i++) {
+        if (sessions[i].active && !(hasKeep && tokensEqual(sessions[i].token, bytes))) {
+            unlink(i);
+        }
+    }
+    generationCount++;
+    portEXIT_CRITICAL(&session_lock);
+}
+
+uint8_t SessionStore::activeCount() {
+    int64_t now = esp_timer_get_time();
+    uint8_t count = 0;
+
+    portENTER_CRITICAL(&session_lock);
+    expire(now);
+    for (uint8_t i = 0; i < CAPACITY; i++) {
+        if (sessions[i].active) {
+            count++;
+        }
+    }
+    portEXIT_CRITICAL(&session_lock);
+
+    return count;
+}
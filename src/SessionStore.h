@@ -0,0 +1,71 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Fixed-capacity table of login sessions.
+ *
+ * - 128-bit random tokens, sent as 32 hex characters
+ * - Absolute expiry per session
+ * - Lookup through a small hash on the token bytes, compare in constant time
+ * - When full, a new login evicts the least recently used session
+ */
+class SessionStore {
+public:
+    static const uint8_t CAPACITY = 8;
+    static const uint8_t TOKEN_BYTES = 16;
+    static const size_t TOKEN_STRING_SIZE = TOKEN_BYTES * 2 + 1;
+    static const uint64_t DEFAULT_TTL_US = 24ULL * 60ULL * 60ULL * 1000000ULL;  // 24 hours
+
+    SessionStore();
+
+    /**
+     * Start a new session
+     * @param tokenOut Receives the token as hex string (TOKEN_STRING_SIZE bytes)
+     * @return false if tokenOut is too small
+     */
+    bool create(char* tokenOut, size_t tokenSize, uint64_t ttlUs = DEFAULT_TTL_US);
+
+    // true if the token belongs to a live session; marks it as used
+    bool validate(const char* token);
+
+    // End one session (logout); false if the token was unknown
+    bool revoke(const char* token);
+
+    // End all sessions
+    void clear();
+
+    // End all sessions but the one of keep (after a password change the client
+    // that changed it stays logged in); an unknown keep ends all of them
+    void clearExcept(const char* keep);
+
+    uint8_t activeCount();
+
+    // Changes whenever a session ends (logout, expiry, eviction, clear), so
+    // callers caching a validate() result know when to check again
+    uint32_t generation() const { return generationCount; }
+
+private:
+    static const uint8_t BUCKETS = 16;  // Power of two
+    static const uint8_t NONE = 0xFF;
+
+    struct Session {
+        uint8_t token[TOKEN_BYTES];
+        int64_t expiresUs;
+        int64_t lastUsedUs;
+        uint8_t next;       // Next session in the same bucket
+        bool active;
+    };
+
+    Session sessions[CAPACITY];
+    uint8_t buckets[BUCKETS];
+    volatile uint32_t generationCount;
+
+    static bool parseToken(const char* token, uint8_t* out);
+    static bool tokensEqual(const uint8_t* a, const uint8_t* b);
+    static uint8_t bucketOf(const uint8_t* token);
+
+    int find(const uint8_t* token);
+    void unlink(uint8_t index);
+    void expire(int64_t now);
+};
@@ -0,0 +1,64 @@
+#include "Sha256.h"
+#include "esp_idf_version.h"
+
+// mbedtls 3 (IDF 5) dropped the _ret suffix
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+#define SHA256_STARTS mbedtls_sha256_starts
+#define SHA256_UPDATE mbedtls_sha256_update
+#define SHA256_FINISH mbedtls_sha256_finish
+#else
+#define SHA256_STARTS mbedtls_sha256_starts_ret
+#define SHA256_UPDATE mbedtls_sha256_update_ret
+#define SHA256_FINISH mbedtls_sha256_finish_ret
+#endif
+
+Sha256::Sha256() {
+    mbedtls_sha256_init(&ctx);
+    SHA256_STARTS(&ctx, 0);
+}
+
+Sha256::~Sha256() {
+    mbedtls_sha256_free(&ctx);
+}
+
+void Sha256::reset() {
+    mbedtls_sha256_free(&ctx);
+    mbedtls_sha256_init(&ctx);
+    SHA256_STARTS(&ctx, 0);
+}
+
+void Sha256::update(const uint8_t* data, size_t len) {
+    SHA256_UPDATE(&ctx, data, len);
+}
+
+void Sha256::finish(uint8_t digest[DIGEST_SIZE]) {
+    SHA256_FINISH(&ctx, digest);
+}
+
+void Sha256::toHex(const uint8_t digest[DIGEST_SIZE], char* out) {
+    static const char hex[] = "0123456789abcdef";
+    for (size_t i = 0; i < DIGEST_SIZE; i++) {
+        out[i * 2] = hex[digest[i] >> 4];
+        out[i * 2 + 1] = hex[digest[i] & 0x0F];
+    }
+    out[DIGEST_SIZE * 2] = '\0';
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+bool Sha256::fromHex(const char* hex, uint8_t digest[DIGEST_SIZE]) {
+    for (size_t i = 0; i < DIGEST_SIZE; i++) {
+        int hi = hex_value(hex[i * 2]);
+        int lo = hi < 0 ? -1 : hex_value(hex[i * 2 + 1]);
+        if (lo < 0) {
+            return false;
+        }
+        digest[i] = (uint8_t)(hi << 4 | lo);
+    }
+    return hex[DIGEST_SIZE * 2] == '\0';
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "mbedtls/sha256.h"
+
+/**
+ * Incremental SHA-256 over mbedtls, which uses the SHA accelerator of the
+ * ESP32 when it is free (CONFIG_MBEDTLS_HARDWARE_SHA).
+ */
+class Sha256 {
+public:
+    static const size_t DIGEST_SIZE = 32;
+
+    Sha256();
+    ~Sha256();
+
+    void reset();
+    void update(const uint8_t* data, size_t len);
+    void finish(uint8_t digest[DIGEST_SIZE]);
+
+    /**
+     * Lowercase hex, out needs 2 * DIGEST_SIZE + 1 bytes
+     */
+    static void toHex(const uint8_t digest[DIGEST_SIZE], char* out);
+
+    /**
+     * Parse 2 * DIGEST_SIZE hex digits (either case)
+     * @return false on a wrong length or a non-hex character
+     */
+    static bool fromHex(const char* hex, uint8_t digest[DIGEST_SIZE]);
+
+private:
+    mbedtls_sha256_context ctx;
+};
@@ -0,0 +1,75 @@
+#include "StatusBinary.h"
+#include <math.h>
+#include <string.h>
+
+// Explicit byte order, independent of struct layout and host endianness
+static uint8_t* put_u8(uint8_t* p, uint8_t v) {
+    *p = v;
+    return p + 1;
+}
+
+static uint8_t* put_u16(uint8_t* p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    return p + 2;
+}
+
+static uint8_t* put_u32(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+    return p + 4;
+}
+
+// Hundredths, saturated to int32 (NaN becomes INT32_MIN as "no value")
+static uint8_t* put_centi(uint8_t* p, float v) {
+    int32_t c;
+    if (isnan(v)) {
+        c = INT32_MIN;
+    } else {
+        // In double, so the bounds are exact; negative values stop at
+        // INT32_MIN + 1 because INT32_MIN is reserved for NaN
+        double scaled = round((double)v * 100.0);
+        c = scaled >= 2147483647.0 ? INT32_MAX : scaled <= -2147483647.0 ? INT32_MIN + 1 : (int32_t)scaled;
+    }
+    return put_u32(p, (uint32_t)c);
+}
+
+size_t StatusBinary::encode(const DashboardSnapshot& snap, uint32_t uptimeS, uint32_t freeHeap,
+                            uint32_t minFreeHeap, uint8_t* out) {
+    uint16_t flags = 0;
+    if (snap.sensorInitialized) flags |= STATUS_FLAG_SENSOR_INITIALIZED;
+    if (snap.sensorReady)       flags |= STATUS_FLAG_SENSOR_READY;
+    if (snap.wifiConnected)     flags |= STATUS_FLAG_WIFI_CONNECTED;
+    if (snap.mqttConnected)     flags |= STATUS_FLAG_MQTT_CONNECTED;
+    if (snap.manualMode)        flags |= STATUS_FLAG_MANUAL_MODE;
+    if (snap.autoPWM)           flags |= STATUS_FLAG_AUTO_PWM;
+    if (snap.ledState)          flags |= STATUS_FLAG_LED_ON;
+
+    uint8_t* p = out;
+    memcpy(p, "HBVS", 4);
+    p += 4;
+    p = put_u8(p, FORMAT_VERSION);
+    p = put_u8(p, 0);
+    p = put_u16(p, RECORD_SIZE);
+    p = put_u32(p, snap.version);
+    p = put_u32(p, uptimeS);
+    p = put_u32(p, freeHeap);
+    p = put_u32(p, minFreeHeap);
+    p = put_centi(p, snap.temperatureC);
+    p = put_centi(p, snap.temperatureF);
+    p = put_centi(p, snap.internalTemperature);
+    p = put_u16(p, (uint16_t)snap.dutyRaw);
+    p = put_u8(p, snap.dutyPercent);
+    p = put_u8(p, (uint8_t)snap.wifiRssi);
+    p = put_u16(p, flags);
+    p = put_u16(p, 0);  // RPM
+    p = put_u8(p, snap.sensorError);
+    p = put_u8(p, snap.manualDuty);
+    p = put_u16(p, 0);  // Reserved, keeps the frequency 4-byte aligned
+    p = put_u32(p, snap.manualFreq);
+    p = put_centi(p, snap.tempStart);
+    p = put_centi(p, snap.tempMax);
+    return p - out;
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "ServerManager.h"
+
+/**
+ * Fixed little-endian status record for /api/status.bin.
+ *
+ * Encoded field by field straight from the dashboard snapshot, no
+ * intermediate document. Decoder: tools/status_bin_client.py
+ *
+ *  off size  field
+ *    0   4   magic "HBVS"
+ *    4   1   format version (2)
+ *    5   1   reserved (0)
+ *    6   2   record length in bytes (60); clients skip unknown trailing bytes
+ *    8   4   seq (snapshot version, see ?since= on the JSON endpoints)
+ *   12   4   uptime in seconds
+ *   16   4   free heap in bytes
+ *   20   4   minimum free heap in bytes
+ *   24   4   temperature   °C x 100, signed
+ *   28   4   temperature   °F x 100, signed
+ *   32   4   internal temperature °C x 100, signed
+ *   36   2   duty raw (0-255)
+ *   38   1   duty percent
+ *   39   1   WiFi RSSI dBm, signed
+ *   40   2   flags (STATUS_FLAG_*)
+ *   42   2   fan RPM, valid only with STATUS_FLAG_RPM_VALID
+ *   44   1   sensor error status
+ *   45   1   manual duty percent
+ *   46   2   reserved (0)
+ *   48   4   manual PWM frequency in Hz
+ *   52   4   mapping start °C x 100, signed
+ *   56   4   mapping max   °C x 100, signed
+ *
+ * Temperatures are int32 since version 2: in int16 °F x 100 clipped at
+ * 164 °C, inside what a type-K probe reports. INT32_MIN means no value.
+ */
+class StatusBinary {
+public:
+    static const uint8_t FORMAT_VERSION = 2;
+    static const size_t RECORD_SIZE = 60;
+
+    enum Flags : uint16_t {
+        STATUS_FLAG_SENSOR_INITIALIZED = 1 << 0,
+        STATUS_FLAG_SENSOR_READY       = 1 << 1,
+        STATUS_FLAG_WIFI_CONNECTED     = 1 << 2,
+        STATUS_FLAG_MQTT_CONNECTED     = 1 << 3,
+        STATUS_FLAG_MANUAL_MODE        = 1 << 4,
+        STATUS_FLAG_AUTO_PWM           = 1 << 5,
+        STATUS_FLAG_LED_ON             = 1 << 6,
+        STATUS_FLAG_RPM_VALID          = 1 << 7   // No tachometer input on this hardware yet
+    };
+
+    /**
+     * Encode one record
+     * @param out At least RECORD_SIZE bytes
+     * @return Bytes written
+     */
+    static size_t encode(const DashboardSnapshot& snap, uint32_t uptimeS, uint32_t freeHeap,
+                         uint32_t minFreeHeap, uint8_t* out);
+};
@@ -0,0 +1,263 @@
+#include "StatusFields.h"
+#include "JsonStream.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum FieldType : uint8_t {
+    FIELD_BOOL,
+    FIELD_U8,
+    FIELD_I8,
+    FIELD_U32,
+    FIELD_FLOAT,
+    FIELD_STRING,          // char array in the snapshot
+    FIELD_SENSOR_STATUS,   // Text derived from the sensor state
+    FIELD_CONST_STRING,
+    FIELD_CONST_INT
+};
+
+static const uint8_t SNAP_CONSTANT = 0xFF;
+
+struct StatusField {
+    const char* name;
+    FieldType type;
+    uint8_t member;
+    uint16_t offset;
+    const char* text;      // FIELD_CONST_STRING
+    int32_t number;        // FIELD_CONST_INT
+};
+
+struct MemberSpan {
+    uint16_t offset;
+    uint16_t size;
+};
+
+#define SNAP_OFFSET(field) offsetof(DashboardSnapshot, field)
+#define SNAP_SPAN(first, last) \
+    { SNAP_OFFSET(first), (uint16_t)(SNAP_OFFSET(last) + sizeof(((DashboardSnapshot*)0)->last) - SNAP_OFFSET(first)) }
+#define FIELD(name, type, member, field) { name, type, member, SNAP_OFFSET(field), nullptr, 0 }
+
+// Bytes of the snapshot covered by each SnapshotMember
+static const MemberSpan member_spans[SNAP_MEMBER_COUNT] = {
+    SNAP_SPAN(sensorInitialized, sensorError),   // SNAP_SENSOR_STATE
+    SNAP_SPAN(temperatureC, temperatureC),       // SNAP_TEMPERATURE_C
+    SNAP_SPAN(temperatureF, temperatureF),       // SNAP_TEMPERATURE_F
+    SNAP_SPAN(internalTemperature, internalTemperature),
+    SNAP_SPAN(dutyRaw, dutyPercent),             // SNAP_DUTY
+    SNAP_SPAN(manualMode, manualMode),
+    SNAP_SPAN(manualFreq, manualFreq),
+    SNAP_SPAN(manualDuty, manualDuty),
+    SNAP_SPAN(autoPWM, autoPWM),
+    SNAP_SPAN(tempStart, tempMax),               // SNAP_TEMP_MAPPING
+    SNAP_SPAN(wifiConnected, wifiConnected),
+    SNAP_SPAN(mqttConnected, mqttConnected),
+    SNAP_SPAN(wifiRssi, wifiRssi),
+    SNAP_SPAN(ledState, ledB),                   // SNAP_LED
+    SNAP_SPAN(uptimeMinutes, uptimeMinutes),
+    SNAP_SPAN(deviceName, deviceName),
+    SNAP_SPAN(tempUnit, tempUnit)
+};
+
+static const StatusField dashboard_fields[] = {
+    FIELD("device_name",          FIELD_STRING, SNAP_DEVICE_NAME,          deviceName),
+    FIELD("sensor_initialized",   FIELD_BOOL,   SNAP_SENSOR_STATE,         sensorInitialized),
+    FIELD("sensor_ready",         FIELD_BOOL,   SNAP_SENSOR_STATE,         sensorReady),
+    FIELD("error_status",         FIELD_U8,     SNAP_SENSOR_STATE,         sensorError),
+    FIELD("temperature_celsius",  FIELD_FLOAT,  SNAP_TEMPERATURE_C,        temperatureC),
+    FIELD("temperatureF",         FIELD_FLOAT,  SNAP_TEMPERATURE_F,        temperatureF),
+    FIELD("internal_temperature", FIELD_FLOAT,  SNAP_INTERNAL_TEMPERATURE, internalTemperature),
+    FIELD("unit",                 FIELD_STRING, SNAP_TEMP_UNIT,            tempUnit),
+    FIELD("duty_raw",             FIELD_U32,    SNAP_DUTY,                 dutyRaw),
+    FIELD("duty_percent",         FIELD_U8,     SNAP_DUTY,                 dutyPercent),
+    FIELD("manual_mode",          FIELD_BOOL,   SNAP_MANUAL_MODE,          manualMode),
+    FIELD("manual_freq",          FIELD_U32,    SNAP_MANUAL_FREQ,          manualFreq),
+    FIELD("manual_duty",          FIELD_U8,     SNAP_MANUAL_DUTY,          manualDuty),
+    FIELD("auto_pwm",             FIELD_BOOL,   SNAP_AUTO_PWM,             autoPWM),
+    FIELD("startTemp",            FIELD_FLOAT,  SNAP_TEMP_MAPPING,         tempStart),
+    FIELD("maxTemp",              FIELD_FLOAT,  SNAP_TEMP_MAPPING,         tempMax),
+    FIELD("wifi_connected",       FIELD_BOOL,   SNAP_WIFI_CONNECTED,       wifiConnected),
+    FIELD("wifi_rssi",            FIELD_I8,     SNAP_WIFI_RSSI,            wifiRssi),
+    FIELD("mqtt_connected",       FIELD_BOOL,   SNAP_MQTT_CONNECTED,       mqttConnected),
+    FIELD("led_state",            FIELD_BOOL,   SNAP_LED,                  ledState),
+    FIELD("led_r",                FIELD_U8,     SNAP_LED,                  ledR),
+    FIELD("led_g",                FIELD_U8,     SNAP_LED,                  ledG),
+    FIELD("led_b",                FIELD_U8,     SNAP_LED,                  ledB),
+    FIELD("uptime_minutes",       FIELD_U32,    SNAP_UPTIME,               uptimeMinutes)
+};
+
+// Aliases kept for existing clients; ?fields= lets new ones pick one of each
+static const StatusField kmeter_fields[] = {
+    FIELD("connected",              FIELD_BOOL,          SNAP_SENSOR_STATE,         sensorInitialized),
+    FIELD("initialized",            FIELD_BOOL,          SNAP_SENSOR_STATE,         sensorInitialized),
+    FIELD("ready",                  FIELD_BOOL,          SNAP_SENSOR_STATE,         sensorReady),
+    FIELD("temperature",            FIELD_FLOAT,         SNAP_TEMPERATURE_C,        temperatureC),
+    FIELD("temperature_celsius",    FIELD_FLOAT,         SNAP_TEMPERATURE_C,        temperatureC),
+    FIELD("temperatureF",           FIELD_FLOAT,         SNAP_TEMPERATURE_F,        temperatureF),
+    FIELD("temperature_fahrenheit", FIELD_FLOAT,         SNAP_TEMPERATURE_F,        temperatureF),
+    FIELD("internal_temperature",   FIELD_FLOAT,         SNAP_INTERNAL_TEMPERATURE, internalTemperature),
+    FIELD("unit",                   FIELD_STRING,        SNAP_TEMP_UNIT,            tempUnit),
+    FIELD("error_status",           FIELD_U8,            SNAP_SENSOR_STATE,         sensorError),
+    FIELD("status_string",          FIELD_SENSOR_STATUS, SNAP_SENSOR_STATE,         sensorInitialized),
+    { "i2c_address",   FIELD_CONST_STRING, SNAP_CONSTANT, 0, "0x66", 0 },
+    { "read_interval", FIELD_CONST_INT,    SNAP_CONSTANT, 0, nullptr, 5000 }
+};
+
+static const StatusField pwm_fields[] = {
+    FIELD("manual_mode",  FIELD_BOOL, SNAP_MANUAL_MODE, manualMode),
+    FIELD("manual_freq",  FIELD_U32,  SNAP_MANUAL_FREQ, manualFreq),
+    FIELD("manual_duty",  FIELD_U8,   SNAP_MANUAL_DUTY, manualDuty),
+    FIELD("frequency",    FIELD_U32,  SNAP_MANUAL_FREQ, manualFreq),
+    FIELD("duty",         FIELD_U8,   SNAP_MANUAL_DUTY, manualDuty),
+    FIELD("auto_pwm",     FIELD_BOOL, SNAP_AUTO_PWM,    autoPWM),
+    FIELD("duty_raw",     FIELD_U32,  SNAP_DUTY,        dutyRaw),
+    FIELD("duty_percent", FIELD_U8,   SNAP_DUTY,        dutyPercent)
+};
+
+#define FIELD_COUNT(table) (sizeof(table) / sizeof(table[0]))
+
+void StatusFields::resetVersions(DashboardSnapshot& snap) {
+    snap.baseVersion = snap.version;
+    for (uint8_t i = 0; i < SNAP_MEMBER_COUNT; i++) {
+        snap.memberVersion[i] = snap.version;
+    }
+}
+
+void StatusFields::markChanges(const DashboardSnapshot& previous, DashboardSnapshot& fresh) {
+    const uint8_t* a = (const uint8_t*)&previous;
+    const uint8_t* b = (const uint8_t*)&fresh;
+    for (uint8_t i = 0; i < SNAP_MEMBER_COUNT; i++) {
+        if (memcmp(a + member_spans[i].offset, b + member_spans[i].offset, member_spans[i].size) != 0) {
+            fresh.memberVersion[i] = fresh.version;
+        }
+    }
+}
+
+// Exact match of name in a comma separated list
+static bool field_selected(const char* list, const char* name) {
+    size_t len = strlen(name);
+    for (const char* p = list; *p; ) {
+        const char* end = strchr(p, ',');
+        size_t n = end ? (size_t)(end - p) : strlen(p);
+        if (n == len && strncmp(p, name, len) == 0) {
+            return true;
+        }
+        if (!end) {
+            break;
+        }
+        p = end + 1;
+    }
+    return false;
+}
+
+static void add_field(JsonStreamWriter& json, const StatusField& field, const DashboardSnapshot& snap) {
+    const uint8_t* base = (const uint8_t*)&snap + field.offset;
+    switch (field.type) {
+        case FIELD_BOOL:
+            json.add(field.name, *(const bool*)base);
+            break;
+        case FIELD_U8:
+            json.add(field.name, (unsigned int)*base);
+            break;
+        case FIELD_I8:
+            json.add(field.name, (int)*(const int8_t*)base);
+            break;
+        case FIELD_U32: {
+            uint32_t v;
+            memcpy(&v, base, sizeof(v));
+            json.add(field.name, (unsigned long)v);
+            break;
+        }
+        case FIELD_FLOAT: {
+            float v;
+            memcpy(&v, base, sizeof(v));
+            json.add(field.name, v);
+            break;
+        }
+        case FIELD_STRING:
+            json.add(field.name, (const char*)base);
+            break;
+        case FIELD_SENSOR_STATUS:
+            if (!snap.sensorInitialized) {
+                json.add(field.name, "Sensor nicht initialisiert");
+            } else if (snap.sensorReady) {
+                json.add(field.name, "Bereit");
+            } else {
+                char statusBuf[64];
+                snprintf(statusBuf, sizeof(statusBuf), "Fehler (Status: %d)", snap.sensorError);
+                json.add(field.name, statusBuf);
+            }
+            break;
+        case FIELD_CONST_STRING:
+            json.add(field.name, field.text);
+            break;
+        case FIELD_CONST_INT:
+            json.add(field.name, (long)field.number);
+            break;
+    }
+}
+
+esp_err_t StatusFields::send(httpd_req_t* req, const DashboardSnapshot& snap, View view) {
+    const StatusField* fields;
+    size_t count;
+    const char* seqKey = "seq";
+    switch (view) {
+        case VIEW_DASHBOARD:
+            fields = dashboard_fields;
+            count = FIELD_COUNT(dashboard_fields);
+            seqKey = "version";  // Name the dashboard page already uses
+            break;
+        case VIEW_KMETER:
+            fields = kmeter_fields;
+            count = FIELD_COUNT(kmeter_fields);
+            break;
+        default:
+            fields = pwm_fields;
+            count = FIELD_COUNT(pwm_fields);
+            break;
+    }
+
+    char query[256] = {0};
+    char selection[192] = {0};
+    bool hasSelection = false;
+    bool delta = false;
+    uint32_t since = 0;
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        hasSelection = httpd_query_key_value(query, "fields", selection, sizeof(selection)) == ESP_OK;
+        char sinceStr[12] = {0};
+        if (httpd_query_key_value(query, "since", sinceStr, sizeof(sinceStr)) == ESP_OK) {
+            since = strtoul(sinceStr, NULL, 10);
+            // Only sequence numbers of this boot can be compared (wrap-safe)
+            delta = (uint32_t)(since - snap.baseVersion) <= (uint32_t)(snap.version - snap.baseVersion);
+        }
+    }
+
+    bool emit[48];
+    size_t emitted = 0;
+    for (size_t i = 0; i < count && i < sizeof(emit); i++) {
+        const StatusField& field = fields[i];
+        bool wanted = !hasSelection || field_selected(selection, field.name);
+        if (wanted && delta) {
+            wanted = field.member != SNAP_CONSTANT &&
+                     (int32_t)(snap.memberVersion[field.member] - since) > 0;
+        }
+        emit[i] = wanted;
+        emitted += wanted ? 1 : 0;
+    }
+
+    if (delta && emitted == 0) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        return httpd_resp_send(req, NULL, 0);
+    }
+
+    JsonStreamWriter json(req);
+    json.beginObject();
+    json.add(seqKey, (unsigned long)snap.version);
+    for (size_t i = 0; i < count && i < sizeof(emit); i++) {
+        if (emit[i]) {
+            add_field(json, fields[i], snap);
+        }
+    }
+    json.endObject();
+    return json.finish();
+}
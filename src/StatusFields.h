@@ -0,0 +1,31 @@
+#pragma once
+#include <stdint.h>
+#include "esp_http_server.h"
+#include "ServerManager.h"
+
+/**
+ * Table-driven rendering of the snapshot-backed status endpoints.
+ *
+ * Query parameters understood by send():
+ * - fields=a,b,c  Only emit the named fields
+ * - since=<seq>   Only emit fields whose snapshot member changed after <seq>;
+ *                 nothing changed gives an empty 304
+ *
+ * Every non-304 response carries the current sequence number (the snapshot
+ * version) for the next ?since=. Sequence numbers start at a random value on
+ * each boot; a value from another boot gets a full response.
+ */
+class StatusFields {
+public:
+    enum View : uint8_t {
+        VIEW_DASHBOARD,     // /api/dashboard
+        VIEW_KMETER,        // /api/kmeter-status
+        VIEW_PWM            // /api/pwm-status
+    };
+
+    static esp_err_t send(httpd_req_t* req, const DashboardSnapshot& snap, View view);
+
+    // Snapshot bookkeeping, called under the snapshot mutex
+    static void resetVersions(DashboardSnapshot& snap);
+    static void markChanges(const DashboardSnapshot& previous, DashboardSnapshot& fresh);
+};
@@ -0,0 +1,298 @@
+#include "TarStream.h"
+#include <string.h>
+
+// ustar header layout
+static const size_t OFF_NAME = 0;
+static const size_t LEN_NAME = 100;
+static const size_t OFF_SIZE = 124;
+static const size_t LEN_SIZE = 12;
+static const size_t OFF_CHECKSUM = 148;
+static const size_t LEN_CHECKSUM = 8;
+static const size_t OFF_TYPE = 156;
+static const size_t OFF_MAGIC = 257;
+static const size_t OFF_PREFIX = 345;
+static const size_t LEN_PREFIX = 155;
+
+TarStream::TarStream(EntryFunction onEntry, DataFunction onData, EndFunction onEnd, void* ctx)
+    : onEntry(onEntry), onData(onData), onEnd(onEnd), ctx(ctx), state(STATE_HEADER), headerFill(0), zeroBlocks(0),
+      remaining(0), padding(0), metaType(0), metaFill(0), hasPendingName(false), pendingSize(0),
+      hasPendingSize(false), error(nullptr) {
+    pendingName[0] = '\0';
+    name[0] = '\0';
+    entry.name = name;
+    entry.size = 0;
+    entry.type = 0;
+}
+
+bool TarStream::fail(const char* message) {
+    if (state != STATE_ERROR) {
+        error = message;
+        state = STATE_ERROR;
+    }
+    return false;
+}
+
+// Octal, space/NUL terminated, or GNU base-256 when the top bit is set
+bool TarStream::parseNumber(const uint8_t* field, size_t len, size_t* out) {
+    size_t value = 0;
+    if (field[0] & 0x80) {
+        for (size_t i = 1; i < len; i++) {
+            if (value > (SIZE_MAX >> 8)) {
+                return false;
+            }
+            value = (value << 8) | field[i];
+        }
+        *out = value;
+        return true;
+    }
+    size_t i = 0;
+    while (i < len && field[i] == ' ') {
+        i++;
+    }
+    for (; i < len && field[i] != '\0' && field[i] != ' '; i++) {
+        if (field[i] < '0' || field[i] > '7' || value > (SIZE_MAX >> 3)) {
+            return false;
+        }
+        value = value * 8 + (field[i] - '0');
+    }
+    *out = value;
+    return true;
+}
+
+void TarStream::startRun(State next, size_t size) {
+    state = next;
+    remaining = size;
+    padding = (BLOCK_SIZE - size % BLOCK_SIZE) % BLOCK_SIZE;
+    if (size == 0) {
+        endRun();
+    }
+}
+
+// Data / meta run complete: finish the member, then skip its padding
+void TarStream::endRun() {
+    if (state == STATE_DATA) {
+        if (onEnd && !onEnd(entry, ctx)) {
+            fail("Aborted at member end");
+            return;
+        }
+    } else if (state == STATE_META) {
+        parseMeta();
+    }
+    state = padding > 0 ? STATE_PADDING : STATE_HEADER;
+    remaining = padding;
+    padding = 0;
+}
+
+bool TarStream::parseHeader() {
+    bool allZero = true;
+    for (size_t i = 0; i < BLOCK_SIZE; i++) {
+        if (header[i] != 0) {
+            allZero = false;
+            break;
+        }
+    }
+    if (allZero) {
+        // Two zero blocks end the archive; whatever follows is record padding
+        if (++zeroBlocks == 2) {
+            state = STATE_END;
+        }
+        return true;
+    }
+    zeroBlocks = 0;
+
+    size_t expected;
+    if (!parseNumber(header + OFF_CHECKSUM, LEN_CHECKSUM, &expected)) {
+        return fail("Bad header checksum field");
+    }
+    uint32_t sum = 0;
+    for (size_t i = 0; i < BLOCK_SIZE; i++) {
+        sum += (i >= OFF_CHECKSUM && i < OFF_CHECKSUM + LEN_CHECKSUM) ? ' ' : header[i];
+    }
+    if (sum != expected) {
+        return fail("Header checksum mismatch");
+    }
+
+    size_t size;
+    if (!parseNumber(header + OFF_SIZE, LEN_SIZE, &size)) {
+        return fail("Bad size field");
+    }
+    char type = header[OFF_TYPE] == '\0' ? '0' : (char)header[OFF_TYPE];
+
+    switch (type) {
+        case 'L':   // GNU long name for the next member
+        case 'x':   // pax extended header for the next member
+            if (size > META_SIZE) {
+                return fail("Extended header too large");
+            }
+            metaType = type;
+            metaFill = 0;
+            startRun(STATE_META, size);
+            return state != STATE_ERROR;
+        case 'g':   // pax global header, GNU long link name: nothing we use
+        case 'K':
+            startRun(STATE_SKIP, size);
+            return true;
+        default:
+            break;
+    }
+
+    if (hasPendingName) {
+        memcpy(name, pendingName, NAME_SIZE);
+    } else {
+        // The prefix field only exists in POSIX ustar ("ustar\0"); GNU keeps other data there
+        size_t len = 0;
+        if (memcmp(header + OFF_MAGIC, "ustar\0", 6) == 0 && header[OFF_PREFIX] != '\0') {
+            len = strnlen((const char*)header + OFF_PREFIX, LEN_PREFIX);
+            memcpy(name, header + OFF_PREFIX, len);
+            name[len++] = '/';
+        }
+        size_t nameLen = strnlen((const char*)header + OFF_NAME, LEN_NAME);
+        if (len + nameLen >= NAME_SIZE) {
+            nameLen = NAME_SIZE - 1 - len;
+        }
+        memcpy(name + len, header + OFF_NAME, nameLen);
+        name[len + nameLen] = '\0';
+    }
+    if (hasPendingSize) {
+        size = pendingSize;
+    }
+    hasPendingName = false;
+    hasPendingSize = false;
+
+    entry.size = size;
+    entry.type = type;
+    Decision decision = onEntry ? onEntry(entry, ctx) : ENTRY_SKIP;
+    if (decision == ENTRY_ABORT) {
+        return fail("Aborted at member start");
+    }
+    startRun(decision == ENTRY_ACCEPT ? STATE_DATA : STATE_SKIP, size);
+    return state != STATE_ERROR;
+}
+
+// Records are "<length> <key>=<value>\n"; only path and size matter here
+void TarStream::parseMeta() {
+    if (metaType == 'L') {
+        size_t len = strnlen((const char*)meta, metaFill);
+        if (len >= NAME_SIZE) {
+            len = NAME_SIZE - 1;
+        }
+        memcpy(pendingName, meta, len);
+        pendingName[len] = '\0';
+        hasPendingName = true;
+        return;
+    }
+
+    size_t pos = 0;
+    while (pos < metaFill) {
+        size_t recordLen = 0;
+        size_t i = pos;
+        while (i < metaFill && meta[i] >= '0' && meta[i] <= '9') {
+            recordLen = recordLen * 10 + (meta[i++] - '0');
+        }
+        // The length covers its own digits, the space and the '\n'
+        if (i >= metaFill || meta[i] != ' ' || recordLen == 0 || recordLen > metaFill - pos ||
+            i + 1 > pos + recordLen - 1 || meta[pos + recordLen - 1] != '\n') {
+            return;   // Malformed: keep what was parsed so far
+        }
+        const char* key = (const char*)meta + i + 1;
+        const char* end = (const char*)meta + pos + recordLen - 1;   // The '\n'
+        const char* eq = (const char*)memchr(key, '=', end - key);
+        if (eq) {
+            size_t keyLen = eq - key;
+            const char* value = eq + 1;
+            size_t valueLen = end - value;
+            if (keyLen == 4 && memcmp(key, "path", 4) == 0) {
+                if (valueLen >= NAME_SIZE) {
+                    valueLen = NAME_SIZE - 1;
+                }
+                memcpy(pendingName, value, valueLen);
+                pendingName[valueLen] = '\0';
+                hasPendingName = true;
+            } else if (keyLen == 4 && memcmp(key, "size", 4) == 0) {
+                size_t size = 0;
+                for (size_t k = 0; k < valueLen && value[k] >= '0' && value[k] <= '9'; k++) {
+                    size = size * 10 + (value[k] - '0');
+                }
+                pendingSize = size;
+                hasPendingSize = true;
+            }
+        }
+        pos += recordLen;
+    }
+}
+
+bool TarStream::push(const uint8_t* data, size_t len) {
+    while (len > 0) {
+        size_t n;
+        switch (state) {
+            case STATE_HEADER:
+                n = BLOCK_SIZE - headerFill < len ? BLOCK_SIZE - headerFill : len;
+                memcpy(header + headerFill, data, n);
+                headerFill += n;
+                if (headerFill == BLOCK_SIZE) {
+                    headerFill = 0;
+                    if (!parseHeader()) {
+                        return false;
+                    }
+                }
+                break;
+
+            case STATE_DATA:
+                n = remaining < len ? remaining : len;
+                if (onData && !onData(data, n, ctx)) {
+                    return fail("Aborted in member data");
+                }
+                remaining -= n;
+                if (remaining == 0) {
+                    endRun();
+                }
+                break;
+
+            case STATE_META:
+                n = remaining < len ? remaining : len;
+                memcpy(meta + metaFill, data, n);   // Size checked against META_SIZE in parseHeader
+                metaFill += n;
+                remaining -= n;
+                if (remaining == 0) {
+                    endRun();
+                }
+                break;
+
+            case STATE_SKIP:
+            case STATE_PADDING:
+                n = remaining < len ? remaining : len;
+                remaining -= n;
+                if (remaining == 0) {
+                    if (state == STATE_SKIP) {
+                        endRun();
+                    } else {
+                        state = STATE_HEADER;
+                    }
+                }
+                break;
+
+            case STATE_END:
+                return true;   // Record padding after the end blocks
+
+            default:
+                return false;
+        }
+        data += n;
+        len -= n;
+        if (state == STATE_ERROR) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool TarStream::finish() {
+    if (state == STATE_ERROR) {
+        return false;
+    }
+    // Writers that omit the end blocks still stop on a member boundary
+    if (state == STATE_END || (state == STATE_HEADER && headerFill == 0 && !hasPendingName && !hasPendingSize)) {
+        return true;
+    }
+    return fail("Archive truncated");
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Incremental, push-based TAR reader.
+ *
+ * Feed the archive in chunks of any size with push(); member data is handed
+ * to the data callback as pointers into those chunks, so nothing is copied
+ * except the 512 byte headers. Understands ustar (including the prefix
+ * field), GNU long names ('L') and pax extended headers ('x': path, size).
+ *
+ * No allocation and no ESP-IDF dependency, so it runs unchanged on the host.
+ */
+class TarStream {
+public:
+    static const size_t BLOCK_SIZE = 512;
+    static const size_t NAME_SIZE = 256;   // Longer names are truncated
+    static const size_t META_SIZE = 512;   // Largest GNU long name / pax header data
+
+    struct Entry {
+        const char* name;   // pax path, GNU long name or prefix/name
+        size_t size;
+        char type;          // '0' regular file ('\0' is mapped to '0'), '5' directory, ...
+    };
+
+    enum Decision : uint8_t {
+        ENTRY_SKIP = 0,     // Discard the member data
+        ENTRY_ACCEPT,       // Deliver the member data
+        ENTRY_ABORT         // Stop the whole stream
+    };
+
+    typedef Decision (*EntryFunction)(const Entry& entry, void* ctx);
+    // Data of an accepted member, in order; false aborts the stream
+    typedef bool (*DataFunction)(const uint8_t* data, size_t len, void* ctx);
+    // All data of an accepted member delivered; false aborts the stream
+    typedef bool (*EndFunction)(const Entry& entry, void* ctx);
+
+    TarStream(EntryFunction onEntry, DataFunction onData, EndFunction onEnd, void* ctx);
+
+    /**
+     * Parse the next part of the archive
+     * @return false once the archive is invalid or a callback aborted
+     */
+    bool push(const uint8_t* data, size_t len);
+
+    /**
+     * Input is over
+     * @return true if it ended at the end-of-archive blocks or between members
+     */
+    bool finish();
+
+    bool done() const { return state == STATE_END; }
+    const char* getError() const { return error; }
+
+private:
+    enum State : uint8_t {
+        STATE_HEADER = 0,
+        STATE_DATA,      // Member data for the callbacks
+        STATE_SKIP,      // Member data nobody wants
+        STATE_META,      // GNU long name or pax header data
+        STATE_PADDING,   // Up to the next 512 byte boundary
+        STATE_END,
+        STATE_ERROR
+    };
+
+    EntryFunction onEntry;
+    DataFunction onData;
+    EndFunction onEnd;
+    void* ctx;
+
+    State state;
+    uint8_t header[BLOCK_SIZE];
+    size_t headerFill;
+    uint8_t zeroBlocks;
+    size_t remaining;        // Bytes left in the current data / meta / padding run
+    size_t padding;          // Padding after the current run
+
+    char metaType;           // 'L' or 'x' while in STATE_META
+    uint8_t meta[META_SIZE];
+    size_t metaFill;
+
+    // Overrides for the next header, from 'L' or 'x'
+    char pendingName[NAME_SIZE];
+    bool hasPendingName;
+    size_t pendingSize;
+    bool hasPendingSize;
+
+    char name[NAME_SIZE];
+    Entry entry;
+    const char* error;
+
+    bool parseHeader();
+    void parseMeta();
+    void startRun(State next, size_t size);
+    void endRun();
+    bool fail(const char* message);
+    static bool parseNumber(const uint8_t* field, size_t len, size_t* out);
+};
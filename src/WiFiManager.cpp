@@ -4,16 +4,28 @@
 #include "nvs.h"
 #include "esp_log.h"
 #include "esp_timer.h"
+#include "esp_idf_version.h"
 #include "lwip/ip4_addr.h"
+#include "freertos/FreeRTOS.h"
 #include <string.h>
+#include <stdlib.h>
 
 static const char *TAG = "WiFiManager";
 
+// Scan cache timing
+static const int64_t SCAN_REFRESH_US = 60LL * 1000000LL;   // Refresh interval while someone is looking
+static const int64_t SCAN_INTEREST_US = 120LL * 1000000LL; // How long a request counts as interest
+static const int64_t SCAN_TIMEOUT_US = 15LL * 1000000LL;   // Give up on a scan that never reported done
+static const uint16_t SCAN_MAX_RECORDS = 32;               // Raw records fetched per scan
+
+static portMUX_TYPE scan_lock = portMUX_INITIALIZER_UNLOCKED;
+
 WiFiManager wifi;
 extern ServerManager web;
 
 WiFiManager::WiFiManager() 
-    : sta_netif(nullptr), ap_netif(nullptr), sta_connected(false), ap_started(false), ip_wait_start_time(0) {
+    : sta_netif(nullptr), ap_netif(nullptr), sta_connected(false), ap_started(false), ip_wait_start_time(0),
+      scanCount(0), scanInProgress(false), scanStartedUs(0), scanCompletedUs(0), scanInterestUs(0) {
 }
 
 void WiFiManager::wifi_event_handler(void* arg, esp_event_base_t event_base,
@@ -46,6 +58,11 @@ void WiFiManager::wifi_event_handler(void* arg, esp_event_base_t event_base,
                 // Don't auto-reconnect here - let checkWiFiConnection handle it
                 // to avoid spamming reconnect attempts that interfere with AP
                 break;
+            case WIFI_EVENT_SCAN_DONE: {
+                wifi_event_sta_scan_done_t* event = (wifi_event_sta_scan_done_t*) event_data;
+                manager->onScanDone(event->status == 0);
+                break;
+            }
         }
     } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
         ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
@@ -53,19 +70,23 @@ void WiFiManager::wifi_event_handler(void* arg, esp_event_base_t event_base,
         manager->sta_connected = true;
         manager->ip_wait_start_time = 0;  // Reset IP wait timer
         
-        // Restart HTTP server in separate task to avoid stack overflow in sys_evt
-        ESP_LOGI(TAG, "Scheduling HTTP server restart for STA interface...");
-        xTaskCreate(
-            [](void* param) {
-                web.restart();
-                vTaskDelete(NULL);
-            },
-            "http_restart",
-            4096,
-            NULL,
-            5,
-            NULL
-        );
+        // The HTTP server listens on all interfaces and keeps running across
+        // IP changes; it only needs starting if it is not up (e.g. failed at boot).
+        // Separate task to avoid stack overflow in sys_evt
+        if (!web.isRunning()) {
+            ESP_LOGW(TAG, "HTTP server not running, starting it for STA interface...");
+            xTaskCreate(
+                [](void* param) {
+                    web.restart();
+                    vTaskDelete(NULL);
+                },
+                "http_restart",
+                4096,
+                NULL,
+                5,
+                NULL
+            );
+        }
     }
 }
 
@@ -239,6 +260,8 @@ void WiFiManager::clearCredentials() {
 }
 
 void WiFiManager::checkWiFiConnection() {
+    serviceScanner();
+    
     // Throttle reconnection attempts to avoid log spam
     static int64_t lastReconnectAttempt = 0;
     int64_t now = esp_timer_get_time() / 1000000; // Convert to seconds
@@ -260,7 +283,7 @@ void WiFiManager::checkWiFiConnection() {
             
             // Check if we've been waiting too long for IP
             if (now - ip_wait_start_time > IP_WAIT_TIMEOUT) {
-                ESP_LOGW(TAG, "IP address timeout after %lld seconds. Forcing reconnect...", IP_WAIT_TIMEOUT);
+                ESP_LOGW(TAG, "IP address timeout after %lld seconds. Forcing reconnect...", (long long)IP_WAIT_TIMEOUT);
                 ip_wait_start_time = 0;
                 esp_wifi_disconnect();
                 return;
@@ -268,7 +291,7 @@ void WiFiManager::checkWiFiConnection() {
             
             // Log every 5 seconds to reduce spam
             if ((now - ip_wait_start_time) % 5 == 0) {
-                ESP_LOGI(TAG, "Still waiting for IP address... (%lld seconds)", now - ip_wait_start_time);
+                ESP_LOGI(TAG, "Still waiting for IP address... (%lld seconds)", (long long)(now - ip_wait_start_time));
             }
             return;
         }
@@ -384,3 +407,185 @@ int WiFiManager::getStationNum() {
     return sta_list.num;
 }
 
+bool WiFiManager::requestScan() {
+    int64_t now = esp_timer_get_time();
+    
+    // Coalesce: only one scan at a time, later callers just get its result
+    portENTER_CRITICAL(&scan_lock);
+    if (scanInProgress && now - scanStartedUs < SCAN_TIMEOUT_US) {
+        portEXIT_CRITICAL(&scan_lock);
+        return true;
+    }
+    scanInProgress = true;
+    scanStartedUs = now;
+    portEXIT_CRITICAL(&scan_lock);
+    
+    // Scanning needs the STA interface; in pure AP mode switch to APSTA
+    wifi_mode_t mode;
+    if (esp_wifi_get_mode(&mode) != ESP_OK) {
+        scanInProgress = false;
+        return false;
+    }
+    if (mode == WIFI_MODE_AP) {
+        if (!sta_netif) {
+            sta_netif = esp_netif_create_default_wifi_sta();
+        }
+        ESP_LOGI(TAG, "Switching from AP to APSTA mode for scanning");
+        if (esp_wifi_set_mode(WIFI_MODE_APSTA) != ESP_OK) {
+            scanInProgress = false;
+            return false;
+        }
+    }
+    
+    // Short active dwell keeps AP clients served; IDF 5.1+ also returns to the
+    // home channel between scanned channels
+    wifi_scan_config_t scan_config = {
+        .ssid = NULL,
+        .bssid = NULL,
+        .channel = 0,
+        .show_hidden = false,
+        .scan_type = WIFI_SCAN_TYPE_ACTIVE,
+        .scan_time = {
+            .active = {
+                .min = 0,
+                .max = 120
+            },
+            .passive = 0
+        },
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 1, 0)
+        .home_chan_dwell_time = 30
+#endif
+    };
+    
+    esp_err_t err = esp_wifi_scan_start(&scan_config, false);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "WiFi scan start failed: %s", esp_err_to_name(err));
+        scanInProgress = false;
+        return false;
+    }
+    
+    ESP_LOGI(TAG, "Background WiFi scan started");
+    return true;
+}
+
+void WiFiManager::requestScanIfStale(uint32_t maxAgeMs) {
+    int64_t now = esp_timer_get_time();
+    scanInterestUs = now;
+    
+    if (scanCompletedUs == 0 || now - scanCompletedUs > (int64_t)maxAgeMs * 1000) {
+        requestScan();
+    }
+}
+
+// Runs on the event task: pull the records, dedupe and sort them into the cache
+void WiFiManager::onScanDone(bool success) {
+    if (!success) {
+        ESP_LOGW(TAG, "WiFi scan failed");
+        scanInProgress = false;
+        return;
+    }
+    
+    uint16_t count = 0;
+    esp_wifi_scan_get_ap_num(&count);
+    if (count > SCAN_MAX_RECORDS) {
+        count = SCAN_MAX_RECORDS;
+    }
+    
+    // Heap, not stack: the event task stack is small
+    wifi_ap_record_t* records = NULL;
+    if (count > 0) {
+        records = (wifi_ap_record_t*)malloc(sizeof(wifi_ap_record_t) * count);
+    }
+    if (records == NULL) {
+        // Still fetch one record so the driver releases its result list
+        wifi_ap_record_t discard;
+        uint16_t one = 1;
+        esp_wifi_scan_get_ap_records(&one, &discard);
+        count = 0;
+    } else {
+        esp_wifi_scan_get_ap_records(&count, records);
+    }
+    
+    WiFiScanEntry fresh[SCAN_CACHE_SIZE];
+    uint8_t freshCount = 0;
+    
+    for (uint16_t i = 0; i < count; i++) {
+        const char* ssid = (const char*)records[i].ssid;
+        if (ssid[0] == '\0') {
+            continue;  // Hidden network
+        }
+        
+        // Same SSID from several APs: keep the strongest
+        int existing = -1;
+        for (uint8_t j = 0; j < freshCount; j++) {
+            if (strcmp(fresh[j].ssid, ssid) == 0) {
+                existing = j;
+                break;
+            }
+        }
+        if (existing >= 0) {
+            if (records[i].rssi <= fresh[existing].rssi) {
+                continue;
+            }
+        } else if (freshCount < SCAN_CACHE_SIZE) {
+            existing = freshCount++;
+        } else if (records[i].rssi > fresh[SCAN_CACHE_SIZE - 1].rssi) {
+            existing = SCAN_CACHE_SIZE - 1;  // Replace the weakest
+        } else {
+            continue;
+        }
+        
+        WiFiScanEntry& entry = fresh[existing];
+        strncpy(entry.ssid, ssid, sizeof(entry.ssid) - 1);
+        entry.ssid[sizeof(entry.ssid) - 1] = '\0';
+        entry.rssi = records[i].rssi;
+        entry.channel = records[i].primary;
+        entry.authmode = (uint8_t)records[i].authmode;
+        
+        // Insertion step keeps the list sorted by RSSI, strongest first
+        for (int k = existing; k > 0 && fresh[k].rssi > fresh[k - 1].rssi; k--) {
+            WiFiScanEntry tmp = fresh[k];
+            fresh[k] = fresh[k - 1];
+            fresh[k - 1] = tmp;
+        }
+    }
+    free(records);
+    
+    portENTER_CRITICAL(&scan_lock);
+    memcpy(scanCache, fresh, sizeof(WiFiScanEntry) * freshCount);
+    scanCount = freshCount;
+    scanCompletedUs = esp_timer_get_time();
+    scanInProgress = false;
+    portEXIT_CRITICAL(&scan_lock);
+    
+    ESP_LOGI(TAG, "WiFi scan done: %u networks (%u unique)", (unsigned int)count, (unsigned int)freshCount);
+}
+
+uint8_t WiFiManager::getScanResults(WiFiScanEntry* out, uint8_t maxEntries, int64_t* ageMs, bool* scanning) {
+    int64_t now = esp_timer_get_time();
+    
+    portENTER_CRITICAL(&scan_lock);
+    uint8_t n = scanCount < maxEntries ? scanCount : maxEntries;
+    memcpy(out, scanCache, sizeof(WiFiScanEntry) * n);
+    *ageMs = scanCompletedUs == 0 ? -1 : (now - scanCompletedUs) / 1000;
+    *scanning = scanInProgress;
+    portEXIT_CRITICAL(&scan_lock);
+    
+    return n;
+}
+
+void WiFiManager::serviceScanner() {
+    int64_t now = esp_timer_get_time();
+    
+    // Recover from a scan whose SCAN_DONE never arrived
+    if (scanInProgress && now - scanStartedUs > SCAN_TIMEOUT_US) {
+        ESP_LOGW(TAG, "WiFi scan timed out");
+        scanInProgress = false;
+    }
+    
+    // Low duty: only refresh while a client looked at the list recently
+    if (scanInterestUs != 0 && now - scanInterestUs < SCAN_INTEREST_US &&
+        !scanInProgress && now - scanCompletedUs > SCAN_REFRESH_US) {
+        requestScan();
+    }
+}
@@ -4,6 +4,14 @@
 #include "esp_netif.h"
 #include "Config.h"
 
+// Compact scan result kept in the background scan cache
+struct WiFiScanEntry {
+    char ssid[33];
+    int8_t rssi;
+    uint8_t channel;
+    uint8_t authmode;
+};
+
 class WiFiManager {
 public:
     WiFiManager();
@@ -19,6 +27,13 @@ public:
     void getAPIP(char* ipStr, size_t maxLen);
     int getStationNum();
     
+    // Background scan cache: deduplicated by SSID, strongest first
+    static const uint8_t SCAN_CACHE_SIZE = 24;
+    bool requestScan();                      // Non-blocking; joins a scan already running
+    void requestScanIfStale(uint32_t maxAgeMs);
+    uint8_t getScanResults(WiFiScanEntry* out, uint8_t maxEntries, int64_t* ageMs, bool* scanning);
+    void serviceScanner();                   // Periodic refresh while the list is being viewed
+    
     static void wifi_event_handler(void* arg, esp_event_base_t event_base,
                                    int32_t event_id, void* event_data);
     
@@ -28,5 +43,15 @@ private:
     bool sta_connected;
     bool ap_started;
     int64_t ip_wait_start_time;  // Track when we started waiting for IP
+    
+    // Scan cache (guarded by scan_lock in WiFiManager.cpp - written from the event task)
+    WiFiScanEntry scanCache[SCAN_CACHE_SIZE];
+    uint8_t scanCount;
+    volatile bool scanInProgress;
+    int64_t scanStartedUs;
+    int64_t scanCompletedUs;             // 0 = no scan finished yet
+    int64_t scanInterestUs;              // Last time a client asked for results
+    
+    void onScanDone(bool success);
 };
 extern WiFiManager wifi;
@@ -0,0 +1,62 @@
+// Stand-ins for the parts of the firmware that only talk to hardware or a
+// broker. They keep the state the web handlers read back and nothing more.
+#include "KMeterIsoComponent.h"
+#include "KMeterManager.h"
+#include "LEDManager.h"
+#include "MQTTManager.h"
+#include "ServerManager.h"
+#include "Wire.h"
+
+TwoWire Wire;
+
+// Globals normally defined by main.cpp
+ServerManager web;
+LEDManager led;
+KMeterIsoComponent kmeterIso;
+
+MQTTManager mqttManager;
+
+KMeterManager::KMeterManager()
+    : i2c_port(I2C_NUM_0), initialized(false), lastReadTime(0),
+      currentTempCelsius(0.0f), currentTempFahrenheit(32.0f), internalTempCelsius(0.0f), errorStatus(255),
+      i2cAddress(0x66), sdaPin(21), sclPin(22), i2cSpeed(100000), readInterval(1000000) {
+}
+
+// Hybrid mode reads the Arduino sensor; the legacy driver stays uninitialized
+void KMeterManager::update() {
+}
+
+const char* KMeterManager::getStatusString() const {
+    return "Not Initialized";
+}
+
+void LEDManager::begin() {
+    current_r = current_g = current_b = 0;
+    led_is_on = false;
+}
+
+void LEDManager::setColor(uint8_t r, uint8_t g, uint8_t b) {
+    current_r = r;
+    current_g = g;
+    current_b = b;
+    led_is_on = r != 0 || g != 0 || b != 0;
+}
+
+void LEDManager::off() {
+    setColor(0, 0, 0);
+}
+
+MQTTManager::MQTTManager()
+    : mqtt_client(nullptr), lastReconnectAttempt(0), lastHeartbeat(0), autoDiscoveryPublished(false),
+      connected(false), ledCallback(nullptr), ledColorCallback(nullptr) {
+}
+
+bool MQTTManager::isConnected() {
+    return connected;
+}
+
+void MQTTManager::reconnect() {
+}
+
+void MQTTManager::publishLEDState(bool isOn, uint8_t r, uint8_t g, uint8_t b) {
+}
@@ -0,0 +1,306 @@
+// File-backed flash with a latency model for the OTA benchmark; replaces
+// shim/src/esp_partition.cpp. See flash_fake.h.
+#include "flash_fake.h"
+#include "host_esp.h"
+#include "esp_err.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace flash_fake {
+
+const Timing TYPICAL = { "typ", 45000, 150000, 400, 20, 100 };
+const Timing WORST = { "max", 400000, 2000000, 3000, 50, 100 };
+
+}  // namespace flash_fake
+
+namespace {
+
+using namespace flash_fake;
+
+static const uint8_t IMAGE_MAGIC = 0xE9;         // ESP_IMAGE_HEADER_MAGIC
+static const size_t VERIFY_WINDOW = 64 * 1024;   // esp_image_verify reads through mmap pages
+static const size_t OTADATA_ENTRY = 32;          // esp_ota_select_entry_t
+
+// partitions.csv
+esp_partition_t partitions[REGION_COUNT] = {
+    { nullptr, ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_FACTORY, 0x10000, 0x180000, "factory", false },
+    { nullptr, ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_0, 0x190000, 0x180000, "ota_0", false },
+    { nullptr, ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_OTA, 0x310000, 0x2000, "otadata", false },
+    { nullptr, ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_SPIFFS, 0x312000, 0xEE000, "spiffs", false },
+};
+
+uint8_t* flash = nullptr;
+int flashFd = -1;
+Timing timing = TYPICAL;
+Counters stats;
+const esp_partition_t* bootTo = nullptr;
+
+// One update at a time, as in OTAManager
+struct OtaSlot {
+    esp_ota_handle_t handle;
+    const esp_partition_t* partition;
+    size_t written;
+};
+OtaSlot ota = { 0, nullptr, 0 };
+esp_ota_handle_t nextHandle = 1;
+
+void spend(int64_t us) {
+    stats.flashUs += us;
+    host_esp::advanceTime(us);
+}
+
+bool inPartition(const esp_partition_t* partition, size_t offset, size_t size) {
+    return partition != nullptr && offset <= partition->size && size <= partition->size - offset;
+}
+
+// spi_flash_erase_range: 64 KB block erase where aligned, sectors elsewhere
+void eraseFlash(size_t address, size_t size) {
+    stats.eraseCalls++;
+    int64_t us = timing.callUs;
+    size_t end = address + size;
+    while (address < end) {
+        size_t step = SPI_FLASH_SEC_SIZE;
+        if (address % BLOCK_SIZE == 0 && end - address >= BLOCK_SIZE) {
+            step = BLOCK_SIZE;
+            stats.blockErases++;
+            us += timing.blockEraseUs;
+        } else {
+            stats.sectorErases++;
+            us += timing.sectorEraseUs;
+        }
+        memset(flash + address, 0xFF, step);
+        address += step;
+    }
+    spend(us);
+}
+
+// NOR flash programs by clearing bits; whatever was not erased stays set to 0
+void programFlash(size_t address, const uint8_t* data, size_t size) {
+    stats.writeCalls++;
+    stats.bytesWritten += size;
+    uint8_t* dst = flash + address;
+    bool bad = false;
+    for (size_t i = 0; i < size; i++) {
+        bad |= (dst[i] & data[i]) != data[i];
+        dst[i] &= data[i];
+    }
+    if (bad) {
+        stats.badWrites++;
+    }
+    uint32_t pages = size == 0 ? 0 : (uint32_t)((address + size - 1) / PAGE_SIZE - address / PAGE_SIZE + 1);
+    stats.pagesProgrammed += pages;
+    spend(timing.callUs + (int64_t)pages * timing.pageProgramUs);
+}
+
+void readFlash(size_t address, void* dst, size_t size) {
+    stats.readCalls++;
+    stats.bytesRead += size;
+    if (dst) {
+        memcpy(dst, flash + address, size);
+    }
+    spend(timing.callUs + (int64_t)size * timing.readNsPerByte / 1000);
+}
+
+}  // namespace
+
+namespace flash_fake {
+
+bool open(const char* path) {
+    char temp[] = "/tmp/ota_bench_flash_XXXXXX";
+    int fd = path ? ::open(path, O_RDWR | O_CREAT, 0644) : mkstemp(temp);
+    if (fd < 0) {
+        perror(path ? path : temp);
+        return false;
+    }
+    if (!path) {
+        unlink(temp);
+    }
+    if (ftruncate(fd, FLASH_SIZE) != 0) {
+        perror("ftruncate");
+        ::close(fd);
+        return false;
+    }
+    void* map = mmap(nullptr, FLASH_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        ::close(fd);
+        return false;
+    }
+    flash = (uint8_t*)map;
+    flashFd = fd;
+    return true;
+}
+
+void close() {
+    if (flash) {
+        munmap(flash, FLASH_SIZE);
+        ::close(flashFd);
+        flash = nullptr;
+        flashFd = -1;
+    }
+}
+
+void setTiming(const Timing& t) {
+    timing = t;
+}
+
+const Counters& counters() {
+    return stats;
+}
+
+void resetCounters() {
+    memset(&stats, 0, sizeof(stats));
+}
+
+const esp_partition_t* partition(Region region) {
+    return &partitions[region];
+}
+
+uint8_t* contents(Region region) {
+    return flash + partitions[region].address;
+}
+
+const esp_partition_t* bootPartition() {
+    return bootTo;
+}
+
+void resetBootPartition() {
+    bootTo = nullptr;
+}
+
+}  // namespace flash_fake
+
+extern "C" {
+
+const esp_partition_t* esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype, const char* label) {
+    for (size_t i = 0; i < REGION_COUNT; i++) {
+        const esp_partition_t* p = &partitions[i];
+        if (p->type == type && (subtype == ESP_PARTITION_SUBTYPE_ANY || p->subtype == subtype) &&
+            (label == nullptr || strcmp(p->label, label) == 0)) {
+            return p;
+        }
+    }
+    return nullptr;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t* partition, size_t src_offset, void* dst, size_t size) {
+    if (!inPartition(partition, src_offset, size)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    readFlash(partition->address + src_offset, dst, size);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t* partition, size_t dst_offset, const void* src, size_t size) {
+    if (!inPartition(partition, dst_offset, size)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    programFlash(partition->address + dst_offset, (const uint8_t*)src, size);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t* partition, size_t offset, size_t size) {
+    if (!inPartition(partition, offset, size)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (offset % SPI_FLASH_SEC_SIZE != 0 || size % SPI_FLASH_SEC_SIZE != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    eraseFlash(partition->address + offset, size);
+    return ESP_OK;
+}
+
+// The device boots from factory and updates into ota_0
+const esp_partition_t* esp_ota_get_running_partition(void) {
+    return &partitions[FACTORY];
+}
+
+const esp_partition_t* esp_ota_get_next_update_partition(const esp_partition_t* start_from) {
+    return &partitions[OTA_0];
+}
+
+// IDF 4.4 erases the announced size plus one sector up front
+esp_err_t esp_ota_begin(const esp_partition_t* partition, size_t image_size, esp_ota_handle_t* out_handle) {
+    if (partition == nullptr || partition->type != ESP_PARTITION_TYPE_APP || partition == &partitions[FACTORY]) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    size_t erase = partition->size;
+    if (image_size != OTA_SIZE_UNKNOWN && image_size != OTA_WITH_SEQUENTIAL_WRITES) {
+        erase = (image_size / SPI_FLASH_SEC_SIZE + 1) * SPI_FLASH_SEC_SIZE;
+        if (erase > partition->size) {
+            erase = partition->size;
+        }
+    }
+    eraseFlash(partition->address, erase);
+    ota.handle = nextHandle++;
+    ota.partition = partition;
+    ota.written = 0;
+    *out_handle = ota.handle;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_write(esp_ota_handle_t handle, const void* data, size_t size) {
+    if (ota.partition == nullptr || handle != ota.handle) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (ota.written == 0 && size > 0 && ((const uint8_t*)data)[0] != IMAGE_MAGIC) {
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+    if (!inPartition(ota.partition, ota.written, size)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    programFlash(ota.partition->address + ota.written, (const uint8_t*)data, size);
+    ota.written += size;
+    return ESP_OK;
+}
+
+// esp_image_verify() reads the whole image back before the handle closes
+esp_err_t esp_ota_end(esp_ota_handle_t handle) {
+    if (ota.partition == nullptr || handle != ota.handle) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    const esp_partition_t* partition = ota.partition;
+    size_t written = ota.written;
+    ota.partition = nullptr;
+    if (written == 0 || flash[partition->address] != IMAGE_MAGIC) {
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+    for (size_t offset = 0; offset < written; offset += VERIFY_WINDOW) {
+        readFlash(partition->address + offset, nullptr,
+                  written - offset < VERIFY_WINDOW ? written - offset : VERIFY_WINDOW);
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_abort(esp_ota_handle_t handle) {
+    if (ota.partition == nullptr || handle != ota.handle) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    ota.partition = nullptr;
+    return ESP_OK;
+}
+
+// Reads both otadata entries, rewrites the sector of the older one
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t* partition) {
+    if (partition == nullptr || partition->type != ESP_PARTITION_TYPE_APP) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    const esp_partition_t* otadata = &partitions[OTADATA];
+    uint8_t entry[OTADATA_ENTRY];
+    readFlash(otadata->address, entry, sizeof(entry));
+    readFlash(otadata->address + SPI_FLASH_SEC_SIZE, entry, sizeof(entry));
+    eraseFlash(otadata->address, SPI_FLASH_SEC_SIZE);
+    memset(entry, 0xFF, sizeof(entry));
+    entry[0] = 1;   // ota_seq
+    programFlash(otadata->address, entry, sizeof(entry));
+    bootTo = partition;
+    return ESP_OK;
+}
+
+}  // extern "C"
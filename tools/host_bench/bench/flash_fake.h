@@ -0,0 +1,78 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_partition.h"
+
+/**
+ * File-backed SPI flash for the OTA benchmark.
+ *
+ * The 4 MB chip is an mmap'd file with the partitions of partitions.csv at
+ * their real offsets; esp_partition_* and esp_ota_* work on it the way
+ * IDF 4.4 does. Erase sets bytes to 0xFF (64 KB blocks where aligned, like
+ * spi_flash_erase_range), programming can only clear bits, so a missing
+ * erase shows up as a corrupt image instead of passing unnoticed.
+ *
+ * Every operation advances the virtual clock by a latency model, which makes
+ * OTAPipeline's statistics and the benchmark's flash time what the chip
+ * would have spent.
+ */
+namespace flash_fake {
+
+static const size_t FLASH_SIZE = 4 * 1024 * 1024;
+static const size_t PAGE_SIZE = 256;
+static const size_t BLOCK_SIZE = 64 * 1024;
+
+// Latencies of the flash chip (W25Q32-class datasheet values) plus the cost
+// of an IDF flash call: cache disable/enable and the SPI transaction setup
+struct Timing {
+    const char* name;
+    uint32_t sectorEraseUs;   // 4 KB
+    uint32_t blockEraseUs;    // 64 KB
+    uint32_t pageProgramUs;   // Per 256-byte page touched
+    uint32_t callUs;          // Per erase/write/read call
+    uint32_t readNsPerByte;   // 40 MHz DIO
+};
+
+extern const Timing TYPICAL;
+extern const Timing WORST;
+
+struct Counters {
+    uint32_t eraseCalls;
+    uint32_t sectorErases;
+    uint32_t blockErases;
+    uint32_t writeCalls;
+    uint32_t pagesProgrammed;
+    size_t bytesWritten;
+    uint32_t readCalls;
+    size_t bytesRead;
+    uint32_t badWrites;       // Programmed over bits that were not erased
+    int64_t flashUs;          // Modeled time of all of the above
+};
+
+enum Region { FACTORY = 0, OTA_0, OTADATA, SPIFFS, REGION_COUNT };
+
+/**
+ * Map the flash file (created or grown to FLASH_SIZE); nullptr: an unlinked
+ * temporary file
+ */
+bool open(const char* path);
+void close();
+
+void setTiming(const Timing& timing);
+const Counters& counters();
+void resetCounters();
+
+const esp_partition_t* partition(Region region);
+
+/**
+ * Direct view of a partition, bypassing counters and latency
+ */
+uint8_t* contents(Region region);
+
+/**
+ * Partition of the last esp_ota_set_boot_partition(), nullptr before
+ */
+const esp_partition_t* bootPartition();
+void resetBootPartition();
+
+}  // namespace flash_fake
@@ -0,0 +1,462 @@
+// Host benchmark for the HTTP handlers.
+//
+// Boots the firmware the way main.cpp does (NVS, WiFi, Config, sensor, web
+// server) on top of the shims, logs in, then replays a fixed set of requests.
+// Per endpoint it reports wire bytes, heap allocations per request, peak
+// stack depth and median/p95 latency, and compares them with a baseline file.
+#include "host_esp.h"
+#include "host_httpd.h"
+#include "Config.h"
+#include "KMeterIsoComponent.h"
+#include "LEDManager.h"
+#include "ServerManager.h"
+#include "WiFiManager.h"
+#include "esp_event.h"
+#include "esp_netif.h"
+#include "esp_wifi.h"
+#include "nvs_flash.h"
+#include <algorithm>
+#include <map>
+#include <new>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <time.h>
+#include <vector>
+
+extern ServerManager web;
+extern LEDManager led;
+extern KMeterIsoComponent kmeterIso;
+extern WiFiManager wifi;
+
+// ---------------------------------------------------------------------------
+// Allocation counting: malloc & co. are wrapped at link time (-Wl,--wrap),
+// operator new is replaced. Only calls made while host_esp::measuring is set
+// are counted, i.e. firmware code inside a handler, not shim bookkeeping.
+// ---------------------------------------------------------------------------
+
+static thread_local unsigned alloc_count = 0;
+
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t n, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+void __real_free(void* ptr);
+
+void* __wrap_malloc(size_t size) {
+    if (host_esp::measuring) alloc_count++;
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t n, size_t size) {
+    if (host_esp::measuring) alloc_count++;
+    return __real_calloc(n, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+    if (host_esp::measuring) alloc_count++;
+    return __real_realloc(ptr, size);
+}
+
+void __wrap_free(void* ptr) {
+    __real_free(ptr);
+}
+}
+
+void* operator new(size_t size) {
+    if (host_esp::measuring) alloc_count++;
+    void* p = __real_malloc(size ? size : 1);
+    if (p == nullptr) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    if (host_esp::measuring) alloc_count++;
+    return __real_malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return operator new(size, std::nothrow);
+}
+
+void operator delete(void* ptr) noexcept {
+    __real_free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    __real_free(ptr);
+}
+
+// ---------------------------------------------------------------------------
+// Scenarios
+// ---------------------------------------------------------------------------
+
+struct Scenario {
+    const char* name;
+    httpd_method_t method;
+    const char* uri;
+    const char* body;
+    bool auth;
+};
+
+// GETs first; the POSTs change state the GETs report. Login last: every
+// iteration creates a session and would eventually evict the bench session.
+static const Scenario scenarios[] = {
+    { "status",               HTTP_GET,  "/api/status",                    nullptr, true },
+    { "status_bin",           HTTP_GET,  "/api/status.bin",                nullptr, true },
+    { "dashboard",            HTTP_GET,  "/api/dashboard",                 nullptr, true },
+    { "dashboard_fields",     HTTP_GET,  "/api/dashboard?fields=temperature_celsius,duty_percent", nullptr, true },
+    { "system_info",          HTTP_GET,  "/api/system-info",               nullptr, false },
+    { "settings",             HTTP_GET,  "/api/settings",                  nullptr, true },
+    { "server_stats",         HTTP_GET,  "/api/server-stats",              nullptr, true },
+    { "kmeter_status",        HTTP_GET,  "/api/kmeter-status",             nullptr, true },
+    { "pwm_status",           HTTP_GET,  "/api/pwm-status",                nullptr, true },
+    { "wifi_status",          HTTP_GET,  "/api/wifi-status",               nullptr, true },
+    { "temp_mapping_status",  HTTP_GET,  "/api/temp-mapping-status",       nullptr, true },
+    { "ota_status",           HTTP_GET,  "/api/ota/status",                nullptr, true },
+    { "unauthorized",         HTTP_GET,  "/api/status",                    nullptr, false },
+    { "not_found",            HTTP_GET,  "/api/does-not-exist",            nullptr, true },
+    { "pwm_control",          HTTP_POST, "/api/pwm/control",               "{\"duty\":40}", true },
+    { "led_color",            HTTP_POST, "/api/led-color",                 "r=255&g=128&b=0", true },
+    { "settings_batch",       HTTP_POST, "/api/settings/batch",            "{\"device_name\":\"Bench\"}", true },
+    { "login",                HTTP_POST, "/api/login",                     "{\"password\":\"smarthome-assistant.info\"}", false },
+};
+static const size_t SCENARIO_COUNT = sizeof(scenarios) / sizeof(scenarios[0]);
+
+// Virtual time between requests: 4 requests/s stays inside the rate limits
+static const int64_t REQUEST_SPACING_US = 250000;
+
+struct Result {
+    size_t bytes;       // Largest response on the wire
+    unsigned allocs;    // Most allocations in one request
+    size_t stack;       // Peak stack depth below the calibration frame
+    double medianUs;
+    double p95Us;
+};
+
+struct Options {
+    const char* baselinePath;
+    bool updateBaseline;
+    bool checkLatency;
+    int iterations;
+    bool verbose;
+};
+
+static std::string session_cookie;
+
+static double elapsed_us(const timespec& a, const timespec& b) {
+    return (b.tv_sec - a.tv_sec) * 1e6 + (b.tv_nsec - a.tv_nsec) / 1e3;
+}
+
+static void tick() {
+    host_esp::advanceTime(REQUEST_SPACING_US);
+    kmeterIso.update();
+    web.updateSensors();
+    host_httpd::runQueuedWork();
+}
+
+static void build_request(const Scenario& s, int sockfd, host_httpd::Request* request) {
+    request->method = s.method;
+    request->uri = s.uri;
+    request->headers.clear();
+    request->headers.push_back(std::make_pair(std::string("Host"), std::string("192.168.0.42")));
+    if (s.auth) {
+        request->headers.push_back(std::make_pair(std::string("Cookie"), session_cookie));
+    }
+    if (s.body != nullptr) {
+        request->headers.push_back(std::make_pair(std::string("Content-Type"),
+            std::string(s.body[0] == '{' ? "application/json" : "application/x-www-form-urlencoded")));
+    }
+    request->body = s.body ? s.body : "";
+    request->sockfd = sockfd;
+}
+
+// ---------------------------------------------------------------------------
+// Stack measurement: each run gets its own thread on a painted stack
+// ---------------------------------------------------------------------------
+
+static const size_t BENCH_STACK_SIZE = 512 * 1024;
+static const uint8_t STACK_PAINT = 0xA5;
+
+struct StackRun {
+    void (*fn)(void*);
+    void* arg;
+};
+
+static void* stack_trampoline(void* arg) {
+    StackRun* run = (StackRun*)arg;
+    run->fn(run->arg);
+    return nullptr;
+}
+
+// Returns the number of stack bytes touched (the stack grows down)
+static size_t run_on_painted_stack(void (*fn)(void*), void* arg) {
+    uint8_t* stack = (uint8_t*)aligned_alloc(4096, BENCH_STACK_SIZE);
+    memset(stack, STACK_PAINT, BENCH_STACK_SIZE);
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstack(&attr, stack, BENCH_STACK_SIZE);
+    StackRun run = { fn, arg };
+    pthread_t thread;
+    if (pthread_create(&thread, &attr, stack_trampoline, &run) != 0) {
+        fprintf(stderr, "pthread_create failed\n");
+        exit(2);
+    }
+    pthread_join(thread, nullptr);
+    pthread_attr_destroy(&attr);
+
+    size_t untouched = 0;
+    while (untouched < BENCH_STACK_SIZE && stack[untouched] == STACK_PAINT) {
+        untouched++;
+    }
+    free(stack);
+    return BENCH_STACK_SIZE - untouched;
+}
+
+static void noop(void*) {
+}
+
+struct ScenarioRun {
+    const Scenario* scenario;
+    int iterations;
+    Result* result;
+    std::string lastStatus;
+};
+
+static void run_scenario(void* arg) {
+    ScenarioRun* run = (ScenarioRun*)arg;
+    const Scenario& s = *run->scenario;
+    std::vector<double> latencies;
+    latencies.reserve(run->iterations);
+
+    int sockfd = host_httpd::openSocket();
+    host_httpd::Request request;
+    host_httpd::Response response;
+    build_request(s, sockfd, &request);
+
+    // One warm-up request: first-use initialisation is not steady state
+    for (int i = -1; i < run->iterations; i++) {
+        tick();
+        timespec start, end;
+        alloc_count = 0;
+        host_esp::measuring = true;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        host_httpd::dispatch(request, &response);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        host_esp::measuring = false;
+        if (i < 0) {
+            continue;
+        }
+        latencies.push_back(elapsed_us(start, end));
+        run->result->allocs = std::max(run->result->allocs, alloc_count);
+        run->result->bytes = std::max(run->result->bytes, response.wireBytes);
+    }
+    run->lastStatus = response.status;
+    host_httpd::closeSocket(sockfd);
+
+    std::sort(latencies.begin(), latencies.end());
+    run->result->medianUs = latencies[latencies.size() / 2];
+    run->result->p95Us = latencies[(latencies.size() * 95) / 100];
+}
+
+// ---------------------------------------------------------------------------
+// Setup, mirroring setup() in main.cpp
+// ---------------------------------------------------------------------------
+
+static void boot() {
+    ESP_ERROR_CHECK(nvs_flash_init());
+    ESP_ERROR_CHECK(esp_netif_init());
+    ESP_ERROR_CHECK(esp_event_loop_create_default());
+    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
+    ESP_ERROR_CHECK(esp_wifi_init(&cfg));
+    ESP_ERROR_CHECK(esp_event_handler_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &WiFiManager::wifi_event_handler, &wifi));
+    ESP_ERROR_CHECK(esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &WiFiManager::wifi_event_handler, &wifi));
+
+    // Saved credentials, so beginAutoSTA() takes the station path
+    nvs_handle_t handle;
+    ESP_ERROR_CHECK(nvs_open("wifi", NVS_READWRITE, &handle));
+    nvs_set_str(handle, "ssid", "Werkstatt");
+    nvs_set_str(handle, "password", "bench-password");
+    nvs_close(handle);
+
+    Config::load();
+    led.begin();
+    wifi.beginAutoSTA();
+    kmeterIso.begin(0x66, 26, 32, 100000);
+    web.setLEDManager(&led);
+    web.setExternalSensor(&kmeterIso);
+    web.begin();
+    if (!host_httpd::running()) {
+        fprintf(stderr, "web server did not start\n");
+        exit(2);
+    }
+}
+
+static bool login() {
+    int sockfd = host_httpd::openSocket();
+    host_httpd::Request request;
+    host_httpd::Response response;
+    Scenario s = { "login", HTTP_POST, "/api/login", "{\"password\":\"smarthome-assistant.info\"}", false };
+    build_request(s, sockfd, &request);
+    host_httpd::dispatch(request, &response);
+    host_httpd::closeSocket(sockfd);
+
+    const char* token = strstr(response.body.c_str(), "\"token\":\"");
+    if (token == nullptr) {
+        return false;
+    }
+    token += strlen("\"token\":\"");
+    const char* end = strchr(token, '"');
+    session_cookie = "token=" + std::string(token, end ? end - token : strlen(token));
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Baseline file: "<name> <bytes> <allocs> <stack> <median_us> <p95_us>"
+// ---------------------------------------------------------------------------
+
+static bool load_baseline(const char* path, std::map<std::string, Result>* out) {
+    FILE* f = fopen(path, "r");
+    if (f == nullptr) {
+        return false;
+    }
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        if (line[0] == '#' || line[0] == '\n') {
+            continue;
+        }
+        char name[64];
+        Result r = {};
+        if (sscanf(line, "%63s %zu %u %zu %lf %lf", name, &r.bytes, &r.allocs, &r.stack, &r.medianUs, &r.p95Us) == 6) {
+            (*out)[name] = r;
+        }
+    }
+    fclose(f);
+    return true;
+}
+
+static bool save_baseline(const char* path, const std::vector<Result>& results) {
+    FILE* f = fopen(path, "w");
+    if (f == nullptr) {
+        return false;
+    }
+    fprintf(f, "# Host benchmark baseline - regenerate with: host_bench --baseline <file> --update-baseline\n");
+    fprintf(f, "# name bytes allocs stack median_us p95_us\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& r = results[i];
+        fprintf(f, "%s %zu %u %zu %.1f %.1f\n", scenarios[i].name, r.bytes, r.allocs, r.stack, r.medianUs, r.p95Us);
+    }
+    fclose(f);
+    return true;
+}
+
+// Thresholds: bytes and stack get a little slack (uptime digits, compiler
+// noise), allocations none. Latency is only meaningful against a baseline
+// taken on the same machine.
+static int compare(const Scenario& s, const Result& now, const Result& base, bool checkLatency) {
+    int failures = 0;
+    if (now.bytes > base.bytes * 105 / 100 + 16) {
+        printf("REGRESSION %s: bytes %zu > baseline %zu\n", s.name, now.bytes, base.bytes);
+        failures++;
+    }
+    if (now.allocs > base.allocs) {
+        printf("REGRESSION %s: allocs %u > baseline %u\n", s.name, now.allocs, base.allocs);
+        failures++;
+    }
+    if (now.stack > base.stack * 110 / 100 + 128) {
+        printf("REGRESSION %s: stack %zu > baseline %zu\n", s.name, now.stack, base.stack);
+        failures++;
+    }
+    if (checkLatency && now.medianUs > base.medianUs * 2 + 20) {
+        printf("REGRESSION %s: median %.1f us > baseline %.1f us\n", s.name, now.medianUs, base.medianUs);
+        failures++;
+    }
+    return failures;
+}
+
+static void usage() {
+    fprintf(stderr,
+            "usage: host_bench [--baseline FILE] [--update-baseline] [--no-latency]\n"
+            "                  [--iterations N] [--verbose]\n");
+}
+
+int main(int argc, char** argv) {
+    Options opt = { nullptr, false, true, 200, false };
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+            opt.baselinePath = argv[++i];
+        } else if (strcmp(argv[i], "--update-baseline") == 0) {
+            opt.updateBaseline = true;
+        } else if (strcmp(argv[i], "--no-latency") == 0) {
+            opt.checkLatency = false;
+        } else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            opt.iterations = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--verbose") == 0) {
+            opt.verbose = true;
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (opt.iterations < 1 || (opt.updateBaseline && opt.baselinePath == nullptr)) {
+        usage();
+        return 2;
+    }
+
+    host_esp::setLogLevel(opt.verbose ? ESP_LOG_INFO : ESP_LOG_ERROR);
+    boot();
+    if (!login()) {
+        fprintf(stderr, "login failed\n");
+        return 2;
+    }
+
+    size_t calibration = run_on_painted_stack(noop, nullptr);
+
+    std::vector<Result> results(SCENARIO_COUNT);
+    printf("%-22s %8s %7s %7s %10s %10s  %s\n", "endpoint", "bytes", "allocs", "stack", "median_us", "p95_us", "status");
+    for (size_t i = 0; i < SCENARIO_COUNT; i++) {
+        Result& r = results[i];
+        r = Result();
+        ScenarioRun run = { &scenarios[i], opt.iterations, &r, std::string() };
+        size_t used = run_on_painted_stack(run_scenario, &run);
+        r.stack = used > calibration ? used - calibration : 0;
+        printf("%-22s %8zu %7u %7zu %10.1f %10.1f  %s\n", scenarios[i].name, r.bytes, r.allocs, r.stack,
+               r.medianUs, r.p95Us, run.lastStatus.c_str());
+    }
+
+    if (opt.baselinePath == nullptr) {
+        return 0;
+    }
+    if (opt.updateBaseline) {
+        if (!save_baseline(opt.baselinePath, results)) {
+            fprintf(stderr, "cannot write %s\n", opt.baselinePath);
+            return 2;
+        }
+        printf("baseline written to %s\n", opt.baselinePath);
+        return 0;
+    }
+
+    std::map<std::string, Result> baseline;
+    if (!load_baseline(opt.baselinePath, &baseline)) {
+        fprintf(stderr, "cannot read %s\n", opt.baselinePath);
+        return 2;
+    }
+    int failures = 0;
+    for (size_t i = 0; i < SCENARIO_COUNT; i++) {
+        std::map<std::string, Result>::const_iterator it = baseline.find(scenarios[i].name);
+        if (it == baseline.end()) {
+            printf("NEW %s: not in baseline\n", scenarios[i].name);
+            continue;
+        }
+        failures += compare(scenarios[i], results[i], it->second, opt.checkLatency);
+    }
+    printf(failures ? "%d regression(s)\n" : "no regressions\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,608 @@
+// OTA throughput benchmark.
+//
+// Runs OTAManager and OTAPackage unchanged against the file-backed flash in
+// flash_fake.cpp. From update.tar it builds the packages the device accepts
+// (raw, packed, delta against the "running" firmware) and feeds them, and the
+// bare images, through every OTA entry point at several chunk sizes. Per run
+// it reports host CPU time, modeled flash time, throughput, peak heap and the
+// flash calls, then checks what ended up on the fake flash.
+#include "flash_fake.h"
+#include "host_esp.h"
+#include "OTAManager.h"
+#include "OTAPackage.h"
+#include "Sha256.h"
+#include <errno.h>
+#include <malloc.h>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <time.h>
+#include <vector>
+#include <zlib.h>
+
+typedef std::vector<uint8_t> Bytes;
+
+// ---------------------------------------------------------------------------
+// Heap tracking: malloc & co. are wrapped at link time (-Wl,--wrap), operator
+// new is replaced. Live bytes are tracked all the time; a run reports the
+// peak above the level it started at, and the calls made while
+// host_esp::measuring is set.
+// ---------------------------------------------------------------------------
+
+static size_t heap_live = 0;
+static size_t heap_peak = 0;
+static unsigned alloc_count = 0;
+
+static void track_alloc(void* p) {
+    if (p == nullptr) return;
+    if (host_esp::measuring) alloc_count++;
+    heap_live += malloc_usable_size(p);
+    if (heap_live > heap_peak) heap_peak = heap_live;
+}
+
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t n, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+void __real_free(void* ptr);
+
+void* __wrap_malloc(size_t size) {
+    void* p = __real_malloc(size);
+    track_alloc(p);
+    return p;
+}
+
+void* __wrap_calloc(size_t n, size_t size) {
+    void* p = __real_calloc(n, size);
+    track_alloc(p);
+    return p;
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+    size_t old = ptr ? malloc_usable_size(ptr) : 0;
+    void* p = __real_realloc(ptr, size);
+    if (p != nullptr || size == 0) {
+        heap_live -= old;
+    }
+    track_alloc(p);
+    return p;
+}
+
+void __wrap_free(void* ptr) {
+    if (ptr) heap_live -= malloc_usable_size(ptr);
+    __real_free(ptr);
+}
+}
+
+void* operator new(size_t size) {
+    void* p = __wrap_malloc(size ? size : 1);
+    if (p == nullptr) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return __wrap_malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return __wrap_malloc(size ? size : 1);
+}
+
+void operator delete(void* p) noexcept {
+    __wrap_free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    __wrap_free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    __wrap_free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    __wrap_free(p);
+}
+
+// ---------------------------------------------------------------------------
+// Packages: the images come out of update.tar, the variants are rebuilt the
+// way build_ota_package.py / build_ota_delta.py write them
+// ---------------------------------------------------------------------------
+
+static const size_t TAR_BLOCK = 512;
+static const int WINDOW_BITS = 12;   // OTAInflate::WINDOW_SIZE
+
+static bool read_file(const char* path, Bytes* out) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return false;
+    uint8_t buffer[65536];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+        out->insert(out->end(), buffer, buffer + n);
+    }
+    fclose(f);
+    return true;
+}
+
+static bool inflate_member(const Bytes& member, Bytes* out) {
+    if (member.size() < 8 || memcmp(member.data(), "HBZ1", 4) != 0) return false;
+    uint32_t size;
+    memcpy(&size, member.data() + 4, 4);
+    out->resize(size);
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (inflateInit2(&zs, -15) != Z_OK) return false;
+    zs.next_in = (Bytes::value_type*)member.data() + 8;
+    zs.avail_in = (uInt)(member.size() - 8);
+    zs.next_out = out->data();
+    zs.avail_out = size;
+    int ret = inflate(&zs, Z_FINISH);
+    inflateEnd(&zs);
+    return ret == Z_STREAM_END && zs.avail_out == 0;
+}
+
+// firmware.bin and spiffs.bin, raw or packed; other members are ignored
+static bool extract_images(const Bytes& tar, Bytes* firmware, Bytes* spiffs) {
+    size_t pos = 0;
+    while (pos + TAR_BLOCK <= tar.size() && tar[pos] != 0) {
+        const uint8_t* header = tar.data() + pos;
+        std::string name((const char*)header, strnlen((const char*)header, 100));
+        size_t size = strtoul(std::string((const char*)header + 124, 12).c_str(), nullptr, 8);
+        pos += TAR_BLOCK;
+        if (pos + size > tar.size()) return false;
+        Bytes data(tar.begin() + pos, tar.begin() + pos + size);
+        if (name == "firmware.bin") *firmware = data;
+        else if (name == "spiffs.bin") *spiffs = data;
+        else if (name == "firmware.bin.z" && !inflate_member(data, firmware)) return false;
+        else if (name == "spiffs.bin.z" && !inflate_member(data, spiffs)) return false;
+        pos += (size + TAR_BLOCK - 1) / TAR_BLOCK * TAR_BLOCK;
+    }
+    return !firmware->empty() && !spiffs->empty();
+}
+
+static void sha256_of(const Bytes& data, uint8_t digest[Sha256::DIGEST_SIZE]) {
+    Sha256 sha;
+    sha.update(data.data(), data.size());
+    sha.finish(digest);
+}
+
+static void put_u32(Bytes* out, uint32_t value) {
+    for (int i = 0; i < 4; i++) out->push_back((uint8_t)(value >> (8 * i)));
+}
+
+static Bytes pack(const Bytes& data) {
+    Bytes out = { 'H', 'B', 'Z', '1' };
+    put_u32(&out, (uint32_t)data.size());
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    deflateInit2(&zs, 9, Z_DEFLATED, -WINDOW_BITS, 9, Z_DEFAULT_STRATEGY);
+    size_t header = out.size();
+    out.resize(header + deflateBound(&zs, data.size()));
+    zs.next_in = (Bytes::value_type*)data.data();
+    zs.avail_in = (uInt)data.size();
+    zs.next_out = out.data() + header;
+    zs.avail_out = (uInt)(out.size() - header);
+    deflate(&zs, Z_FINISH);
+    out.resize(header + zs.total_out);
+    deflateEnd(&zs);
+    return out;
+}
+
+// A new release that differs from the running one in scattered places, some
+// of them shifting everything behind; the patch is built alongside
+static void make_delta(const Bytes& base, Bytes* target, Bytes* patch) {
+    static const size_t STRIDE = 24 * 1024;
+    static const size_t CHANGED = 48;
+    Bytes ops;
+    uint32_t seed = 0x1234567;
+    size_t s = 0;
+    for (int n = 0; s < base.size(); n++) {
+        size_t copy = base.size() - s < STRIDE ? base.size() - s : STRIDE;
+        ops.push_back(0x01);
+        put_u32(&ops, (uint32_t)s);
+        put_u32(&ops, (uint32_t)copy);
+        target->insert(target->end(), base.begin() + s, base.begin() + s + copy);
+        s += copy;
+        if (s >= base.size()) break;
+        size_t literal = n % 4 == 3 ? CHANGED * 3 : CHANGED;   // Every 4th edit grows the image
+        ops.push_back(0x02);
+        put_u32(&ops, (uint32_t)literal);
+        for (size_t i = 0; i < literal; i++) {
+            seed = seed * 1103515245 + 12345;
+            uint8_t b = (uint8_t)(seed >> 16);
+            ops.push_back(b);
+            target->push_back(b);
+        }
+        s += CHANGED < base.size() - s ? CHANGED : base.size() - s;
+    }
+    uint8_t digest[Sha256::DIGEST_SIZE];
+    *patch = { 'H', 'B', 'D', '1' };
+    put_u32(patch, (uint32_t)base.size());
+    sha256_of(base, digest);
+    patch->insert(patch->end(), digest, digest + sizeof(digest));
+    put_u32(patch, (uint32_t)target->size());
+    sha256_of(*target, digest);
+    patch->insert(patch->end(), digest, digest + sizeof(digest));
+    patch->insert(patch->end(), ops.begin(), ops.end());
+}
+
+static void tar_add(Bytes* tar, const char* name, const Bytes& data) {
+    uint8_t header[TAR_BLOCK];
+    memset(header, 0, sizeof(header));
+    strncpy((char*)header, name, 99);
+    snprintf((char*)header + 100, 8, "%07o", 0644);
+    snprintf((char*)header + 108, 8, "%07o", 0);
+    snprintf((char*)header + 116, 8, "%07o", 0);
+    snprintf((char*)header + 124, 12, "%011o", (unsigned)data.size());
+    snprintf((char*)header + 136, 12, "%011o", 1700000000u);
+    header[156] = '0';
+    memcpy(header + 257, "ustar\0" "00", 8);
+    memset(header + 148, ' ', 8);
+    unsigned sum = 0;
+    for (size_t i = 0; i < TAR_BLOCK; i++) sum += header[i];
+    snprintf((char*)header + 148, 8, "%06o", sum);
+    tar->insert(tar->end(), header, header + TAR_BLOCK);
+    tar->insert(tar->end(), data.begin(), data.end());
+    tar->resize((tar->size() + TAR_BLOCK - 1) / TAR_BLOCK * TAR_BLOCK, 0);
+}
+
+static void tar_end(Bytes* tar) {
+    tar->resize(tar->size() + 2 * TAR_BLOCK, 0);
+}
+
+static std::string manifest_entry(const char* key, const char* member, const Bytes& image) {
+    uint8_t digest[Sha256::DIGEST_SIZE];
+    char hex[2 * Sha256::DIGEST_SIZE + 1];
+    sha256_of(image, digest);
+    Sha256::toHex(digest, hex);
+    char entry[192];
+    snprintf(entry, sizeof(entry), "\"%s\": {\"member\": \"%s\", \"size\": %u, \"sha256\": \"%s\"}",
+             key, member, (unsigned)image.size(), hex);
+    return entry;
+}
+
+static Bytes string_bytes(const std::string& s) {
+    return Bytes(s.begin(), s.end());
+}
+
+// ---------------------------------------------------------------------------
+// Scenarios
+// ---------------------------------------------------------------------------
+
+enum Entry { PACKAGE_PUSH, TAR_MEMORY, TAR_FILE, FIRMWARE_STREAM, SPIFFS_STREAM, FIRMWARE_DIRECT, SPIFFS_DIRECT };
+enum Input { PKG_RAW, PKG_PACKED, PKG_DELTA, IMG_FIRMWARE, IMG_SPIFFS };
+
+struct Scenario {
+    const char* name;
+    Entry entry;
+    Input input;
+    bool chunked;   // Input arrives in chunks of the benchmarked size
+};
+
+// Names follow the firmware's entry points; "upload" is POST /api/ota/upload
+// and the pull mode, which push through OTAPackage the same way
+static const Scenario scenarios[] = {
+    { "upload raw",      PACKAGE_PUSH,    PKG_RAW,      true },
+    { "upload packed",   PACKAGE_PUSH,    PKG_PACKED,   true },
+    { "upload delta",    PACKAGE_PUSH,    PKG_DELTA,    true },
+    { "firmware stream", FIRMWARE_STREAM, IMG_FIRMWARE, true },
+    { "spiffs stream",   SPIFFS_STREAM,   IMG_SPIFFS,   true },
+    { "tar file",        TAR_FILE,        PKG_PACKED,   false },
+    { "tar memory",      TAR_MEMORY,      PKG_RAW,      false },
+    { "firmware direct", FIRMWARE_DIRECT, IMG_FIRMWARE, false },
+    { "spiffs direct",   SPIFFS_DIRECT,   IMG_SPIFFS,   false },
+};
+
+struct Data {
+    Bytes firmware;       // Running image, factory partition
+    Bytes spiffs;
+    Bytes release;        // Target of the delta package
+    Bytes packages[3];    // PKG_RAW, PKG_PACKED, PKG_DELTA
+    std::string packedPath;
+};
+
+struct Source {
+    const uint8_t* data;
+    size_t size;
+    size_t pos;
+    size_t chunk;
+};
+
+static size_t read_source(uint8_t* buffer, size_t size, void* userData) {
+    Source* src = (Source*)userData;
+    size_t n = src->size - src->pos;
+    if (n > size) n = size;
+    if (n > src->chunk) n = src->chunk;
+    memcpy(buffer, src->data + src->pos, n);
+    src->pos += n;
+    return n;
+}
+
+static const Bytes& input_of(const Data& data, Input input) {
+    switch (input) {
+        case PKG_RAW:      return data.packages[PKG_RAW];
+        case PKG_PACKED:   return data.packages[PKG_PACKED];
+        case PKG_DELTA:    return data.packages[PKG_DELTA];
+        case IMG_FIRMWARE: return data.firmware;
+        default:           return data.spiffs;
+    }
+}
+
+static bool run_entry(OTAManager& ota, const Scenario& sc, const Bytes& in, size_t chunk, const Data& data,
+                      std::string* error) {
+    bool ok = false;
+    switch (sc.entry) {
+        case PACKAGE_PUSH: {
+            // Allocated per request like the upload handler does
+            OTAPackage* package = new (std::nothrow) OTAPackage(ota);
+            ok = true;
+            for (size_t pos = 0; ok && pos < in.size(); pos += chunk) {
+                ok = package->push(in.data() + pos, in.size() - pos < chunk ? in.size() - pos : chunk);
+            }
+            ok = ok && package->finish();
+            if (!ok) *error = package->getError();
+            delete package;
+            return ok;
+        }
+        case TAR_MEMORY:
+            ok = ota.processTarUpdate(in.data(), in.size());
+            break;
+        case TAR_FILE:
+            ok = ota.processTarUpdateFromFile(data.packedPath.c_str());
+            break;
+        case FIRMWARE_STREAM: {
+            Source src = { in.data(), in.size(), 0, chunk };
+            ok = ota.flashFirmwareStreaming(in.size(), read_source, &src);
+            break;
+        }
+        case SPIFFS_STREAM: {
+            Source src = { in.data(), in.size(), 0, chunk };
+            ok = ota.flashSPIFFSStreaming(in.size(), read_source, &src);
+            break;
+        }
+        case FIRMWARE_DIRECT:
+            ok = ota.flashFirmwareDirect(in.data(), in.size());
+            break;
+        case SPIFFS_DIRECT:
+            ok = ota.flashSPIFFSDirect(in.data(), in.size());
+            break;
+    }
+    if (!ok) *error = ota.getLastError();
+    return ok;
+}
+
+// Partitions as a device in the field has them: the running firmware in
+// factory, stale data everywhere an update may write
+static void prepare_flash(const Data& data, const Scenario& sc) {
+    static const uint8_t STALE = 0x5A;
+    uint8_t* factory = flash_fake::contents(flash_fake::FACTORY);
+    size_t factorySize = flash_fake::partition(flash_fake::FACTORY)->size;
+    if (sc.entry == FIRMWARE_DIRECT) {
+        memset(factory, STALE, factorySize);
+    } else {
+        memcpy(factory, data.firmware.data(), data.firmware.size());
+        memset(factory + data.firmware.size(), 0xFF, factorySize - data.firmware.size());
+    }
+    memset(flash_fake::contents(flash_fake::OTA_0), STALE, flash_fake::partition(flash_fake::OTA_0)->size);
+    memset(flash_fake::contents(flash_fake::SPIFFS), STALE, flash_fake::partition(flash_fake::SPIFFS)->size);
+    flash_fake::resetBootPartition();
+}
+
+static bool same(flash_fake::Region region, const Bytes& image, bool blankTail) {
+    const uint8_t* flash = flash_fake::contents(region);
+    if (memcmp(flash, image.data(), image.size()) != 0) return false;
+    size_t size = flash_fake::partition(region)->size;
+    for (size_t i = image.size(); blankTail && i < size; i++) {
+        if (flash[i] != 0xFF) return false;
+    }
+    return true;
+}
+
+// What the scenario must have left on flash
+static const char* check_flash(const Data& data, const Scenario& sc) {
+    bool firmware = sc.input == PKG_RAW || sc.input == PKG_PACKED || sc.entry == FIRMWARE_STREAM;
+    bool spiffs = sc.input == PKG_RAW || sc.input == PKG_PACKED || sc.entry == SPIFFS_STREAM ||
+                  sc.entry == SPIFFS_DIRECT;
+    if (flash_fake::counters().badWrites > 0) return "programmed over bits that were not erased";
+    if (firmware && !same(flash_fake::OTA_0, data.firmware, false)) return "ota_0 does not hold the firmware";
+    if (sc.input == PKG_DELTA && !same(flash_fake::OTA_0, data.release, false)) return "ota_0 does not hold the patched firmware";
+    if ((firmware || sc.input == PKG_DELTA) && flash_fake::bootPartition() != flash_fake::partition(flash_fake::OTA_0)) {
+        return "boot partition not switched to ota_0";
+    }
+    if (sc.entry == FIRMWARE_DIRECT && !same(flash_fake::FACTORY, data.firmware, true)) {
+        return "factory does not hold the firmware";
+    }
+    if (spiffs && !same(flash_fake::SPIFFS, data.spiffs, true)) return "spiffs partition differs from the image";
+    return nullptr;
+}
+
+struct Result {
+    size_t inBytes;
+    size_t imageBytes;
+    double hostMs;       // Best of the rounds
+    double flashMs;      // Modeled, identical every round
+    size_t peakHeap;
+    unsigned allocs;
+    flash_fake::Counters flash;
+};
+
+static double now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static bool run(const Data& data, const Scenario& sc, size_t chunk, int rounds, Result* out) {
+    const Bytes& in = input_of(data, sc.input);
+    memset(out, 0, sizeof(*out));
+    out->inBytes = in.size();
+    out->hostMs = 1e30;
+    for (int round = 0; round < rounds; round++) {
+        OTAManager* ota = new OTAManager();
+        prepare_flash(data, sc);
+        flash_fake::resetCounters();
+        std::string error;
+
+        size_t base = heap_live;
+        heap_peak = heap_live;
+        alloc_count = 0;
+        host_esp::measuring = true;
+        double start = now_ms();
+        bool ok = run_entry(*ota, sc, in, chunk, data, &error);
+        double elapsed = now_ms() - start;   // Includes the fake's memset/memcpy
+        host_esp::measuring = false;
+        delete ota;
+
+        const char* wrong = ok ? check_flash(data, sc) : nullptr;
+        if (!ok || wrong) {
+            fprintf(stderr, "FAIL %s, chunk %u: %s\n", sc.name, (unsigned)chunk, ok ? wrong : error.c_str());
+            return false;
+        }
+        const flash_fake::Counters& c = flash_fake::counters();
+        if (elapsed < out->hostMs) out->hostMs = elapsed;
+        out->flashMs = c.flashUs / 1e3;
+        out->peakHeap = heap_peak - base;
+        out->allocs = alloc_count;
+        out->flash = c;
+    }
+    out->imageBytes = 0;
+    if (sc.input == PKG_RAW || sc.input == PKG_PACKED) out->imageBytes = data.firmware.size() + data.spiffs.size();
+    else if (sc.input == PKG_DELTA) out->imageBytes = data.release.size();
+    else out->imageBytes = in.size();
+    return true;
+}
+
+static std::vector<size_t> parse_chunks(const char* list) {
+    std::vector<size_t> chunks;
+    for (const char* p = list; *p;) {
+        char* end;
+        unsigned long n = strtoul(p, &end, 10);
+        if (end == p || n == 0) break;
+        chunks.push_back(n);
+        p = *end == ',' ? end + 1 : end;
+    }
+    return chunks;
+}
+
+static void usage() {
+    fprintf(stderr,
+            "usage: ota_bench update.tar [--rounds N] [--chunks 512,1460,4096] [--timing typ|max]\n"
+            "                 [--flash FILE] [--only NAME]\n");
+}
+
+int main(int argc, char** argv) {
+    const char* tarPath = nullptr;
+    const char* flashPath = nullptr;
+    const char* only = nullptr;
+    int rounds = 3;
+    std::vector<size_t> chunks = { 512, 1460, 4096, 16384, 65536 };
+    const flash_fake::Timing* timing = &flash_fake::TYPICAL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--rounds") == 0 && i + 1 < argc) {
+            rounds = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--chunks") == 0 && i + 1 < argc) {
+            chunks = parse_chunks(argv[++i]);
+        } else if (strcmp(argv[i], "--timing") == 0 && i + 1 < argc) {
+            const char* name = argv[++i];
+            timing = strcmp(name, "max") == 0 ? &flash_fake::WORST : &flash_fake::TYPICAL;
+        } else if (strcmp(argv[i], "--flash") == 0 && i + 1 < argc) {
+            flashPath = argv[++i];
+        } else if (strcmp(argv[i], "--only") == 0 && i + 1 < argc) {
+            only = argv[++i];
+        } else if (argv[i][0] != '-' && !tarPath) {
+            tarPath = argv[i];
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (!tarPath || rounds < 1 || chunks.empty()) {
+        usage();
+        return 2;
+    }
+
+    Data data;
+    Bytes tar;
+    if (!read_file(tarPath, &tar) || !extract_images(tar, &data.firmware, &data.spiffs)) {
+        fprintf(stderr, "%s: no firmware.bin and spiffs.bin found\n", tarPath);
+        return 2;
+    }
+
+    Bytes patch;
+    make_delta(data.firmware, &data.release, &patch);
+    std::string both = "{\"version\": 1, " + manifest_entry("firmware", "firmware.bin", data.firmware) + ", " +
+                       manifest_entry("spiffs", "spiffs.bin", data.spiffs) + "}";
+    tar_add(&data.packages[PKG_RAW], "manifest.json", string_bytes(both));
+    tar_add(&data.packages[PKG_RAW], "firmware.bin", data.firmware);
+    tar_add(&data.packages[PKG_RAW], "spiffs.bin", data.spiffs);
+    tar_end(&data.packages[PKG_RAW]);
+
+    both = "{\"version\": 1, " + manifest_entry("firmware", "firmware.bin.z", data.firmware) + ", " +
+           manifest_entry("spiffs", "spiffs.bin.z", data.spiffs) + "}";
+    tar_add(&data.packages[PKG_PACKED], "manifest.json", string_bytes(both));
+    tar_add(&data.packages[PKG_PACKED], "firmware.bin.z", pack(data.firmware));
+    tar_add(&data.packages[PKG_PACKED], "spiffs.bin.z", pack(data.spiffs));
+    tar_end(&data.packages[PKG_PACKED]);
+
+    std::string delta = "{\"version\": 1, " + manifest_entry("firmware", "firmware.hbd.z", data.release) + "}";
+    tar_add(&data.packages[PKG_DELTA], "manifest.json", string_bytes(delta));
+    tar_add(&data.packages[PKG_DELTA], "firmware.hbd.z", pack(patch));
+    tar_end(&data.packages[PKG_DELTA]);
+
+    char packedPath[] = "/tmp/ota_bench_packed_XXXXXX";
+    int fd = mkstemp(packedPath);
+    FILE* packed = fd >= 0 ? fdopen(fd, "wb") : nullptr;
+    if (!packed || fwrite(data.packages[PKG_PACKED].data(), 1, data.packages[PKG_PACKED].size(), packed) !=
+                       data.packages[PKG_PACKED].size()) {
+        fprintf(stderr, "%s: %s\n", packedPath, strerror(errno));
+        return 2;
+    }
+    fclose(packed);
+    data.packedPath = packedPath;
+
+    if (!flash_fake::open(flashPath)) {
+        unlink(packedPath);
+        return 2;
+    }
+    flash_fake::setTiming(*timing);
+
+    printf("firmware %u B, spiffs %u B; packages: raw %u B, packed %u B, delta %u B; flash timing %s\n",
+           (unsigned)data.firmware.size(), (unsigned)data.spiffs.size(), (unsigned)data.packages[PKG_RAW].size(),
+           (unsigned)data.packages[PKG_PACKED].size(), (unsigned)data.packages[PKG_DELTA].size(), timing->name);
+    printf("%-16s %6s %9s %9s %8s %8s %9s %7s %8s %7s %11s %7s %7s\n", "scenario", "chunk", "in_B", "image_B",
+           "host_ms", "host_MBs", "flash_ms", "MB/s", "peak_B", "allocs", "erase4K/64K", "writes", "reads");
+
+    bool failed = false;
+    for (const Scenario& sc : scenarios) {
+        if (only && strstr(sc.name, only) == nullptr) continue;
+        std::vector<size_t> sizes = sc.chunked ? chunks : std::vector<size_t>(1, 0);
+        for (size_t chunk : sizes) {
+            Result r;
+            if (!run(data, sc, chunk, rounds, &r)) {
+                failed = true;
+                continue;
+            }
+            char chunkText[16] = "-";
+            if (chunk) snprintf(chunkText, sizeof(chunkText), "%u", (unsigned)chunk);
+            char erases[24];
+            snprintf(erases, sizeof(erases), "%u/%u", r.flash.sectorErases, r.flash.blockErases);
+            // Device time if receiving and flashing did not overlap; host CPU stands in for the ESP32's
+            double totalS = (r.hostMs + r.flashMs) / 1e3;
+            printf("%-16s %6s %9u %9u %8.2f %8.1f %9.0f %7.3f %8u %7u %11s %7u %7u\n", sc.name, chunkText,
+                   (unsigned)r.inBytes, (unsigned)r.imageBytes, r.hostMs, r.inBytes / 1e6 / (r.hostMs / 1e3),
+                   r.flashMs, r.imageBytes / 1e6 / totalS, (unsigned)r.peakHeap, r.allocs, erases,
+                   r.flash.writeCalls, r.flash.readCalls);
+        }
+    }
+
+    flash_fake::close();
+    unlink(packedPath);
+    return failed ? 1 : 0;
+}
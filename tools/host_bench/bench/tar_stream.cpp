@@ -0,0 +1,529 @@
+// Unit checks and throughput benchmark for TarStream.
+//
+// The unit cases build archives in memory (ustar prefix, GNU long names, pax
+// headers, base-256 sizes, broken checksums, truncation, malformed extended
+// headers) and feed each one at
+// every chunk size from 1 byte up, so every header / data / padding boundary
+// falls inside a chunk at least once. The benchmark parses a real
+// update.tar at several chunk sizes and checks that each run sees the same
+// members with the same content.
+#include "TarStream.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <time.h>
+#include <vector>
+
+typedef std::vector<uint8_t> Bytes;
+
+static int failures = 0;
+
+#define CHECK(cond, ...)                                   \
+    do {                                                   \
+        if (!(cond)) {                                     \
+            printf("FAIL %s:%d: ", __FILE__, __LINE__);    \
+            printf(__VA_ARGS__);                           \
+            printf("\n");                                  \
+            failures++;                                    \
+        }                                                  \
+    } while (0)
+
+// ---------------------------------------------------------------------------
+// Archive builder
+// ---------------------------------------------------------------------------
+
+struct Header {
+    std::string name;
+    std::string prefix;
+    char type;
+    bool gnuMagic;       // "ustar  \0" instead of POSIX "ustar\0" "00"
+    bool base256Size;
+};
+
+static Header file(const std::string& name) {
+    Header h = { name, "", '0', false, false };
+    return h;
+}
+
+static void put_octal(uint8_t* field, size_t len, size_t value) {
+    snprintf((char*)field, len, "%0*lo", (int)len - 1, (unsigned long)value);
+}
+
+static void add_block(Bytes* out, const Header& h, size_t size) {
+    uint8_t block[512];
+    memset(block, 0, sizeof(block));
+    memcpy(block, h.name.data(), h.name.size() < 100 ? h.name.size() : 100);
+    put_octal(block + 100, 8, 0644);
+    put_octal(block + 108, 8, 0);
+    put_octal(block + 116, 8, 0);
+    if (h.base256Size) {
+        block[124] = 0x80;
+        for (int i = 0; i < 8; i++) {
+            block[135 - i] = (uint8_t)(size >> (8 * i));
+        }
+    } else {
+        put_octal(block + 124, 12, size);
+    }
+    put_octal(block + 136, 12, 0);
+    block[156] = (uint8_t)h.type;
+    if (h.gnuMagic) {
+        memcpy(block + 257, "ustar  ", 8);
+    } else {
+        memcpy(block + 257, "ustar", 6);
+        memcpy(block + 263, "00", 2);
+    }
+    memcpy(block + 345, h.prefix.data(), h.prefix.size());
+    memset(block + 148, ' ', 8);
+    unsigned sum = 0;
+    for (size_t i = 0; i < 512; i++) {
+        sum += block[i];
+    }
+    snprintf((char*)block + 148, 8, "%06o", sum);
+    out->insert(out->end(), block, block + 512);
+}
+
+static void add_data(Bytes* out, const Bytes& data) {
+    out->insert(out->end(), data.begin(), data.end());
+    out->resize(out->size() + (512 - data.size() % 512) % 512, 0);
+}
+
+static void add_member(Bytes* out, const Header& h, const Bytes& data) {
+    add_block(out, h, data.size());
+    add_data(out, data);
+}
+
+static void add_gnu_longname(Bytes* out, const std::string& name) {
+    Header h = { "././@LongLink", "", 'L', true, false };
+    Bytes data(name.begin(), name.end());
+    data.push_back('\0');
+    add_member(out, h, data);
+}
+
+static std::string pax_record(const std::string& key, const std::string& value) {
+    // The length counts its own digits
+    size_t base = key.size() + value.size() + 3;   // ' ', '=', '\n'
+    size_t len = base + std::to_string(base).size();
+    while (len != base + std::to_string(len).size()) {
+        len = base + std::to_string(len).size();
+    }
+    return std::to_string(len) + " " + key + "=" + value + "\n";
+}
+
+static void add_pax(Bytes* out, char type, const std::string& records) {
+    Header h = { "PaxHeaders/x", "", type, false, false };
+    add_member(out, h, Bytes(records.begin(), records.end()));
+}
+
+static void add_end(Bytes* out) {
+    out->resize(out->size() + 1024, 0);
+}
+
+static Bytes pattern(size_t size, uint8_t seed) {
+    Bytes data(size);
+    uint32_t x = 0x9E3779B9u * (seed + 1);
+    for (size_t i = 0; i < size; i++) {
+        x = x * 1664525u + 1013904223u;
+        data[i] = (uint8_t)(x >> 24);
+    }
+    return data;
+}
+
+// ---------------------------------------------------------------------------
+// Collector
+// ---------------------------------------------------------------------------
+
+struct Member {
+    std::string name;
+    char type;
+    size_t size;
+    Bytes data;
+    bool ended;
+};
+
+struct Collector {
+    std::vector<Member> members;
+    bool keepData;
+    uint64_t bytes;
+    uint32_t hash;        // FNV-1a over every member's data, for the benchmark
+    const char* abortAt;  // Name to abort on, or nullptr
+};
+
+static TarStream::Decision on_entry(const TarStream::Entry& entry, void* ctx) {
+    Collector* c = (Collector*)ctx;
+    if (c->abortAt && strcmp(entry.name, c->abortAt) == 0) {
+        return TarStream::ENTRY_ABORT;
+    }
+    Member m = { entry.name, entry.type, entry.size, Bytes(), false };
+    c->members.push_back(m);
+    return entry.type == '0' ? TarStream::ENTRY_ACCEPT : TarStream::ENTRY_SKIP;
+}
+
+static bool on_data(const uint8_t* data, size_t len, void* ctx) {
+    Collector* c = (Collector*)ctx;
+    if (c->keepData) {
+        c->members.back().data.insert(c->members.back().data.end(), data, data + len);
+    }
+    uint32_t h = c->hash;
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ data[i]) * 16777619u;
+    }
+    c->hash = h;
+    c->bytes += len;
+    return true;
+}
+
+static bool on_end(const TarStream::Entry& entry, void* ctx) {
+    Collector* c = (Collector*)ctx;
+    c->members.back().ended = true;
+    return true;
+}
+
+struct Run {
+    bool pushed;
+    bool finished;
+    bool done;
+    std::string error;
+};
+
+static Run parse(const Bytes& archive, size_t chunk, Collector* c) {
+    c->members.clear();
+    c->bytes = 0;
+    c->hash = 2166136261u;
+    TarStream tar(on_entry, on_data, on_end, c);
+    Run r = { true, false, false, "" };
+    for (size_t pos = 0; pos < archive.size() && r.pushed; pos += chunk) {
+        size_t n = archive.size() - pos < chunk ? archive.size() - pos : chunk;
+        r.pushed = tar.push(archive.data() + pos, n);
+    }
+    r.finished = r.pushed && tar.finish();
+    r.done = tar.done();
+    r.error = tar.getError() ? tar.getError() : "";
+    return r;
+}
+
+// Chunk sizes for the unit cases: every size up to a bit over one block,
+// then a few larger ones
+static std::vector<size_t> unit_chunks() {
+    std::vector<size_t> sizes;
+    for (size_t n = 1; n <= 520; n++) {
+        sizes.push_back(n);
+    }
+    sizes.push_back(1023);
+    sizes.push_back(4096);
+    sizes.push_back(1 << 20);
+    return sizes;
+}
+
+// ---------------------------------------------------------------------------
+// Unit cases
+// ---------------------------------------------------------------------------
+
+struct Expected {
+    const char* name;
+    const Bytes* data;
+};
+
+static void expect_members(const char* test, const Bytes& archive, const Expected* expected, size_t count) {
+    std::vector<size_t> chunks = unit_chunks();
+    for (size_t ci = 0; ci < chunks.size(); ci++) {
+        Collector c = { std::vector<Member>(), true, 0, 0, nullptr };
+        Run r = parse(archive, chunks[ci], &c);
+        size_t files = 0;
+        bool ok = r.finished;
+        for (size_t i = 0; ok && i < c.members.size(); i++) {
+            if (c.members[i].type != '0') {
+                continue;
+            }
+            ok = files < count && c.members[i].name == expected[files].name &&
+                 c.members[i].data == *expected[files].data && c.members[i].ended;
+            files++;
+        }
+        ok = ok && files == count;
+        CHECK(ok, "%s: chunk %zu (finished %d, %zu members, error '%s')", test, chunks[ci], r.finished,
+              c.members.size(), r.error.c_str());
+        if (!ok) {
+            return;   // One report per case is enough
+        }
+    }
+}
+
+static void expect_failure(const char* test, const Bytes& archive, const char* error) {
+    std::vector<size_t> chunks = unit_chunks();
+    for (size_t ci = 0; ci < chunks.size(); ci++) {
+        Collector c = { std::vector<Member>(), false, 0, 0, nullptr };
+        Run r = parse(archive, chunks[ci], &c);
+        bool ok = !r.finished && r.error == error;
+        CHECK(ok, "%s: chunk %zu expected '%s', got finished %d error '%s'", test, chunks[ci], error, r.finished,
+              r.error.c_str());
+        if (!ok) {
+            return;
+        }
+    }
+}
+
+static void test_plain() {
+    Bytes a = pattern(1000, 1), b = pattern(512, 2), empty;
+    Bytes archive;
+    add_member(&archive, file("firmware.bin"), a);
+    add_member(&archive, file("empty.txt"), empty);
+    add_member(&archive, file("spiffs.bin"), b);
+    add_end(&archive);
+    archive.resize(archive.size() + 8192, 0);   // Record padding
+    Expected e[] = { { "firmware.bin", &a }, { "empty.txt", &empty }, { "spiffs.bin", &b } };
+    expect_members("plain", archive, e, 3);
+}
+
+static void test_prefix() {
+    Bytes a = pattern(700, 3);
+    std::string dir(120, 'd');
+    Header h = file("firmware.bin");
+    h.prefix = dir;
+    Bytes archive;
+    add_member(&archive, h, a);
+    // GNU magic: the prefix field holds other data and must be ignored
+    Header g = file("spiffs.bin");
+    g.gnuMagic = true;
+    add_member(&archive, g, a);
+    add_end(&archive);
+    std::string full = dir + "/firmware.bin";
+    Expected e[] = { { full.c_str(), &a }, { "spiffs.bin", &a } };
+    expect_members("ustar prefix", archive, e, 2);
+}
+
+static void test_gnu_longname() {
+    Bytes a = pattern(5000, 4), b = pattern(3, 5);
+    std::string longName = std::string(150, 'n') + "/firmware.bin";
+    Bytes archive;
+    add_gnu_longname(&archive, longName);
+    add_member(&archive, file(longName.substr(0, 100)), a);
+    add_member(&archive, file("after.bin"), b);   // The long name must not stick
+    add_end(&archive);
+    Expected e[] = { { longName.c_str(), &a }, { "after.bin", &b } };
+    expect_members("GNU long name", archive, e, 2);
+}
+
+static void test_pax() {
+    Bytes a = pattern(2048, 6), b = pattern(77, 7);
+    std::string paxName = std::string(200, 'p') + ".bin";
+    Bytes archive;
+    add_pax(&archive, 'g', pax_record("comment", "global, ignored"));
+    add_pax(&archive, 'x', pax_record("mtime", "1700000000.5") + pax_record("path", paxName) +
+                               pax_record("size", std::to_string(a.size())));
+    Header h = file("truncated-name");
+    add_block(&archive, h, 0);   // pax size overrides the header size
+    add_data(&archive, a);
+    add_member(&archive, file("next.bin"), b);
+    add_end(&archive);
+    Expected e[] = { { paxName.c_str(), &a }, { "next.bin", &b } };
+    expect_members("pax", archive, e, 2);
+}
+
+static void test_base256() {
+    Bytes a = pattern(600, 8);
+    Header h = file("big.bin");
+    h.base256Size = true;
+    Bytes archive;
+    add_member(&archive, h, a);
+    add_end(&archive);
+    Expected e[] = { { "big.bin", &a } };
+    expect_members("base-256 size", archive, e, 1);
+}
+
+static void test_skip_types() {
+    Bytes a = pattern(100, 9), dirData;
+    Header d = file("dir/");
+    d.type = '5';
+    Header l = file("link");
+    l.type = '2';
+    Bytes archive;
+    add_member(&archive, d, dirData);
+    add_member(&archive, l, dirData);
+    add_member(&archive, file("dir/file"), a);
+    add_end(&archive);
+    Expected e[] = { { "dir/file", &a } };
+    expect_members("directories and links", archive, e, 1);
+}
+
+static void test_no_end_blocks() {
+    Bytes a = pattern(513, 10);
+    Bytes archive;
+    add_member(&archive, file("firmware.bin"), a);
+    Expected e[] = { { "firmware.bin", &a } };
+    expect_members("missing end blocks", archive, e, 1);
+}
+
+static void test_truncated() {
+    Bytes a = pattern(3000, 11);
+    Bytes archive;
+    add_member(&archive, file("firmware.bin"), a);
+    add_end(&archive);
+    Bytes cut(archive.begin(), archive.begin() + 512 + 1000);
+    expect_failure("truncated data", cut, "Archive truncated");
+    Bytes half(archive.begin(), archive.begin() + 300);
+    expect_failure("truncated header", half, "Archive truncated");
+}
+
+static void test_bad_checksum() {
+    Bytes a = pattern(10, 12);
+    Bytes archive;
+    add_member(&archive, file("firmware.bin"), a);
+    add_member(&archive, file("spiffs.bin"), a);
+    add_end(&archive);
+    archive[512 + 512 + 0] ^= 0x01;   // Name of the second member
+    expect_failure("bad checksum", archive, "Header checksum mismatch");
+}
+
+static void test_abort() {
+    Bytes a = pattern(10, 13);
+    Bytes archive;
+    add_member(&archive, file("firmware.bin"), a);
+    add_member(&archive, file("stop"), a);
+    add_end(&archive);
+    Collector c = { std::vector<Member>(), false, 0, 0, "stop" };
+    Run r = parse(archive, 7, &c);
+    CHECK(!r.pushed && r.error == "Aborted at member start" && c.members.size() == 1,
+          "abort: pushed %d error '%s'", r.pushed, r.error.c_str());
+}
+
+static void test_gnu_longname_limits() {
+    Bytes a = pattern(40, 14);
+    // Fits the extended header buffer but not the name: truncated
+    std::string longName = std::string(400, 'n');
+    Bytes archive;
+    add_gnu_longname(&archive, longName);
+    add_member(&archive, file("short"), a);
+    add_end(&archive);
+    std::string truncated = longName.substr(0, TarStream::NAME_SIZE - 1);
+    Expected e[] = { { truncated.c_str(), &a } };
+    expect_members("GNU long name truncated", archive, e, 1);
+
+    Bytes big;
+    add_gnu_longname(&big, std::string(TarStream::META_SIZE, 'n'));
+    add_member(&big, file("short"), a);
+    add_end(&big);
+    expect_failure("GNU long name too large", big, "Extended header too large");
+}
+
+// Records that lie about their length are ignored from there on; the member
+// keeps its header name and the archive still parses
+static void test_pax_malformed() {
+    Bytes a = pattern(90, 15);
+    const char* records[] = {
+        "1 x\n",                       // Shorter than its own "<len> " prefix
+        "3 path=p.bin\n",              // Too short for its key
+        "13 path=p.bin!",               // No '\n' where the length ends
+        "99 path=p.bin\n",             // Past the end of the header data
+        "path=p.bin\n",                // No length
+        "0 path=p.bin\n",
+    };
+    for (size_t i = 0; i < sizeof(records) / sizeof(records[0]); i++) {
+        Bytes archive;
+        add_pax(&archive, 'x', records[i]);
+        add_member(&archive, file("header.bin"), a);
+        add_end(&archive);
+        std::string test = "malformed pax " + std::to_string(i);
+        Expected e[] = { { "header.bin", &a } };
+        expect_members(test.c_str(), archive, e, 1);
+    }
+
+    // Parsing stops at the bad record: the size after it is not applied
+    Bytes archive;
+    add_pax(&archive, 'x', pax_record("path", "good.bin") + "2 size=1\n" + pax_record("size", "1"));
+    add_member(&archive, file("header.bin"), a);
+    add_end(&archive);
+    Expected e[] = { { "good.bin", &a } };
+    expect_members("malformed pax after a good record", archive, e, 1);
+}
+
+// ---------------------------------------------------------------------------
+// Benchmark
+// ---------------------------------------------------------------------------
+
+static double now_s() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static bool read_file(const char* path, Bytes* out) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        return false;
+    }
+    uint8_t buffer[65536];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+        out->insert(out->end(), buffer, buffer + n);
+    }
+    fclose(f);
+    return true;
+}
+
+static void benchmark(const char* path, int rounds) {
+    Bytes archive;
+    if (!read_file(path, &archive)) {
+        CHECK(false, "cannot read %s", path);
+        return;
+    }
+    Collector reference = { std::vector<Member>(), false, 0, 0, nullptr };
+    Run r = parse(archive, archive.size(), &reference);
+    CHECK(r.finished && r.done && !reference.members.empty(), "%s: parse failed: '%s'", path, r.error.c_str());
+    printf("%s: %zu bytes\n", path, archive.size());
+    for (size_t i = 0; i < reference.members.size(); i++) {
+        printf("  %-24s %c %10zu\n", reference.members[i].name.c_str(), reference.members[i].type,
+               reference.members[i].size);
+    }
+
+    static const size_t chunks[] = { 1, 64, 512, 1460, 4096, 32768 };
+    printf("%8s %10s %10s\n", "chunk", "MB/s", "us/member");
+    for (size_t ci = 0; ci < sizeof(chunks) / sizeof(chunks[0]); ci++) {
+        size_t chunk = chunks[ci];
+        int n = chunk < 64 ? (rounds + 9) / 10 : rounds;
+        Collector c = { std::vector<Member>(), false, 0, 0, nullptr };
+        double start = now_s();
+        for (int i = 0; i < n; i++) {
+            r = parse(archive, chunk, &c);
+        }
+        double elapsed = now_s() - start;
+        CHECK(r.finished && c.hash == reference.hash && c.bytes == reference.bytes &&
+                  c.members.size() == reference.members.size(),
+              "chunk %zu: members differ from the single-push parse", chunk);
+        double mbps = archive.size() * (double)n / elapsed / (1024.0 * 1024.0);
+        printf("%8zu %10.1f %10.1f\n", chunk, mbps, elapsed * 1e6 / n / reference.members.size());
+    }
+}
+
+int main(int argc, char** argv) {
+    const char* archive = nullptr;
+    int rounds = 20;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--rounds") == 0 && i + 1 < argc) {
+            rounds = atoi(argv[++i]);
+        } else if (argv[i][0] != '-' && !archive) {
+            archive = argv[i];
+        } else {
+            fprintf(stderr, "usage: tar_stream [update.tar] [--rounds N]\n");
+            return 2;
+        }
+    }
+
+    test_plain();
+    test_prefix();
+    test_gnu_longname();
+    test_gnu_longname_limits();
+    test_pax();
+    test_pax_malformed();
+    test_base256();
+    test_skip_types();
+    test_no_end_blocks();
+    test_truncated();
+    test_bad_checksum();
+    test_abort();
+    printf("unit cases: %s\n", failures ? "FAILED" : "ok");
+
+    if (archive && rounds > 0) {
+        benchmark(archive, rounds);
+    }
+    return failures ? 1 : 0;
+}
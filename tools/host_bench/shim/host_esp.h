@@ -0,0 +1,34 @@
+#pragma once
+#include <stdint.h>
+#include "esp_log.h"
+
+/**
+ * Controls for the ESP-IDF / FreeRTOS shim.
+ *
+ * Time is virtual: esp_timer_get_time(), millis() and vTaskDelay() use a
+ * clock that only moves when the host says so, which keeps rate limits,
+ * session expiry and snapshot ticks deterministic between runs.
+ */
+namespace host_esp {
+
+void advanceTime(int64_t us);
+int64_t now();
+
+// Messages below this level are dropped (default: errors only)
+void setLogLevel(esp_log_level_t level);
+
+// WiFi: a station connect succeeds and raises IP_EVENT_STA_GOT_IP
+void setStationRssi(int8_t rssi);
+void setStationIp(uint8_t a, uint8_t b, uint8_t c, uint8_t d);
+
+// True while the benchmark measures firmware code. Shim bookkeeping (capturing
+// responses, queueing work) runs under ShimScope so it is not counted.
+extern thread_local bool measuring;
+
+struct ShimScope {
+    bool saved;
+    ShimScope() : saved(measuring) { measuring = false; }
+    ~ShimScope() { measuring = saved; }
+};
+
+}  // namespace host_esp
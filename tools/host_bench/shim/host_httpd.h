@@ -0,0 +1,52 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+#include "esp_http_server.h"
+
+/**
+ * Host-side driver for the esp_http_server shim.
+ *
+ * The firmware registers its handlers through httpd_start() and
+ * httpd_register_uri_handler() as usual; the benchmark then feeds requests
+ * through dispatch() instead of a socket. Responses are captured, and the
+ * bytes that would go on the wire are counted the way httpd frames them.
+ */
+namespace host_httpd {
+
+typedef std::vector<std::pair<std::string, std::string> > Headers;
+
+struct Request {
+    httpd_method_t method;
+    std::string uri;        // Path and query
+    Headers headers;
+    std::string body;
+    int sockfd;             // From openSocket(); -1 for none
+};
+
+struct Response {
+    std::string status;     // "200 OK" unless the handler set one
+    std::string type;
+    Headers headers;
+    std::string body;
+    size_t wireBytes;       // Status line, headers, chunk framing and body
+    unsigned chunks;
+    bool completed;         // Final chunk or httpd_resp_send() seen
+    esp_err_t result;       // Handler return value
+};
+
+// Simulate a client connect/disconnect (runs the server's open_fn/close_fn)
+int openSocket();
+void closeSocket(int sockfd);
+
+// Run the registered handler for the request, as the httpd task would
+void dispatch(const Request& request, Response* response);
+
+// Execute work queued with httpd_queue_work() and pending trigger_close()
+void runQueuedWork();
+
+bool running();
+
+}  // namespace host_httpd
@@ -0,0 +1,12 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#ifdef __cplusplus
+extern "C" {
+#endif
+unsigned long millis(void);
+void delay(unsigned long ms);
+#ifdef __cplusplus
+}
+#endif
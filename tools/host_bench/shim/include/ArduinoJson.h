@@ -0,0 +1,3 @@
+#pragma once
+// Host builds compile the firmware sources without ArduinoJson; the
+// translation units under test only include it transitively.
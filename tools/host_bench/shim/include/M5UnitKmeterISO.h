@@ -0,0 +1,17 @@
+#pragma once
+#include <stdint.h>
+#include "Wire.h"
+// Fake KMeter-ISO: a steady 23.50 °C thermocouple reading, values in 1/100 °
+class M5UnitKmeterISO {
+public:
+    int32_t celsius = 2350;
+    int32_t internal = 2812;
+    uint8_t status = 0;
+
+    bool begin(TwoWire* wire, uint8_t addr, uint8_t sda, uint8_t scl, uint32_t speed) { return true; }
+    uint8_t getFirmwareVersion() { return 3; }
+    uint8_t getReadyStatus() { return status; }
+    int32_t getCelsiusTempValue() { return celsius; }
+    int32_t getFahrenheitTempValue() { return celsius * 9 / 5 + 3200; }
+    int32_t getInternalCelsiusTempValue() { return internal; }
+};
@@ -0,0 +1,3 @@
+#pragma once
+#include "esp_err.h"
+typedef int gpio_num_t;
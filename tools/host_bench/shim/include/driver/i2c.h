@@ -0,0 +1,4 @@
+#pragma once
+#include "esp_err.h"
+typedef int i2c_port_t;
+#define I2C_NUM_0 0
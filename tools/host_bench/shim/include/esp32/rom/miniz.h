@@ -0,0 +1,34 @@
+#pragma once
+// tinfl API of the ESP32 ROM, as far as OTAInflate uses it
+#include <stdint.h>
+#include <stddef.h>
+typedef unsigned char mz_uint8;
+typedef uint32_t mz_uint32;
+enum {
+    TINFL_FLAG_PARSE_ZLIB_HEADER = 1,
+    TINFL_FLAG_HAS_MORE_INPUT = 2,
+    TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF = 4,
+    TINFL_FLAG_COMPUTE_ADLER32 = 8
+};
+typedef enum {
+    TINFL_STATUS_BAD_PARAM = -3,
+    TINFL_STATUS_ADLER32_MISMATCH = -2,
+    TINFL_STATUS_FAILED = -1,
+    TINFL_STATUS_DONE = 0,
+    TINFL_STATUS_NEEDS_MORE_INPUT = 1,
+    TINFL_STATUS_HAS_MORE_OUTPUT = 2
+} tinfl_status;
+typedef struct {
+    mz_uint32 m_state;
+    void* m_stream;
+} tinfl_decompressor;
+#define tinfl_init(r) do { (r)->m_state = 0; } while (0)
+#ifdef __cplusplus
+extern "C" {
+#endif
+tinfl_status tinfl_decompress(tinfl_decompressor* r, const mz_uint8* pIn_buf_next, size_t* pIn_buf_size,
+                              mz_uint8* pOut_buf_start, mz_uint8* pOut_buf_next, size_t* pOut_buf_size,
+                              const mz_uint32 decomp_flags);
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,10 @@
+#pragma once
+#include <stdint.h>
+typedef struct { int model; uint32_t features; uint8_t cores; uint8_t revision; } esp_chip_info_t;
+#ifdef __cplusplus
+extern "C" {
+#endif
+void esp_chip_info(esp_chip_info_t* out_info);
+#ifdef __cplusplus
+}
+#endif
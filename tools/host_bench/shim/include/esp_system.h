@@ -0,0 +1,14 @@
+#pragma once
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_idf_version.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+uint32_t esp_get_free_heap_size(void);
+uint32_t esp_get_minimum_free_heap_size(void);
+void esp_restart(void);
+const char* esp_get_idf_version(void);
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,15 @@
+#pragma once
+#include "FreeRTOS.h"
+typedef struct QueueDefinition* QueueHandle_t;
+#ifdef __cplusplus
+extern "C" {
+#endif
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size);
+void vQueueDelete(QueueHandle_t queue);
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticks_to_wait);
+BaseType_t xQueueReceive(QueueHandle_t queue, void* buffer, TickType_t ticks_to_wait);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+#ifdef __cplusplus
+}
+#endif
+#define xQueueSendToBack xQueueSend
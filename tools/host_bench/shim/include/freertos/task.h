@@ -0,0 +1,21 @@
+#pragma once
+#include "FreeRTOS.h"
+typedef struct tskTaskControlBlock* TaskHandle_t;
+typedef void (*TaskFunction_t)(void*);
+#ifdef __cplusplus
+extern "C" {
+#endif
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char* name, uint32_t stack_depth, void* param, UBaseType_t priority, TaskHandle_t* created_task, BaseType_t core_id);
+static inline BaseType_t xTaskCreate(TaskFunction_t fn, const char* name, uint32_t stack_depth, void* param, UBaseType_t priority, TaskHandle_t* created_task) {
+    return xTaskCreatePinnedToCore(fn, name, stack_depth, param, priority, created_task, tskNO_AFFINITY);
+}
+void vTaskDelay(TickType_t ticks);
+void vTaskDelete(TaskHandle_t task);
+TickType_t xTaskGetTickCount(void);
+BaseType_t xPortGetCoreID(void);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait);
+#ifdef __cplusplus
+}
+#endif
+#define tskIDLE_PRIORITY ((UBaseType_t)0U)
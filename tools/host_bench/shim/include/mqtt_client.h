@@ -0,0 +1,4 @@
+#pragma once
+#include "esp_err.h"
+#include "esp_event.h"
+typedef struct esp_mqtt_client* esp_mqtt_client_handle_t;
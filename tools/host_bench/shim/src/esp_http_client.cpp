@@ -0,0 +1,44 @@
+// HTTP client for host builds. The benchmark has no network: every request
+// fails to connect, as on a device whose update server is down.
+#include "esp_http_client.h"
+
+struct esp_http_client {
+    int unused;
+};
+
+extern "C" {
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t* config) {
+    return new esp_http_client();
+}
+
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t client, const char* key, const char* value) {
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_open(esp_http_client_handle_t client, int write_len) {
+    return ESP_FAIL;
+}
+
+int esp_http_client_fetch_headers(esp_http_client_handle_t client) {
+    return ESP_FAIL;
+}
+
+int esp_http_client_get_status_code(esp_http_client_handle_t client) {
+    return 0;
+}
+
+int esp_http_client_read(esp_http_client_handle_t client, char* buffer, int len) {
+    return -1;
+}
+
+esp_err_t esp_http_client_close(esp_http_client_handle_t client) {
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client) {
+    delete client;
+    return ESP_OK;
+}
+
+}  // extern "C"
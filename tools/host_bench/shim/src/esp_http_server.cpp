@@ -0,0 +1,465 @@
+// esp_http_server subset for host builds: requests come from host_httpd::dispatch()
+// instead of sockets, responses are captured. Semantics follow IDF 4.4 where the
+// firmware depends on them (header limit, truncation codes, close_fn, session ctx).
+#include "host_httpd.h"
+#include "host_esp.h"
+#include <map>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+struct Session {
+    void* ctx;
+    httpd_free_ctx_fn_t freeCtx;
+};
+
+struct Server {
+    bool running;
+    httpd_config_t config;
+    std::vector<httpd_uri_t> handlers;
+    std::map<int, Session> sessions;
+    std::vector<std::pair<httpd_work_fn_t, void*> > work;
+    std::vector<int> pendingClose;
+};
+
+Server server;
+
+// Per-request state behind httpd_req_t::aux
+struct Aux {
+    const host_httpd::Request* in;
+    host_httpd::Response* out;
+    size_t bodyPos;
+    bool headersSent;
+};
+
+Aux* aux_of(httpd_req_t* r) {
+    return (Aux*)r->aux;
+}
+
+size_t header_bytes(const Aux* aux, bool chunked, size_t contentLength) {
+    const host_httpd::Response& resp = *aux->out;
+    size_t bytes = strlen("HTTP/1.1 \r\n") + resp.status.size();
+    bytes += strlen("Content-Type: \r\n") + resp.type.size();
+    if (chunked) {
+        bytes += strlen("Transfer-Encoding: chunked\r\n");
+    } else {
+        char len[24];
+        bytes += strlen("Content-Length: \r\n") + snprintf(len, sizeof(len), "%zu", contentLength);
+    }
+    for (size_t i = 0; i < resp.headers.size(); i++) {
+        bytes += resp.headers[i].first.size() + 2 + resp.headers[i].second.size() + 2;
+    }
+    return bytes + 2;
+}
+
+const std::string* find_header(httpd_req_t* r, const char* field) {
+    const host_httpd::Headers& headers = aux_of(r)->in->headers;
+    for (size_t i = 0; i < headers.size(); i++) {
+        if (strcasecmp(headers[i].first.c_str(), field) == 0) {
+            return &headers[i].second;
+        }
+    }
+    return nullptr;
+}
+
+// No temporaries: httpd does not allocate here, the measured handlers must not see it either
+esp_err_t copy_truncated(const char* value, size_t size, char* out, size_t outSize) {
+    if (outSize == 0) {
+        return ESP_ERR_HTTPD_RESULT_TRUNC;
+    }
+    size_t n = size < outSize - 1 ? size : outSize - 1;
+    memcpy(out, value, n);
+    out[n] = '\0';
+    return n < size ? ESP_ERR_HTTPD_RESULT_TRUNC : ESP_OK;
+}
+
+const char* status_text(httpd_err_code_t error) {
+    switch (error) {
+        case HTTPD_400_BAD_REQUEST:              return "400 Bad Request";
+        case HTTPD_401_UNAUTHORIZED:             return "401 Unauthorized";
+        case HTTPD_403_FORBIDDEN:                return "403 Forbidden";
+        case HTTPD_404_NOT_FOUND:                return "404 Not Found";
+        case HTTPD_405_METHOD_NOT_ALLOWED:       return "405 Method Not Allowed";
+        case HTTPD_408_REQ_TIMEOUT:              return "408 Request Timeout";
+        case HTTPD_411_LENGTH_REQUIRED:          return "411 Length Required";
+        case HTTPD_414_URI_TOO_LONG:             return "414 URI Too Long";
+        case HTTPD_431_REQ_HDR_FIELDS_TOO_LARGE: return "431 Request Header Fields Too Large";
+        case HTTPD_501_METHOD_NOT_IMPLEMENTED:   return "501 Method Not Implemented";
+        case HTTPD_505_VERSION_NOT_SUPPORTED:    return "505 Version Not Supported";
+        default:                                 return "500 Internal Server Error";
+    }
+}
+
+void free_session(Session& session) {
+    if (session.ctx != nullptr) {
+        if (session.freeCtx != nullptr) {
+            session.freeCtx(session.ctx);
+        } else {
+            free(session.ctx);
+        }
+    }
+    session.ctx = nullptr;
+}
+
+}  // namespace
+
+extern "C" {
+
+esp_err_t httpd_start(httpd_handle_t* handle, const httpd_config_t* config) {
+    if (server.running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    server.running = true;
+    server.config = *config;
+    server.handlers.clear();
+    *handle = &server;
+    return ESP_OK;
+}
+
+esp_err_t httpd_stop(httpd_handle_t handle) {
+    if (handle != &server || !server.running) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    while (!server.sessions.empty()) {
+        host_httpd::closeSocket(server.sessions.begin()->first);
+    }
+    server.work.clear();
+    server.pendingClose.clear();
+    server.handlers.clear();
+    server.running = false;
+    return ESP_OK;
+}
+
+esp_err_t httpd_register_uri_handler(httpd_handle_t handle, const httpd_uri_t* uri_handler) {
+    for (size_t i = 0; i < server.handlers.size(); i++) {
+        if (server.handlers[i].method == uri_handler->method &&
+            strcmp(server.handlers[i].uri, uri_handler->uri) == 0) {
+            return ESP_ERR_HTTPD_HANDLER_EXISTS;
+        }
+    }
+    if (server.handlers.size() >= server.config.max_uri_handlers) {
+        return ESP_ERR_HTTPD_HANDLERS_FULL;
+    }
+    server.handlers.push_back(*uri_handler);
+    return ESP_OK;
+}
+
+esp_err_t httpd_unregister_uri(httpd_handle_t handle, const char* uri) {
+    for (size_t i = server.handlers.size(); i-- > 0;) {
+        if (strcmp(server.handlers[i].uri, uri) == 0) {
+            server.handlers.erase(server.handlers.begin() + i);
+        }
+    }
+    return ESP_OK;
+}
+
+// Same rules as IDF: trailing '*' matches any rest, trailing '?' makes the last character optional
+bool httpd_uri_match_wildcard(const char* uri_template, const char* uri_to_match, size_t match_upto) {
+    size_t tpl_len = strlen(uri_template);
+    if (tpl_len > 0 && uri_template[tpl_len - 1] == '*') {
+        return strncmp(uri_template, uri_to_match, tpl_len - 1) == 0 && match_upto >= tpl_len - 1;
+    }
+    if (tpl_len > 0 && uri_template[tpl_len - 1] == '?') {
+        tpl_len--;
+        if (match_upto == tpl_len - 1 && strncmp(uri_template, uri_to_match, tpl_len - 1) == 0) {
+            return true;
+        }
+    }
+    return match_upto == tpl_len && strncmp(uri_template, uri_to_match, tpl_len) == 0;
+}
+
+int httpd_req_recv(httpd_req_t* r, char* buf, size_t buf_len) {
+    Aux* aux = aux_of(r);
+    const std::string& body = aux->in->body;
+    size_t n = body.size() - aux->bodyPos;
+    if (n > buf_len) {
+        n = buf_len;
+    }
+    memcpy(buf, body.data() + aux->bodyPos, n);
+    aux->bodyPos += n;
+    return (int)n;
+}
+
+size_t httpd_req_get_hdr_value_len(httpd_req_t* r, const char* field) {
+    const std::string* value = find_header(r, field);
+    return value ? value->size() : 0;
+}
+
+esp_err_t httpd_req_get_hdr_value_str(httpd_req_t* r, const char* field, char* val, size_t val_size) {
+    const std::string* value = find_header(r, field);
+    if (value == nullptr) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    return copy_truncated(value->data(), value->size(), val, val_size);
+}
+
+esp_err_t httpd_req_get_cookie_val(httpd_req_t* r, const char* cookie_name, char* val, size_t* val_size) {
+    const std::string* cookies = find_header(r, "Cookie");
+    if (cookies == nullptr) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    size_t name_len = strlen(cookie_name);
+    size_t pos = 0;
+    while (pos < cookies->size()) {
+        while (pos < cookies->size() && ((*cookies)[pos] == ' ' || (*cookies)[pos] == ';')) {
+            pos++;
+        }
+        size_t end = cookies->find(';', pos);
+        if (end == std::string::npos) {
+            end = cookies->size();
+        }
+        if (cookies->compare(pos, name_len, cookie_name) == 0 && (*cookies)[pos + name_len] == '=') {
+            size_t value_len = end - pos - name_len - 1;
+            esp_err_t err = copy_truncated(cookies->data() + pos + name_len + 1, value_len, val, *val_size);
+            *val_size = value_len + 1;
+            return err;
+        }
+        pos = end;
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+size_t httpd_req_get_url_query_len(httpd_req_t* r) {
+    const char* query = strchr(r->uri, '?');
+    return query ? strlen(query + 1) : 0;
+}
+
+esp_err_t httpd_req_get_url_query_str(httpd_req_t* r, char* buf, size_t buf_len) {
+    const char* query = strchr(r->uri, '?');
+    if (query == nullptr) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    return copy_truncated(query + 1, strlen(query + 1), buf, buf_len);
+}
+
+esp_err_t httpd_query_key_value(const char* qry, const char* key, char* val, size_t val_size) {
+    size_t key_len = strlen(key);
+    const char* p = qry;
+    while (p != nullptr && *p != '\0') {
+        const char* end = strchr(p, '&');
+        size_t len = end ? (size_t)(end - p) : strlen(p);
+        if (len > key_len && strncmp(p, key, key_len) == 0 && p[key_len] == '=') {
+            return copy_truncated(p + key_len + 1, len - key_len - 1, val, val_size);
+        }
+        p = end ? end + 1 : nullptr;
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+int httpd_req_to_sockfd(httpd_req_t* r) {
+    return aux_of(r)->in->sockfd;
+}
+
+esp_err_t httpd_resp_set_status(httpd_req_t* r, const char* status) {
+    host_esp::ShimScope shim;
+    aux_of(r)->out->status = status;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_type(httpd_req_t* r, const char* type) {
+    host_esp::ShimScope shim;
+    aux_of(r)->out->type = type;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_hdr(httpd_req_t* r, const char* field, const char* value) {
+    host_esp::ShimScope shim;
+    host_httpd::Headers& headers = aux_of(r)->out->headers;
+    if (headers.size() >= server.config.max_resp_headers) {
+        return ESP_ERR_HTTPD_RESP_HDR;
+    }
+    headers.push_back(std::make_pair(std::string(field), std::string(value)));
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send(httpd_req_t* r, const char* buf, ssize_t buf_len) {
+    host_esp::ShimScope shim;
+    Aux* aux = aux_of(r);
+    if (buf_len == HTTPD_RESP_USE_STRLEN) {
+        buf_len = buf ? strlen(buf) : 0;
+    }
+    aux->out->wireBytes += header_bytes(aux, false, buf_len) + buf_len;
+    if (buf_len > 0) {
+        aux->out->body.append(buf, buf_len);
+    }
+    aux->headersSent = true;
+    aux->out->completed = true;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send_chunk(httpd_req_t* r, const char* buf, ssize_t buf_len) {
+    host_esp::ShimScope shim;
+    Aux* aux = aux_of(r);
+    if (buf_len == HTTPD_RESP_USE_STRLEN) {
+        buf_len = buf ? strlen(buf) : 0;
+    }
+    if (!aux->headersSent) {
+        aux->out->wireBytes += header_bytes(aux, true, 0);
+        aux->headersSent = true;
+    }
+    if (buf == nullptr || buf_len == 0) {
+        aux->out->wireBytes += strlen("0\r\n\r\n");
+        aux->out->completed = true;
+        return ESP_OK;
+    }
+    char len[16];
+    aux->out->wireBytes += snprintf(len, sizeof(len), "%zx", (size_t)buf_len) + 2 + buf_len + 2;
+    aux->out->body.append(buf, buf_len);
+    aux->out->chunks++;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send_err(httpd_req_t* req, httpd_err_code_t error, const char* msg) {
+    httpd_resp_set_status(req, status_text(error));
+    httpd_resp_set_type(req, "text/html");
+    return httpd_resp_send(req, msg ? msg : status_text(error), HTTPD_RESP_USE_STRLEN);
+}
+
+esp_err_t httpd_queue_work(httpd_handle_t handle, httpd_work_fn_t work, void* arg) {
+    host_esp::ShimScope shim;
+    if (handle != &server || !server.running) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    server.work.push_back(std::make_pair(work, arg));
+    return ESP_OK;
+}
+
+void* httpd_sess_get_ctx(httpd_handle_t handle, int sockfd) {
+    std::map<int, Session>::iterator it = server.sessions.find(sockfd);
+    return it != server.sessions.end() ? it->second.ctx : nullptr;
+}
+
+void httpd_sess_set_ctx(httpd_handle_t handle, int sockfd, void* ctx, httpd_free_ctx_fn_t free_fn) {
+    std::map<int, Session>::iterator it = server.sessions.find(sockfd);
+    if (it == server.sessions.end()) {
+        return;
+    }
+    if (it->second.ctx != ctx) {
+        free_session(it->second);
+    }
+    it->second.ctx = ctx;
+    it->second.freeCtx = free_fn;
+}
+
+esp_err_t httpd_sess_trigger_close(httpd_handle_t handle, int sockfd) {
+    host_esp::ShimScope shim;
+    if (server.sessions.find(sockfd) == server.sessions.end()) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    server.pendingClose.push_back(sockfd);
+    return ESP_OK;
+}
+
+esp_err_t httpd_get_client_list(httpd_handle_t handle, size_t* fds, int* client_fds) {
+    size_t n = 0;
+    for (std::map<int, Session>::iterator it = server.sessions.begin(); it != server.sessions.end() && n < *fds; ++it) {
+        client_fds[n++] = it->first;
+    }
+    *fds = n;
+    return ESP_OK;
+}
+
+}  // extern "C"
+
+namespace host_httpd {
+
+bool running() {
+    return server.running;
+}
+
+int openSocket() {
+    // A real descriptor, so the firmware's close()/getpeername() behave
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    Session session = { nullptr, nullptr };
+    server.sessions[fd] = session;
+    if (server.config.open_fn != nullptr && server.config.open_fn(&server, fd) != ESP_OK) {
+        closeSocket(fd);
+        return -1;
+    }
+    return fd;
+}
+
+void closeSocket(int sockfd) {
+    std::map<int, Session>::iterator it = server.sessions.find(sockfd);
+    if (it == server.sessions.end()) {
+        return;
+    }
+    // As in IDF: with close_fn set, closing the descriptor is the application's job
+    if (server.config.close_fn != nullptr) {
+        server.config.close_fn(&server, sockfd);
+    } else {
+        close(sockfd);
+    }
+    free_session(it->second);
+    server.sessions.erase(it);
+}
+
+void dispatch(const Request& request, Response* response) {
+    response->status = "200 OK";
+    response->type = "text/html";
+    response->headers.clear();
+    response->body.clear();
+    response->wireBytes = 0;
+    response->chunks = 0;
+    response->completed = false;
+    response->result = ESP_OK;
+
+    Aux aux = { &request, response, 0, false };
+    // uri is const in httpd_req_t, so the struct cannot be default-constructed
+    alignas(httpd_req_t) unsigned char storage[sizeof(httpd_req_t)] = {};
+    httpd_req_t& req = *reinterpret_cast<httpd_req_t*>(storage);
+    req.handle = &server;
+    req.method = request.method;
+    strncpy((char*)req.uri, request.uri.c_str(), HTTPD_MAX_URI_LEN);
+    req.content_len = request.body.size();
+    req.aux = &aux;
+    req.sess_ctx = httpd_sess_get_ctx(&server, request.sockfd);
+
+    size_t match_upto = strcspn(req.uri, "?");
+    const httpd_uri_t* handler = nullptr;
+    for (size_t i = 0; i < server.handlers.size() && handler == nullptr; i++) {
+        const httpd_uri_t& h = server.handlers[i];
+        bool match = server.config.uri_match_fn
+            ? server.config.uri_match_fn(h.uri, req.uri, match_upto)
+            : (strlen(h.uri) == match_upto && strncmp(h.uri, req.uri, match_upto) == 0);
+        if (match && h.method == request.method) {
+            handler = &h;
+        }
+    }
+    if (handler == nullptr) {
+        httpd_resp_send_err(&req, HTTPD_404_NOT_FOUND, nullptr);
+        response->result = ESP_FAIL;
+        return;
+    }
+
+    req.user_ctx = handler->user_ctx;
+    response->result = handler->handler(&req);
+
+    // The handler may have replaced the session context
+    if (!req.ignore_sess_ctx_changes && request.sockfd >= 0 &&
+        req.sess_ctx != httpd_sess_get_ctx(&server, request.sockfd)) {
+        httpd_sess_set_ctx(&server, request.sockfd, req.sess_ctx, req.free_ctx);
+    }
+}
+
+void runQueuedWork() {
+    std::vector<std::pair<httpd_work_fn_t, void*> > work;
+    work.swap(server.work);
+    for (size_t i = 0; i < work.size(); i++) {
+        work[i].first(work[i].second);
+    }
+    std::vector<int> pending;
+    pending.swap(server.pendingClose);
+    for (size_t i = 0; i < pending.size(); i++) {
+        closeSocket(pending[i]);
+    }
+}
+
+}  // namespace host_httpd
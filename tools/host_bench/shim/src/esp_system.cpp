@@ -0,0 +1,196 @@
+// Core ESP-IDF services for host builds: virtual clock, logging, random,
+// system info, SPIFFS, LEDC and CRC. Partition/OTA access is in
+// esp_partition.cpp, or in bench/flash_fake.cpp for the OTA benchmark.
+#include "host_esp.h"
+#include "Arduino.h"
+#include "driver/ledc.h"
+#include "esp_chip_info.h"
+#include "esp_crc.h"
+#include "esp_err.h"
+#include "esp_flash.h"
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_random.h"
+#include "esp_spiffs.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace {
+
+int64_t clock_us = 1000000;             // Not zero: "never" timestamps stay in the past
+esp_log_level_t log_level = ESP_LOG_ERROR;
+uint32_t random_state = 0x2545F491;     // Fixed seed, runs are reproducible
+uint32_t ledc_duty[2];
+
+}  // namespace
+
+namespace host_esp {
+
+thread_local bool measuring = false;
+
+void advanceTime(int64_t us) {
+    clock_us += us;
+}
+
+int64_t now() {
+    return clock_us;
+}
+
+void setLogLevel(esp_log_level_t level) {
+    log_level = level;
+}
+
+}  // namespace host_esp
+
+extern "C" {
+
+int64_t esp_timer_get_time(void) {
+    return clock_us;
+}
+
+unsigned long millis(void) {
+    return (unsigned long)(clock_us / 1000);
+}
+
+void delay(unsigned long ms) {
+    clock_us += (int64_t)ms * 1000;
+}
+
+void esp_log_level_set(const char* tag, esp_log_level_t level) {
+}
+
+void esp_log_write(esp_log_level_t level, const char* tag, const char* format, ...) {
+    if (level > log_level || level == ESP_LOG_NONE) {
+        return;
+    }
+    static const char letters[] = "NEWIDV";
+    fprintf(stderr, "%c (%lld) %s: ", letters[level], (long long)(clock_us / 1000), tag);
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fputc('\n', stderr);
+}
+
+const char* esp_err_to_name(esp_err_t code) {
+    switch (code) {
+        case ESP_OK:                return "ESP_OK";
+        case ESP_FAIL:              return "ESP_FAIL";
+        case ESP_ERR_NO_MEM:        return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG:   return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_INVALID_SIZE:  return "ESP_ERR_INVALID_SIZE";
+        case ESP_ERR_NOT_FOUND:     return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+        case ESP_ERR_TIMEOUT:       return "ESP_ERR_TIMEOUT";
+        default:                    return "ERROR";
+    }
+}
+
+// xorshift32
+uint32_t esp_random(void) {
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state;
+}
+
+void esp_fill_random(void* buf, size_t len) {
+    uint8_t* out = (uint8_t*)buf;
+    while (len > 0) {
+        uint32_t r = esp_random();
+        size_t n = len < 4 ? len : 4;
+        memcpy(out, &r, n);
+        out += n;
+        len -= n;
+    }
+}
+
+// Fixed values, so responses that report them keep a stable size
+uint32_t esp_get_free_heap_size(void) {
+    return 187432;
+}
+
+uint32_t esp_get_minimum_free_heap_size(void) {
+    return 151208;
+}
+
+void esp_restart(void) {
+    fprintf(stderr, "esp_restart() called - a benchmark scenario must not reboot the device\n");
+    abort();
+}
+
+const char* esp_get_idf_version(void) {
+    return "v4.4.7-host";
+}
+
+void esp_chip_info(esp_chip_info_t* out_info) {
+    out_info->model = 1;         // CHIP_ESP32
+    out_info->features = 0x32;   // WiFi, BLE, BT
+    out_info->cores = 2;
+    out_info->revision = 3;
+}
+
+esp_err_t esp_flash_get_size(esp_flash_t* chip, uint32_t* out_size) {
+    *out_size = 4 * 1024 * 1024;
+    return ESP_OK;
+}
+
+esp_err_t esp_read_mac(uint8_t* mac, esp_mac_type_t type) {
+    static const uint8_t base[6] = { 0x24, 0x0A, 0xC4, 0x12, 0x34, 0x56 };
+    memcpy(mac, base, 6);
+    mac[5] += (uint8_t)type;
+    return ESP_OK;
+}
+
+esp_err_t esp_vfs_spiffs_register(const esp_vfs_spiffs_conf_t* conf) {
+    return ESP_OK;
+}
+
+esp_err_t esp_vfs_spiffs_unregister(const char* partition_label) {
+    return ESP_OK;
+}
+
+esp_err_t esp_spiffs_info(const char* partition_label, size_t* total_bytes, size_t* used_bytes) {
+    *total_bytes = 1378241;
+    *used_bytes = 131072;
+    return ESP_OK;
+}
+
+esp_err_t ledc_timer_config(const ledc_timer_config_t* timer_conf) {
+    return ESP_OK;
+}
+
+esp_err_t ledc_channel_config(const ledc_channel_config_t* ledc_conf) {
+    ledc_duty[ledc_conf->channel & 1] = ledc_conf->duty;
+    return ESP_OK;
+}
+
+esp_err_t ledc_set_duty(ledc_mode_t speed_mode, ledc_channel_t channel, uint32_t duty) {
+    ledc_duty[channel & 1] = duty;
+    return ESP_OK;
+}
+
+esp_err_t ledc_update_duty(ledc_mode_t speed_mode, ledc_channel_t channel) {
+    return ESP_OK;
+}
+
+uint32_t ledc_get_duty(ledc_mode_t speed_mode, ledc_channel_t channel) {
+    return ledc_duty[channel & 1];
+}
+
+uint32_t esp_crc32_le(uint32_t crc, const uint8_t* buf, uint32_t len) {
+    crc = ~crc;
+    for (uint32_t i = 0; i < len; i++) {
+        crc ^= buf[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+}  // extern "C"
@@ -0,0 +1,227 @@
+// WiFi, netif and default event loop for host builds. Events are delivered
+// synchronously to the registered handlers: a station connect raises
+// IP_EVENT_STA_GOT_IP at once, a scan completes with a fixed AP list.
+#include "host_esp.h"
+#include "esp_event.h"
+#include "esp_netif.h"
+#include "esp_wifi.h"
+#include <string.h>
+#include <vector>
+
+esp_event_base_t const WIFI_EVENT = "WIFI_EVENT";
+esp_event_base_t const IP_EVENT = "IP_EVENT";
+
+struct esp_netif_obj {
+    esp_netif_ip_info_t ip;
+};
+
+namespace {
+
+struct Handler {
+    esp_event_base_t base;
+    int32_t id;
+    esp_event_handler_t fn;
+    void* arg;
+};
+
+std::vector<Handler> handlers;
+esp_netif_obj sta_netif = { { { 0 }, { 0 }, { 0 } } };
+esp_netif_obj ap_netif = { { { 0x0104A8C0 }, { 0x00FFFFFF }, { 0x0104A8C0 } } };   // 192.168.4.1/24
+wifi_mode_t mode = WIFI_MODE_NULL;
+wifi_config_t sta_config;
+wifi_config_t ap_config;
+bool sta_connected = false;
+int8_t station_rssi = -58;
+uint32_t station_ip = 0x2A00A8C0;   // 192.168.0.42
+
+struct FakeAp {
+    const char* ssid;
+    int8_t rssi;
+    uint8_t channel;
+    wifi_auth_mode_t auth;
+};
+
+const FakeAp scan_results[] = {
+    { "Werkstatt", -48, 6, WIFI_AUTH_WPA2_PSK },
+    { "Buero-2G", -63, 1, WIFI_AUTH_WPA2_WPA3_PSK },
+    { "Gast", -77, 11, WIFI_AUTH_OPEN },
+};
+const uint16_t scan_result_count = sizeof(scan_results) / sizeof(scan_results[0]);
+uint16_t scan_pending = 0;
+
+void post(esp_event_base_t base, int32_t id, void* data) {
+    // Copy: a handler may register further handlers
+    std::vector<Handler> targets = handlers;
+    for (size_t i = 0; i < targets.size(); i++) {
+        if (targets[i].base == base && (targets[i].id == ESP_EVENT_ANY_ID || targets[i].id == id)) {
+            targets[i].fn(targets[i].arg, base, id, data);
+        }
+    }
+}
+
+}  // namespace
+
+namespace host_esp {
+
+void setStationRssi(int8_t rssi) {
+    station_rssi = rssi;
+}
+
+void setStationIp(uint8_t a, uint8_t b, uint8_t c, uint8_t d) {
+    station_ip = (uint32_t)a | ((uint32_t)b << 8) | ((uint32_t)c << 16) | ((uint32_t)d << 24);
+}
+
+}  // namespace host_esp
+
+extern "C" {
+
+esp_err_t esp_event_loop_create_default(void) {
+    return ESP_OK;
+}
+
+esp_err_t esp_event_handler_register(esp_event_base_t event_base, int32_t event_id, esp_event_handler_t event_handler, void* event_handler_arg) {
+    Handler handler = { event_base, event_id, event_handler, event_handler_arg };
+    handlers.push_back(handler);
+    return ESP_OK;
+}
+
+esp_err_t esp_netif_init(void) {
+    return ESP_OK;
+}
+
+esp_netif_t* esp_netif_create_default_wifi_sta(void) {
+    return &sta_netif;
+}
+
+esp_netif_t* esp_netif_create_default_wifi_ap(void) {
+    return &ap_netif;
+}
+
+esp_netif_t* esp_netif_get_handle_from_ifkey(const char* if_key) {
+    return strcmp(if_key, "WIFI_AP_DEF") == 0 ? &ap_netif : &sta_netif;
+}
+
+esp_err_t esp_netif_get_ip_info(esp_netif_t* esp_netif, esp_netif_ip_info_t* ip_info) {
+    *ip_info = esp_netif->ip;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_init(const wifi_init_config_t* config) {
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_mode(wifi_mode_t new_mode) {
+    mode = new_mode;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_get_mode(wifi_mode_t* out_mode) {
+    *out_mode = mode;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_start(void) {
+    if (mode == WIFI_MODE_AP || mode == WIFI_MODE_APSTA) {
+        post(WIFI_EVENT, WIFI_EVENT_AP_START, nullptr);
+    }
+    if (mode == WIFI_MODE_STA || mode == WIFI_MODE_APSTA) {
+        post(WIFI_EVENT, WIFI_EVENT_STA_START, nullptr);
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_connect(void) {
+    if (mode != WIFI_MODE_STA && mode != WIFI_MODE_APSTA) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    sta_connected = true;
+    sta_netif.ip.ip.addr = station_ip;
+    sta_netif.ip.netmask.addr = 0x00FFFFFF;
+    sta_netif.ip.gw.addr = (station_ip & 0x00FFFFFF) | 0x01000000;
+    post(WIFI_EVENT, WIFI_EVENT_STA_CONNECTED, nullptr);
+    ip_event_got_ip_t event = {};
+    event.esp_netif = &sta_netif;
+    event.ip_info = sta_netif.ip;
+    event.ip_changed = true;
+    post(IP_EVENT, IP_EVENT_STA_GOT_IP, &event);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_disconnect(void) {
+    if (sta_connected) {
+        sta_connected = false;
+        sta_netif.ip.ip.addr = 0;
+        post(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, nullptr);
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_config(wifi_interface_t interface, wifi_config_t* conf) {
+    (interface == WIFI_IF_AP ? ap_config : sta_config) = *conf;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_get_config(wifi_interface_t interface, wifi_config_t* conf) {
+    *conf = interface == WIFI_IF_AP ? ap_config : sta_config;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_get_mac(wifi_interface_t ifx, uint8_t mac[6]) {
+    static const uint8_t base[6] = { 0x24, 0x0A, 0xC4, 0x12, 0x34, 0x56 };
+    memcpy(mac, base, 6);
+    mac[5] += ifx == WIFI_IF_AP ? 1 : 0;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_sta_get_ap_info(wifi_ap_record_t* ap_info) {
+    if (!sta_connected) {
+        return ESP_ERR_NOT_FOUND;   // ESP_ERR_WIFI_NOT_CONNECT on the device
+    }
+    memset(ap_info, 0, sizeof(*ap_info));
+    memcpy(ap_info->ssid, sta_config.sta.ssid, sizeof(sta_config.sta.ssid));
+    ap_info->primary = 6;
+    ap_info->rssi = station_rssi;
+    ap_info->authmode = WIFI_AUTH_WPA2_PSK;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_scan_start(const wifi_scan_config_t* config, bool block) {
+    if (mode != WIFI_MODE_STA && mode != WIFI_MODE_APSTA) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    scan_pending = scan_result_count;
+    wifi_event_sta_scan_done_t event = { 0, (uint8_t)scan_result_count, 1 };
+    post(WIFI_EVENT, WIFI_EVENT_SCAN_DONE, &event);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_scan_stop(void) {
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_scan_get_ap_num(uint16_t* number) {
+    *number = scan_pending;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_scan_get_ap_records(uint16_t* number, wifi_ap_record_t* ap_records) {
+    uint16_t n = *number < scan_pending ? *number : scan_pending;
+    for (uint16_t i = 0; i < n; i++) {
+        memset(&ap_records[i], 0, sizeof(ap_records[i]));
+        strncpy((char*)ap_records[i].ssid, scan_results[i].ssid, sizeof(ap_records[i].ssid) - 1);
+        ap_records[i].bssid[5] = (uint8_t)(i + 1);
+        ap_records[i].primary = scan_results[i].channel;
+        ap_records[i].rssi = scan_results[i].rssi;
+        ap_records[i].authmode = scan_results[i].auth;
+    }
+    *number = n;
+    scan_pending = 0;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_ap_get_sta_list(wifi_sta_list_t* sta) {
+    sta->num = 1;
+    return ESP_OK;
+}
+
+}  // extern "C"
@@ -0,0 +1,102 @@
+// FreeRTOS subset for host builds. There is no scheduler: tasks are not
+// started (callers take their inline fallbacks), delays advance the virtual
+// clock, and critical sections map to one recursive mutex.
+#include "host_esp.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include <mutex>
+
+namespace {
+
+std::recursive_mutex critical;
+
+struct Semaphore {
+    std::recursive_mutex mutex;
+};
+
+}  // namespace
+
+extern "C" {
+
+void vPortEnterCritical(portMUX_TYPE* mux) {
+    critical.lock();
+}
+
+void vPortExitCritical(portMUX_TYPE* mux) {
+    critical.unlock();
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char* name, uint32_t stack_depth, void* param,
+                                   UBaseType_t priority, TaskHandle_t* created_task, BaseType_t core_id) {
+    return pdFAIL;
+}
+
+void vTaskDelay(TickType_t ticks) {
+    host_esp::advanceTime((int64_t)ticks * 1000000 / configTICK_RATE_HZ);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+}
+
+TickType_t xTaskGetTickCount(void) {
+    return (TickType_t)(host_esp::now() * configTICK_RATE_HZ / 1000000);
+}
+
+BaseType_t xPortGetCoreID(void) {
+    return 0;
+}
+
+// Only called from tasks, which never run here
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait) {
+    return 0;
+}
+
+// Queues would need a consumer task; returning none selects the inline paths
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+    return nullptr;
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticks_to_wait) {
+    return pdFAIL;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* buffer, TickType_t ticks_to_wait) {
+    return pdFAIL;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    return 0;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+    return (SemaphoreHandle_t)new Semaphore();
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void) {
+    return (SemaphoreHandle_t)new Semaphore();
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks_to_wait) {
+    ((Semaphore*)sem)->mutex.lock();
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) {
+    ((Semaphore*)sem)->mutex.unlock();
+    return pdTRUE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem) {
+    delete (Semaphore*)sem;
+}
+
+}  // extern "C"
@@ -0,0 +1,45 @@
+// ROM tinfl for host builds, on top of the system zlib. zlib keeps its own
+// window, so the caller's ring only receives output; the stream is released
+// when it ends or fails, a decoder dropped halfway leaks it.
+#include "esp32/rom/miniz.h"
+#include <stdlib.h>
+#include <zlib.h>
+
+extern "C" {
+
+tinfl_status tinfl_decompress(tinfl_decompressor* r, const mz_uint8* pIn_buf_next, size_t* pIn_buf_size,
+                              mz_uint8* pOut_buf_start, mz_uint8* pOut_buf_next, size_t* pOut_buf_size,
+                              const mz_uint32 decomp_flags) {
+    if (r->m_state == 0) {
+        z_stream* stream = (z_stream*)calloc(1, sizeof(z_stream));
+        int bits = (decomp_flags & TINFL_FLAG_PARSE_ZLIB_HEADER) ? 15 : -15;
+        if (!stream || inflateInit2(stream, bits) != Z_OK) {
+            free(stream);
+            return TINFL_STATUS_FAILED;
+        }
+        r->m_stream = stream;
+        r->m_state = 1;
+    }
+    z_stream* stream = (z_stream*)r->m_stream;
+    if (!stream) {
+        return TINFL_STATUS_FAILED;   // Already ended
+    }
+
+    stream->next_in = (Bytef*)pIn_buf_next;
+    stream->avail_in = (uInt)*pIn_buf_size;
+    stream->next_out = pOut_buf_next;
+    stream->avail_out = (uInt)*pOut_buf_size;
+    int ret = inflate(stream, Z_NO_FLUSH);
+    *pIn_buf_size -= stream->avail_in;
+    *pOut_buf_size -= stream->avail_out;
+
+    if (ret == Z_OK || ret == Z_BUF_ERROR) {
+        return stream->avail_out == 0 ? TINFL_STATUS_HAS_MORE_OUTPUT : TINFL_STATUS_NEEDS_MORE_INPUT;
+    }
+    inflateEnd(stream);
+    free(stream);
+    r->m_stream = nullptr;
+    return ret == Z_STREAM_END ? TINFL_STATUS_DONE : TINFL_STATUS_FAILED;
+}
+
+}  // extern "C"
@@ -0,0 +1,174 @@
+// In-memory NVS for host builds. Namespaces and keys behave like the real
+// store as far as Config and WiFiManager rely on it; nothing is persisted.
+// std::string keys allocate where flash would not, so lookups run under ShimScope.
+#include "host_esp.h"
+#include "nvs_flash.h"
+#include <map>
+#include <string>
+#include <string.h>
+
+namespace {
+
+struct Entry {
+    bool isString;
+    std::string str;
+    int64_t number;
+};
+
+typedef std::map<std::string, Entry> Namespace;
+
+std::map<std::string, Namespace> store;
+std::map<nvs_handle_t, std::string> handles;
+nvs_handle_t nextHandle = 1;
+
+Namespace* lookup(nvs_handle_t handle) {
+    std::map<nvs_handle_t, std::string>::iterator it = handles.find(handle);
+    return it == handles.end() ? nullptr : &store[it->second];
+}
+
+esp_err_t setNumber(nvs_handle_t handle, const char* key, int64_t value) {
+    host_esp::ShimScope shim;
+    Namespace* ns = lookup(handle);
+    if (!ns) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    Entry& entry = (*ns)[key];
+    entry.isString = false;
+    entry.number = value;
+    return ESP_OK;
+}
+
+template <typename T>
+esp_err_t getNumber(nvs_handle_t handle, const char* key, T* out_value) {
+    host_esp::ShimScope shim;
+    Namespace* ns = lookup(handle);
+    if (!ns) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    Namespace::iterator it = ns->find(key);
+    if (it == ns->end() || it->second.isString) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    *out_value = (T)it->second.number;
+    return ESP_OK;
+}
+
+}  // namespace
+
+extern "C" {
+
+esp_err_t nvs_flash_init(void) {
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void) {
+    store.clear();
+    return ESP_OK;
+}
+
+esp_err_t nvs_open(const char* name, nvs_open_mode_t open_mode, nvs_handle_t* out_handle) {
+    host_esp::ShimScope shim;
+    if (open_mode == NVS_READONLY && store.find(name) == store.end()) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    store[name];
+    *out_handle = nextHandle++;
+    handles[*out_handle] = name;
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle) {
+    handles.erase(handle);
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle) {
+    return lookup(handle) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t nvs_erase_all(nvs_handle_t handle) {
+    Namespace* ns = lookup(handle);
+    if (!ns) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    ns->clear();
+    return ESP_OK;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char* key) {
+    host_esp::ShimScope shim;
+    Namespace* ns = lookup(handle);
+    if (!ns) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return ns->erase(key) ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_set_str(nvs_handle_t handle, const char* key, const char* value) {
+    host_esp::ShimScope shim;
+    Namespace* ns = lookup(handle);
+    if (!ns) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    Entry& entry = (*ns)[key];
+    entry.isString = true;
+    entry.str = value;
+    return ESP_OK;
+}
+
+// Same contract as IDF: out_value NULL queries the length including the terminator
+esp_err_t nvs_get_str(nvs_handle_t handle, const char* key, char* out_value, size_t* length) {
+    host_esp::ShimScope shim;
+    Namespace* ns = lookup(handle);
+    if (!ns) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    Namespace::iterator it = ns->find(key);
+    if (it == ns->end() || !it->second.isString) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    size_t needed = it->second.str.size() + 1;
+    if (!out_value) {
+        *length = needed;
+        return ESP_OK;
+    }
+    if (*length < needed) {
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    memcpy(out_value, it->second.str.c_str(), needed);
+    *length = needed;
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_u8(nvs_handle_t handle, const char* key, uint8_t value) {
+    return setNumber(handle, key, value);
+}
+
+esp_err_t nvs_get_u8(nvs_handle_t handle, const char* key, uint8_t* out_value) {
+    return getNumber(handle, key, out_value);
+}
+
+esp_err_t nvs_set_u16(nvs_handle_t handle, const char* key, uint16_t value) {
+    return setNumber(handle, key, value);
+}
+
+esp_err_t nvs_get_u16(nvs_handle_t handle, const char* key, uint16_t* out_value) {
+    return getNumber(handle, key, out_value);
+}
+
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char* key, uint32_t value) {
+    return setNumber(handle, key, value);
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char* key, uint32_t* out_value) {
+    return getNumber(handle, key, out_value);
+}
+
+esp_err_t nvs_set_i32(nvs_handle_t handle, const char* key, int32_t value) {
+    return setNumber(handle, key, value);
+}
+
+esp_err_t nvs_get_i32(nvs_handle_t handle, const char* key, int32_t* out_value) {
+    return getNumber(handle, key, out_value);
+}
+
+}  // extern "C"
@@ -0,0 +1,187 @@
+#!/usr/bin/env python3
+"""
+Lokaler Update-Server für den OTA-Pull-Modus (siehe src/OTAPull.h)
+
+Liefert zwei Dateien:
+  /manifest.json   {"version": ..., "package": "update.tar", "size": N, "sha256": "..."}
+  /update.tar      mit Range-Anfragen (206), ETag und If-Range
+
+Das Gerät lädt das Paket, wenn "version" von seiner Firmware-Version abweicht
+(Standard: FIRMWARE_VERSION aus src/Config.h) und es dieses Paket noch nicht
+installiert hat. Ein neues update.tar wird beim nächsten Abruf erkannt.
+
+Zum Testen der Fortsetzung und der Drosselung:
+  --drop-after BYTES   Verbindung nach so vielen Bytes pro Anfrage abbrechen
+  --rate KBPS          Server-seitig drosseln
+
+Beispiele:
+  python3 tools/ota_pull_server.py
+  python3 tools/ota_pull_server.py --port 8070 --package update.tar --drop-after 300000
+Auf dem Gerät: POST /api/ota/pull {"url": "http://<pc>:8070/manifest.json", "check": true}
+"""
+
+import argparse
+import hashlib
+import json
+import re
+import sys
+import threading
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from pathlib import Path
+
+PROJECT_ROOT = Path(__file__).resolve().parent.parent
+CONFIG_H = PROJECT_ROOT / "src" / "Config.h"
+CHUNK = 4096
+
+
+def firmware_version():
+    """FIRMWARE_VERSION aus src/Config.h, damit Gerät und Server dasselbe vergleichen"""
+    match = re.search(r'FIRMWARE_VERSION\[\]\s*=\s*"([^"]+)"', CONFIG_H.read_text(encoding="utf-8"))
+    return match.group(1) if match else "unknown"
+
+
+class Package:
+    """update.tar mit Prüfsumme; neu berechnet, sobald sich die Datei ändert"""
+
+    def __init__(self, path):
+        self.path = path
+        self.lock = threading.Lock()
+        self.stamp = None
+        self.size = 0
+        self.sha256 = ""
+
+    def refresh(self):
+        with self.lock:
+            stat = self.path.stat()
+            stamp = (stat.st_mtime_ns, stat.st_size)
+            if stamp != self.stamp:
+                self.sha256 = hashlib.sha256(self.path.read_bytes()).hexdigest()
+                self.size = stat.st_size
+                self.stamp = stamp
+                print(f"Paket {self.path.name}: {self.size} Bytes, sha256 {self.sha256[:16]}...")
+            return self.size, self.sha256
+
+
+def parse_range(header, size):
+    """'bytes=A-' oder 'bytes=A-B' -> (start, ende exklusiv); None wenn ungültig"""
+    match = re.fullmatch(r"bytes=(\d+)-(\d*)", header.strip())
+    if not match:
+        return None
+    start = int(match.group(1))
+    end = int(match.group(2)) + 1 if match.group(2) else size
+    if start >= size or end <= start:
+        return None
+    return start, min(end, size)
+
+
+def make_handler(args, package):
+    class Handler(BaseHTTPRequestHandler):
+        protocol_version = "HTTP/1.1"
+
+        def log_message(self, fmt, *params):
+            sys.stderr.write(f"{self.address_string()} {fmt % params}\n")
+
+        def do_GET(self):
+            size, sha256 = package.refresh()
+            if self.path == "/manifest.json":
+                self.send_manifest(size, sha256)
+            elif self.path == "/" + package.path.name:
+                self.send_package(size, sha256)
+            else:
+                self.send_error(404)
+
+        def send_manifest(self, size, sha256):
+            body = json.dumps({
+                "version": args.version,
+                "package": package.path.name,
+                "size": size,
+                "sha256": sha256,
+            }).encode()
+            self.send_response(200)
+            self.send_header("Content-Type", "application/json")
+            self.send_header("Content-Length", str(len(body)))
+            self.send_header("Cache-Control", "no-cache")
+            self.end_headers()
+            self.wfile.write(body)
+
+        def send_package(self, size, sha256):
+            etag = f'"{sha256[:32]}"'
+            start, end = 0, size
+            partial = False
+            range_header = self.headers.get("Range")
+            if_range = self.headers.get("If-Range")
+            # If-Range mit altem ETag: Datei wurde ersetzt, also komplett ausliefern
+            if range_header and (if_range is None or if_range == etag):
+                parsed = parse_range(range_header, size)
+                if parsed is None:
+                    self.send_response(416)
+                    self.send_header("Content-Range", f"bytes */{size}")
+                    self.send_header("Content-Length", "0")
+                    self.end_headers()
+                    return
+                start, end = parsed
+                partial = True
+
+            self.send_response(206 if partial else 200)
+            self.send_header("Content-Type", "application/x-tar")
+            self.send_header("Content-Length", str(end - start))
+            self.send_header("Accept-Ranges", "bytes")
+            self.send_header("ETag", etag)
+            if partial:
+                self.send_header("Content-Range", f"bytes {start}-{end - 1}/{size}")
+            self.end_headers()
+
+            sent = 0
+            began = time.monotonic()
+            with open(package.path, "rb") as f:
+                f.seek(start)
+                while start + sent < end:
+                    data = f.read(min(CHUNK, end - start - sent))
+                    if args.drop_after and sent + len(data) > args.drop_after:
+                        data = data[:args.drop_after - sent]
+                        self.wfile.write(data)
+                        print(f"  Verbindung nach {start + sent + len(data)} Bytes abgebrochen (--drop-after)")
+                        self.close_connection = True
+                        return
+                    self.wfile.write(data)
+                    sent += len(data)
+                    if args.rate:
+                        ahead = sent / (args.rate * 1024) - (time.monotonic() - began)
+                        if ahead > 0:
+                            time.sleep(ahead)
+
+    return Handler
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Update-Server für den OTA-Pull-Modus")
+    parser.add_argument("--port", type=int, default=8070)
+    parser.add_argument("--package", type=Path, default=PROJECT_ROOT / "update.tar",
+                        help="Paket von build_ota_package.py (Standard: update.tar im Projekt)")
+    parser.add_argument("--version", default=None,
+                        help="Angebotene Version (Standard: FIRMWARE_VERSION aus src/Config.h)")
+    parser.add_argument("--drop-after", type=int, default=0, metavar="BYTES",
+                        help="Jede Paket-Antwort nach so vielen Bytes abbrechen (Test der Fortsetzung)")
+    parser.add_argument("--rate", type=float, default=0, metavar="KBPS",
+                        help="Server-seitige Drosselung in KB/s")
+    args = parser.parse_args()
+    if args.version is None:
+        args.version = firmware_version()
+    if not args.package.exists():
+        print(f"❌ {args.package} nicht gefunden - erst build_ota_package.py ausführen")
+        return 1
+
+    package = Package(args.package.resolve())
+    package.refresh()
+    server = ThreadingHTTPServer(("", args.port), make_handler(args, package))
+    print(f"Version {args.version} auf http://0.0.0.0:{args.port}/manifest.json")
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
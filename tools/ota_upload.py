@@ -0,0 +1,172 @@
+#!/usr/bin/env python3
+"""
+Fortsetzbarer OTA-Upload über /api/ota/session (HeatBodyVentilator)
+
+Schickt update.tar in CRC-geprüften Stücken von höchstens 16 KB, wie die
+Weboberfläche. Zwischen den Stücken bedient der HTTP-Server andere Anfragen,
+und nach einem Verbindungsabbruch geht es am zuletzt bestätigten Offset
+weiter. Ein zweiter Aufruf mit derselben Datei setzt eine offene Sitzung fort.
+
+Beispiele:
+  python3 tools/ota_upload.py 192.168.1.50 --password <passwort>
+  python3 tools/ota_upload.py 192.168.1.50 --token <token> --package update.tar
+"""
+
+import argparse
+import json
+import sys
+import time
+import urllib.error
+import urllib.request
+import zlib
+from pathlib import Path
+
+PROJECT_ROOT = Path(__file__).resolve().parent.parent
+MAX_RETRIES = 20
+
+
+def request(base, path, token, body, content_type, timeout):
+    """JSON-Antwort des Geräts als (Status, dict), auch bei 4xx; Netzwerkfehler werfen OSError.
+    Ohne body ein GET"""
+    sep = "&" if "?" in path else "?"
+    req = urllib.request.Request(f"{base}{path}{sep}token={token}", data=body,
+                                 method="POST" if body is not None else "GET",
+                                 headers={"Content-Type": content_type})
+    try:
+        with urllib.request.urlopen(req, timeout=timeout) as response:
+            return response.status, json.loads(response.read() or b"{}")
+    except urllib.error.HTTPError as err:
+        try:
+            return err.code, json.loads(err.read() or b"{}")
+        except ValueError:
+            return err.code, {}
+
+
+def login(base, password):
+    status, data = request(base, "/api/login", "", json.dumps({"password": password}).encode(),
+                           "application/json", 10)
+    if status != 200 or "token" not in data:
+        raise SystemExit(f"❌ Login fehlgeschlagen (HTTP {status})")
+    return data["token"]
+
+
+def open_session(base, token, package, label):
+    body = json.dumps({"size": len(package), "label": label}).encode()
+    status, data = request(base, "/api/ota/session", token, body, "application/json", 10)
+    if status != 200 or data.get("status") not in ("ok", "success"):
+        raise RuntimeError(data.get("message", f"HTTP {status}"))
+    return data
+
+
+def confirm(base, token, label):
+    """Nach dem letzten Stück ohne Antwort: True = installiert, False = fehlgeschlagen,
+    None = Sitzung noch offen (Stück kam nie an). Ein Neustart zählt als Erfolg, nur
+    nach erfolgreichem Update startet das Gerät von selbst neu."""
+    unreachable = False
+    for _ in range(MAX_RETRIES):
+        try:
+            _, session = request(base, "/api/ota/session", token, None, "application/json", 5)
+            if unreachable:
+                return True
+            if session.get("active") and session.get("label") == label:
+                return None
+            _, status = request(base, "/api/ota/status", token, None, "application/json", 5)
+            if status.get("state") == "done":
+                return True
+            if status.get("state") in ("failed", "idle"):
+                print(f"\n❌ {status.get('error', 'Upload-Sitzung auf dem Gerät nicht mehr vorhanden')}")
+                return False
+        except OSError:
+            unreachable = True   # Startet neu
+        time.sleep(2)
+    print("\n❌ Gerät nach dem Upload nicht wieder erreichbar")
+    return False
+
+
+def upload(base, token, path):
+    package = path.read_bytes()
+    stat = path.stat()
+    label = f"{path.name}|{stat.st_size}|{int(stat.st_mtime * 1000)}"[:64]
+    session = open_session(base, token, package, label)
+    if session["status"] == "success":
+        print("Paket ist bereits installiert, Gerät startet neu")
+        return 0
+    offset = session["offset"]
+    if offset > 0:
+        print(f"Setze Sitzung {session['session']} bei {offset} Bytes fort")
+
+    retries = 0
+    final_sent = False   # Das letzte Stück ging mindestens einmal raus
+    while True:
+        chunk = package[offset:offset + session["chunk"]]
+        final_sent = final_sent or offset + len(chunk) >= len(package)
+        path_query = (f"/api/ota/session/chunk?session={session['session']}&offset={offset}"
+                      f"&crc={zlib.crc32(chunk):x}")
+        try:
+            status, data = request(base, path_query, token, chunk, "application/octet-stream", 60)
+        except OSError as err:
+            status, data = 0, {"message": str(err)}
+
+        if status == 200 and data.get("status") == "success":
+            print(f"\r{len(package)}/{len(package)} Bytes - Update erfolgreich, Gerät startet neu")
+            return 0
+        if final_sent and (status == 404 or status == 0 or status >= 500):
+            # Antwort auf das letzte Stück verloren: nicht neu öffnen, das flasht nach dem Neustart erneut
+            installed = confirm(base, token, label)
+            if installed is not None:
+                if installed:
+                    print(f"\r{len(package)}/{len(package)} Bytes - Update erfolgreich, Gerät neu gestartet")
+                return 0 if installed else 1
+            final_sent = False
+            status = 0   # Sitzung noch offen: Offset neu erfragen
+        if status == 200 and data.get("status") == "ok":
+            offset = data["offset"]
+            retries = 0
+            print(f"\r{offset}/{len(package)} Bytes", end="", flush=True)
+            continue
+        if status in (200, 404):
+            print(f"\n❌ {data.get('message', f'HTTP {status}')}")
+            return 1
+        if status in (400, 409) and "offset" in data:
+            offset = data["offset"]   # Beschädigtes oder falsch platziertes Stück
+        else:
+            # Abbruch, Ratenbegrenzung oder 5xx: Offset nach der Pause neu erfragen
+            time.sleep(min(retries + 1, 10))
+            try:
+                session = open_session(base, token, package, label)
+                if session["status"] == "success":
+                    print(f"\r{len(package)}/{len(package)} Bytes - Update erfolgreich, Gerät startet neu")
+                    return 0
+                offset = session["offset"]
+            except (OSError, RuntimeError) as err:
+                print(f"\n⚠️  {err}")
+        retries += 1
+        if retries > MAX_RETRIES:
+            print(f"\n❌ Nach {MAX_RETRIES} Versuchen aufgegeben")
+            return 1
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("host", help="IP oder Hostname des Geräts")
+    parser.add_argument("--package", type=Path, default=PROJECT_ROOT / "update.tar",
+                        help="Paket von build_ota_package.py (Standard: update.tar im Projekt)")
+    auth = parser.add_mutually_exclusive_group(required=True)
+    auth.add_argument("--token", help="Login-Token")
+    auth.add_argument("--password", help="Web-Passwort, meldet sich damit an")
+    args = parser.parse_args()
+
+    base = args.host if args.host.startswith("http") else f"http://{args.host}"
+    if not args.package.exists():
+        print(f"❌ {args.package} nicht gefunden - erst build_ota_package.py ausführen")
+        return 1
+    token = args.token or login(base, args.password)
+    try:
+        return upload(base, token, args.package)
+    except RuntimeError as err:
+        print(f"❌ {err}")
+        return 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
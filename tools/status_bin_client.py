@@ -0,0 +1,143 @@
+#!/usr/bin/env python3
+"""
+Decoder und Benchmark für /api/status.bin (HeatBodyVentilator)
+
+Format: siehe src/StatusBinary.h ("HBVS", little-endian, Formatversion 2;
+Version 1 älterer Firmware mit int16-Temperaturen wird ebenfalls gelesen)
+
+Beispiele:
+  python3 tools/status_bin_client.py 192.168.1.50 --token <token>
+  python3 tools/status_bin_client.py 192.168.1.50 --token <token> --bench 200
+"""
+
+import argparse
+import json
+import struct
+import sys
+import time
+import urllib.error
+import urllib.request
+
+MAGIC = b"HBVS"
+HEADER = struct.Struct("<4sBBH")
+RECORD_V1 = struct.Struct("<4sBBHIIIIhhhHBbHHBBIhh")
+RECORD_V2 = struct.Struct("<4sBBHIIIIiiiHBbHHBBHIii")
+RECORDS = {1: RECORD_V1, 2: RECORD_V2}
+
+FLAGS = (
+    "sensor_initialized",
+    "sensor_ready",
+    "wifi_connected",
+    "mqtt_connected",
+    "manual_mode",
+    "auto_pwm",
+    "led_on",
+    "rpm_valid",
+)
+
+NO_VALUE = {1: -32768, 2: -2147483648}
+
+JSON_ENDPOINTS = ("/api/dashboard", "/api/kmeter-status", "/api/pwm-status", "/api/status")
+
+
+def decode(data):
+    """Dekodiert einen Datensatz; unbekannte Felder hinter dem Datensatz werden ignoriert"""
+    if len(data) < HEADER.size:
+        raise ValueError("Datensatz zu kurz")
+    magic, version, _, length = HEADER.unpack_from(data)
+    if magic != MAGIC:
+        raise ValueError(f"Falsche Kennung {magic!r}")
+    record = RECORDS.get(version)
+    if record is None or length < record.size or len(data) < record.size:
+        raise ValueError(f"Nicht unterstützte Formatversion {version} / Länge {length}")
+
+    fields = record.unpack_from(data)
+    if version == 1:
+        fields = fields[:18] + (0,) + fields[18:]   # Ohne das Reserve-Feld vor manual_freq
+    (_, _, _, _, seq, uptime, free_heap, min_free_heap, temp_c, temp_f, internal,
+     duty_raw, duty_percent, rssi, flags, rpm, sensor_error, manual_duty, _, manual_freq,
+     temp_start, temp_max) = fields
+
+    def centi(value):
+        return None if value == NO_VALUE[version] else value / 100.0
+
+    status = {
+        "seq": seq,
+        "uptime_s": uptime,
+        "free_heap": free_heap,
+        "min_free_heap": min_free_heap,
+        "temperature_c": centi(temp_c),
+        "temperature_f": centi(temp_f),
+        "internal_temperature": centi(internal),
+        "duty_raw": duty_raw,
+        "duty_percent": duty_percent,
+        "wifi_rssi": rssi,
+        "rpm": rpm if flags & (1 << 7) else None,
+        "sensor_error": sensor_error,
+        "manual_duty": manual_duty,
+        "manual_freq": manual_freq,
+        "temp_start": centi(temp_start),
+        "temp_max": centi(temp_max),
+    }
+    for bit, name in enumerate(FLAGS):
+        status[name] = bool(flags & (1 << bit))
+    return status
+
+
+def fetch(base, path, token):
+    """Abruf; bei 429 (Ratenbegrenzung des Geräts) wird Retry-After abgewartet"""
+    sep = "&" if "?" in path else "?"
+    url = f"{base}{path}{sep}token={token}" if token else f"{base}{path}"
+    while True:
+        try:
+            with urllib.request.urlopen(url, timeout=5) as response:
+                return response.read()
+        except urllib.error.HTTPError as err:
+            if err.code != 429:
+                raise
+            time.sleep(int(err.headers.get("Retry-After", "1")))
+
+
+def bench(base, token, count):
+    """Vergleicht Latenz, Größe und Dekodierzeit von status.bin mit den JSON-Endpunkten"""
+    endpoints = [("/api/status.bin", decode)] + [(path, json.loads) for path in JSON_ENDPOINTS]
+
+    print(f"{'Endpunkt':<22}{'Bytes':>8}{'ms/Abruf':>11}{'us/Dekodieren':>15}")
+    for path, parse in endpoints:
+        size = 0
+        fetch_time = 0.0
+        parse_time = 0.0
+        for _ in range(count):
+            # Unter dem Limit pro Client bleiben (8 Anfragen/s), sonst misst man Wartezeit
+            time.sleep(0.15)
+            start = time.perf_counter()
+            body = fetch(base, path, token)
+            fetch_time += time.perf_counter() - start
+
+            start = time.perf_counter()
+            parse(body)
+            parse_time += time.perf_counter() - start
+            size = len(body)
+        print(f"{path:<22}{size:>8}{fetch_time / count * 1000:>11.1f}{parse_time / count * 1e6:>15.1f}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("host", help="IP oder Hostname des Geräts")
+    parser.add_argument("--token", default="", help="Login-Token")
+    parser.add_argument("--bench", type=int, metavar="N", help="N Abrufe pro Endpunkt messen")
+    args = parser.parse_args()
+
+    base = args.host if args.host.startswith("http") else f"http://{args.host}"
+
+    if args.bench:
+        bench(base, args.token, args.bench)
+        return 0
+
+    status = decode(fetch(base, "/api/status.bin", args.token))
+    print(json.dumps(status, indent=2))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())